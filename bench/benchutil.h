@@ -0,0 +1,134 @@
+//-----------------------------------------------------------------------------
+// benchutil - Timer and result helpers shared by the bench programs.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+#include <windows.h>
+#include <psapi.h>
+#include <chrono>
+#include <initializer_list>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Wall clock time since construction or Reset.
+class BenchTimer
+{
+public:
+    BenchTimer() : m_start(std::chrono::steady_clock::now())
+    { }
+
+    void Reset()
+    { m_start = std::chrono::steady_clock::now(); }
+
+    double Ms() const
+    { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count(); }
+
+private:
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// Process working set in bytes, current or peak.
+inline size_t BenchWorkingSet(bool peak = false)
+{
+    PROCESS_MEMORY_COUNTERS counters;
+    memset(&counters, 0, sizeof(counters));
+    counters.cb = sizeof(counters);
+    if ( !GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return peak ? counters.PeakWorkingSetSize : counters.WorkingSetSize;
+}
+
+// Optional count argument, argv[idx] if present else defCnt.
+// Exit with code 2 if argument is not a number.
+inline size_t BenchArg(int argc, char* argv[], int idx, size_t defCnt)
+{
+    if (argc <= idx)
+        return defCnt;
+
+    char* pEnd = NULL;
+    const size_t value = (size_t)strtoull(argv[idx], &pEnd, 10);
+    if (argv[idx][0] < '0' || argv[idx][0] > '9' || *pEnd != '\0')
+    {
+        printf("Count argument %s is not a number\n", argv[idx]);
+        exit(2);
+    }
+    return value;
+}
+
+// Print check summary, return process exit code, 0 if no mismatches.
+inline int BenchResult(const char* name, size_t cases, size_t bad)
+{
+    printf("%s: %zu cases, %zu mismatches\n", name, cases, bad);
+    return (bad == 0) ? 0 : 1;
+}
+
+// Check body, count from "check [count]" or the bench default, adds cases
+// run to cases and returns mismatches.
+typedef size_t (*BenchCheckFn)(size_t count, size_t& cases);
+// Time or other mode body, returns process exit code.
+typedef int (*BenchModeFn)(int argc, char* argv[]);
+
+struct BenchMode
+{
+    const char*     name;
+    BenchModeFn     run;
+};
+
+// Run mode argv[1], time, one of extra modes or check, which is also run
+// when no mode is given. Mode arguments start at argv[2]. check takes an
+// optional count, checkCnt if none given, or no argument if checkCnt is 0.
+// Return process exit code, 2 if mode or count is not valid.
+inline int BenchMain(int argc, char* argv[], const char* name, BenchCheckFn checkFn, size_t checkCnt,
+    BenchModeFn timeFn, std::initializer_list<BenchMode> extra = {})
+{
+    const char* mode = (argc > 1) ? argv[1] : "check";
+    if (strcmp(mode, "check") == 0)
+    {
+        if (checkCnt == 0 && argc > 2)
+        {
+            printf("%s check takes no count\n", name);
+            return 2;
+        }
+        size_t cases = 0;
+        const size_t bad = checkFn(BenchArg(argc, argv, 2, checkCnt), cases);
+        return BenchResult(name, cases, bad);
+    }
+    if (strcmp(mode, "time") == 0)
+        return timeFn(argc, argv);
+    for (const BenchMode& benchMode : extra)
+    {
+        if (strcmp(mode, benchMode.name) == 0)
+            return benchMode.run(argc, argv);
+    }
+
+    printf("Unknown mode %s, see usage at top of %s.cpp\n", mode, name);
+    return 2;
+}
@@ -0,0 +1,246 @@
+//-----------------------------------------------------------------------------
+// cmpgroupbench - Check and time LLCmp::GroupDirEntries, llcmp match groups.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+//
+// Usage: cmpgroupbench [mode [args]]
+//
+//  check               ; Random left and right trees, few names and directories which
+//                        differ in case or upper levels. Every group must hold entries
+//                        with the same name and last levels directories, no two groups
+//                        may match, each group is sorted by directory and no entry is lost.
+//  time <count>        ; Group count entries over two trees, GroupDirEntries against
+//                        the std::set ordering llcmp used before.
+
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include <climits>
+
+#include "llcmp.h"
+#include "benchutil.h"
+
+static const char* const sRoots[] = { "c:\\left", "c:\\right" };
+
+// ---------------------------------------------------------------------------
+// Last levels directories of entry below its scan directory, see -l.
+static std::string RefMatchDir(const LLDirEntry* pDirEnt, unsigned levels)
+{
+    const std::string dir = pDirEnt->szDir + pDirEnt->baseDirLen;
+    size_t pos = dir.length();
+    for (unsigned level = 0; level < levels && pos != 0; level++)
+    {
+        const size_t slash = dir.rfind('\\', pos - 1);
+        pos = (slash == std::string::npos) ? 0 : slash;
+    }
+    return dir.substr(pos);
+}
+
+static bool RefSameMatch(const LLDirEntry* pLeft, const LLDirEntry* pRight, unsigned levels)
+{
+    return _stricmp(pLeft->filenameLStr, pRight->filenameLStr) == 0
+        && _stricmp(RefMatchDir(pLeft, levels).c_str(), RefMatchDir(pRight, levels).c_str()) == 0;
+}
+
+// ---------------------------------------------------------------------------
+// Ordering of the std::set llcmp grouped with before GroupDirEntries, kept for timing.
+class OldCompareDirLevels
+{
+public:
+    static void SetLevels(unsigned levels)
+    { s_levels = levels; }
+
+    static const char* GetDir(const LLDirEntry* pDirEnt)
+    {
+        const int sMaxLevels = 50;
+        const char* dirs[sMaxLevels];
+        int dirLevel = 0;
+        const char* pDirStr = pDirEnt->szDir + pDirEnt->baseDirLen;
+        while (*pDirStr != 0 && dirLevel < sMaxLevels)
+        {
+            if (*pDirStr == '\\')
+                dirs[dirLevel++] = pDirStr;
+            pDirStr++;
+        }
+        dirLevel--;
+        if (dirLevel >= (int)s_levels)
+            return dirs[dirLevel - s_levels];
+        return (dirLevel < 0) ? "" : dirs[0];
+    }
+
+    static bool Compare(LLDirEntry* pDirEnt1, LLDirEntry* pDirEnt2)
+    {
+        int nameCmp = _stricmp(pDirEnt1->filenameLStr, pDirEnt2->filenameLStr);
+        if (nameCmp == 0)
+            nameCmp = _stricmp(GetDir(pDirEnt1), GetDir(pDirEnt2));
+        const int fullCmp = (nameCmp != 0) ? nameCmp : _stricmp(pDirEnt1->szDir, pDirEnt2->szDir);
+        return fullCmp < 0;
+    }
+
+    static unsigned s_levels;
+};
+unsigned OldCompareDirLevels::s_levels = 0;
+
+static size_t OldSortEntries(LLDirSort& dirSort, unsigned levels)
+{
+    OldCompareDirLevels::SetLevels(levels);
+    std::set<LLDirEntry*, bool(*)(LLDirEntry*, LLDirEntry*)> sortedSet(OldCompareDirLevels::Compare);
+    for (LLDirEntry* pDirEntry = dirSort.m_pFirst; pDirEntry != nullptr; pDirEntry = pDirEntry->pNext)
+        sortedSet.insert(pDirEntry);
+    return sortedSet.size();
+}
+
+// ---------------------------------------------------------------------------
+// Add count entries under each root. Check trees use few short names and
+// directories which differ only in case, time trees a realistic layout.
+static void AddTrees(LLCmp& cmp, std::mt19937& rng, size_t count, bool timeTree)
+{
+    LLDirSort& dirSort = cmp.m_dirSort;
+    WIN32_FIND_DATA findData;
+    char dirName[128];
+
+    for (const char* pRoot : sRoots)
+    {
+        dirSort.m_baseDirLen = (int)strlen(pRoot);
+        for (size_t idx = 0; idx < count; idx++)
+        {
+            memset(&findData, 0, sizeof(findData));
+            findData.dwFileAttributes = FILE_ATTRIBUTE_ARCHIVE;
+            if (timeTree)
+            {
+                snprintf(findData.cFileName, sizeof(findData.cFileName), "file%zu.txt", idx);
+                const unsigned dirIdx = (unsigned)(idx % 1000);
+                snprintf(dirName, sizeof(dirName), "%s\\src\\m%u\\sub%u", pRoot, dirIdx % 97, dirIdx);
+            }
+            else
+            {
+                for (unsigned len = 1 + rng() % 3, pos = 0; pos < len; pos++)
+                    findData.cFileName[pos] = "aAb"[rng() % 3];
+                static const char* const sSubDirs[] = { "", "\\X\\y", "\\x\\Y", "\\z\\x\\y", "\\a\\y", "\\Y" };
+                snprintf(dirName, sizeof(dirName), "%s%s", pRoot, sSubDirs[rng() % 6]);
+            }
+            LLDirSort::SortCb(&dirSort, dirName, &findData, 1);
+        }
+    }
+    dirSort.Sort();
+}
+
+// ---------------------------------------------------------------------------
+static size_t CheckGroups(size_t, size_t& cases)
+{
+    std::mt19937 rng(7);
+    size_t bad = 0;
+
+    for (unsigned round = 0; round < 400; round++)
+    {
+        LLCmp cmp;
+        cmp.m_dirSort.SetSort(cmp.m_dirScan, "n", false, true);
+        cmp.m_dirSort.m_onlyAttr = (DWORD)-1;
+        const unsigned levels = (round % 5 == 0) ? UINT_MAX : rng() % 4;
+        AddTrees(cmp, rng, 1 + rng() % 200, false);
+
+        DirEntryList entries;
+        std::vector<size_t> groupEnds;
+        cmp.GroupDirEntries(levels, entries, groupEnds);
+        cases++;
+
+        size_t listed = 0;
+        for (const LLDirEntry* pEntry = cmp.m_dirSort.m_pFirst; pEntry != nullptr; pEntry = pEntry->pNext)
+            listed++;
+        if (listed != entries.size() || (groupEnds.empty() ? 0 : groupEnds.back()) != entries.size())
+        {
+            bad++;
+            printf("Grouped %zu of %zu entries, levels=%u\n", entries.size(), listed, levels);
+            continue;
+        }
+
+        size_t beg = 0;
+        std::vector<const LLDirEntry*> groupFirst;
+        for (size_t grpEnd : groupEnds)
+        {
+            for (size_t idx = beg; idx < grpEnd; idx++)
+            {
+                if ( !RefSameMatch(entries[beg], entries[idx], levels)
+                    || (idx > beg && _stricmp(entries[idx - 1]->szDir, entries[idx]->szDir) > 0))
+                {
+                    if (bad++ < 5)
+                        printf("Group member %s\\%s with %s\\%s, levels=%u\n",
+                            entries[idx]->szDir, (const char*)entries[idx]->filenameLStr,
+                            entries[beg]->szDir, (const char*)entries[beg]->filenameLStr, levels);
+                }
+            }
+            for (const LLDirEntry* pFirst : groupFirst)
+            {
+                if (RefSameMatch(pFirst, entries[beg], levels) && bad++ < 5)
+                    printf("Split group %s\\%s, levels=%u\n",
+                        entries[beg]->szDir, (const char*)entries[beg]->filenameLStr, levels);
+            }
+            groupFirst.push_back(entries[beg]);
+            beg = grpEnd;
+        }
+    }
+
+    return bad;
+}
+
+// ---------------------------------------------------------------------------
+static int RunTime(size_t count)
+{
+    std::mt19937 rng(7);
+    LLCmp cmp;
+    cmp.m_dirSort.SetSort(cmp.m_dirScan, "n", false, true);
+    cmp.m_dirSort.m_onlyAttr = (DWORD)-1;
+    AddTrees(cmp, rng, count / 2, true);
+
+    DirEntryList entries;
+    std::vector<size_t> groupEnds;
+    BenchTimer timer;
+    cmp.GroupDirEntries(30, entries, groupEnds);
+    const double groupMs = timer.Ms();
+
+    timer.Reset();
+    const size_t oldCount = OldSortEntries(cmp.m_dirSort, 30);
+    const double oldMs = timer.Ms();
+
+    printf("entries=%zu groups=%zu  GroupDirEntries %.0f ms  old std::set %.0f ms (%zu)\n",
+        entries.size(), groupEnds.size(), groupMs, oldMs, oldCount);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+static int TimeMode(int argc, char* argv[])
+{
+    return RunTime(BenchArg(argc, argv, 2, 2000000));
+}
+
+// ---------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    return BenchMain(argc, argv, "cmpgroupbench", CheckGroups, 0, TimeMode);
+}
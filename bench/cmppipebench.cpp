@@ -0,0 +1,191 @@
+//-----------------------------------------------------------------------------
+// cmppipebench - Check and time llcmp -j, the parallel compare pipe.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+//
+// Usage: cmppipebench [mode [args]]
+//
+//  check               ; Temp left and right trees of equal, different, shorter and
+//                        one sided files, binary and text, a few over 1MB. DoCmp
+//                        output and counts with -j=2..8 must match the serial run,
+//                        and workers must not write per file progress.
+//  time <pairs> <sizeKB> <threads>
+//                      ; Binary compare of pairs equal files, serial against -j.
+//
+// Trees are made in the temp directory and removed.
+
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cmptrees.h"
+#include "benchutil.h"
+
+// ---------------------------------------------------------------------------
+static std::string RandomText(std::mt19937& rng, unsigned lines)
+{
+    static const char* const sWords[] = { "alpha", "beta", "gamma", "delta", "  ", "\t", "x" };
+    std::string text;
+    for (unsigned line = 0; line < lines; line++)
+    {
+        for (unsigned word = rng() % 8; word != 0; word--)
+            text += sWords[rng() % 7];
+        text += (rng() % 4 == 0) ? "\r\n" : "\n";
+    }
+    return text;
+}
+
+// Add a pair of files, or one sided file, of a random kind.
+static void AddPair(TempTrees& trees, const std::vector<LLCmp*>& cmps, std::mt19937& rng, bool text, unsigned fileIdx)
+{
+    std::string left;
+    if (text)
+        left = RandomText(rng, rng() % 200);
+    else
+    {
+        const size_t size = (fileIdx % 40 == 7) ? 1536 * 1024 : rng() % 100000;
+        left.resize(size);
+        for (char& chr : left)
+            chr = (char)(rng() % 4);
+    }
+
+    std::string right = left;
+    const unsigned kind = rng() % 6;
+    switch (kind)
+    {
+    case 1:     // Different bytes or lines
+    case 2:
+        if (text)
+            right.insert(rng() % (right.size() + 1), "inserted line\n");
+        else if ( !right.empty())
+            for (unsigned cnt = 1 + rng() % 20; cnt != 0; cnt--)
+                right[rng() % right.size()] ^= 0x10;
+        break;
+    case 3:     // Shorter
+        right.resize(right.size() / 2);
+        break;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), text ? "file%u.txt" : "file%u.bin", fileIdx);
+    char subDir[32];
+    snprintf(subDir, sizeof(subDir), "dir%u", fileIdx % 7);
+    if (kind != 4)
+        trees.Add(cmps, true, subDir, name, left);
+    if (kind != 5)
+        trees.Add(cmps, false, subDir, name, right);
+}
+
+// ---------------------------------------------------------------------------
+static size_t CheckPipe(size_t, size_t& cases)
+{
+    std::mt19937 rng(11);
+    size_t bad = 0;
+
+    for (unsigned round = 0; round < 12; round++)
+    {
+        const bool text = (round % 2) != 0;
+        const bool verbose = (round % 3) == 2;
+        TempTrees trees("llcmp_pipebench");
+        BenchCmp serialCmp(trees, text, verbose, 1);
+        BenchCmp parallelCmp(trees, text, verbose, 2 + round % 7);
+        const std::vector<LLCmp*> cmps = { &serialCmp, &parallelCmp };
+
+        const unsigned fileCnt = 20 + rng() % 120;
+        for (unsigned fileIdx = 0; fileIdx < fileCnt; fileIdx++)
+            AddPair(trees, cmps, rng, text, fileIdx);
+
+        std::string serialErr, parallelErr;
+        const std::string serialOut = serialCmp.Compare(serialErr);
+        const std::string parallelOut = parallelCmp.Compare(parallelErr);
+        cases++;
+
+        if (serialOut != parallelOut)
+        {
+            size_t pos = 0;
+            while (pos < serialOut.size() && serialOut[pos] == parallelOut[pos])
+                pos++;
+            if (bad++ < 5)
+                printf("Round %u text=%d output differs at %zu:\n  serial   [%.80s]\n  parallel [%.80s]\n",
+                    round, text, pos, serialOut.c_str() + pos,
+                    parallelOut.c_str() + (pos < parallelOut.size() ? pos : parallelOut.size()));
+        }
+        if (parallelErr.find(" %\r") != std::string::npos && bad++ < 5)
+            printf("Round %u text=%d -j workers wrote per file progress\n", round, text);
+    }
+
+    return bad;
+}
+
+// ---------------------------------------------------------------------------
+static int RunTime(size_t pairCnt, size_t sizeKB, unsigned threads)
+{
+    TempTrees trees("llcmp_pipebench");
+    BenchCmp serialCmp(trees, false, false, 1);
+    BenchCmp parallelCmp(trees, false, false, threads);
+    const std::vector<LLCmp*> cmps = { &serialCmp, &parallelCmp };
+    std::mt19937 rng(3);
+    std::string data(sizeKB * 1024, '\0');
+    for (char& chr : data)
+        chr = (char)rng();
+
+    char name[32];
+    for (size_t idx = 0; idx < pairCnt; idx++)
+    {
+        snprintf(name, sizeof(name), "file%zu.bin", idx);
+        data[idx % data.size()]++;
+        trees.Add(cmps, true, "dir", name, data);
+        trees.Add(cmps, false, "dir", name, data);
+    }
+
+    std::string errText;
+    const double MB = pairCnt * 2.0 * sizeKB / 1024.0;
+    BenchTimer timer;
+    serialCmp.Compare(errText);
+    const double serialMs = timer.Ms();
+    timer.Reset();
+    parallelCmp.Compare(errText);
+    const double parallelMs = timer.Ms();
+
+    printf("pairs=%zu size=%zuKB  serial %.0f ms (%.0f MB/s)  -j=%u %.0f ms (%.0f MB/s)\n",
+        pairCnt, sizeKB, serialMs, MB * 1000 / serialMs, threads, parallelMs, MB * 1000 / parallelMs);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+static int TimeMode(int argc, char* argv[])
+{
+    return RunTime(BenchArg(argc, argv, 2, 2000), BenchArg(argc, argv, 3, 256), (unsigned)BenchArg(argc, argv, 4, 8));
+}
+
+// ---------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    return BenchMain(argc, argv, "cmppipebench", CheckPipe, 0, TimeMode);
+}
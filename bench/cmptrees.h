@@ -0,0 +1,197 @@
+//-----------------------------------------------------------------------------
+// cmptrees - Temp left and right trees and an LLCmp driver for the llcmp benches.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "llcmp.h"
+
+// ---------------------------------------------------------------------------
+// Temp left and right trees below %TMP%\name, files removed by the destructor.
+class TempTrees
+{
+public:
+    explicit TempTrees(const char* name)
+    {
+        char tmpDir[LL_MAX_PATH];
+        GetTempPath(ARRAYSIZE(tmpDir), tmpDir);
+        m_root = std::string(tmpDir) + name;
+        m_left = m_root + "\\left";
+        m_right = m_root + "\\right";
+        CreateDirectory(m_root.c_str(), NULL);
+        CreateDirectory(m_left.c_str(), NULL);
+        CreateDirectory(m_right.c_str(), NULL);
+    }
+
+    ~TempTrees()
+    {
+        for (const std::string& path : m_files)
+            DeleteFile(path.c_str());
+        for (auto iter = m_dirs.rbegin(); iter != m_dirs.rend(); ++iter)
+            RemoveDirectory(iter->c_str());
+        RemoveDirectory(m_left.c_str());
+        RemoveDirectory(m_right.c_str());
+        RemoveDirectory(m_root.c_str());
+    }
+
+    // Write file below left or right root, add it to each cmp.
+    bool Add(const std::vector<LLCmp*>& cmps, bool left, const std::string& subDir, const std::string& name, const std::string& data)
+    {
+        const std::string& root = left ? m_left : m_right;
+        const std::string dir = root + "\\" + subDir;
+        if (CreateDirectory(dir.c_str(), NULL))
+            m_dirs.push_back(dir);
+
+        const std::string path = dir + "\\" + name;
+        HANDLE hFile = CreateFile(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hFile == INVALID_HANDLE_VALUE)
+            return false;
+        DWORD written = 0;
+        const bool okay = WriteFile(hFile, data.data(), (DWORD)data.size(), &written, NULL) && written == data.size();
+        CloseHandle(hFile);
+        m_files.push_back(path);
+
+        WIN32_FIND_DATA findData;
+        memset(&findData, 0, sizeof(findData));
+        strcpy_s(findData.cFileName, ARRAYSIZE(findData.cFileName), name.c_str());
+        findData.dwFileAttributes = FILE_ATTRIBUTE_ARCHIVE;
+        findData.nFileSizeLow = (DWORD)data.size();
+        for (LLCmp* pCmp : cmps)
+        {
+            pCmp->m_dirSort.m_baseDirLen = (int)root.length();
+            LLDirSort::SortCb(&pCmp->m_dirSort, dir.c_str(), &findData, 1);
+        }
+        return okay;
+    }
+
+    std::string m_root;
+    std::string m_left;
+    std::string m_right;
+
+private:
+    std::vector<std::string> m_files;
+    std::vector<std::string> m_dirs;
+};
+
+// ---------------------------------------------------------------------------
+// LLCmp set up as llcmp -a [-t] [-V=quitAfter] [-j=threads] on the two trees.
+class BenchCmp : public LLCmp
+{
+public:
+    BenchCmp(const TempTrees& trees, bool text, bool verbose, unsigned threads, unsigned quitAfter = 10)
+    {
+        m_compareDataMode = text ? eCompareText : eCompareBinary;
+        m_showDiff = m_showEqual = m_showSkipLeft = m_showSkipRight = true;
+        m_verbose = verbose;
+        m_quitByteLimit = quitAfter;
+        m_dirScan.m_threads = threads;
+        m_dirs.push_back(trees.m_left);
+        m_dirs.push_back(trees.m_right);
+        m_dirSort.SetSort(m_dirScan, "n", true, true);
+        m_dirSort.m_onlyAttr = (DWORD)-1;
+    }
+
+    // Run DoCmp, return its output and counts, per file progress in errText.
+    std::string Compare(std::string& errText)
+    {
+        m_dirSort.Sort();
+        std::ostringstream outStream, errStream;
+        std::streambuf* pOutBuf = std::cout.rdbuf(outStream.rdbuf());
+        std::streambuf* pErrBuf = std::cerr.rdbuf(errStream.rdbuf());
+        DoCmp(m_levels);
+        std::cout.rdbuf(pOutBuf);
+        std::cerr.rdbuf(pErrBuf);
+
+        errText = errStream.str();
+        outStream << "Eq:" << m_equalCount << " Ne:" << m_diffCount << " Er:" << m_errorCount
+            << " SL:" << m_skipCount[0] << " SR:" << m_skipCount[1] << "\n";
+        return outStream.str();
+    }
+};
+
+// ---------------------------------------------------------------------------
+// LLCmp set up as llcmp -h=<hashName> [-c=chunkMB] [-j=threads] [-v] -q
+// on the left tree.
+class HashCmp : public BenchCmp
+{
+public:
+    HashCmp(const TempTrees& trees, const char* hashName, unsigned chunkMB = 0, unsigned threads = 1, bool verbose = false) :
+        BenchCmp(trees, false, verbose, threads)
+    {
+        m_showMD5hash = true;
+        m_hashName = hashName;
+        m_treeChunkMB = chunkMB;
+        m_quiet = true;
+    }
+
+    // Run HashFiles, return its "hash, size, path" lines.
+    std::string Hash()
+    {
+        m_dirSort.Sort();
+        std::ostringstream outStream;
+        std::streambuf* pOutBuf = std::cout.rdbuf(outStream.rdbuf());
+        HashFiles();
+        std::cout.rdbuf(pOutBuf);
+        return outStream.str();
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Line of HashFiles output, "hash, size, path".
+struct HashLine
+{
+    std::string hash;
+    size_t      size;
+    std::string path;
+};
+
+inline std::vector<HashLine> ParseHashLines(const std::string& output)
+{
+    std::vector<HashLine> hashLines;
+    std::istringstream lines(output);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        const size_t comma1 = line.find(", ");
+        const size_t comma2 = line.find(", ", comma1 + 1);
+        if (comma1 == std::string::npos || comma2 == std::string::npos || line.find_first_not_of("0123456789abcdef") != comma1)
+            continue;       // Title line
+        HashLine hashLine;
+        hashLine.hash = line.substr(0, comma1);
+        hashLine.size = (size_t)strtoull(line.c_str() + comma1 + 1, NULL, 10);
+        hashLine.path = line.substr(comma2 + 2);
+        hashLines.push_back(hashLine);
+    }
+    return hashLines;
+}
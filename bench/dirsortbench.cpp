@@ -0,0 +1,498 @@
+//-----------------------------------------------------------------------------
+// dirsortbench - Check and time LLDirSort, the ld -S sorted listing.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+//
+// Usage: dirsortbench [mode [args]]
+//
+//  check               ; Sort of random entries, every key and direction, must
+//                        match the reference order: sort field, then name, then
+//                        scan order. Includes 200K entry lists (parallel sort).
+//  time <count> <key> [all]
+//                      ; Add count entries named IMG_<random>.jpg, 500 per directory,
+//                        with random size and time. Report working set growth per
+//                        entry while adding, and Sort() time. all keeps all columns.
+//  intern <count> <dirs>
+//                      ; Add count entries spread over dirs long directories, first
+//                        in directory order then interleaved. Report name pool and
+//                        total allocated bytes. Interleaved must pool the same bytes
+//                        and share one directory pointer per directory.
+//  spill               ; ShowSorted with a small memory budget, entries spilled to
+//                        temp file runs and merged, must match the in-memory output.
+//                        Some rounds make later spills fail (TMP set to a missing
+//                        directory), remaining entries must still be shown.
+//  spill <count> <key> <budgetMB>
+//                      ; Time add and ShowSorted of count entries with budgetMB
+//                        memory budget (0 = all in memory), report peak working set.
+
+#include <random>
+#include <string>
+#include <vector>
+#include <new>
+
+#include "lldirSort.h"
+#include "benchutil.h"
+
+// Bytes allocated by operator new, for intern mode.
+static size_t sNewBytes = 0;
+
+void* operator new(size_t size)
+{
+    sNewBytes += size;
+    void* ptr = malloc(size ? size : 1);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+static const char* const sSortKeys[] = { "n", "s", "m", "e", "t", "p" };
+
+// ---------------------------------------------------------------------------
+static ULONGLONG TimeValue(const FILETIME& fileTime)
+{
+    return ((ULONGLONG)fileTime.dwHighDateTime << 32) | fileTime.dwLowDateTime;
+}
+
+// ---------------------------------------------------------------------------
+// Reference order of two entries for sortKey, increasing. 0 if equal.
+static int RefCompare(const LLDirSort& dirSort, char sortKey, const LLDirEntry& left, const LLDirEntry& right)
+{
+    WIN32_FIND_DATA leftData, rightData;
+    memset(&leftData, 0, sizeof(leftData));
+    memset(&rightData, 0, sizeof(rightData));
+    dirSort.FillFindData(leftData, left);
+    dirSort.FillFindData(rightData, right);
+
+    ULONGLONG leftValue = 0, rightValue = 0;
+    switch (sortKey)
+    {
+    case 's':
+        leftValue  = ((ULONGLONG)leftData.nFileSizeHigh << 32) | leftData.nFileSizeLow;
+        rightValue = ((ULONGLONG)rightData.nFileSizeHigh << 32) | rightData.nFileSizeLow;
+        break;
+    case 'm':
+        leftValue  = TimeValue(leftData.ftLastWriteTime);
+        rightValue = TimeValue(rightData.ftLastWriteTime);
+        break;
+    case 't':
+        leftValue  = leftData.dwFileAttributes;
+        rightValue = rightData.dwFileAttributes;
+        break;
+    case 'e':
+    {
+        // Names without an extension first.
+        const char* pLeftExt  = strrchr(left.filenameLStr, '.');
+        const char* pRightExt = strrchr(right.filenameLStr, '.');
+        const int diff = _stricmp(pLeftExt ? pLeftExt : "", pRightExt ? pRightExt : "");
+        if (diff != 0)
+            return (diff < 0) ? -1 : 1;
+        break;
+    }
+    }
+
+    if (leftValue != rightValue)
+        return (leftValue < rightValue) ? -1 : 1;
+    const int diff = _stricmp(left.filenameLStr, right.filenameLStr);
+    return (diff < 0) ? -1 : (diff > 0 ? 1 : 0);
+}
+
+// ---------------------------------------------------------------------------
+static void RandomEntry(std::mt19937& rng, WIN32_FIND_DATA& findData, unsigned maxLen, unsigned chrCnt)
+{
+    const char nameChars[] = "aAbB._zZ0";
+    memset(&findData, 0, sizeof(findData));
+    const unsigned len = 1 + rng() % maxLen;
+    for (unsigned idx = 0; idx < len; idx++)
+        findData.cFileName[idx] = nameChars[rng() % chrCnt];
+    findData.dwFileAttributes = (rng() % 2) ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_ARCHIVE;
+    findData.nFileSizeLow = rng() % 50;
+    findData.ftLastWriteTime.dwLowDateTime  = rng() % 30;
+    findData.ftLastWriteTime.dwHighDateTime = rng() % 2;
+}
+
+// ---------------------------------------------------------------------------
+// Sort() order and links against the reference order.
+static size_t CheckSort(size_t& cases)
+{
+    std::mt19937 rng(3);
+    size_t bad = 0;
+
+    for (unsigned round = 0; round < 120; round++)
+    {
+        for (int increasing = 0; increasing < 2; increasing++)
+        {
+            const char* pSortKey = sSortKeys[round % 6];
+            LLDirSort dirSort;
+            DirectoryScan dirScan;
+            dirSort.SetSort(dirScan, pSortKey, round % 4 != 1, increasing != 0);
+            dirSort.m_onlyAttr = (DWORD)-1;
+
+            // Short names from few characters give many ties.
+            const size_t count = (round % 5 == 0) ? 200000 : 1 + rng() % 3000;
+            const unsigned maxLen = (round % 3 == 0) ? 30 : 12;
+            const unsigned chrCnt = (round % 3 == 0) ? 3 : 9;
+            WIN32_FIND_DATA findData;
+            for (size_t idx = 0; idx < count; idx++)
+            {
+                RandomEntry(rng, findData, maxLen, chrCnt);
+                LLDirSort::SortCb(&dirSort, "dir", &findData, 1);
+            }
+            dirSort.Sort();
+            cases++;
+
+            size_t listed = 0;
+            const LLDirEntry* pPrev = nullptr;
+            for (const LLDirEntry* pEntry = dirSort.m_pFirst; pEntry != nullptr; pEntry = pEntry->pNext)
+            {
+                if (pPrev != nullptr)
+                {
+                    int order = RefCompare(dirSort, *pSortKey, *pPrev, *pEntry);
+                    if ( !increasing)
+                        order = -order;
+                    if (order > 0 || (order == 0 && pPrev->row > pEntry->row))
+                    {
+                        if (bad++ < 5)
+                            printf("Order key=%s inc=%d [%s] before [%s]\n", pSortKey, increasing,
+                                (const char*)pPrev->filenameLStr, (const char*)pEntry->filenameLStr);
+                    }
+                }
+                if (pEntry->pPrev != pPrev)
+                    bad++;
+                pPrev = pEntry;
+                listed++;
+            }
+
+            if (listed != count || dirSort.m_pLast != pPrev)
+            {
+                bad++;
+                printf("Listed %zu of %zu entries, key=%s inc=%d\n", listed, count, pSortKey, increasing);
+            }
+        }
+    }
+
+    return bad;
+}
+
+// ---------------------------------------------------------------------------
+// ShowSorted output, one line per entry or just the count.
+struct ShowOutput
+{
+    std::vector<std::string> lines;
+    size_t  count;
+    bool    keepLines;
+};
+
+static int ShowCb(void* cbData, const char* pDir, const WIN32_FIND_DATA* pFileData, int depth)
+{
+    ShowOutput* pOutput = (ShowOutput*)cbData;
+    pOutput->count++;
+    if (pOutput->keepLines)
+    {
+        char line[LL_MAX_PATH * 2];
+        snprintf(line, sizeof(line), "%s|%s|%lu|%lu|%lu|%lx", pDir, pFileData->cFileName,
+            (unsigned long)pFileData->nFileSizeLow,
+            (unsigned long)pFileData->ftLastWriteTime.dwLowDateTime,
+            (unsigned long)pFileData->ftLastWriteTime.dwHighDateTime,
+            (unsigned long)pFileData->dwFileAttributes);
+        pOutput->lines.push_back(line);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Add count entries, 300 per directory. At entry failAt TMP is set to a
+// missing directory so later spills fail.
+static void AddSpillEntries(LLDirSort& dirSort, size_t count, unsigned seed, bool shortNames, size_t failAt)
+{
+    std::mt19937 rng(seed);
+    WIN32_FIND_DATA findData;
+    char dirName[64] = "";
+    char tmpDir[LL_MAX_PATH];
+
+    for (size_t idx = 0; idx < count; idx++)
+    {
+        if (idx == failAt)
+        {
+            GetTempPath(ARRAYSIZE(tmpDir), tmpDir);
+            strcat_s(tmpDir, ARRAYSIZE(tmpDir), "llfile_missing_dir\\");
+            SetEnvironmentVariable("TMP", tmpDir);
+        }
+        if (idx % 300 == 0)
+            snprintf(dirName, sizeof(dirName), "c:\\data\\dir%zu", idx / 300);
+
+        if (shortNames)
+            RandomEntry(rng, findData, 10, 9);
+        else
+        {
+            memset(&findData, 0, sizeof(findData));
+            snprintf(findData.cFileName, sizeof(findData.cFileName), "IMG_%08u.jpg", (unsigned)rng());
+            findData.dwFileAttributes = (rng() % 2) ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_ARCHIVE;
+            findData.nFileSizeLow = rng() % 1000000;
+            findData.ftLastWriteTime.dwLowDateTime  = rng() % 1000000;
+            findData.ftLastWriteTime.dwHighDateTime = rng() % 2;
+        }
+        LLDirSort::SortCb(&dirSort, dirName, &findData, 1);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Spilled and merged output against in-memory output.
+static size_t CheckSpill(size_t& cases)
+{
+    size_t bad = 0;
+    char savedTmp[LL_MAX_PATH];
+    const DWORD savedLen = GetEnvironmentVariable("TMP", savedTmp, ARRAYSIZE(savedTmp));
+
+    for (unsigned round = 0; round < 36; round++)
+    {
+        for (int increasing = 0; increasing < 2; increasing++)
+        {
+            const char* pSortKey = sSortKeys[round % 6];
+            const size_t count = 20000 + round * 1000;
+            const bool shortNames = (round % 2) != 0;
+            const size_t failAt = (round % 4 == 3) ? count * 3 / 4 : count;
+            ShowOutput memOutput = { {}, 0, true };
+            ShowOutput spillOutput = { {}, 0, true };
+
+            {
+                LLDirSort dirSort;
+                DirectoryScan dirScan;
+                dirSort.SetSort(dirScan, pSortKey, round % 3 != 0, increasing != 0);
+                dirSort.m_onlyAttr = (DWORD)-1;
+                AddSpillEntries(dirSort, count, round, shortNames, count);
+                dirSort.ShowSorted(ShowCb, &memOutput);
+            }
+            {
+                LLDirSort dirSort;
+                DirectoryScan dirScan;
+                dirSort.SetSort(dirScan, pSortKey, round % 3 != 0, increasing != 0);
+                dirSort.m_onlyAttr = (DWORD)-1;
+                dirSort.SetMemoryBudget(200000 + round * 37000);
+                AddSpillEntries(dirSort, count, round, shortNames, failAt);
+                dirSort.ShowSorted(ShowCb, &spillOutput);
+            }
+            SetEnvironmentVariable("TMP", (savedLen != 0 && savedLen < ARRAYSIZE(savedTmp)) ? savedTmp : nullptr);
+            cases++;
+
+            if (memOutput.lines != spillOutput.lines)
+            {
+                size_t idx = 0;
+                while (idx < memOutput.lines.size() && idx < spillOutput.lines.size()
+                    && memOutput.lines[idx] == spillOutput.lines[idx])
+                    idx++;
+                if (bad++ < 5)
+                    printf("Spill key=%s inc=%d fail=%d differs at %zu of %zu/%zu entries\n",
+                        pSortKey, increasing, failAt != count, idx,
+                        memOutput.lines.size(), spillOutput.lines.size());
+            }
+        }
+    }
+
+    return bad;
+}
+
+// ---------------------------------------------------------------------------
+static int RunSpillTime(size_t count, const char* pSortKey, size_t budgetMB)
+{
+    LLDirSort dirSort;
+    DirectoryScan dirScan;
+    dirSort.SetSort(dirScan, pSortKey, true, true);
+    dirSort.m_onlyAttr = (DWORD)-1;
+    dirSort.SetMemoryBudget(budgetMB << 20);
+
+    BenchTimer timer;
+    AddSpillEntries(dirSort, count, 7, false, count);
+    const double addMs = timer.Ms();
+
+    timer.Reset();
+    ShowOutput output = { {}, 0, false };
+    dirSort.ShowSorted(ShowCb, &output);
+    const double showMs = timer.Ms();
+
+    printf("count=%zu key=%s budget=%zu MB  shown %zu  add %.0f ms  sort+show %.0f ms  peak %.0f MB\n",
+        count, pSortKey, budgetMB, output.count, addMs, showMs, BenchWorkingSet(true) / (1024.0 * 1024.0));
+    return (output.count == count) ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+static int RunTime(size_t count, const char* pSortKey, bool allData)
+{
+    std::mt19937 rng(5);
+    LLDirSort dirSort;
+    DirectoryScan dirScan;
+    dirSort.SetSort(dirScan, pSortKey, allData, true);
+    dirSort.m_onlyAttr = (DWORD)-1;
+
+    WIN32_FIND_DATA findData;
+    memset(&findData, 0, sizeof(findData));
+    char dirName[64] = "";
+
+    const size_t memBefore = BenchWorkingSet();
+    BenchTimer timer;
+    for (size_t idx = 0; idx < count; idx++)
+    {
+        if (idx % 500 == 0)
+            snprintf(dirName, sizeof(dirName), "c:\\data\\dir%zu", idx / 500);
+        snprintf(findData.cFileName, sizeof(findData.cFileName), "IMG_%08u.jpg", (unsigned)rng());
+        findData.dwFileAttributes = FILE_ATTRIBUTE_ARCHIVE;
+        findData.nFileSizeLow = rng();
+        findData.ftLastWriteTime.dwLowDateTime  = rng();
+        findData.ftLastWriteTime.dwHighDateTime = rng() % 4;
+        LLDirSort::SortCb(&dirSort, dirName, &findData, 1);
+    }
+    const double addMs = timer.Ms();
+    const size_t memAfter = BenchWorkingSet();
+
+    timer.Reset();
+    dirSort.Sort();
+    const double sortMs = timer.Ms();
+
+    printf("count=%zu key=%s all=%d  %.1f bytes/entry  add %.0f ms  sort %.0f ms\n",
+        count, pSortKey, allData, (double)(memAfter - memBefore) / count, addMs, sortMs);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Add count entries over dirCnt directories, interleaved or in directory order.
+// Return name pool bytes and add bytes allocated, count directory pointer mismatches.
+static size_t InternPass(size_t count, size_t dirCnt, bool interleave, size_t& poolBytes, size_t& bad)
+{
+    LLDirSort dirSort;
+    DirectoryScan dirScan;
+    dirSort.SetSort(dirScan, "n", false, true);
+    dirSort.m_onlyAttr = (DWORD)-1;
+
+    WIN32_FIND_DATA findData;
+    memset(&findData, 0, sizeof(findData));
+    findData.dwFileAttributes = FILE_ATTRIBUTE_ARCHIVE;
+    char dirName[MAX_PATH];
+    const char* const pDirFormat =
+        "c:\\users\\someone\\projects\\archive\\2024\\photos\\album%06zu\\raw\\converted\\export";
+
+    const size_t newBefore = sNewBytes;
+    const size_t perDir = (count + dirCnt - 1) / dirCnt;
+    for (size_t idx = 0; idx < count; idx++)
+    {
+        const size_t dirIdx = interleave ? (idx % dirCnt) : (idx / perDir);
+        snprintf(dirName, sizeof(dirName), pDirFormat, dirIdx);
+        snprintf(findData.cFileName, sizeof(findData.cFileName), "IMG_%08zu.jpg", idx);
+        LLDirSort::SortCb(&dirSort, dirName, &findData, 1);
+    }
+    const size_t newBytes = sNewBytes - newBefore;
+    poolBytes = dirSort.m_namePool.Stats().used;
+
+    // Entries of a directory share one pooled copy.
+    dirSort.Sort();
+    std::vector<const char*> dirPtrs(dirCnt, nullptr);
+    for (const LLDirEntry* pEntry = dirSort.m_pFirst; pEntry != nullptr; pEntry = pEntry->pNext)
+    {
+        const size_t idx = strtoul(pEntry->filenameLStr + 4, nullptr, 10);
+        const size_t dirIdx = interleave ? (idx % dirCnt) : (idx / perDir);
+        snprintf(dirName, sizeof(dirName), pDirFormat, dirIdx);
+        if (dirPtrs[dirIdx] == nullptr)
+            dirPtrs[dirIdx] = pEntry->szDir;
+        else if (dirPtrs[dirIdx] != pEntry->szDir && bad++ < 5)
+            printf("Directory %zu stored twice, interleave=%d\n", dirIdx, interleave);
+        if (strcmp(pEntry->szDir, dirName) != 0 && bad++ < 5)
+            printf("Directory %zu is [%s]\n", dirIdx, pEntry->szDir);
+    }
+
+    return newBytes;
+}
+
+// ---------------------------------------------------------------------------
+static int RunIntern(size_t count, size_t dirCnt)
+{
+    if (count == 0 || dirCnt == 0)
+        return 2;
+
+    size_t bad = 0;
+    size_t orderPool, mixPool;
+    const size_t orderNew = InternPass(count, dirCnt, false, orderPool, bad);
+    const size_t mixNew = InternPass(count, dirCnt, true, mixPool, bad);
+    if (orderPool != mixPool)
+        bad++;
+
+    const double MB = 1024.0 * 1024.0;
+    printf("count=%zu dirs=%zu\n", count, dirCnt);
+    printf("  in order     name pool %8.1f MB  allocated %8.1f MB\n", orderPool / MB, orderNew / MB);
+    printf("  interleaved  name pool %8.1f MB  allocated %8.1f MB\n", mixPool / MB, mixNew / MB);
+    return BenchResult("dirsortbench intern", 2, bad);
+}
+
+// ---------------------------------------------------------------------------
+static size_t CheckAll(size_t, size_t& cases)
+{
+    const size_t bad = CheckSort(cases);
+    return bad + CheckSpill(cases);
+}
+
+// ---------------------------------------------------------------------------
+static int TimeMode(int argc, char* argv[])
+{
+    if (argc <= 3)
+    {
+        printf("Usage: dirsortbench time <count> <key> [all]\n");
+        return 2;
+    }
+    return RunTime(BenchArg(argc, argv, 2, 0), argv[3], argc > 4);
+}
+
+// ---------------------------------------------------------------------------
+static int SpillMode(int argc, char* argv[])
+{
+    if (argc > 4)
+        return RunSpillTime(BenchArg(argc, argv, 2, 0), argv[3], BenchArg(argc, argv, 4, 0));
+
+    size_t cases = 0;
+    const size_t bad = CheckSpill(cases);
+    return BenchResult("dirsortbench spill", cases, bad);
+}
+
+// ---------------------------------------------------------------------------
+static int InternMode(int argc, char* argv[])
+{
+    return RunIntern(BenchArg(argc, argv, 2, 1000000), BenchArg(argc, argv, 3, 200000));
+}
+
+// ---------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    return BenchMain(argc, argv, "dirsortbench", CheckAll, 0, TimeMode,
+        { { "spill", SpillMode }, { "intern", InternMode } });
+}
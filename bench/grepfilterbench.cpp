@@ -0,0 +1,314 @@
+//-----------------------------------------------------------------------------
+// grepfilterbench - Check and time GrepPrefilter, the llgrep -G literal prefilter.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+//
+// Usage: grepfilterbench [mode [args]]
+//
+//  check [count]       ; Literal and SpansLines of fixed patterns. Then count
+//                        random patterns against random text, every std::regex
+//                        match must hold the literal, and must not hold a line
+//                        break unless SpansLines. Search of only the lines Find
+//                        hits, as llgrep does, must find the same matches as a
+//                        whole buffer search. Find against a naive search, with
+//                        and without ignore case.
+//  time                ; ms to search a log with std::regex alone and with the
+//                        prefilter.
+
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "grepfilter.h"
+#include "benchutil.h"
+
+typedef std::match_results<const char*> Match;
+
+// ---------------------------------------------------------------------------
+// Same line search as llgrep, only lines holding the literal are searched.
+static bool PrefilterSearch(const GrepPrefilter& prefilter, const char*& strPtr, const char* begPtr,
+    const char* endPtr, Match& match, const std::regex& pattern, std::regex_constants::match_flag_type flags)
+{
+    for (;;)
+    {
+        const char* hitPtr = prefilter.Find(strPtr, endPtr);
+        if (hitPtr == NULL)
+            return false;
+
+        const char* begLine = hitPtr;
+        while (begLine > strPtr && begLine[-1] != '\n')
+            begLine--;
+        const char* endLine = (const char*)memchr(hitPtr, '\n', endPtr - hitPtr);
+        if (endLine == NULL)
+            endLine = endPtr;
+
+        std::regex_constants::match_flag_type lineFlags = flags;
+        if (begLine != begPtr)
+            lineFlags |= std::regex_constants::match_prev_avail;
+        if (std::regex_search(begLine, endLine, match, pattern, lineFlags))
+            return true;
+        strPtr = endLine;
+    }
+}
+
+// Offset and length of each match, searching all text or only prefilter lines.
+static std::vector<std::pair<size_t, size_t>> AllMatches(const std::string& text, const std::regex& pattern,
+    const GrepPrefilter* pPrefilter)
+{
+    std::vector<std::pair<size_t, size_t>> matches;
+    const char* begPtr = text.data();
+    const char* endPtr = begPtr + text.size();
+    const char* strPtr = begPtr;
+    std::regex_constants::match_flag_type flags = std::regex_constants::match_default;
+    Match match;
+    while (strPtr <= endPtr && (pPrefilter != NULL
+        ? PrefilterSearch(*pPrefilter, strPtr, begPtr, endPtr, match, pattern, flags)
+        : std::regex_search(strPtr, endPtr, match, pattern, flags)))
+    {
+        matches.push_back(std::make_pair((size_t)(match[0].first - begPtr), (size_t)match.length()));
+        strPtr = match[0].second + (match.length() == 0 ? 1 : 0);
+        flags = std::regex_constants::match_prev_avail;
+    }
+    return matches;
+}
+
+static bool HasLiteral(const std::string& str, const std::string& literal, bool ignoreCase)
+{
+    if ( !ignoreCase)
+        return str.find(literal) != std::string::npos;
+    std::string lower = str;
+    for (char& chr : lower)
+        chr = (char)tolower((unsigned char)chr);
+    return lower.find(literal) != std::string::npos;
+}
+
+// ---------------------------------------------------------------------------
+static size_t CheckFixed(size_t& cases)
+{
+    struct Fixed { const char* pattern; const char* literal; bool spansLines; };
+    static const Fixed sFixed[] =
+    {
+        { "foo.*bar",       "foo",          false },
+        { "foo|bar",        "",             false },
+        { "abc?d",          "ab",           false },
+        { "ab+cd",          "ab",           false },
+        { "(foo)bar",       "bar",          false },
+        { "x[abc]yyyy",     "yyyy",         false },
+        { "hello\\.world",  "hello.world",  false },
+        { "a\\dbcd",        "bcd",          false },
+        { "foo\\s+barbaz",  "barbaz",       true },
+        { "[^\"]*quote",    "quote",        true },
+        { "ab{2,3}cdef",    "cdef",         false },
+        { "\\x41BC",        "BC",           true },
+        { "(a|b)xyz",       "xyz",          false },
+        { "^start",         "start",        false },
+        { "end$",           "end",          false },
+        { "a*",             "",             false },
+        { "q\\bword",       "word",         false },
+    };
+
+    size_t bad = 0;
+    for (const Fixed& fixed : sFixed)
+    {
+        GrepPrefilter prefilter;
+        prefilter.Init(fixed.pattern, false);
+        cases++;
+        if ((prefilter.Literal() != fixed.literal || prefilter.SpansLines() != fixed.spansLines) && bad++ < 10)
+            printf("Pattern [%s] literal [%s] spans=%d, expected [%s] spans=%d\n", fixed.pattern,
+                prefilter.Literal().c_str(), prefilter.SpansLines(), fixed.literal, fixed.spansLines);
+    }
+    return bad;
+}
+
+// ---------------------------------------------------------------------------
+static std::string RandomPattern(std::mt19937& rng)
+{
+    static const char* const sAtoms[] =
+    {
+        "a", "b", "c", "A", "ab", "bca", ".", "[ab]", "[^a]", "\\s", "\\w", "\\d", "\\b", "\\.", " ",
+        "(ab|ca)", "(bc)",
+    };
+    static const char* const sQuants[] = { "", "", "", "*", "+", "?", "{2}", "{0,1}" };
+
+    std::string pattern;
+    if (rng() % 8 == 0)
+        pattern += '^';
+    for (unsigned atom = 1 + rng() % 6; atom != 0; atom--)
+    {
+        pattern += sAtoms[rng() % (sizeof(sAtoms) / sizeof(sAtoms[0]))];
+        pattern += sQuants[rng() % (sizeof(sQuants) / sizeof(sQuants[0]))];
+        if (rng() % 20 == 0)
+            pattern += '|';
+    }
+    if (rng() % 8 == 0)
+        pattern += '$';
+    return pattern;
+}
+
+static size_t CheckRandom(size_t checkCnt, size_t& cases)
+{
+    std::mt19937 rng(3);
+    size_t bad = 0;
+
+    for (size_t iter = 0; iter < checkCnt; iter++)
+    {
+        const std::string patStr = RandomPattern(rng);
+        const bool ignoreCase = (rng() % 3) == 0;
+        std::regex pattern;
+        try
+        {
+            pattern.assign(patStr, ignoreCase ? std::regex::ECMAScript | std::regex::icase : std::regex::ECMAScript);
+        }
+        catch (const std::regex_error&)
+        {
+            continue;
+        }
+        GrepPrefilter prefilter;
+        prefilter.Init(patStr, ignoreCase);
+
+        std::string text;
+        for (unsigned len = rng() % 120; len != 0; len--)
+            text += "abcAB1. \n"[rng() % 9];
+
+        const std::vector<std::pair<size_t, size_t>> matches = AllMatches(text, pattern, NULL);
+        cases++;
+        for (const auto& match : matches)
+        {
+            const std::string matchStr = text.substr(match.first, match.second);
+            const bool hasBreak = matchStr.find('\n') != std::string::npos;
+            if (( !HasLiteral(matchStr, prefilter.Literal(), ignoreCase) || (hasBreak && !prefilter.SpansLines())))
+            {
+                if (bad++ < 10)
+                    printf("Pattern [%s] icase=%d literal [%s] spans=%d, match [%s]\n", patStr.c_str(), ignoreCase,
+                        prefilter.Literal().c_str(), prefilter.SpansLines(), matchStr.c_str());
+                break;
+            }
+        }
+
+        // llgrep searches only hit lines when the pattern has a literal, can't span
+        // lines and has no ^ or $, those are searched a line at a time.
+        if ( !prefilter.empty() && !prefilter.SpansLines() && patStr.find_first_of("^$") == std::string::npos)
+        {
+            cases++;
+            if (AllMatches(text, pattern, &prefilter) != matches && bad++ < 10)
+                printf("Pattern [%s] icase=%d literal [%s] line search differs, text [%s]\n", patStr.c_str(),
+                    ignoreCase, prefilter.Literal().c_str(), text.c_str());
+        }
+    }
+
+    return bad;
+}
+
+// ---------------------------------------------------------------------------
+static size_t CheckFind(size_t checkCnt, size_t& cases)
+{
+    std::mt19937 rng(1);
+    size_t bad = 0;
+
+    for (size_t iter = 0; iter < checkCnt; iter++)
+    {
+        std::string text, literal;
+        for (unsigned len = rng() % 200; len != 0; len--)
+            text += "abAB\n"[rng() % 5];
+        for (unsigned len = 1 + rng() % 4; len != 0; len--)
+            literal += "abAB"[rng() % 4];
+        const bool ignoreCase = (rng() % 2) != 0;
+
+        GrepPrefilter prefilter;
+        prefilter.Init(literal, ignoreCase);
+        const char* hitPtr = prefilter.Find(text.data(), text.data() + text.size());
+        const size_t got = (hitPtr == NULL) ? std::string::npos : hitPtr - text.data();
+
+        size_t expect = std::string::npos;
+        for (size_t pos = 0; expect == std::string::npos && pos + literal.size() <= text.size(); pos++)
+        {
+            if (HasLiteral(text.substr(pos, literal.size()), prefilter.Literal(), ignoreCase))
+                expect = pos;
+        }
+
+        cases++;
+        if (got != expect && bad++ < 10)
+            printf("Find [%s] icase=%d in [%s] at %zd, expected %zd\n", literal.c_str(), ignoreCase, text.c_str(),
+                (ptrdiff_t)got, (ptrdiff_t)expect);
+    }
+
+    return bad;
+}
+
+// ---------------------------------------------------------------------------
+static void TimeSearch()
+{
+    std::string text;
+    for (unsigned line = 0; line < 400000; line++)
+    {
+        text += "2026-10-17 12:00:" + std::to_string(line % 60) + " INFO worker thread " + std::to_string(line)
+            + " processed request ok\n";
+        if (line % 5000 == 0)
+            text += "2026-10-17 12:00:00 ERROR timeout=1234 in handler\n";
+    }
+
+    printf("\n%-24s %8s %12s %12s   (%.1f MB log)\n", "pattern", "matches", "regex ms", "prefilter ms", text.size() / 1e6);
+    for (const char* patStr : { "ERROR timeout=[0-9]+", "\\bhandler\\b", "thread 39999[0-9]" })
+    {
+        const std::regex pattern(patStr);
+        GrepPrefilter prefilter;
+        prefilter.Init(patStr, false);
+
+        BenchTimer timer;
+        const size_t regexCnt = AllMatches(text, pattern, NULL).size();
+        const double regexMs = timer.Ms();
+        timer.Reset();
+        const size_t filterCnt = AllMatches(text, pattern, &prefilter).size();
+        const double filterMs = timer.Ms();
+
+        printf("%-24s %8zu %12.1f %12.1f%s\n", patStr, regexCnt, regexMs, filterMs,
+            (regexCnt == filterCnt) ? "" : "  match count differs");
+    }
+}
+
+// ---------------------------------------------------------------------------
+static size_t CheckAll(size_t checkCnt, size_t& cases)
+{
+    size_t bad = CheckFixed(cases);
+    bad += CheckRandom(checkCnt, cases);
+    return bad + CheckFind(checkCnt, cases);
+}
+
+// ---------------------------------------------------------------------------
+static int TimeMode(int, char*[])
+{
+    TimeSearch();
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    return BenchMain(argc, argv, "grepfilterbench", CheckAll, 20000, TimeMode);
+}
@@ -0,0 +1,268 @@
+//-----------------------------------------------------------------------------
+// hashbench - Check and time the llcmp -h hash engines and Md5Batch.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+//
+// Usage: hashbench [mode [args]]
+//
+//  check [rounds]      ; Known md5, xxh3 and crc32c values of fixed data at
+//                        lengths that take each short, stripe and block path,
+//                        hashed in one Append and in random sized pieces.
+//                        Md5Batch of random message sets must match the md5
+//                        engine.
+//  time                ; GB/s of each engine on a 64MB buffer, and Md5Batch
+//                        against one md5 at a time on small messages.
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "hashengine.h"
+#include "benchutil.h"
+
+// ---------------------------------------------------------------------------
+// Fixed test data, same bytes as the tool that made sKnown.
+static std::vector<unsigned char> MakeData(size_t len)
+{
+    std::vector<unsigned char> data(len);
+    unsigned seed = 1;
+    for (unsigned char& chr : data)
+    {
+        seed = seed * 1103515245 + 12345;
+        chr = (unsigned char)(seed >> 16);
+    }
+    return data;
+}
+
+struct Known
+{
+    size_t      len;
+    const char* md5;
+    const char* xxh3;
+    const char* crc32c;
+};
+
+static const Known sKnown[] =
+{
+    {     0, "d41d8cd98f00b204e9800998ecf8427e", "2d06800538d394c2", "00000000" },
+    {     1, "f664908b48b07e34c3472a6243f37cbf", "e5e62017e96f839c", "b751927d" },
+    {     3, "a531c2566f9b40f90e7f177fe0cbdd92", "d3bcc83c6f14e70f", "c6885c81" },
+    {     4, "1e3ffd1f5f5536fcc4f95131190cc113", "c7f159f34b126cb4", "da695b2f" },
+    {     8, "7dcbee5e202bd1f3ad3a92f9559f71b7", "0f25a2a1cc43dda2", "a543210a" },
+    {     9, "0c0817df79d9a01da33919b048e82283", "1e3be9699baa50cf", "af857584" },
+    {    16, "85a3b1f3109e4d6f6105967a356bd6d8", "9ec324145cea1dcb", "551f3798" },
+    {    17, "8602de1c924928149d50b44f7ca96e16", "48f3651d7436310a", "b8326bbd" },
+    {    64, "95b8013433c46680b8120921167ec17a", "7abe508541644d25", "79931fc0" },
+    {    65, "73532b7ccf1cfc69947cbe61cd2bd54d", "da2a9fa52b7fadf5", "dec1f1b7" },
+    {   128, "10db93b7d3090618c23abfd03712c963", "5d813d42c0005ea8", "d010491a" },
+    {   129, "15f74a90c24424753edbe6b98776f54b", "c61639b552225575", "fcde24d2" },
+    {   240, "830c3fbcee3049ff92ff5168ee01c3d7", "7d85b8d4f8b10c82", "9b9ece16" },
+    {   241, "e1ec8319458349f8a6db55be916f342c", "5c56141c894cd97e", "02c6fb3a" },
+    {  1024, "647edf93bfb61d528bf5d543afc781ac", "0551dea22e104ea8", "75769aef" },
+    {  4095, "de55a9ff34deac21980a15391cfb3b54", "e59bac446ae460f1", "6f63a0ec" },
+    { 65536, "6446c04d4118feff6c64aa62ed1033cc", "3387c315d69e9c87", "66f37dd5" },
+    { 70000, "7647e850c9bb5bdada0b90a152e9b567", "ec72118ff3d3b6bd", "4c63c63d" },
+};
+
+static std::string ToHex(const unsigned char* pDigest, unsigned size)
+{
+    std::string hex;
+    char buf[4];
+    for (unsigned idx = 0; idx < size; idx++)
+    {
+        snprintf(buf, sizeof(buf), "%02x", pDigest[idx]);
+        hex += buf;
+    }
+    return hex;
+}
+
+// Hash data in pieces of random size, one piece if rng is NULL.
+static std::string HashHex(HashEngine& engine, const unsigned char* pData, size_t len, std::mt19937* pRng)
+{
+    engine.Init();
+    size_t pos = 0;
+    while (pos < len)
+    {
+        size_t piece = len - pos;
+        if (pRng != NULL)
+        {
+            const size_t maxPiece = ((*pRng)() % 4 == 0) ? (*pRng)() % 5000 : (*pRng)() % 300;
+            piece = min(piece, maxPiece);
+        }
+        engine.Append(pData + pos, piece);
+        pos += piece;
+    }
+    unsigned char digest[HashEngine::sMaxDigest];
+    engine.Finish(digest);
+    return ToHex(digest, engine.DigestSize());
+}
+
+// ---------------------------------------------------------------------------
+static size_t CheckKnown(size_t rounds, size_t& cases)
+{
+    std::mt19937 rng(1);
+    size_t bad = 0;
+    const std::vector<unsigned char> data = MakeData(70000);
+
+    for (const char* name : { "md5", "xxh3", "crc32c" })
+    {
+        std::unique_ptr<HashEngine> engine(HashEngine::Create(name));
+        for (const Known& known : sKnown)
+        {
+            const std::string expect = (name[0] == 'm') ? known.md5 : ((name[0] == 'x') ? known.xxh3 : known.crc32c);
+            for (size_t round = 0; round <= rounds; round++)
+            {
+                const std::string got = HashHex(*engine, data.data(), known.len, (round == 0) ? NULL : &rng);
+                cases++;
+                if (got != expect && bad++ < 10)
+                    printf("Mismatch %s len=%zu pieces=%d %s expected %s\n", name, known.len, round != 0, got.c_str(), expect.c_str());
+            }
+        }
+    }
+
+    // Published values.
+    struct Published { const char* name; const char* text; const char* expect; };
+    static const Published sPublished[] =
+    {
+        { "md5",    "abc",              "900150983cd24fb0d6963f7d28e17f72" },
+        { "md5",    "message digest",   "f96b697d7cb7938d525a2f31aaf161d0" },
+        { "crc32c", "123456789",        "e3069283" },
+        { "xxh3",   "",                 "2d06800538d394c2" },
+    };
+    for (const Published& published : sPublished)
+    {
+        std::unique_ptr<HashEngine> engine(HashEngine::Create(published.name));
+        const std::string got = HashHex(*engine, (const unsigned char*)published.text, strlen(published.text), NULL);
+        cases++;
+        if (got != published.expect && bad++ < 10)
+            printf("Mismatch %s [%s] %s expected %s\n", published.name, published.text, got.c_str(), published.expect);
+    }
+
+    return bad;
+}
+
+// ---------------------------------------------------------------------------
+static size_t CheckMd5Batch(size_t rounds, size_t& cases)
+{
+    std::mt19937 rng(2);
+    size_t bad = 0;
+    const std::vector<unsigned char> data = MakeData(70000);
+    std::unique_ptr<HashEngine> md5(HashEngine::Create("md5"));
+
+    for (size_t round = 0; round < rounds; round++)
+    {
+        const size_t count = 1 + rng() % 20;
+        std::vector<const unsigned char*> ptrs(count);
+        std::vector<size_t> lens(count);
+        for (size_t idx = 0; idx < count; idx++)
+        {
+            lens[idx] = (rng() % 10 == 0) ? rng() % data.size() : rng() % 300;
+            ptrs[idx] = data.data() + rng() % (data.size() - lens[idx] + 1);
+        }
+
+        std::vector<unsigned char> digests(count * 16);
+        Md5Batch(ptrs.data(), lens.data(), count, (unsigned char (*)[16])digests.data());
+        for (size_t idx = 0; idx < count; idx++)
+        {
+            const std::string expect = HashHex(*md5, ptrs[idx], lens[idx], NULL);
+            cases++;
+            const std::string got = ToHex(&digests[idx * 16], 16);
+            if (got != expect && bad++ < 10)
+                printf("Mismatch Md5Batch count=%zu idx=%zu len=%zu %s expected %s\n",
+                    count, idx, lens[idx], got.c_str(), expect.c_str());
+        }
+    }
+
+    return bad;
+}
+
+// ---------------------------------------------------------------------------
+static void TimeEngines()
+{
+    const size_t sBufSize = 64 * 1024 * 1024;
+    const std::vector<unsigned char> data = MakeData(sBufSize);
+    unsigned char digest[HashEngine::sMaxDigest];
+
+    printf("\n%-8s %10s\n", "engine", "GB/s");
+    for (const char* name : { "md5", "xxh3", "crc32c" })
+    {
+        std::unique_ptr<HashEngine> engine(HashEngine::Create(name));
+        BenchTimer timer;
+        engine->Init();
+        engine->Append(data.data(), data.size());
+        engine->Finish(digest);
+        printf("%-8s %10.2f\n", name, sBufSize / (timer.Ms() * 1e6));
+    }
+
+    // Small files, as SmallHashBatch hashes them.
+    std::unique_ptr<HashEngine> md5(HashEngine::Create("md5"));
+    printf("\n%8s %14s %14s   (MB/s)\n", "msgSize", "md5 each", "Md5Batch");
+    for (size_t msgSize : { 64, 512, 4096, 32768 })
+    {
+        const size_t count = sBufSize / msgSize;
+        std::vector<const unsigned char*> ptrs(count);
+        std::vector<size_t> lens(count, msgSize);
+        for (size_t idx = 0; idx < count; idx++)
+            ptrs[idx] = data.data() + idx * msgSize;
+        std::vector<unsigned char> digests(count * 16);
+
+        BenchTimer timer;
+        for (size_t idx = 0; idx < count; idx++)
+        {
+            md5->Init();
+            md5->Append(ptrs[idx], msgSize);
+            md5->Finish(&digests[idx * 16]);
+        }
+        const double eachMs = timer.Ms();
+        timer.Reset();
+        Md5Batch(ptrs.data(), lens.data(), count, (unsigned char (*)[16])digests.data());
+        const double batchMs = timer.Ms();
+        printf("%8zu %14.0f %14.0f\n", msgSize, sBufSize / (eachMs * 1e3), sBufSize / (batchMs * 1e3));
+    }
+}
+
+// ---------------------------------------------------------------------------
+static size_t CheckAll(size_t rounds, size_t& cases)
+{
+    const size_t bad = CheckKnown(rounds, cases);
+    return bad + CheckMd5Batch(rounds * 100, cases);
+}
+
+// ---------------------------------------------------------------------------
+static int TimeMode(int, char*[])
+{
+    TimeEngines();
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    return BenchMain(argc, argv, "hashbench", CheckAll, 20, TimeMode);
+}
@@ -0,0 +1,190 @@
+//-----------------------------------------------------------------------------
+// hashfilebench - Check and time llcmp -h file hashes, small md5 files in batches.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+//
+// Usage: hashfilebench [mode [args]]
+//
+//  check               ; Temp tree of empty, small, 64KB edge and large files.
+//                        -h must list every file once, in the same order as
+//                        -h=xxh3 which hashes one file at a time, with the
+//                        md5 and size of its data, across batch flushes.
+//  time <files> <sizeKB>
+//                      ; Files/s and MB/s of -h, batched md5, and -h=xxh3.
+//
+// Trees are made in the temp directory and removed.
+
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cmptrees.h"
+#include "hashengine.h"
+#include "benchutil.h"
+
+// ---------------------------------------------------------------------------
+static std::string Md5Hex(const std::string& data)
+{
+    std::unique_ptr<HashEngine> md5(HashEngine::Create("md5"));
+    unsigned char digest[16];
+    md5->Init();
+    md5->Append(data.data(), data.size());
+    md5->Finish(digest);
+    char hex[40];
+    for (unsigned idx = 0; idx < 16; idx++)
+        snprintf(hex + idx * 2, 3, "%02x", digest[idx]);
+    return hex;
+}
+
+// ---------------------------------------------------------------------------
+static size_t CheckHashes(size_t, size_t& cases)
+{
+    std::mt19937 rng(13);
+    size_t bad = 0;
+    const size_t sSmall = 64 * 1024;
+    const size_t sEdgeSizes[] = { 0, 1, 55, 56, 64, sSmall - 1, sSmall, sSmall + 1 };
+
+    for (unsigned round = 0; round < 4; round++)
+    {
+        TempTrees trees("llcmp_hashfilebench");
+        HashCmp md5Cmp(trees, "md5");
+        HashCmp xxh3Cmp(trees, "xxh3");
+        const std::vector<LLCmp*> cmps = { &md5Cmp, &xxh3Cmp };
+
+        // Path without the left root, as Add names it, to md5 and size.
+        std::vector<std::pair<std::string, std::string>> expected;
+        const unsigned fileCnt = 100 + rng() % 700;
+        for (unsigned fileIdx = 0; fileIdx < fileCnt; fileIdx++)
+        {
+            size_t size = rng() % 20000;
+            if (fileIdx % 25 == 3)
+                size = sSmall + rng() % (1024 * 1024);
+            else if (fileIdx % 10 == 1)
+                size = sEdgeSizes[rng() % (sizeof(sEdgeSizes) / sizeof(sEdgeSizes[0]))];
+            std::string data(size, '\0');
+            for (char& chr : data)
+                chr = (char)rng();
+
+            char name[32], subDir[32];
+            snprintf(name, sizeof(name), "file%04u.bin", fileIdx);
+            snprintf(subDir, sizeof(subDir), "dir%u", fileIdx % 5);
+            trees.Add(cmps, true, subDir, name, data);
+            expected.push_back(std::make_pair(std::string(subDir) + "\\" + name, Md5Hex(data) + ", " + std::to_string(size)));
+        }
+
+        const std::vector<HashLine> md5Lines = ParseHashLines(md5Cmp.Hash());
+        const std::vector<HashLine> xxh3Lines = ParseHashLines(xxh3Cmp.Hash());
+        cases++;
+        if (md5Lines.size() != fileCnt || xxh3Lines.size() != fileCnt)
+        {
+            if (bad++ < 5)
+                printf("Round %u files=%u -h lists %zu, -h=xxh3 lists %zu\n", round, fileCnt, md5Lines.size(), xxh3Lines.size());
+            continue;
+        }
+
+        for (size_t idx = 0; idx < md5Lines.size(); idx++)
+        {
+            const HashLine& hashLine = md5Lines[idx];
+            cases++;
+            if (hashLine.path != xxh3Lines[idx].path)
+            {
+                if (bad++ < 5)
+                    printf("Round %u line %zu -h %s, -h=xxh3 %s\n", round, idx, hashLine.path.c_str(), xxh3Lines[idx].path.c_str());
+                continue;
+            }
+
+            const std::string got = hashLine.hash + ", " + std::to_string(hashLine.size);
+            bool found = false;
+            for (const auto& expect : expected)
+            {
+                const std::string& relPath = expect.first;
+                if (hashLine.path.length() > relPath.length() &&
+                    hashLine.path.compare(hashLine.path.length() - relPath.length(), relPath.length(), relPath) == 0)
+                {
+                    found = true;
+                    if (got != expect.second && bad++ < 5)
+                        printf("Round %u %s is %s, expected %s\n", round, hashLine.path.c_str(), got.c_str(), expect.second.c_str());
+                    break;
+                }
+            }
+            if ( !found && bad++ < 5)
+                printf("Round %u unexpected file %s\n", round, hashLine.path.c_str());
+        }
+    }
+
+    return bad;
+}
+
+// ---------------------------------------------------------------------------
+static int RunTime(size_t fileCnt, size_t sizeKB)
+{
+    TempTrees trees("llcmp_hashfilebench");
+    HashCmp md5Cmp(trees, "md5");
+    HashCmp xxh3Cmp(trees, "xxh3");
+    const std::vector<LLCmp*> cmps = { &md5Cmp, &xxh3Cmp };
+    std::mt19937 rng(3);
+    std::string data(sizeKB * 1024, '\0');
+    for (char& chr : data)
+        chr = (char)rng();
+
+    char name[32];
+    for (size_t idx = 0; idx < fileCnt; idx++)
+    {
+        snprintf(name, sizeof(name), "file%zu.bin", idx);
+        if ( !data.empty())
+            data[idx % data.size()]++;
+        trees.Add(cmps, true, "dir", name, data);
+    }
+
+    const double MB = fileCnt * sizeKB / 1024.0;
+    BenchTimer timer;
+    md5Cmp.Hash();
+    const double md5Ms = timer.Ms();
+    timer.Reset();
+    xxh3Cmp.Hash();
+    const double xxh3Ms = timer.Ms();
+
+    printf("files=%zu size=%zuKB  -h %.0f ms (%.0f files/s, %.0f MB/s)  -h=xxh3 %.0f ms (%.0f files/s, %.0f MB/s)\n",
+        fileCnt, sizeKB, md5Ms, fileCnt * 1000 / md5Ms, MB * 1000 / md5Ms,
+        xxh3Ms, fileCnt * 1000 / xxh3Ms, MB * 1000 / xxh3Ms);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+static int TimeMode(int argc, char* argv[])
+{
+    return RunTime(BenchArg(argc, argv, 2, 20000), BenchArg(argc, argv, 3, 4));
+}
+
+// ---------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    return BenchMain(argc, argv, "hashfilebench", CheckHashes, 0, TimeMode);
+}
@@ -0,0 +1,522 @@
+//-----------------------------------------------------------------------------
+// indexbench - Check and time llindex build, update and query against a live scan.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+//
+// Usage: indexbench [mode [args]]
+//
+//  check               ; Generated temp tree. build must index every entry a
+//                        live DirectoryScan finds, scanning every directory.
+//                        update with no changes must reuse every directory.
+//                        After files are added, deleted and renamed and
+//                        directories added in some directories, update must
+//                        rescan only those and the new directories, and query,
+//                        with and without name and path patterns, must list
+//                        what a live scan finds. build with -X=<dir>\* must not
+//                        scan below dir. Truncated, extended and bad magic index
+//                        files and directory or entry references past their
+//                        tables must be rejected, no .tmp file may be left.
+//  time <dirs> <files> ; Tree of dirs directories with up to files files each.
+//                        ms of build, update, query and a live scan.
+//
+// Trees are made in the temp directory and removed.
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+#include "llindex.h"
+#include "benchutil.h"
+
+// ---------------------------------------------------------------------------
+// Remove directory and everything below it.
+static void RemoveTree(const std::string& dir)
+{
+    WIN32_FIND_DATA findData;
+    const std::string dirPat = dir + "\\*";
+    HANDLE hSearch = FindFirstFile(dirPat.c_str(), &findData);
+    if (hSearch != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if (strcmp(findData.cFileName, ".") == 0 || strcmp(findData.cFileName, "..") == 0)
+                continue;
+            const std::string path = dir + "\\" + findData.cFileName;
+            if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+                RemoveTree(path);
+            else
+                DeleteFile(path.c_str());
+        } while (FindNextFile(hSearch, &findData) != 0);
+        FindClose(hSearch);
+    }
+    RemoveDirectory(dir.c_str());
+}
+
+// ---------------------------------------------------------------------------
+static bool WriteData(const std::string& path, const std::string& data)
+{
+    HANDLE hFile = CreateFile(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+    DWORD written = 0;
+    const bool okay = WriteFile(hFile, data.data(), (DWORD)data.size(), &written, NULL) && written == data.size();
+    CloseHandle(hFile);
+    return okay;
+}
+
+// ---------------------------------------------------------------------------
+static std::string ReadData(const std::string& path)
+{
+    std::string data;
+    HANDLE hFile = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return data;
+    data.resize(GetFileSize(hFile, NULL));
+    DWORD rlen = 0;
+    if ( !ReadFile(hFile, &data[0], (DWORD)data.size(), &rlen, NULL))
+        rlen = 0;
+    data.resize(rlen);
+    CloseHandle(hFile);
+    return data;
+}
+
+// ---------------------------------------------------------------------------
+// Temp tree below %TMP%\llindex_bench, index file next to it.
+// Directory names are unique, d<n> or n<n>. Tree and index are removed
+// by the destructor.
+class IndexTree
+{
+public:
+    IndexTree()
+    {
+        char tmpDir[LL_MAX_PATH];
+        GetTempPath(ARRAYSIZE(tmpDir), tmpDir);
+        GetLongPathName(tmpDir, tmpDir, ARRAYSIZE(tmpDir));     // Index keeps paths as given.
+        m_root = std::string(tmpDir) + "llindex_bench";
+        m_indexPath = m_root + ".idx";
+        RemoveTree(m_root);
+        CreateDirectory(m_root.c_str(), NULL);
+        m_dirs.push_back(m_root);
+        m_files.resize(1);
+    }
+
+    ~IndexTree()
+    {
+        RemoveTree(m_root);
+        DeleteFile(m_indexPath.c_str());
+        DeleteFile((m_indexPath + ".tmp").c_str());
+    }
+
+    // Add directory below m_dirs[parent], return its index.
+    size_t AddDir(size_t parent, const char* prefix)
+    {
+        const std::string path = m_dirs[parent] + "\\" + prefix + std::to_string(m_dirs.size());
+        CreateDirectory(path.c_str(), NULL);
+        m_dirs.push_back(path);
+        m_files.resize(m_dirs.size());
+        return m_dirs.size() - 1;
+    }
+
+    void AddFile(size_t dir, const std::string& name, size_t size)
+    {
+        WriteData(m_dirs[dir] + "\\" + name, std::string(size, 'x'));
+        m_files[dir].push_back(name);
+    }
+
+    // Random tree of dirCnt directories, root included, up to maxFiles files each.
+    void Generate(std::mt19937& rng, size_t dirCnt, unsigned maxFiles)
+    {
+        static const char* const sExts[] = { ".txt", ".dat", ".log" };
+        while (m_dirs.size() < dirCnt)
+            AddDir(rng() % m_dirs.size(), "d");
+        for (size_t dir = 0; dir < m_dirs.size(); dir++)
+        {
+            for (unsigned fileCnt = rng() % (maxFiles + 1); fileCnt != 0; fileCnt--)
+                AddFile(dir, "f" + std::to_string(m_files[dir].size()) + sExts[rng() % 3], rng() % 3000);
+        }
+    }
+
+    // Add, delete or rename a file or add a sub-directory in touchCnt
+    // directories, return their indices.
+    std::vector<size_t> Mutate(std::mt19937& rng, size_t touchCnt)
+    {
+        std::vector<size_t> order(m_dirs.size());
+        for (size_t idx = 0; idx < order.size(); idx++)
+            order[idx] = idx;
+        std::shuffle(order.begin(), order.end(), rng);
+        order.resize(std::min(touchCnt, order.size()));
+
+        for (size_t dir : order)
+        {
+            std::vector<std::string>& files = m_files[dir];
+            const unsigned op = files.empty() ? 0 : rng() % 4;
+            const size_t fileIdx = files.empty() ? 0 : rng() % files.size();
+            switch (op)
+            {
+            case 0:
+                AddFile(dir, "new" + std::to_string(files.size()) + ".txt", rng() % 3000);
+                break;
+            case 1:
+                DeleteFile((m_dirs[dir] + "\\" + files[fileIdx]).c_str());
+                files.erase(files.begin() + fileIdx);
+                break;
+            case 2:
+                MoveFile((m_dirs[dir] + "\\" + files[fileIdx]).c_str(),
+                    (m_dirs[dir] + "\\" + files[fileIdx] + "_r").c_str());
+                files[fileIdx] += "_r";
+                break;
+            case 3:
+                {
+                    const size_t subDir = AddDir(dir, "n");
+                    AddFile(subDir, "a.txt", 10);
+                    AddFile(subDir, "b.dat", 20);
+                }
+                break;
+            }
+        }
+        return order;
+    }
+
+    std::string m_root;
+    std::string m_indexPath;
+    std::vector<std::string> m_dirs;                    // m_dirs[0] is m_root
+    std::vector<std::vector<std::string>> m_files;      // File names per directory
+};
+
+// ---------------------------------------------------------------------------
+// Line as li -s query shows an entry.
+static std::string EntryLine(const std::string& path, ULONGLONG size)
+{
+    std::ostringstream line;
+    line << std::setw(12) << size << " " << path;
+    return line.str();
+}
+
+static std::vector<std::string> SortedLines(const std::string& text)
+{
+    std::vector<std::string> lines;
+    std::istringstream input(text);
+    std::string line;
+    while (std::getline(input, line))
+    {
+        if ( !line.empty())
+            lines.push_back(line);
+    }
+    std::sort(lines.begin(), lines.end());
+    return lines;
+}
+
+// ---------------------------------------------------------------------------
+// LLIndex set up as li -s -i=<indexFile> [-X=<pathPat>], one object per
+// command as li runs them.
+class BenchIndex : public LLIndex
+{
+public:
+    explicit BenchIndex(const std::string& indexPath, const char* pExclude = nullptr)
+    {
+        m_indexPath = indexPath;
+        m_showSize = true;
+        if (pExclude != nullptr)
+            ParseBaseCmds(pExclude);
+    }
+
+    int Build(const std::string& root)
+    {
+        const char* pDirs[] = { root.c_str() };
+        return LLIndex::Build(1, pDirs);
+    }
+
+    int Update()
+    { return LLIndex::Update(); }
+
+    // Run query, return output lines sorted.
+    std::vector<std::string> Query(std::vector<const char*> patterns, int& result)
+    {
+        std::ostringstream outStream, errStream;
+        std::streambuf* pOutBuf = std::cout.rdbuf(outStream.rdbuf());
+        std::streambuf* pErrBuf = std::cerr.rdbuf(errStream.rdbuf());
+        result = LLIndex::Query((int)patterns.size(), patterns.data());
+        std::cout.rdbuf(pOutBuf);
+        std::cerr.rdbuf(pErrBuf);
+        return SortedLines(outStream.str());
+    }
+
+    LONGLONG Scanned() const
+    { return m_countScanned; }
+    LONGLONG Reused() const
+    { return m_countReused; }
+};
+
+// ---------------------------------------------------------------------------
+// Live DirectoryScan of tree, entries whose name matches pNamePat or whose
+// path matches pPathPat, all if both are null.
+struct LiveScan
+{
+    const CompiledPattern*      pNameMatch;
+    const CompiledPattern*      pPathMatch;
+    std::vector<std::string>    lines;
+};
+
+static int LiveCb(void* cbData, const char* pDir, const WIN32_FIND_DATA* pFileData, int depth)
+{
+    if (depth < 0)
+        return sIgnore;     // End of directory
+
+    LiveScan& scan = *(LiveScan*)cbData;
+    const std::string path = LLPath::Join(pDir, pFileData->cFileName);
+    if (scan.pNameMatch != nullptr || scan.pPathMatch != nullptr)
+    {
+        if ( !(scan.pNameMatch != nullptr && scan.pNameMatch->Matches(pFileData->cFileName))
+            && !(scan.pPathMatch != nullptr && scan.pPathMatch->Matches(path.c_str())))
+            return sIgnore;
+    }
+
+    const ULONGLONG size = ((ULONGLONG)pFileData->nFileSizeHigh << 32) | pFileData->nFileSizeLow;
+    scan.lines.push_back(EntryLine(path, size));
+    return sOkay;
+}
+
+static std::vector<std::string> LiveLines(const std::string& root, const char* pNamePat = nullptr, const char* pPathPat = nullptr)
+{
+    const CompiledPattern nameMatch(pNamePat != nullptr ? pNamePat : "");
+    const CompiledPattern pathMatch(pPathPat != nullptr ? pPathPat : "");
+    LiveScan scan;
+    scan.pNameMatch = (pNamePat != nullptr) ? &nameMatch : nullptr;
+    scan.pPathMatch = (pPathPat != nullptr) ? &pathMatch : nullptr;
+
+    DirectoryScan dirScan;
+    dirScan.m_recurse = true;
+    dirScan.m_add_cb = LiveCb;
+    dirScan.m_cb_data = &scan;
+    dirScan.Init(root.c_str(), NULL);
+    dirScan.GetFilesInDirectory();
+
+    std::sort(scan.lines.begin(), scan.lines.end());
+    return scan.lines;
+}
+
+// ---------------------------------------------------------------------------
+static bool SameLines(const char* step, const std::vector<std::string>& got, const std::vector<std::string>& expect)
+{
+    if (got == expect)
+        return true;
+
+    size_t idx = 0;
+    while (idx < got.size() && idx < expect.size() && got[idx] == expect[idx])
+        idx++;
+    printf("%s: query %zu lines, live scan %zu, first difference\n  query [%s]\n  live  [%s]\n", step,
+        got.size(), expect.size(), (idx < got.size()) ? got[idx].c_str() : "", (idx < expect.size()) ? expect[idx].c_str() : "");
+    return false;
+}
+
+static bool SameCounts(const char* step, const BenchIndex& index, size_t scanned, size_t reused)
+{
+    if (index.Scanned() == (LONGLONG)scanned && index.Reused() == (LONGLONG)reused)
+        return true;
+    printf("%s: scanned %lld reused %lld, expected %zu and %zu\n", step, index.Scanned(), index.Reused(), scanned, reused);
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Query of a damaged copy of the index must fail.
+static bool RejectsIndex(const char* step, const std::string& indexPath, const std::string& data)
+{
+    const std::string badPath = indexPath + ".bad";
+    WriteData(badPath, data);
+    BenchIndex index(badPath);
+    int result = 0;
+    index.Query({}, result);
+    DeleteFile(badPath.c_str());
+    if (result == sError)
+        return true;
+    printf("%s: damaged index was accepted\n", step);
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+static size_t CheckIndex(size_t, size_t& cases)
+{
+    std::mt19937 rng(8);
+    size_t bad = 0;
+
+    for (unsigned round = 0; round < 6; round++)
+    {
+        IndexTree tree;
+        tree.Generate(rng, 4 + rng() % 200, (round % 2 == 0) ? 5 : 40);
+        const size_t dirCnt = tree.m_dirs.size();
+        int result = 0;
+
+        // build scans every directory.
+        BenchIndex build(tree.m_indexPath);
+        cases++;
+        if (build.Build(tree.m_root) < 0 || !SameCounts("build", build, dirCnt, 0))
+            bad++;
+        cases++;
+        if ( !SameLines("build", BenchIndex(tree.m_indexPath).Query({}, result), LiveLines(tree.m_root)))
+            bad++;
+
+        // update without changes reuses every directory.
+        BenchIndex same(tree.m_indexPath);
+        cases++;
+        if (same.Update() < 0 || !SameCounts("unchanged update", same, 0, dirCnt))
+            bad++;
+
+        // Directory modify time has the system clock resolution, so changes
+        // made in the same tick as the tree was written would not show.
+        Sleep(50);
+        const size_t touchCnt = 1 + rng() % (dirCnt / 4 + 1);
+        const std::vector<size_t> touched = tree.Mutate(rng, touchCnt);
+        const size_t newDirs = tree.m_dirs.size() - dirCnt;
+
+        BenchIndex update(tree.m_indexPath);
+        cases++;
+        if (update.Update() < 0 || !SameCounts("update", update, touched.size() + newDirs, dirCnt - touched.size()))
+            bad++;
+        cases++;
+        if (GetFileAttributes((tree.m_indexPath + ".tmp").c_str()) != INVALID_FILE_ATTRIBUTES)
+        {
+            printf("update left %s.tmp\n", tree.m_indexPath.c_str());
+            bad++;
+        }
+
+        cases++;
+        if ( !SameLines("update", BenchIndex(tree.m_indexPath).Query({}, result), LiveLines(tree.m_root)))
+            bad++;
+        cases++;
+        if ( !SameLines("query *.log", BenchIndex(tree.m_indexPath).Query({ "*.log" }, result),
+                LiveLines(tree.m_root, "*.log")))
+            bad++;
+        const std::string pathPat = "*\\" + tree.m_dirs[dirCnt / 2].substr(tree.m_dirs[dirCnt / 2].rfind('\\') + 1) + "\\*";
+        cases++;
+        if ( !SameLines("query name and path", BenchIndex(tree.m_indexPath).Query({ "new*", pathPat.c_str() }, result),
+                LiveLines(tree.m_root, "new*", pathPat.c_str())))
+            bad++;
+
+        // Damaged index files.
+        const std::string data = ReadData(tree.m_indexPath);
+        cases += 4;
+        bad += !RejectsIndex("truncated", tree.m_indexPath, data.substr(0, data.size() - 1));
+        bad += !RejectsIndex("extended", tree.m_indexPath, data + '\0');
+        bad += !RejectsIndex("bad magic", tree.m_indexPath, "X" + data.substr(1));
+        bad += !RejectsIndex("empty", tree.m_indexPath, std::string());
+
+        // Table references out of range, sizes still add up.
+        LLIndexHeader header;
+        memcpy(&header, data.data(), sizeof(header));
+        const size_t dirPos = sizeof(LLIndexHeader);
+        const size_t entryPos = dirPos + header.dirCount * sizeof(LLIndexDir);
+        std::string damaged = data;
+        const DWORD entryEnd = header.entryCount + 1;
+        memcpy(&damaged[dirPos + offsetof(LLIndexDir, entryCount)], &entryEnd, sizeof(entryEnd));
+        cases += 3;
+        bad += !RejectsIndex("dir entries past table", tree.m_indexPath, damaged);
+        damaged = data;
+        memcpy(&damaged[dirPos + offsetof(LLIndexDir, pathOff)], &header.nameBytes, sizeof(header.nameBytes));
+        bad += !RejectsIndex("dir path past names", tree.m_indexPath, damaged);
+        damaged = data;
+        memcpy(&damaged[entryPos + offsetof(LLIndexEntry, nameOff)], &header.nameBytes, sizeof(header.nameBytes));
+        bad += !RejectsIndex("entry name past names", tree.m_indexPath, damaged);
+
+        // build with -X=*\d1\* does not walk into d1, d1 itself is indexed.
+        const std::string prunePath = tree.m_dirs[1] + "\\";
+        const std::string exclude = "X=*\\" + tree.m_dirs[1].substr(tree.m_dirs[1].rfind('\\') + 1) + "\\*";
+        size_t pruned = 0;
+        for (const std::string& dir : tree.m_dirs)
+            pruned += (dir == tree.m_dirs[1] || dir.compare(0, prunePath.length(), prunePath) == 0);
+        std::vector<std::string> expect;
+        for (const std::string& line : LiveLines(tree.m_root))
+        {
+            if (line.find(prunePath) == std::string::npos)
+                expect.push_back(line);
+        }
+
+        BenchIndex prune(tree.m_indexPath, exclude.c_str());
+        cases++;
+        if (prune.Build(tree.m_root) < 0 || !SameCounts("build -X", prune, tree.m_dirs.size() - pruned, 0))
+            bad++;
+        cases++;
+        if ( !SameLines("build -X", BenchIndex(tree.m_indexPath).Query({}, result), expect))
+            bad++;
+    }
+
+    return bad;
+}
+
+// ---------------------------------------------------------------------------
+static int RunTime(size_t dirCnt, unsigned maxFiles)
+{
+    std::mt19937 rng(5);
+    IndexTree tree;
+    tree.Generate(rng, dirCnt, maxFiles);
+    int result = 0;
+
+    BenchTimer timer;
+    BenchIndex(tree.m_indexPath).Build(tree.m_root);
+    const double buildMs = timer.Ms();
+
+    timer.Reset();
+    BenchIndex(tree.m_indexPath).Update();
+    const double updateMs = timer.Ms();
+
+    timer.Reset();
+    const size_t queryAll = BenchIndex(tree.m_indexPath).Query({}, result).size();
+    const double queryAllMs = timer.Ms();
+    timer.Reset();
+    const size_t liveAll = LiveLines(tree.m_root).size();
+    const double liveAllMs = timer.Ms();
+
+    timer.Reset();
+    const size_t queryLog = BenchIndex(tree.m_indexPath).Query({ "*.log" }, result).size();
+    const double queryLogMs = timer.Ms();
+    timer.Reset();
+    const size_t liveLog = LiveLines(tree.m_root, "*.log").size();
+    const double liveLogMs = timer.Ms();
+
+    printf("dirs=%zu entries=%zu  build %.0f ms  unchanged update %.0f ms\n", tree.m_dirs.size(), liveAll, buildMs, updateMs);
+    printf("%-8s %10s %12s %12s\n", "query", "entries", "index ms", "live ms");
+    printf("%-8s %10zu %12.1f %12.1f%s\n", "all", queryAll, queryAllMs, liveAllMs, (queryAll == liveAll) ? "" : "  count differs");
+    printf("%-8s %10zu %12.1f %12.1f%s\n", "*.log", queryLog, queryLogMs, liveLogMs, (queryLog == liveLog) ? "" : "  count differs");
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+static int TimeMode(int argc, char* argv[])
+{
+    return RunTime(BenchArg(argc, argv, 2, 20000), (unsigned)BenchArg(argc, argv, 3, 50));
+}
+
+// ---------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    return BenchMain(argc, argv, "indexbench", CheckIndex, 0, TimeMode);
+}
@@ -0,0 +1,70 @@
+@echo off
+rem
+rem  Build the bench programs with the Visual Studio compiler (cl) into bench\bin.
+rem  Run from a x64 "Developer Command Prompt".
+rem
+rem     make-bench          ; build all
+rem     make-bench run      ; build all then run each, exit code 1 if any check fails
+rem
+
+setlocal enableextensions
+pushd %~dp0
+if not exist bin mkdir bin
+
+set SRC=..\src
+set CLOPTS=/nologo /O2 /EHsc /std:c++20 /MT /DWIN32 /D_CRT_SECURE_NO_WARNINGS /DWIN32_LEAN_AND_MEAN /DNDEBUG /D_CONSOLE /I%SRC% /Fobin\
+set BENCHES=
+set FAILED=0
+
+rem  Benches of a command class (LLCmp) link all tool sources except the
+rem  llfile main and llreplace, which needs ZipLib.
+setlocal enabledelayedexpansion
+set TOOLSRC=
+for %%F in (%SRC%\*.cpp) do (
+    if /I not "%%~nF"=="llfile" if /I not "%%~nF"=="llreplace" set TOOLSRC=!TOOLSRC! %%F
+)
+
+call :build patternbench    %SRC%\dirscan.cpp %SRC%\llmsg.cpp
+call :build patternsetbench %SRC%\patternset.cpp %SRC%\dirscan.cpp %SRC%\llmsg.cpp
+call :build dirsortbench    %SRC%\lldirSort.cpp %SRC%\dirscan.cpp %SRC%\llmsg.cpp
+call :build cmpgroupbench   %TOOLSRC%
+call :build cmppipebench    %TOOLSRC%
+call :build textdiffbench   %TOOLSRC%
+call :build hashbench       %SRC%\hashengine.cpp %SRC%\hash.cpp
+call :build hashfilebench   %TOOLSRC%
+call :build treehashbench   %TOOLSRC%
+call :build grepfilterbench %SRC%\grepfilter.cpp
+call :build regexbench      %SRC%\llregex.cpp
+call :build indexbench      %TOOLSRC%
+
+if /I "%1" NEQ "run" goto done
+for %%B in (%BENCHES%) do (
+    echo.
+    echo ===== %%B
+    bin\%%B.exe || set FAILED=1
+)
+
+:done
+popd
+exit /b %FAILED%
+
+rem ---------------------------------------------------------------------------
+rem  build <name> <source files...>     ; compile <name>.cpp plus sources into bin\<name>.exe
+:build
+set NAME=%1
+set FILES=
+:buildArgs
+shift
+if "%1"=="" goto buildRun
+set FILES=%FILES% %1
+goto buildArgs
+:buildRun
+echo Building %NAME%
+cl %CLOPTS% /Febin\%NAME%.exe %NAME%.cpp %FILES% Advapi32.lib Psapi.lib > bin\%NAME%.log
+if ERRORLEVEL 1 (
+    type bin\%NAME%.log
+    set FAILED=1
+    exit /b 1
+)
+set BENCHES=%BENCHES% %NAME%
+exit /b 0
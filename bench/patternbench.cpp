@@ -0,0 +1,214 @@
+//-----------------------------------------------------------------------------
+// patternbench - Check and time wildcard matching, PatternMatch and CompiledPattern.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+//
+// Usage: patternbench [mode [args]]
+//
+//  check [count]       ; Random patterns of  a A b B . ? * !  against random
+//                        names, PatternMatch and CompiledPattern must agree
+//                        with a dynamic programming reference.
+//  time                ; Time per match of the old recursive matcher,
+//                        PatternMatch and CompiledPattern on typical and
+//                        worst case patterns.
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "dirscan.h"
+#include "benchutil.h"
+
+// ---------------------------------------------------------------------------
+// Recursive matcher PatternMatch used before compiled patterns, kept for timing.
+static bool OldWildCompare(const char* wildStr, int wildOff, const char* rawStr, int rawOff)
+{
+    const char EOS = '\0';
+    while (wildStr[wildOff])
+    {
+        if (rawStr[rawOff] == EOS)
+            return (wildStr[wildOff] == '*' && wildStr[wildOff+1] == EOS);
+
+        if (wildStr[wildOff] == '*')
+        {
+            if (wildStr[wildOff + 1] == EOS)
+                return true;
+
+            do
+            {
+                while (rawStr[rawOff] &&
+                    !DirectoryScan::ChrCmp(rawStr[rawOff], wildStr[wildOff+1]))
+                    rawOff++;
+                if (rawStr[rawOff] &&
+                    OldWildCompare(wildStr, wildOff + 1, rawStr, rawOff))
+                        return true;
+                if (rawStr[rawOff])
+                    ++rawOff;
+            } while (rawStr[rawOff]);
+
+            if (rawStr[rawOff] == EOS)
+                return (wildStr[wildOff+1] == '*' && wildStr[wildOff + 2] == EOS );
+        }
+        else if (wildStr[wildOff] == '?')
+        {
+            if (rawStr[rawOff] == EOS)
+                return false;
+            rawOff++;
+        }
+        else
+        {
+            if ( !DirectoryScan::ChrCmp(rawStr[rawOff], wildStr[wildOff]))
+                return false;
+            if (wildStr[wildOff] == EOS)
+                return true;
+            ++rawOff;
+        }
+
+        ++wildOff;
+    }
+
+    return (wildStr[wildOff] == rawStr[rawOff]);
+}
+
+static bool OldPatternMatch(const std::string& pattern, const char* str)
+{
+    if (pattern.length() > 1 && pattern[0] == '!')
+        return !OldWildCompare(pattern.c_str(), 1, str, 0);
+    return OldWildCompare(pattern.c_str(), 0, str, 0);
+}
+
+// ---------------------------------------------------------------------------
+// Reference matcher, match[p][s] table over pattern and string prefixes.
+static bool RefMatch(const std::string& pattern, const char* str)
+{
+    const bool negate = pattern.length() > 1 && pattern[0] == '!';
+    const std::string wild = pattern.substr(negate ? 1 : 0);
+    const size_t strLen = strlen(str);
+
+    std::vector<std::vector<char>> match(wild.length() + 1, std::vector<char>(strLen + 1, 0));
+    match[0][0] = 1;
+    for (size_t pIdx = 1; pIdx <= wild.length(); pIdx++)
+    {
+        const char wildChr = wild[pIdx - 1];
+        if (wildChr == '*')
+            match[pIdx][0] = match[pIdx - 1][0];
+        for (size_t sIdx = 1; sIdx <= strLen; sIdx++)
+        {
+            if (wildChr == '*')
+                match[pIdx][sIdx] = match[pIdx - 1][sIdx] || match[pIdx][sIdx - 1];
+            else if (wildChr == '?' || ToLower(wildChr) == ToLower(str[sIdx - 1]))
+                match[pIdx][sIdx] = match[pIdx - 1][sIdx - 1];
+        }
+    }
+
+    return (match[wild.length()][strLen] != 0) != negate;
+}
+
+// ---------------------------------------------------------------------------
+static size_t CheckMatch(size_t checkCnt, size_t& cases)
+{
+    std::mt19937 rng(1);
+    const char patChars[] = "aAbB.?*!x";
+    const char strChars[] = "aAbBx.";
+    size_t bad = 0;
+
+    for (size_t iter = 0; iter < checkCnt; iter++)
+    {
+        std::string pattern, str;
+        const unsigned patLen = rng() % 7;
+        const unsigned strLen = rng() % 9;
+        for (unsigned idx = 0; idx < patLen; idx++)
+            pattern += patChars[rng() % (sizeof(patChars) - 1)];
+        for (unsigned idx = 0; idx < strLen; idx++)
+            str += strChars[rng() % (sizeof(strChars) - 1)];
+
+        const bool ref = RefMatch(pattern, str.c_str());
+        const bool iterative = PatternMatch(pattern, str.c_str());
+        const bool compiled = CompiledPattern(pattern).Matches(str.c_str());
+        if (iterative != ref || compiled != ref)
+        {
+            if (bad++ < 10)
+                printf("Mismatch pattern=[%s] name=[%s] ref=%d PatternMatch=%d Compiled=%d\n",
+                    pattern.c_str(), str.c_str(), ref, iterative, compiled);
+        }
+    }
+    cases += checkCnt;
+    return bad;
+}
+
+// ---------------------------------------------------------------------------
+static int TimeMode(int, char*[])
+{
+    struct TimeCase
+    {
+        const char* pattern;
+        const char* name;
+        unsigned    iters;
+    };
+    static const TimeCase sCases[] =
+    {
+        { "*.txt",          "some_long_file_name_report_2024.txt",      2000000 },
+        { "*report*2024*",  "some_long_file_name_report_2024.txt",      2000000 },
+        { "p???.dat",       "p123.dat",                                 2000000 },
+        { "*a*a*a*a*a*b",   "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", 2000 },
+    };
+
+    printf("\n%-16s %14s %12s %12s   (ns per match)\n", "pattern", "old recursive", "iterative", "compiled");
+    for (const TimeCase& timeCase : sCases)
+    {
+        const std::string pattern = timeCase.pattern;
+        const CompiledPattern compiled(pattern);
+        volatile unsigned sink = 0;
+
+        BenchTimer timer;
+        for (unsigned idx = 0; idx < timeCase.iters; idx++)
+            sink = sink + OldPatternMatch(pattern, timeCase.name);
+        const double oldMs = timer.Ms();
+
+        timer.Reset();
+        for (unsigned idx = 0; idx < timeCase.iters; idx++)
+            sink = sink + PatternMatch(pattern, timeCase.name);
+        const double iterMs = timer.Ms();
+
+        timer.Reset();
+        for (unsigned idx = 0; idx < timeCase.iters; idx++)
+            sink = sink + compiled.Matches(timeCase.name);
+        const double compMs = timer.Ms();
+
+        const double toNs = 1e6 / timeCase.iters;
+        printf("%-16s %14.1f %12.1f %12.1f\n", timeCase.pattern, oldMs * toNs, iterMs * toNs, compMs * toNs);
+    }
+
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    return BenchMain(argc, argv, "patternbench", CheckMatch, 400000, TimeMode);
+}
@@ -0,0 +1,204 @@
+//-----------------------------------------------------------------------------
+// patternsetbench - Check and time PatternSet, the combined -F/-X/-D matcher.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+//
+// Usage: patternsetbench [mode [args]]
+//
+//  check [lists]       ; Random pattern lists of every shape (*.ext, prefix*,
+//                        literal, general, negated). PatternSet::Find, before
+//                        and after Build, must return the lowest index a linear
+//                        scan of the patterns finds.
+//  time                ; Time to add and Build n patterns, and ns per name for
+//                        Find against a linear scan of the same patterns.
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "patternset.h"
+#include "benchutil.h"
+
+// ---------------------------------------------------------------------------
+static int LinearFind(const std::vector<CompiledPattern>& patterns, const char* str)
+{
+    for (size_t patIdx = 0; patIdx < patterns.size(); patIdx++)
+    {
+        if (patterns[patIdx].Matches(str))
+            return (int)patIdx;
+    }
+    return -1;
+}
+
+// ---------------------------------------------------------------------------
+static std::string RandomPattern(std::mt19937& rng)
+{
+    const char wildChars[] = "aAbB.?*!xc";
+    std::string pattern;
+    const unsigned patLen = rng() % 6;
+
+    switch (rng() % 4)
+    {
+    case 0:     // *.ext
+        pattern = "*.";
+        for (unsigned idx = 1 + rng() % 3; idx != 0; idx--)
+            pattern += "abcx"[rng() % 4];
+        break;
+    case 1:     // prefix*
+        for (unsigned idx = 0; idx < patLen; idx++)
+            pattern += "aAbx."[rng() % 5];
+        pattern += '*';
+        break;
+    default:    // literal, general or negated
+        for (unsigned idx = 0; idx < patLen; idx++)
+            pattern += wildChars[rng() % (sizeof(wildChars) - 1)];
+        break;
+    }
+    return pattern;
+}
+
+// ---------------------------------------------------------------------------
+static size_t CheckRandom(size_t listCnt, size_t& cases)
+{
+    std::mt19937 rng(7);
+    size_t bad = 0;
+
+    for (size_t iter = 0; iter < listCnt; iter++)
+    {
+        PatternSet patSet;
+        std::vector<CompiledPattern> patterns;
+        for (unsigned cnt = 1 + rng() % 8; cnt != 0; cnt--)
+        {
+            patterns.push_back(CompiledPattern(RandomPattern(rng)));
+            patSet.push_back(patterns.back());
+        }
+
+        std::vector<std::string> names;
+        for (unsigned cnt = 0; cnt < 8; cnt++)
+        {
+            std::string name;
+            for (unsigned len = rng() % 9; len != 0; len--)
+                name += "aAbBxc."[rng() % 7];
+            names.push_back(name);
+        }
+
+        // Check unbuilt (linear fallback) then built tables.
+        for (int pass = 0; pass < 2; pass++)
+        {
+            if (pass == 1)
+                patSet.Build();
+            for (const std::string& name : names)
+            {
+                cases++;
+                const int ref = LinearFind(patterns, name.c_str());
+                const int got = patSet.Find(name.c_str());
+                if (got != ref && bad++ < 10)
+                {
+                    printf("Mismatch built=%d name=[%s] linear=%d Find=%d patterns:", pass, name.c_str(), ref, got);
+                    for (const CompiledPattern& pattern : patterns)
+                        printf(" [%s]", pattern.Pattern().c_str());
+                    printf("\n");
+                }
+            }
+        }
+    }
+
+    return bad;
+}
+
+// ---------------------------------------------------------------------------
+// Mix of shapes seen in -X lists, exts, names, prefixes and general globs.
+static std::vector<std::string> MakePatterns(size_t count)
+{
+    std::vector<std::string> patterns;
+    char buf[64];
+    for (size_t idx = 0; idx < count; idx++)
+    {
+        switch (idx % 4)
+        {
+        case 0: snprintf(buf, sizeof(buf), "*.e%zu", idx); break;
+        case 1: snprintf(buf, sizeof(buf), "name%zu.txt", idx); break;
+        case 2: snprintf(buf, sizeof(buf), "pre%zu*", idx); break;
+        default: snprintf(buf, sizeof(buf), "*mid%zu*.log", idx); break;
+        }
+        patterns.push_back(buf);
+    }
+    return patterns;
+}
+
+// ---------------------------------------------------------------------------
+static int TimeMode(int, char*[])
+{
+    const char* sNames[] =
+    {
+        "report_2024.docx", "pre77_build.obj", "name1001.txt", "x_mid3_y.log",
+        "thumbs.db", "main.cpp", "README.md", "a_very_long_file_name_without_match.bin",
+    };
+    const size_t nameCnt = sizeof(sNames) / sizeof(sNames[0]);
+
+    printf("\n%8s %12s %14s %14s   (Find and linear in ns per name)\n", "patterns", "add+Build ms", "Find", "linear");
+    for (size_t count : { 10, 100, 1000, 10000 })
+    {
+        const std::vector<std::string> strPatterns = MakePatterns(count);
+
+        BenchTimer timer;
+        PatternSet patSet;
+        std::vector<CompiledPattern> patterns;
+        for (const std::string& pattern : strPatterns)
+        {
+            patterns.push_back(CompiledPattern(pattern));
+            patSet.push_back(patterns.back());
+        }
+        patSet.Build();
+        const double buildMs = timer.Ms();
+
+        const size_t rounds = 2000000 / count + 1;
+        volatile int sink = 0;
+        timer.Reset();
+        for (size_t round = 0; round < rounds; round++)
+            for (size_t idx = 0; idx < nameCnt; idx++)
+                sink = sink + patSet.Find(sNames[idx]);
+        const double findNs = timer.Ms() * 1e6 / (rounds * nameCnt);
+
+        timer.Reset();
+        for (size_t round = 0; round < rounds; round++)
+            for (size_t idx = 0; idx < nameCnt; idx++)
+                sink = sink + LinearFind(patterns, sNames[idx]);
+        const double linearNs = timer.Ms() * 1e6 / (rounds * nameCnt);
+
+        printf("%8zu %12.2f %14.1f %14.1f\n", count, buildMs, findNs, linearNs);
+    }
+
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    return BenchMain(argc, argv, "patternsetbench", CheckRandom, 200000, TimeMode);
+}
@@ -0,0 +1,440 @@
+//-----------------------------------------------------------------------------
+// regexbench - Check and time LLRegex, the -g=Ed linear time engine, against std::regex.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+//
+// Usage: regexbench [mode [args]]
+//
+//  check [fuzzCount]   ; Corpus of patterns and subjects, then random patterns.
+//                        Search, Search with captures, MatchAll and Replace of
+//                        engine eDfa must give what eStd (std::regex) gives,
+//                        with default, not_bol|not_eol and prev_avail flags.
+//                        Patterns eDfa can't run must fall back to eStd.
+//  time                ; Log search MB/s per engine, whole buffer and by line,
+//                        patterns which backtrack badly in std::regex, a DFA
+//                        state explosion and 8 threads sharing one DFA cache.
+
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "llregex.h"
+#include "benchutil.h"
+
+static const LLRegex::Flags sFlags[] =
+{
+    std::regex_constants::match_default,
+    std::regex_constants::match_not_bol | std::regex_constants::match_not_eol,
+    std::regex_constants::match_prev_avail,
+};
+static const size_t sFlagCnt = sizeof(sFlags) / sizeof(sFlags[0]);
+
+// ---------------------------------------------------------------------------
+// Everything LLRegex returns for subject [beg, end) with the active engine.
+static std::string Results(const LLRegex& regex, const char* beg, const char* end, LLRegex::Flags flags, bool replace)
+{
+    std::ostringstream out;
+    out << regex.Search(beg, end, flags);
+
+    LLRegex::Match match;
+    if (regex.Search(beg, end, match, flags))
+    {
+        for (size_t idx = 0; idx < match.size(); idx++)
+            out << "[" << (match[idx].matched ? match[idx].first - beg : -1) << "," << match.length(idx) << "]";
+        out << match.prefix().length() << "/" << match.suffix().length();
+    }
+    out << "|" << regex.MatchAll(beg, end, flags);
+
+    static const char* const sFormats[] = { "<$&>", "$1-$2", "$$x$`|$'", "[$0$9$10$x]" };
+    for (const char* format : sFormats)
+    {
+        if ( !replace)
+            break;
+        out << "|" << regex.Replace(std::string(beg, end), format, flags);
+        std::ostringstream firstOut;
+        regex.Replace(firstOut, beg, end, format, flags | std::regex_constants::format_first_only);
+        out << "|" << firstOut.str();
+    }
+    return out.str();
+}
+
+// Compare engines on one subject, the character before it is available to
+// match_prev_avail. Return false on a mismatch.
+static bool SameResults(const LLRegex& regex, const std::string& subject, LLRegex::Flags flags, bool replace,
+    std::string& stdResult, std::string& dfaResult)
+{
+    const std::string buffer = "x" + subject;
+    const char* beg = buffer.data() + 1;
+    const char* end = buffer.data() + buffer.size();
+
+    LLRegex::sEngine = LLRegex::eStd;
+    stdResult = Results(regex, beg, end, flags, replace);
+    LLRegex::sEngine = LLRegex::eDfa;
+    dfaResult = Results(regex, beg, end, flags, replace);
+    LLRegex::sEngine = LLRegex::eStd;
+    return stdResult == dfaResult;
+}
+
+static std::string Printable(const std::string& str)
+{
+    std::string printable;
+    for (char chr : str)
+        printable += (chr == '\n') ? "\\n" : ((chr == '\r') ? "\\r" : ((chr == '\t') ? "\\t" : std::string(1, chr)));
+    return printable;
+}
+
+// ---------------------------------------------------------------------------
+static size_t CheckCorpus(size_t& cases)
+{
+    static const char* const sSubjects[] =
+    {
+        "", "a", "abc", "aaa", "abcabc", "hello world", "foo bar_baz 123", "ERROR timeout=1234", "a\nb",
+        "x\r\ny", "The Quick Brown", "ab\nab", "aab", "abab", "xyz", "__init__", "a-b-c", "1.5e10",
+        "tab\there", "AbC", "mississippi", "aaaaaaaaaaaaaaaaaaaab", "\tsp ace\n", "(paren)", "[x]", "a.b",
+        "$dollar", "z{2}", "xaxx",
+    };
+
+    struct Pattern { const char* pattern; bool ignoreCase; bool dfa; };
+    static const Pattern sPatterns[] =
+    {
+        { "a", false, true }, { "abc", false, true }, { "a|b", false, true }, { "a*", false, true },
+        { "a+", false, true }, { "a?", false, true }, { "a*?", false, true }, { "a+?", false, true },
+        { "(a|ab)(c|bcd)?", false, true }, { "(a+)+b", false, true },
+        { "^a", false, true }, { "c$", false, true }, { "^$", false, true }, { "^", false, true },
+        { "$", false, true }, { "\\bw", false, true }, { "o\\b", false, true }, { "\\B.", false, true },
+        { "\\w+", false, true }, { "\\W+", false, true }, { "\\d+", false, true }, { "\\D", false, true },
+        { "\\s+", false, true }, { "\\S+", false, true }, { "[a-c]+", false, true }, { "[^a-c]+", false, true },
+        { "[\\d.]+", false, true }, { "[\\w-]+", false, true }, { ".", false, true }, { ".*", false, true },
+        { ".+", false, true }, { "a.b", false, true }, { "a\\.b", false, true }, { "(\\w+) (\\w+)", false, true },
+        { "(a)|(b)", false, true }, { "(?:ab)+", false, true }, { "(a|b)*c", false, true }, { "a{2}", false, true },
+        { "a{2,}", false, true }, { "a{1,3}", false, true }, { "a{0,2}?", false, true }, { "(ab){1,2}", false, true },
+        { "ss(i|p)", false, true }, { "(s+)(i)", false, true }, { "abc", true, true }, { "[a-c]+", true, true },
+        { "[^a]+", true, true }, { "QUICK", true, true }, { "b[r]own", true, true }, { "\\x41", false, true },
+        { "\\u0062", false, true }, { "\\t", false, true }, { "\\n", false, true }, { "[\\n\\r]", false, true },
+        { "\\$\\w+", false, true }, { "\\(\\w+\\)", false, true }, { "\\[x\\]", false, true },
+        { "z\\{2\\}", false, true }, { "ERROR timeout=[0-9]+", false, true }, { "=\\d{2,3}", false, true },
+        { "(a)(b)?", false, true }, { "((a)b)+", false, true }, { "()", false, true },
+        { "(?:(a)|b)?", false, true },
+        { "a||b", false, true }, { "(|a)", false, true }, { "x*", false, true }, { "\\b", false, true },
+        { "\\B", false, true }, { "(\\d+)\\.(\\d+)", false, true }, { "[.]", false, true }, { "[\\]]", false, true },
+        { "[a\\-z]", false, true }, { "[-a]", false, true }, { "[a-]", false, true },
+        // eStd only, back reference, lookahead, named class, non-ascii, \c,
+        // repeats of patterns which match empty and repeats which can leave
+        // a group unset, ECMAScript clears it on each iteration.
+        { "(a)\\1", false, false }, { "a(?=b)", false, false }, { "[[:alpha:]]+", false, false },
+        { "\\u1234", false, false }, { "\\cI", false, false }, { "(a*)*b", false, false }, { "(a|)+", false, false },
+        { "((a)|b)+", false, false }, { "(?:(a)|b)+", false, false }, { "(?:(a)|(b)){2}", false, false },
+        { "(?:x(a)?)+", false, false }, { "(?:(a)|(a)b)+c", false, false },
+    };
+
+    size_t bad = 0;
+    for (const Pattern& pattern : sPatterns)
+    {
+        LLRegex regex;
+        regex.Assign(pattern.pattern, pattern.ignoreCase);
+        LLRegex::sEngine = LLRegex::eDfa;
+        const bool dfa = regex.ActiveEngine() == LLRegex::eDfa;
+        LLRegex::sEngine = LLRegex::eStd;
+        cases++;
+        if (dfa != pattern.dfa && bad++ < 10)
+            printf("Pattern /%s/ runs on %s, expected %s\n", pattern.pattern, dfa ? "eDfa" : "eStd", pattern.dfa ? "eDfa" : "eStd");
+
+        for (const char* subject : sSubjects)
+        {
+            for (size_t flagIdx = 0; flagIdx < sFlagCnt; flagIdx++)
+            {
+                std::string stdResult, dfaResult;
+                cases++;
+                if ( !SameResults(regex, subject, sFlags[flagIdx], true, stdResult, dfaResult) && bad++ < 10)
+                    printf("Pattern /%s/%s subject [%s] flags %zu\n  std %s\n  dfa %s\n", pattern.pattern,
+                        pattern.ignoreCase ? "i" : "", Printable(subject).c_str(), flagIdx, stdResult.c_str(), dfaResult.c_str());
+            }
+        }
+    }
+    return bad;
+}
+
+// ---------------------------------------------------------------------------
+// Random patterns of nested groups, classes, assertions and quantifiers.
+class PatternMaker
+{
+public:
+    explicit PatternMaker(unsigned seed) : m_rng(seed)
+    { }
+
+    std::string Alternatives(unsigned depth)
+    {
+        std::string pattern;
+        for (unsigned idx = 0, cnt = 1 + m_rng() % 3; idx < cnt; idx++)
+        {
+            if (idx != 0 && m_rng() % 4 == 0)
+                pattern += '|';
+            pattern += Atom(depth);
+        }
+        return pattern;
+    }
+
+    unsigned Next(unsigned range)
+    { return m_rng() % range; }
+
+private:
+    std::string Atom(unsigned depth)
+    {
+        static const char* const sAtoms[] =
+        {
+            "a", "b", "c", "x", " ", "\\n", ".", "\\w", "\\d", "\\s", "\\W", "[ab]", "[^a]", "[a-c]",
+            "\\b", "\\B", "^", "$", "\\.", "_", "1",
+        };
+        static const char* const sQuants[] = { "", "", "", "*", "+", "?", "*?", "+?", "??", "{2}", "{1,2}", "{0,}", "{2,3}?" };
+
+        std::string atom;
+        const unsigned kind = m_rng() % ((depth > 2) ? 10 : 14);
+        if (kind < 10)
+            atom = sAtoms[m_rng() % (sizeof(sAtoms) / sizeof(sAtoms[0]))];
+        else if (kind < 12)
+            atom = "(" + Alternatives(depth + 1) + ")";
+        else
+            atom = "(?:" + Alternatives(depth + 1) + ")";
+
+        if (atom == "^" || atom == "$" || atom == "\\b" || atom == "\\B")
+            return atom;
+        return atom + sQuants[m_rng() % (sizeof(sQuants) / sizeof(sQuants[0]))];
+    }
+
+    std::mt19937 m_rng;
+};
+
+static size_t CheckRandom(size_t patternCnt, size_t& cases)
+{
+    PatternMaker maker(777);
+    size_t bad = 0;
+    const char sAlphabet[] = "abcx _1.\n";
+
+    for (size_t iter = 0; iter < patternCnt; iter++)
+    {
+        std::string pattern = maker.Alternatives(0);
+        const bool ignoreCase = maker.Next(5) == 0;
+        for (char& chr : pattern)
+        {
+            if (ignoreCase && chr == 'a' && maker.Next(2) != 0)
+                chr = 'A';
+        }
+
+        LLRegex regex;
+        try
+        {
+            regex.Assign(pattern, ignoreCase);
+        }
+        catch (const std::regex_error&)
+        {
+            continue;
+        }
+        LLRegex::sEngine = LLRegex::eDfa;
+        const bool dfa = regex.ActiveEngine() == LLRegex::eDfa;
+        LLRegex::sEngine = LLRegex::eStd;
+        if ( !dfa)
+            continue;
+
+        // Replace of \b patterns is left out, std::regex_replace resumes the
+        // search without the previous character in some library versions.
+        const bool replace = pattern.find("\\b") == std::string::npos && pattern.find("\\B") == std::string::npos;
+        for (unsigned subjectIdx = 0; subjectIdx < 8; subjectIdx++)
+        {
+            std::string subject;
+            for (unsigned len = maker.Next(14); len != 0; len--)
+                subject += sAlphabet[maker.Next(sizeof(sAlphabet) - 1)];
+            for (char& chr : subject)
+            {
+                if (ignoreCase && chr == 'a' && maker.Next(2) != 0)
+                    chr = 'A';
+            }
+
+            const size_t flagIdx = maker.Next(sFlagCnt);
+            std::string stdResult, dfaResult;
+            cases++;
+            if ( !SameResults(regex, subject, sFlags[flagIdx], replace, stdResult, dfaResult) && bad++ < 10)
+                printf("Pattern /%s/%s subject [%s] flags %zu\n  std %s\n  dfa %s\n", Printable(pattern).c_str(),
+                    ignoreCase ? "i" : "", Printable(subject).c_str(), flagIdx, stdResult.c_str(), dfaResult.c_str());
+        }
+    }
+    return bad;
+}
+
+// ---------------------------------------------------------------------------
+struct SharedWork
+{
+    const LLRegex*  pRegex;
+    unsigned        thread;
+    size_t          matched;
+};
+
+static DWORD WINAPI SharedThread(LPVOID pParam)
+{
+    SharedWork& work = *(SharedWork*)pParam;
+    const std::string host = "host" + std::to_string(work.thread);
+    for (unsigned idx = 0; idx < 20000; idx++)
+    {
+        const std::string line = "user" + std::to_string(idx * 8 + work.thread) + " mail x" +
+            std::to_string(idx) + "@" + host + ".com end";
+        LLRegex::Match match;
+        if (work.pRegex->Search(line, match) && match.str(2) == host)
+            work.matched++;
+    }
+    return 0;
+}
+
+static const char* EngineName()
+{ return (LLRegex::sEngine == LLRegex::eDfa) ? "dfa" : "std"; }
+
+static void RunTime()
+{
+    std::string text;
+    for (unsigned line = 0; line < 200000; line++)
+    {
+        text += "2026-10-17 12:00:" + std::to_string(line % 60) + " INFO worker thread " + std::to_string(line)
+            + " processed request ok\n";
+        if (line % 5000 == 0)
+            text += "2026-10-17 ERROR timeout=1234 in handler\n";
+    }
+
+    printf("%-30s %s %8s %10s %10s %8s %10s   (%.1f MB log)\n", "pattern", "eng", "matches", "buffer ms", "MB/s",
+        "lines", "lines ms", text.size() / 1e6);
+    for (const char* patStr : { "ERROR timeout=[0-9]+", "\\bhandler\\b", "(worker|thread) \\d+ processed",
+        "[A-Z]{5} \\w+=\\d+", "req(uest)? (ok|fail)" })
+    {
+        LLRegex regex;
+        regex.Assign(patStr, false);
+        for (LLRegex::Engine engine : { LLRegex::eStd, LLRegex::eDfa })
+        {
+            LLRegex::sEngine = engine;
+            const char* strPtr = text.data();
+            const char* endPtr = strPtr + text.size();
+            size_t matchCnt = 0;
+            LLRegex::Match match;
+            BenchTimer timer;
+            while (regex.Search(strPtr, endPtr, match, std::regex_constants::match_not_bol | std::regex_constants::match_not_eol))
+            {
+                matchCnt++;
+                strPtr = match[0].second + (match.length() == 0 ? 1 : 0);
+            }
+            const double bufferMs = timer.Ms();
+
+            timer.Reset();
+            size_t lineCnt = 0;
+            for (const char* linePtr = text.data(); linePtr < endPtr; )
+            {
+                const char* eolPtr = (const char*)memchr(linePtr, '\n', endPtr - linePtr);
+                if (eolPtr == NULL)
+                    eolPtr = endPtr;
+                lineCnt += regex.Search(linePtr, eolPtr);
+                linePtr = eolPtr + 1;
+            }
+            const double linesMs = timer.Ms();
+            printf("%-30s %s %8zu %10.1f %10.1f %8zu %10.1f\n", patStr, EngineName(), matchCnt, bufferMs,
+                text.size() / (bufferMs * 1e3), lineCnt, linesMs);
+        }
+    }
+
+    // Backtracking, std::regex time grows exponentially with the subject.
+    const std::string subject(24, 'a');
+    printf("\n");
+    for (const char* patStr : { "(?:a|aa)+c", "(a+)+b" })
+    {
+        LLRegex regex;
+        regex.Assign(patStr, false);
+        for (LLRegex::Engine engine : { LLRegex::eDfa, LLRegex::eStd })
+        {
+            LLRegex::sEngine = engine;
+            BenchTimer timer;
+            const bool found = regex.Search(subject);
+            printf("%-12s on a{%zu} %s found=%d %10.3f ms\n", patStr, subject.size(), EngineName(), found, timer.Ms());
+        }
+    }
+
+    // DFA state explosion, the cache is flushed and rebuilt as it fills.
+    {
+        LLRegex regex;
+        regex.Assign("[ab]*a[ab]{14}x", false);
+        std::mt19937 rng(1);
+        std::string abText;
+        for (unsigned idx = 0; idx < 2000000; idx++)
+            abText += "ab"[rng() % 2];
+        abText += "x";
+        LLRegex::sEngine = LLRegex::eDfa;
+        LLRegex::Match match;
+        BenchTimer timer;
+        const bool found = regex.Search(abText, match);
+        printf("\n[ab]*a[ab]{14}x on %zu bytes dfa found=%d at %td %.1f ms\n", abText.size(), found,
+            found ? match.position() : -1, timer.Ms());
+    }
+
+    // Threads share one compiled program and DFA cache.
+    {
+        LLRegex::sEngine = LLRegex::eDfa;
+        LLRegex regex;
+        regex.Assign("(\\w+)@(\\w+)\\.com", false);
+        SharedWork work[8];
+        HANDLE threadHnds[8];
+        BenchTimer timer;
+        for (unsigned idx = 0; idx < 8; idx++)
+        {
+            work[idx] = { &regex, idx, 0 };
+            threadHnds[idx] = CreateThread(NULL, 0, SharedThread, &work[idx], 0, NULL);
+        }
+        WaitForMultipleObjects(8, threadHnds, TRUE, INFINITE);
+        size_t matched = 0;
+        for (unsigned idx = 0; idx < 8; idx++)
+        {
+            CloseHandle(threadHnds[idx]);
+            matched += work[idx].matched;
+        }
+        printf("8 threads sharing one DFA matched %zu of 160000 in %.1f ms\n", matched, timer.Ms());
+    }
+    LLRegex::sEngine = LLRegex::eStd;
+}
+
+// ---------------------------------------------------------------------------
+static size_t CheckAll(size_t fuzzCnt, size_t& cases)
+{
+    const size_t bad = CheckCorpus(cases);
+    return bad + CheckRandom(fuzzCnt, cases);
+}
+
+// ---------------------------------------------------------------------------
+static int TimeMode(int, char*[])
+{
+    RunTime();
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    return BenchMain(argc, argv, "regexbench", CheckAll, 20000, TimeMode);
+}
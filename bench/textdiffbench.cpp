@@ -0,0 +1,330 @@
+//-----------------------------------------------------------------------------
+// textdiffbench - Check and time llcmp -t text compare hunks.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+//
+// Usage: textdiffbench [mode [args]]
+//
+//  check               ; Random line files against copies with lines inserted,
+//                        deleted, changed and only white space changed. Files
+//                        must be equal only if equal less white space, applying
+//                        the -V hunks to the left lines must give the right
+//                        lines, hunks must change as few lines as a longest
+//                        common subsequence allows, and -V=<count> must show
+//                        up to count lines from each file.
+//  time <lines> <edits>
+//                      ; Text compare of a lines file against a copy with
+//                        edits changed lines, MB/s with and without -V.
+//
+// Files are made in the temp directory and removed.
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cmptrees.h"
+#include "benchutil.h"
+
+// ---------------------------------------------------------------------------
+// Line less the white space -t ignores.
+static std::string TrimWhite(const std::string& line)
+{
+    std::string trimmed;
+    for (char chr : line)
+    {
+        if (chr != ' ' && chr != '\t' && chr != '\r' && chr != '\n')
+            trimmed += chr;
+    }
+    return trimmed;
+}
+
+static std::string JoinLines(const std::vector<std::string>& lines)
+{
+    std::string text;
+    for (const std::string& line : lines)
+        text += line;
+    return text;
+}
+
+static std::string RandomLine(std::mt19937& rng)
+{
+    static const char* const sWords[] = { "one", "two", "three", "four", " ", "\t" };
+    std::string line;
+    for (unsigned word = rng() % 5; word != 0; word--)
+        line += sWords[rng() % 6];
+    line += (rng() % 4 == 0) ? "\r\n" : "\n";
+    return line;
+}
+
+// Copy of lines with random inserts, deletes, changes and white space changes.
+static std::vector<std::string> EditLines(std::mt19937& rng, const std::vector<std::string>& lines)
+{
+    std::vector<std::string> edited;
+    const unsigned editRate = 2 + rng() % 10;
+    for (const std::string& line : lines)
+    {
+        switch ((rng() % editRate == 0) ? rng() % 4 : 4)
+        {
+        case 0:     // Insert before
+            edited.push_back(RandomLine(rng));
+            edited.push_back(line);
+            break;
+        case 1:     // Delete
+            break;
+        case 2:     // Change
+            edited.push_back(RandomLine(rng));
+            break;
+        case 3:     // White space only
+            edited.push_back(" " + line);
+            break;
+        default:
+            edited.push_back(line);
+            break;
+        }
+    }
+    if (rng() % 3 == 0)
+        edited.push_back(RandomLine(rng));
+    return edited;
+}
+
+// Fewest inserted plus deleted lines between left and right.
+static size_t RefEditCount(const std::vector<std::string>& left, const std::vector<std::string>& right)
+{
+    std::vector<std::vector<unsigned>> lcs(left.size() + 1, std::vector<unsigned>(right.size() + 1, 0));
+    for (size_t idx1 = 1; idx1 <= left.size(); idx1++)
+        for (size_t idx2 = 1; idx2 <= right.size(); idx2++)
+            lcs[idx1][idx2] = (left[idx1 - 1] == right[idx2 - 1])
+                ? lcs[idx1 - 1][idx2 - 1] + 1 : max(lcs[idx1 - 1][idx2], lcs[idx1][idx2 - 1]);
+    return left.size() + right.size() - 2 * lcs[left.size()][right.size()];
+}
+
+// ---------------------------------------------------------------------------
+// Hunks from -V output, as "beg1,end1 op beg2,end2" header then < and > lines.
+struct Hunk
+{
+    size_t beg1, end1, beg2, end2;
+    std::vector<std::string> lines1;
+    std::vector<std::string> lines2;
+};
+
+static bool ParseRange(const char*& str, size_t& beg, size_t& end)
+{
+    char* pEnd;
+    beg = strtoul(str, &pEnd, 10);
+    end = beg;
+    if (pEnd == str)
+        return false;
+    if (*pEnd == ',')
+    {
+        str = pEnd + 1;
+        end = strtoul(str, &pEnd, 10);
+        beg--;
+    }
+    str = pEnd;
+    return true;
+}
+
+static std::vector<Hunk> ParseHunks(const std::string& output)
+{
+    std::vector<Hunk> hunks;
+    std::istringstream lines(output);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        if (line.compare(0, 2, "< ") == 0 && !hunks.empty())
+            hunks.back().lines1.push_back(TrimWhite(line.substr(2)));
+        else if (line.compare(0, 2, "> ") == 0 && !hunks.empty())
+            hunks.back().lines2.push_back(TrimWhite(line.substr(2)));
+        else if ( !line.empty() && isdigit((unsigned char)line[0]))
+        {
+            Hunk hunk;
+            const char* str = line.c_str();
+            if ( !ParseRange(str, hunk.beg1, hunk.end1) || strchr("acd", *str) == NULL)
+                continue;
+            const char op = *str++;
+            if ( !ParseRange(str, hunk.beg2, hunk.end2) || *str != '\0')
+                continue;
+            // Single line ranges name the line, empty ranges the line before.
+            if (op != 'a' && hunk.beg1 == hunk.end1)
+                hunk.beg1--;
+            if (op != 'd' && hunk.beg2 == hunk.end2)
+                hunk.beg2--;
+            hunks.push_back(hunk);
+        }
+    }
+    return hunks;
+}
+
+// Right lines made from left lines and hunks, false if hunks don't fit left.
+static bool ApplyHunks(const std::vector<std::string>& left, const std::vector<Hunk>& hunks, std::vector<std::string>& result)
+{
+    size_t idx1 = 0;
+    for (const Hunk& hunk : hunks)
+    {
+        if (hunk.beg1 < idx1 || hunk.end1 > left.size() || hunk.lines1.size() != hunk.end1 - hunk.beg1
+            || hunk.lines2.size() != hunk.end2 - hunk.beg2 || hunk.beg2 != result.size() + hunk.beg1 - idx1)
+            return false;
+        while (idx1 < hunk.beg1)
+            result.push_back(left[idx1++]);
+        for (const std::string& line : hunk.lines1)
+        {
+            if (line != left[idx1++])
+                return false;
+        }
+        result.insert(result.end(), hunk.lines2.begin(), hunk.lines2.end());
+    }
+    while (idx1 < left.size())
+        result.push_back(left[idx1++]);
+    return true;
+}
+
+static size_t CountPrefix(const std::string& output, const char* prefix)
+{
+    size_t count = 0;
+    std::istringstream lines(output);
+    std::string line;
+    while (std::getline(lines, line))
+        count += (line.compare(0, 2, prefix) == 0);
+    return count;
+}
+
+// ---------------------------------------------------------------------------
+static size_t CheckText(size_t, size_t& cases)
+{
+    std::mt19937 rng(5);
+    size_t bad = 0;
+    const unsigned sQuits[] = { 1000000, 1, 2, 5 };
+    const size_t quitCnt = sizeof(sQuits) / sizeof(sQuits[0]);
+
+    for (unsigned round = 0; round < 300; round++)
+    {
+        std::vector<std::string> left;
+        for (unsigned line = rng() % 60; line != 0; line--)
+            left.push_back(RandomLine(rng));
+        const std::vector<std::string> right = EditLines(rng, left);
+
+        TempTrees trees("llcmp_textdiffbench");
+        std::vector<std::unique_ptr<BenchCmp>> cmpList;
+        std::vector<LLCmp*> cmps;
+        for (unsigned quitAfter : sQuits)
+        {
+            cmpList.emplace_back(new BenchCmp(trees, true, true, 1, quitAfter));
+            cmps.push_back(cmpList.back().get());
+        }
+        trees.Add(cmps, true, "dir", "file.txt", JoinLines(left));
+        trees.Add(cmps, false, "dir", "file.txt", JoinLines(right));
+
+        std::vector<std::string> trimLeft, trimRight;
+        for (const std::string& line : left)
+            trimLeft.push_back(TrimWhite(line));
+        for (const std::string& line : right)
+            trimRight.push_back(TrimWhite(line));
+
+        std::string errText;
+        const std::string output = cmpList[0]->Compare(errText);
+        const std::vector<Hunk> hunks = ParseHunks(output);
+        const bool equal = (trimLeft == trimRight);
+        std::vector<std::string> applied;
+        size_t editCnt = 0;
+        for (const Hunk& hunk : hunks)
+            editCnt += hunk.lines1.size() + hunk.lines2.size();
+        const size_t refEditCnt = RefEditCount(trimLeft, trimRight);
+
+        cases++;
+        if (equal != (output.find("Eq:1 ") != std::string::npos) && bad++ < 5)
+            printf("Round %u equal=%d, compare output:\n%s", round, equal, output.c_str());
+        else if ( !ApplyHunks(trimLeft, hunks, applied) || applied != trimRight)
+        {
+            if (bad++ < 5)
+                printf("Round %u hunks don't turn left into right, compare output:\n%s", round, output.c_str());
+        }
+        else if (editCnt != refEditCnt && bad++ < 5)
+            printf("Round %u hunks change %zu lines, fewest is %zu\n", round, editCnt, refEditCnt);
+
+        const size_t allLeft = CountPrefix(output, "< ");
+        const size_t allRight = CountPrefix(output, "> ");
+        for (size_t quitIdx = 1; quitIdx < quitCnt; quitIdx++)
+        {
+            const std::string quitOutput = cmpList[quitIdx]->Compare(errText);
+            const size_t quitAfter = sQuits[quitIdx];
+            cases++;
+            if ((CountPrefix(quitOutput, "< ") != min(quitAfter, allLeft) ||
+                CountPrefix(quitOutput, "> ") != min(quitAfter, allRight)) && bad++ < 5)
+                printf("Round %u -V=%zu shows %zu < and %zu > lines of %zu and %zu\n", round, quitAfter,
+                    CountPrefix(quitOutput, "< "), CountPrefix(quitOutput, "> "), allLeft, allRight);
+        }
+    }
+
+    return bad;
+}
+
+// ---------------------------------------------------------------------------
+static int RunTime(size_t lineCnt, size_t editCnt)
+{
+    std::mt19937 rng(9);
+    std::vector<std::string> left;
+    for (size_t line = 0; line < lineCnt; line++)
+        left.push_back(RandomLine(rng) + "line " + std::to_string(line) + "\n");
+    std::vector<std::string> right = left;
+    for (size_t edit = 0; edit < editCnt && !right.empty(); edit++)
+        right[rng() % right.size()] = "edited " + std::to_string(edit) + "\n";
+
+    TempTrees trees("llcmp_textdiffbench");
+    BenchCmp quietCmp(trees, true, false, 1);
+    BenchCmp verboseCmp(trees, true, true, 1, 1000000);
+    const std::vector<LLCmp*> cmps = { &quietCmp, &verboseCmp };
+    const std::string leftText = JoinLines(left);
+    trees.Add(cmps, true, "dir", "file.txt", leftText);
+    trees.Add(cmps, false, "dir", "file.txt", JoinLines(right));
+
+    std::string errText;
+    const double MB = leftText.size() * 2.0 / (1024 * 1024);
+    BenchTimer timer;
+    quietCmp.Compare(errText);
+    const double quietMs = timer.Ms();
+    timer.Reset();
+    verboseCmp.Compare(errText);
+    const double verboseMs = timer.Ms();
+
+    printf("lines=%zu edits=%zu %.1f MB  -t %.0f ms (%.0f MB/s)  -t -V %.0f ms (%.0f MB/s)\n",
+        lineCnt, editCnt, MB, quietMs, MB * 1000 / quietMs, verboseMs, MB * 1000 / verboseMs);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+static int TimeMode(int argc, char* argv[])
+{
+    return RunTime(BenchArg(argc, argv, 2, 1000000), BenchArg(argc, argv, 3, 100));
+}
+
+// ---------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    return BenchMain(argc, argv, "textdiffbench", CheckText, 0, TimeMode);
+}
@@ -0,0 +1,199 @@
+//-----------------------------------------------------------------------------
+// treehashbench - Check and time llcmp -c tree hash of large files.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+//
+// Usage: treehashbench [mode [args]]
+//
+//  check               ; Temp files of empty, chunk edge and random sizes.
+//                        -c=1 -h=<name> root and -v chunk digests must match a
+//                        reference made one chunk at a time, for md5, xxh3
+//                        and crc32c, with -j=1, 2, 3 and 8.
+//  time <sizeMB> <chunkMB> <threads>
+//                      ; MB/s of -c on one file, -j=1 against -j=threads.
+//
+// Trees are made in the temp directory and removed.
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cmptrees.h"
+#include "hashengine.h"
+#include "benchutil.h"
+
+// ---------------------------------------------------------------------------
+static std::string ToHex(const unsigned char* pDigest, unsigned size)
+{
+    std::string hex;
+    char buf[4];
+    for (unsigned idx = 0; idx < size; idx++)
+    {
+        snprintf(buf, sizeof(buf), "%02x", pDigest[idx]);
+        hex += buf;
+    }
+    return hex;
+}
+
+// Reference root, hash of the chunk digests in file order, and chunk digests.
+static std::string RefTreeHash(const char* hashName, const std::string& data, size_t chunkSize,
+    std::vector<std::string>& chunkHex)
+{
+    std::unique_ptr<HashEngine> engine(HashEngine::Create(hashName));
+    const unsigned digestSize = engine->DigestSize();
+    std::vector<unsigned char> digests;
+    unsigned char digest[HashEngine::sMaxDigest];
+
+    chunkHex.clear();
+    for (size_t pos = 0; pos < data.size(); pos += chunkSize)
+    {
+        engine->Init();
+        engine->Append(data.data() + pos, min(chunkSize, data.size() - pos));
+        engine->Finish(digest);
+        digests.insert(digests.end(), digest, digest + digestSize);
+        chunkHex.push_back(ToHex(digest, digestSize));
+    }
+
+    engine->Init();
+    engine->Append(digests.data(), digests.size());
+    engine->Finish(digest);
+    return ToHex(digest, digestSize);
+}
+
+// ---------------------------------------------------------------------------
+static size_t CheckTree(size_t, size_t& cases)
+{
+    std::mt19937 rng(17);
+    size_t bad = 0;
+    const size_t sChunk = 1024 * 1024;
+    const size_t sSizes[] = { 0, 1, sChunk - 1, sChunk, sChunk + 1, 3 * sChunk + 12345, 5 * sChunk - 7 };
+    const unsigned sThreads[] = { 1, 2, 3, 8 };
+
+    for (const char* hashName : { "md5", "xxh3", "crc32c" })
+    {
+        TempTrees trees("llcmp_treehashbench");
+        std::vector<std::unique_ptr<HashCmp>> cmpList;
+        std::vector<LLCmp*> cmps;
+        for (unsigned threads : sThreads)
+        {
+            cmpList.emplace_back(new HashCmp(trees, hashName, 1, threads, (threads % 2) == 0));
+            cmps.push_back(cmpList.back().get());
+        }
+
+        // Expected lines in name order, root then chunks when verbose.
+        std::vector<std::string> expectRoot;
+        std::vector<std::vector<std::string>> expectChunks;
+        char name[32];
+        for (size_t fileIdx = 0; fileIdx < sizeof(sSizes) / sizeof(sSizes[0]) + 3; fileIdx++)
+        {
+            const size_t size = (fileIdx < sizeof(sSizes) / sizeof(sSizes[0])) ? sSizes[fileIdx] : rng() % (4 * sChunk);
+            std::string data(size, '\0');
+            for (char& chr : data)
+                chr = (char)rng();
+            snprintf(name, sizeof(name), "file%02zu.bin", fileIdx);
+            trees.Add(cmps, true, "dir", name, data);
+
+            std::vector<std::string> chunkHex;
+            expectRoot.push_back(RefTreeHash(hashName, data, sChunk, chunkHex) + ", " + std::to_string(size));
+            expectChunks.push_back(chunkHex);
+        }
+
+        for (size_t cmpIdx = 0; cmpIdx < cmpList.size(); cmpIdx++)
+        {
+            const bool verbose = (sThreads[cmpIdx] % 2) == 0;
+            const std::vector<HashLine> hashLines = ParseHashLines(cmpList[cmpIdx]->Hash());
+            size_t lineIdx = 0;
+            for (size_t fileIdx = 0; fileIdx < expectRoot.size(); fileIdx++)
+            {
+                cases++;
+                const std::string got = (lineIdx < hashLines.size())
+                    ? hashLines[lineIdx].hash + ", " + std::to_string(hashLines[lineIdx].size) : "missing";
+                lineIdx++;
+                if (got != expectRoot[fileIdx] && bad++ < 5)
+                    printf("%s -j=%u file%02zu root %s, expected %s\n", hashName, sThreads[cmpIdx], fileIdx,
+                        got.c_str(), expectRoot[fileIdx].c_str());
+
+                for (size_t chunkIdx = 0; verbose && chunkIdx < expectChunks[fileIdx].size(); chunkIdx++)
+                {
+                    cases++;
+                    const bool okay = lineIdx < hashLines.size() &&
+                        hashLines[lineIdx].hash == expectChunks[fileIdx][chunkIdx] &&
+                        hashLines[lineIdx].path.find("chunk " + std::to_string(chunkIdx) + " at ") != std::string::npos;
+                    lineIdx++;
+                    if ( !okay && bad++ < 5)
+                        printf("%s -j=%u file%02zu chunk %zu mismatch\n", hashName, sThreads[cmpIdx], fileIdx, chunkIdx);
+                }
+            }
+            cases++;
+            if (lineIdx != hashLines.size() && bad++ < 5)
+                printf("%s -j=%u %zu lines, expected %zu\n", hashName, sThreads[cmpIdx], hashLines.size(), lineIdx);
+        }
+    }
+
+    return bad;
+}
+
+// ---------------------------------------------------------------------------
+static int RunTime(size_t sizeMB, unsigned chunkMB, unsigned threads)
+{
+    TempTrees trees("llcmp_treehashbench");
+    printf("%-8s %12s %12s   (MB/s, %zuMB file, -c=%u)\n", "hash", "-j=1", ("-j=" + std::to_string(threads)).c_str(), sizeMB, chunkMB);
+    for (const char* hashName : { "md5", "xxh3", "crc32c" })
+    {
+        HashCmp serialCmp(trees, hashName, chunkMB, 1);
+        HashCmp parallelCmp(trees, hashName, chunkMB, threads);
+        const std::vector<LLCmp*> cmps = { &serialCmp, &parallelCmp };
+        std::string data(sizeMB * 1024 * 1024, '\0');
+        std::mt19937 rng(3);
+        for (char& chr : data)
+            chr = (char)rng();
+        trees.Add(cmps, true, "dir", std::string(hashName) + ".bin", data);
+
+        BenchTimer timer;
+        serialCmp.Hash();
+        const double serialMs = timer.Ms();
+        timer.Reset();
+        parallelCmp.Hash();
+        const double parallelMs = timer.Ms();
+        printf("%-8s %12.0f %12.0f\n", hashName, sizeMB * 1000 / serialMs, sizeMB * 1000 / parallelMs);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+static int TimeMode(int argc, char* argv[])
+{
+    return RunTime(BenchArg(argc, argv, 2, 512), (unsigned)BenchArg(argc, argv, 3, 8), (unsigned)BenchArg(argc, argv, 4, 8));
+}
+
+// ---------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    return BenchMain(argc, argv, "treehashbench", CheckTree, 0, TimeMode);
+}
@@ -91,6 +91,38 @@ bool MemMapFile::Open(const char* fileName, SIZE_T minViewLength)
 }
 
 
+//=================================================================================================
+bool MemMapFile::Open(HANDLE hFile, SIZE_T minViewLength)
+{
+	Close();
+
+	m_minViewLength = minViewLength;
+	::GetSystemInfo(&m_sysInfo);
+
+	bool ok = false;
+	m_fileSize = 0;
+	LARGE_INTEGER fileSize;
+
+	if (hFile != INVALID_HANDLE_VALUE && ::GetFileSizeEx(hFile, &fileSize) != 0)
+	{
+		m_fileSize = fileSize.QuadPart;
+
+		// Mapping holds its own reference to the file.
+		HANDLE hFileMapping = ::CreateFileMappingW(
+			    hFile,
+			    NULL,
+			    PAGE_READONLY,
+			    0,
+			    0,
+			    NULL);
+
+		m_hFileMapping = (hFileMapping != NULL) ? hFileMapping : INVALID_HANDLE_VALUE;
+		ok = m_hFileMapping.IsValid();
+	}
+
+	return ok;
+}
+
 //=================================================================================================
 void MemMapFile::Close()
 {
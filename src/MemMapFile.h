@@ -63,6 +63,8 @@ public:
 	~MemMapFile(void);
 
 	bool Open(const char* fileName, SIZE_T minViewLength = MinViewLength);
+	// Map a file already open for read, caller keeps and closes hFile.
+	bool Open(HANDLE hFile, SIZE_T minViewLength = MinViewLength);
 	void Close();
 
 	void* MapView(unsigned __int64 viewOffset, SIZE_T& viewLength);
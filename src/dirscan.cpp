@@ -42,6 +42,7 @@
 //
 static char sDirChr = '\\';     // Same as LLPath::sDirChr();
 static char sDirSlash[] = "\\";   // Same as LLPath::sDirSlash
+static const size_t sScanBatch = 64;    // Parallel scan entries per callback lock.
 bool (*DirectoryScan::ChrCmp)(char c1, char c2) = DirectoryScan::NCaseChrCmp;
 
 //-----------------------------------------------------------------------------
@@ -62,55 +63,42 @@ static void RemoveDup(char* inStr, char dupChr)
 // Patterns supported:
 //          ?        ; any single character
 //          *        ; zero or more characters
+//
+// Iterative, only the most recent '*' is retried so there is no exponential
+// backtracking on patterns like *a*a*a*b
 
-static bool WildCompare(const char* wildStr, int wildOff, const char* rawStr, int rawOff)
+static bool WildCompare(const char* wildStr, const char* rawStr)
 {
-    const char EOS = '\0';
-    while (wildStr[wildOff])
-    {
-        if (rawStr[rawOff] == EOS)
-            return (wildStr[wildOff] == '*' && wildStr[wildOff+1] == EOS);
+    const char* starWild = nullptr;
+    const char* starRaw  = nullptr;
 
-        if (wildStr[wildOff] == '*')
+    while (*rawStr)
+    {
+        if (*wildStr == '*')
         {
-            if (wildStr[wildOff + 1] == EOS)
-                return true;
-
-            do
-            {
-                // Find match with char after '*'
-                while (rawStr[rawOff] &&
-                    !DirectoryScan::ChrCmp(rawStr[rawOff], wildStr[wildOff+1]))
-                    rawOff++;
-                if (rawStr[rawOff] &&
-                    WildCompare(wildStr, wildOff + 1, rawStr, rawOff))
-                        return true;
-                if (rawStr[rawOff])
-                    ++rawOff;
-            } while (rawStr[rawOff]);
-
-            if (rawStr[rawOff] == EOS)
-                return (wildStr[wildOff+1] == '*' && wildStr[wildOff + 2] == EOS );
+            starWild = ++wildStr;
+            starRaw  = rawStr;
         }
-        else if (wildStr[wildOff] == '?')
+        else if (*wildStr == '?' || (*wildStr != '\0' && DirectoryScan::ChrCmp(*rawStr, *wildStr)))
         {
-            if (rawStr[rawOff] == EOS)
-                return false;
-            rawOff++;
+            wildStr++;
+            rawStr++;
+        }
+        else if (starWild != nullptr)
+        {
+            // Let last '*' absorb one more character and retry.
+            wildStr = starWild;
+            rawStr  = ++starRaw;
         }
         else
         {
-            if ( !DirectoryScan::ChrCmp(rawStr[rawOff], wildStr[wildOff]))
-                return false;
-            if (wildStr[wildOff] == EOS)
-                return true;
-            ++rawOff;
+            return false;
         }
-
-        ++wildOff;
     }
 
-    return (wildStr[wildOff] == rawStr[rawOff]);
+    while (*wildStr == '*')
+        wildStr++;
+    return (*wildStr == '\0');
 }
 
 //-----------------------------------------------------------------------------
@@ -226,29 +214,240 @@ bool PatternMatch(const std::string& pattern, const char* str)
 {
     if (pattern.length() > 1 && pattern[0] == '!')
     {
-        return !WildCompare(pattern.c_str(), 1, str, 0);
+        return !WildCompare(pattern.c_str() + 1, str);
     } 
     else
     {
-    return WildCompare(pattern.c_str(), 0, str, 0);
+    return WildCompare(pattern.c_str(), str);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Case fold tables, indexed by unsigned char.
+// Built once by the first caller, static init is thread safe.
+struct FoldTables
+{
+    unsigned char noFold[256];
+    unsigned char lowerFold[256];
+
+    FoldTables()
+    {
+        for (unsigned idx = 0; idx < 256; idx++)
+        {
+            noFold[idx]    = (unsigned char)idx;
+            lowerFold[idx] = (unsigned char)tolower(idx);
+        }
+    }
+};
+
+static const unsigned char* GetFoldTable(bool ignoreCase)
+{
+    static const FoldTables sTables;
+    return ignoreCase ? sTables.lowerFold : sTables.noFold;
+}
+
+//-----------------------------------------------------------------------------
+const unsigned char* CompiledPattern::FoldTable()
+{
+    return GetFoldTable(DirectoryScan::ChrCmp != DirectoryScan::YCaseChrCmp);
+}
+
+//-----------------------------------------------------------------------------
+const unsigned char* CompiledPattern::FoldTable(bool ignoreCase)
+{
+    return GetFoldTable(ignoreCase);
+}
+
+//-----------------------------------------------------------------------------
+CompiledPattern::CompiledPattern() noexcept :
+    m_fold(nullptr),
+    m_minLen(0),
+    m_negate(false),
+    m_leadStar(true),
+    m_trailStar(true)
+{
+}
+
+//-----------------------------------------------------------------------------
+CompiledPattern::CompiledPattern(const std::string& pattern)
+{
+    Compile(pattern);
+}
+
+//-----------------------------------------------------------------------------
+//  Split pattern on '*'
+//      *.txt       => lead star,  segments: ".txt"
+//      a*b?c*d     => segments: "a" "b?c" "d"
+void CompiledPattern::Compile(const std::string& pattern)
+{
+    m_pattern = pattern;
+    m_negate  = (pattern.length() > 1 && pattern[0] == '!');
+    m_fold    = FoldTable();
+
+    m_wild.clear();
+    for (size_t idx = m_negate ? 1 : 0; idx < pattern.length(); idx++)
+        m_wild += (char)m_fold[(unsigned char)pattern[idx]];
+
+    m_segments.clear();
+    m_minLen    = 0;
+    m_leadStar  = (!m_wild.empty() && m_wild[0] == '*');
+    m_trailStar = (!m_wild.empty() && m_wild.back() == '*');
+
+    size_t off = 0;
+    while (off < m_wild.length())
+    {
+        size_t len = m_wild.find('*', off);
+        if (len == std::string::npos)
+            len = m_wild.length();
+        len -= off;
+
+        if (len != 0)
+        {
+            Segment seg;
+            seg.off = (unsigned)off;
+            seg.len = (unsigned)len;
+            seg.literal = (memchr(m_wild.c_str() + off, '?', len) == nullptr);
+            m_segments.push_back(seg);
+            m_minLen += len;
+        }
+        off += len + 1;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Return true if segment matches str, str has at least seg.len characters.
+inline bool CompiledPattern::MatchAt(const char* str, const Segment& seg) const
+{
+    const unsigned char* pUstr = (const unsigned char*)str;
+    const char* pWild = m_wild.c_str() + seg.off;
+
+    for (unsigned idx = 0; idx < seg.len; idx++)
+    {
+        if (pWild[idx] != (char)m_fold[pUstr[idx]] && (seg.literal || pWild[idx] != '?'))
+            return false;
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Return left most position of segment in [str, strEnd) or nullptr.
+const char* CompiledPattern::FindSegment(const char* str, const char* strEnd, const Segment& seg) const
+{
+    if (strEnd - str < (ptrdiff_t)seg.len)
+        return nullptr;
+
+    // Search on the first non '?' character of the segment.
+    const char* pWild = m_wild.c_str() + seg.off;
+    unsigned lead = 0;
+    while (lead < seg.len && pWild[lead] == '?')
+        lead++;
+    if (lead == seg.len)
+        return str;         // Only '?', matches at any position.
+
+    const char key = pWild[lead];
+    const unsigned char upper = (unsigned char)ToUpper(key);
+    const bool twoCase = ((char)upper != key && m_fold[upper] == (unsigned char)key);
+    const char* pKey = str + lead;
+    const char* pKeyLast = strEnd - seg.len + lead;
+
+    while (pKey <= pKeyLast)
+    {
+        if (twoCase)
+        {
+            // Key has two cases, scan on the folded byte.
+            while (pKey <= pKeyLast && m_fold[(unsigned char)*pKey] != (unsigned char)key)
+                pKey++;
+            if (pKey > pKeyLast)
+                return nullptr;
+        }
+        else if ((pKey = (const char*)memchr(pKey, key, pKeyLast - pKey + 1)) == nullptr)
+        {
+            return nullptr;
+        }
+
+        if (MatchAt(pKey - lead, seg))
+            return pKey - lead;
+        pKey++;
+    }
+    return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+bool CompiledPattern::Matches(const char* str) const
+{
+    const size_t strLen = strlen(str);
+    bool match = false;
+
+    if (strLen >= m_minLen)
+    {
+        const char* pBeg = str;
+        const char* pEnd = str + strLen;
+        size_t segBeg = 0;
+        size_t segEnd = m_segments.size();
+        match = true;
+
+        if (segEnd == 0)
+        {
+            // Empty pattern or only stars.
+            match = m_leadStar || strLen == 0;
+        }
+        else if ( !m_leadStar && !m_trailStar && segEnd == 1)
+        {
+            match = (strLen == m_segments[0].len && MatchAt(str, m_segments[0]));
+            segBeg = segEnd;
+        }
+        else
+        {
+            if ( !m_leadStar)
+            {
+                // Anchored prefix
+                match = MatchAt(pBeg, m_segments[segBeg]);
+                pBeg += m_segments[segBeg++].len;
+            }
+            if (match && !m_trailStar)
+            {
+                // Anchored suffix
+                const Segment& seg = m_segments[--segEnd];
+                pEnd -= seg.len;
+                match = (pEnd >= pBeg && MatchAt(pEnd, seg));
+            }
+        }
+
+        // Middle segments, left most match.
+        for (; match && segBeg < segEnd; segBeg++)
+        {
+            const Segment& seg = m_segments[segBeg];
+            const char* pFound = FindSegment(pBeg, pEnd, seg);
+            match = (pFound != nullptr);
+            if (match)
+                pBeg = pFound + seg.len;
+        }
     }
+
+    return match != m_negate;
 }
 
 //-----------------------------------------------------------------------------
 DirectoryScan::DirectoryScan() :
+    m_filesFirst(false),
     m_fileFilter(),
     m_recurse(false),
     m_skipJunction(false),
     m_addAllDepths(false),
     m_abort(false),
+    m_threads(1),
     m_disableWow64Redirection(true),
     m_oldWow64Redirection(0),
     m_add_cb(0),
     m_cb_data(0),
-    m_filesFirst(false),
-    m_entryType(eFilesDir)
+    m_prune_cb(0),
+    m_prune_data(0),
+    m_findFirst(FindFirstLarge),
+    m_jobCnt(0),
+    m_parFileCnt(0)
 {
     m_dir[0] = '\0';
+    memset(&m_stats, 0, sizeof(m_stats));
 }
 
 //-----------------------------------------------------------------------------
@@ -258,31 +457,6 @@ DirectoryScan::~DirectoryScan()
         Wow64RevertWow64FsRedirection(m_oldWow64Redirection);
 }
 
-//-----------------------------------------------------------------------------
-size_t DirectoryScan::GetFilesInDirectory(int depth)
-{
-    if (m_filesFirst)
-    {
-        bool recurse = m_recurse;
-
-        m_entryType = eFile;
-        m_recurse   = false;
-        size_t fileSz = GetFilesInDirectory2(depth);
-        size_t dirSz = 0;
-
-        if (recurse)
-        {
-            m_entryType = eDir;
-            m_recurse   = recurse;
-            dirSz = GetFilesInDirectory2(depth);
-        }
-        return fileSz + dirSz;
-    }
-
-    m_entryType = eFilesDir;
-    return GetFilesInDirectory2(depth);
-}
-
 //-----------------------------------------------------------------------------
 //  When a 32-bit application reads from one of these folders on a 64-bit OS:
 //
@@ -300,124 +474,522 @@ size_t DirectoryScan::GetFilesInDirectory(int depth)
 //      %windir%\SysWOW64\logfiles
 //      %windir%\SysWOW64\spool
 //
-size_t DirectoryScan::GetFilesInDirectory2(int depth)
+//  Scan is iterative, m_frames holds one entry per open directory and m_dir
+//  is extended in place as we walk down and truncated as we walk back out.
+//
+//  Normal order keeps each find handle open and descends as sub-directories
+//  are found. With m_filesFirst the directory is read once, files presented
+//  and sub-directories buffered in m_dirArena to be walked afterwards.
+//
+size_t DirectoryScan::GetFilesInDirectory(int depth)
 {
-    WIN32_FIND_DATA FileData;    // Data structure describes the file found
-    HANDLE  hSearch;             // Search handle returned by FindFirstFile
-    bool    is_more = true;
-    size_t  fileCnt = 0;
-    size_t  dirLen = strlen(m_dir);
+    if (depth == 0 && m_threads > 1 && m_recurse)
+        return GetFilesInDirectoryParallel();
 
-    strcat_s(m_dir, ARRAYSIZE(m_dir), "\\*");
-    RemoveDup(m_dir+1, '\\');      // Okay for \\ to appear in front, remove others.
+    const int filterCnt = (int)m_dirFilters.size();
+    size_t fileCnt = 0;
 
-    // Start searching for folder (directories), starting with srcdir directory.
+    m_frames.clear();
+    m_dirArena.clear();
+    PushScanDir(depth, fileCnt);
 
-    hSearch = FindFirstFile(m_dir, &FileData);
-    if (hSearch == INVALID_HANDLE_VALUE)
+    while ( !m_frames.empty())
     {
-        // No files found
-        // if (depth == 0)
-        // {
-            LLMsg::PresentError(GetLastError(), "Failed to open directory, ", m_dir);
-        // }
-        return 0;
-    }
+        ScanFrame& frame = m_frames.back();
+        const WIN32_FIND_DATA* pSubDir = nullptr;
+        m_dir[frame.dirLen] = '\0';
 
-    m_dir[dirLen] = '\0';
-    while (is_more && !m_abort)
-    {
-        // fixFile(m_dir, dirLen, FileData);
-
-        if ((FileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+        if (frame.hSearch != INVALID_HANDLE_VALUE)
         {
-            
-            if (m_skipJunction && (FileData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0)
-            {
-                is_more = (FindNextFile(hSearch, &FileData) != 0) ? true : false;
-                continue;
-            }
-
-            // Skip if  "." or ".."
-            if (m_entryType != eFile 
-                && !(FileData.cFileName[0] == '.' && FileData.cFileName[1] == '\0')
-                && !(FileData.cFileName[0] == '.' && FileData.cFileName[1] == '.' && FileData.cFileName[2] == '\0'))
+            while (pSubDir == nullptr)
             {
-                if (m_recurse || depth < (int)m_dirFilters.size())
+                if ( !frame.haveEntry)
                 {
-                    int newDepth = depth + 1;
-                    if ((int)m_dirFilters.size() < newDepth
-                        || PatternMatch(m_dirFilters[depth], FileData.cFileName))
+                    if (m_abort)
                     {
-                        if ((m_entryType == eDir || m_entryType == eFilesDir) &&
-                            m_add_cb && depth >= (int)m_dirFilters.size())
-                            m_add_cb(m_cb_data, m_dir, &FileData, depth);
-
-                        m_dir[dirLen] = sDirChr;
-                        strcpy_s(m_dir + dirLen +1, ARRAYSIZE(m_dir) - dirLen - 1, FileData.cFileName);
-                        fileCnt += GetFilesInDirectory(depth+1);
-                        m_dir[dirLen] = '\0';
+                        CloseScanDir(frame);
+                        break;
+                    }
+                    m_stats.findNext++;
+                    if (FindNextFile(frame.hSearch, &m_findData) == 0)
+                    {
+                        CloseScanDir(frame);
+                        break;
                     }
                 }
-                else if (m_fileFilter.empty() || PatternMatch(m_fileFilter, FileData.cFileName))
-                {
-                    if (m_add_cb)
-                        m_add_cb(m_cb_data, m_dir, &FileData, depth);
-                }
+
+                frame.haveEntry = false;
+                if (IsScanSubDir(m_findData, frame.depth))
+                    pSubDir = &m_findData;
+                else if (ScanFile(m_findData, frame.depth))
+                    fileCnt++;
             }
         }
+        else if (frame.childNext < frame.childEnd && !m_abort)
+        {
+            pSubDir = &m_dirArena[frame.childNext++];
+        }
+
+        if (pSubDir != nullptr)
+        {
+            if (m_add_cb && frame.depth >= filterCnt)
+                m_add_cb(m_cb_data, m_dir, pSubDir, frame.depth);
+
+            m_dir[frame.dirLen] = sDirChr;
+            strcpy_s(m_dir + frame.dirLen + 1, ARRAYSIZE(m_dir) - frame.dirLen - 1, pSubDir->cFileName);
+            PushScanDir(frame.depth + 1, fileCnt);  // frame no longer valid
+        }
         else
         {
-            if (m_entryType != eDir)
-            {
-                ++fileCnt;
-                if (m_fileFilter.empty() || PatternMatch(m_fileFilter, FileData.cFileName))
-                {
-#if 0
-                    // Try and get alternate short name for files with restricted characters. 
-                    // Did not work !
-                    char filePath[LL_MAX_PATH];
-                    sprintf_s(filePath, ARRAYSIZE(filePath), "%s\\%s", m_dir, FileData.cFileName);
-                    int shortLen = GetShortPathName(filePath, NULL, 0);
-                    char shortPath[LL_MAX_PATH];
-                    shortLen = GetShortPathName(filePath, shortPath, shortLen);
-#endif
-                    if (m_add_cb && depth >= (int)m_dirFilters.size())
-                        m_add_cb(m_cb_data, m_dir, &FileData, depth);
-                }
-            }
+            PopScanDir();
         }
+    }
+
+    return fileCnt;
+}
+
+//-----------------------------------------------------------------------------
+// Open directory in m_dir and push its frame, return false if open failed.
+bool DirectoryScan::PushScanDir(int depth, size_t& fileCnt)
+{
+    strcat_s(m_dir, ARRAYSIZE(m_dir), "\\*");
+    RemoveDup(m_dir+1, '\\');      // Okay for \\ to appear in front, remove others.
 
-        is_more = (FindNextFile(hSearch, &FileData) != 0) ? true : false;
+    HANDLE hSearch = m_findFirst(m_dir, &m_findData);
+    m_stats.findFirst++;
+    if (hSearch == INVALID_HANDLE_VALUE)
+    {
+        LLMsg::PresentError(GetLastError(), "Failed to open directory, ", m_dir);
+        return false;
     }
 
-    // Close directory before calling callback incase client wants to delete dir.
-    FindClose(hSearch);
+    ScanFrame frame;
+    frame.hSearch   = hSearch;
+    frame.dirLen    = strlen(m_dir) - 2;
+    frame.depth     = depth;
+    frame.haveEntry = true;
+    frame.childBeg  = frame.childNext = frame.childEnd = m_dirArena.size();
+    m_dir[frame.dirLen] = '\0';
+
+    if (m_filesFirst)
+    {
+        // Present files now, buffer sub-directories for later.
+        do
+        {
+            if (IsScanSubDir(m_findData, depth))
+                m_dirArena.push_back(m_findData);
+            else if (ScanFile(m_findData, depth))
+                fileCnt++;
+        } while ( !m_abort && (m_stats.findNext++, FindNextFile(hSearch, &m_findData) != 0));
+
+        CloseScanDir(frame);
+        frame.childEnd = m_dirArena.size();
+    }
+
+    m_frames.push_back(frame);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Return true if entry is a sub-directory we should walk into.
+bool DirectoryScan::IsScanSubDir(const WIN32_FIND_DATA& fileData, int depth)
+{
+    if ((fileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+        return false;
+    if (m_skipJunction && (fileData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0)
+        return false;
+
+    // Skip if  "." or ".."
+    if ((fileData.cFileName[0] == '.' && fileData.cFileName[1] == '\0')
+        || (fileData.cFileName[0] == '.' && fileData.cFileName[1] == '.' && fileData.cFileName[2] == '\0'))
+        return false;
+
+    if ( !m_recurse && depth >= (int)m_dirFilters.size())
+        return false;
+
+    if ((int)m_dirFilters.size() >= depth + 1
+        && !m_dirMatch[depth].Matches(fileData.cFileName))
+        return false;
 
+    // m_dir holds parent directory.
+    if (m_prune_cb && m_prune_cb(m_prune_data, m_dir, &fileData, depth))
+    {
+        m_stats.pruned++;
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Present a file, or a directory we are not walking into.
+// Return true if entry is a file.
+bool DirectoryScan::ScanFile(const WIN32_FIND_DATA& fileData, int depth)
+{
+    const bool isDir = (fileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+    if (isDir)
+    {
+        // Directories are only presented as entries when not recursing.
+        if (m_filesFirst || m_recurse || depth < (int)m_dirFilters.size())
+            return false;
+        if (m_skipJunction && (fileData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0)
+            return false;
+        if ((fileData.cFileName[0] == '.' && fileData.cFileName[1] == '\0')
+            || (fileData.cFileName[0] == '.' && fileData.cFileName[1] == '.' && fileData.cFileName[2] == '\0'))
+            return false;
+    }
+
+    if (m_add_cb && depth >= (int)m_dirFilters.size()
+        && (m_fileFilter.empty() || m_fileMatch.Matches(fileData.cFileName)))
+        m_add_cb(m_cb_data, m_dir, &fileData, depth);
+
+    return !isDir;
+}
+
+//-----------------------------------------------------------------------------
+void DirectoryScan::CloseScanDir(ScanFrame& frame)
+{
     DWORD err = GetLastError();
+
+    // Close directory before calling callback incase client wants to delete dir.
+    FindClose(frame.hSearch);
+    m_stats.findClose++;
+    frame.hSearch = INVALID_HANDLE_VALUE;
+
     if (err != ERROR_NO_MORE_FILES && !m_abort)
     {
         LLMsg::PresentError(err, "DirScan ", "\n");
     }
+}
 
-    if (m_entryType != eFile)
+//-----------------------------------------------------------------------------
+// Finished directory, present end-of-directory and pop its frame.
+void DirectoryScan::PopScanDir()
+{
+    const ScanFrame& frame = m_frames.back();
+    m_dir[frame.dirLen] = '\0';
+
+    // dirDepth is positive while walking down into directories and negative when
+    // walking back out.
+    //      del command will delete directories on the way out.
+    if ((m_recurse || m_addAllDepths) && m_add_cb
+        && (m_dirFilters.size() == 0 || frame.depth >= (int)m_dirFilters.size() || m_addAllDepths))
     {
         // Set attribute for end-of-directory
-        FileData.dwFileAttributes = GetFileAttributes(m_dir);  
-        FileData.cFileName[0] = '\0';
-        int dirDepth = -1 - depth;
-
-        // dirDepth is positive while walking down into directories and negative when
-        // walking back out.
-        //      del command will delete directories on the way out.
-        if (m_recurse || dirDepth >= 0 || m_addAllDepths)
-        if (m_add_cb && (m_dirFilters.size() == 0 || depth >= (int)m_dirFilters.size() || m_addAllDepths))
-            m_add_cb(m_cb_data, m_dir, &FileData, dirDepth);
+        memset(&m_findData, 0, sizeof(m_findData));
+        m_findData.dwFileAttributes = GetFileAttributes(m_dir);
+        m_add_cb(m_cb_data, m_dir, &m_findData, -1 - frame.depth);
     }
 
-    return fileCnt;
+    m_dirArena.resize(frame.childBeg);
+    m_frames.pop_back();
 }
- 
+
+//-----------------------------------------------------------------------------
+// Parallel directory scan, -j=<threads>
+//
+//  Each worker owns a deque of directories to scan. A worker pops from the back
+//  of its own deque (depth first) and when empty steals from the front of the
+//  other deques (oldest, largest subtrees first).
+//
+//  Callbacks are delivered in batches under m_cbLock so clients never see
+//  concurrent calls. Order between directories is not defined, but:
+//      A directory entry is delivered before any of its contents.
+//      End-of-directory (negative depth) is delivered after its entire subtree,
+//      so clients like lldel can still remove directories on the way out.
+//      With m_filesFirst a directory's files are delivered together, before any
+//      of its sub-directories are queued.
+//
+size_t DirectoryScan::GetFilesInDirectoryParallel()
+{
+    unsigned threads = (m_threads < MAXIMUM_WAIT_OBJECTS) ? m_threads : MAXIMUM_WAIT_OBJECTS;
+
+    InitializeCriticalSection(&m_cbLock);
+    m_jobCnt = 0;
+    m_parFileCnt = 0;
+
+    for (unsigned idx = 0; idx < threads; idx++)
+    {
+        ScanWorker* pWorker = new ScanWorker();
+        pWorker->pScan = this;
+        pWorker->index = idx;
+        InitializeSRWLock(&pWorker->lock);
+        pWorker->batch.reserve(sScanBatch);
+        m_workers.push_back(pWorker);
+    }
+
+    ScanJob* pRoot  = new ScanJob();
+    pRoot->pParent  = nullptr;
+    pRoot->pending  = 1;
+    pRoot->depth    = 0;
+    pRoot->haveData = false;
+    pRoot->scanned  = false;
+    pRoot->dir      = m_dir;
+    PushJob(*m_workers[0], pRoot);
+
+    std::vector<HANDLE> threadHnds;
+    for (unsigned idx = 1; idx < threads; idx++)
+    {
+        HANDLE hThread = CreateThread(NULL, 0, ScanWorkerThread, m_workers[idx], 0, NULL);
+        if (hThread != NULL)
+            threadHnds.push_back(hThread);
+    }
+
+    // Calling thread is worker 0.
+    ScanWorkerThread(m_workers[0]);
+
+    if ( !threadHnds.empty())
+        WaitForMultipleObjects((DWORD)threadHnds.size(), threadHnds.data(), TRUE, INFINITE);
+    for (HANDLE hThread : threadHnds)
+        CloseHandle(hThread);
+
+    for (ScanWorker* pWorker : m_workers)
+        delete pWorker;
+    m_workers.clear();
+    DeleteCriticalSection(&m_cbLock);
+
+    return (size_t)m_parFileCnt;
+}
+
+//-----------------------------------------------------------------------------
+DWORD WINAPI DirectoryScan::ScanWorkerThread(LPVOID pData)
+{
+    ScanWorker& worker = *(ScanWorker*)pData;
+    DirectoryScan& scan = *worker.pScan;
+
+    // Wow64 redirection is per thread.
+    PVOID oldWow64Redirection = 0;
+    if (scan.m_disableWow64Redirection)
+        Wow64DisableWow64FsRedirection(&oldWow64Redirection);
+
+    unsigned idleCnt = 0;
+    while (scan.m_jobCnt != 0)
+    {
+        ScanJob* pJob = scan.PopJob(worker);
+        if (pJob != nullptr)
+        {
+            idleCnt = 0;
+            scan.ScanJobDir(worker, pJob);
+        }
+        else if (++idleCnt < 64)
+            SwitchToThread();
+        else
+            Sleep(1);
+    }
+
+    if (scan.m_disableWow64Redirection)
+        Wow64RevertWow64FsRedirection(oldWow64Redirection);
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+void DirectoryScan::PushJob(ScanWorker& worker, ScanJob* pJob)
+{
+    InterlockedIncrement(&m_jobCnt);
+    AcquireSRWLockExclusive(&worker.lock);
+    worker.jobs.push_back(pJob);
+    ReleaseSRWLockExclusive(&worker.lock);
+}
+
+//-----------------------------------------------------------------------------
+// Pop newest job from our own deque, else steal oldest job from another worker.
+DirectoryScan::ScanJob* DirectoryScan::PopJob(ScanWorker& worker)
+{
+    ScanJob* pJob = nullptr;
+
+    AcquireSRWLockExclusive(&worker.lock);
+    if ( !worker.jobs.empty())
+    {
+        pJob = worker.jobs.back();
+        worker.jobs.pop_back();
+    }
+    ReleaseSRWLockExclusive(&worker.lock);
+
+    for (unsigned off = 1; pJob == nullptr && off < m_workers.size(); off++)
+    {
+        ScanWorker& victim = *m_workers[(worker.index + off) % m_workers.size()];
+        AcquireSRWLockExclusive(&victim.lock);
+        if ( !victim.jobs.empty())
+        {
+            pJob = victim.jobs.front();
+            victim.jobs.pop_front();
+        }
+        ReleaseSRWLockExclusive(&victim.lock);
+    }
+
+    return pJob;
+}
+
+//-----------------------------------------------------------------------------
+void DirectoryScan::AddEntries(const char* pDir, const WIN32_FIND_DATA* pFileData, size_t count, int depth)
+{
+    if (m_add_cb == nullptr || count == 0)
+        return;
+
+    EnterCriticalSection(&m_cbLock);
+    for (size_t idx = 0; idx < count && !m_abort; idx++)
+        m_add_cb(m_cb_data, pDir, pFileData + idx, depth);
+    LeaveCriticalSection(&m_cbLock);
+}
+
+//-----------------------------------------------------------------------------
+// Scan one directory, same filtering as IsScanSubDir and ScanFile but sub-directories
+// are queued as new jobs instead of walked.
+void DirectoryScan::ScanJobDir(ScanWorker& worker, ScanJob* pJob)
+{
+    const int depth = pJob->depth;
+    const int filterCnt = (int)m_dirFilters.size();
+    size_t fileCnt = 0;
+
+    // Directory entry is reported by the worker which scans it, just before its contents.
+    if (pJob->haveData && !m_abort)
+        AddEntries(pJob->pParent->dir.c_str(), &pJob->fileData, 1, depth - 1);
+
+    if ( !m_abort)
+    {
+        pJob->scanned = true;
+        char dirPat[LL_MAX_PATH];
+        strcpy_s(dirPat, ARRAYSIZE(dirPat), pJob->dir.c_str());
+        strcat_s(dirPat, ARRAYSIZE(dirPat), "\\*");
+        RemoveDup(dirPat+1, '\\');
+
+        WIN32_FIND_DATA fileData;
+        HANDLE hSearch = m_findFirst(dirPat, &fileData);
+        InterlockedIncrement64(&m_stats.findFirst);
+        if (hSearch == INVALID_HANDLE_VALUE)
+        {
+            DWORD err = GetLastError();
+            EnterCriticalSection(&m_cbLock);
+            LLMsg::PresentError(err, "Failed to open directory, ", dirPat);
+            LeaveCriticalSection(&m_cbLock);
+        }
+        else
+        {
+            std::vector<WIN32_FIND_DATA>& batch = worker.batch;
+            LONGLONG findNext = 0;
+            do
+            {
+                if ((fileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+                {
+                    if (m_skipJunction && (fileData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0)
+                        continue;
+                    if ((fileData.cFileName[0] == '.' && fileData.cFileName[1] == '\0')
+                        || (fileData.cFileName[0] == '.' && fileData.cFileName[1] == '.' && fileData.cFileName[2] == '\0'))
+                        continue;
+
+                    if (filterCnt >= depth + 1 && !m_dirMatch[depth].Matches(fileData.cFileName))
+                        continue;
+                    if (m_prune_cb && m_prune_cb(m_prune_data, pJob->dir.c_str(), &fileData, depth))
+                    {
+                        InterlockedIncrement64(&m_stats.pruned);
+                        continue;
+                    }
+
+                    ScanJob* pChild  = new ScanJob();
+                    pChild->pParent  = pJob;
+                    pChild->pending  = 1;
+                    pChild->depth    = depth + 1;
+                    pChild->haveData = (m_add_cb != nullptr && depth >= filterCnt);
+                    pChild->scanned  = false;
+                    pChild->dir      = pJob->dir;
+                    pChild->dir     += sDirChr;
+                    pChild->dir     += fileData.cFileName;
+                    pChild->fileData = fileData;
+
+                    InterlockedIncrement(&pJob->pending);
+                    if (m_filesFirst)
+                        worker.subDirs.push_back(pChild);
+                    else
+                        PushJob(worker, pChild);
+                }
+                else
+                {
+                    ++fileCnt;
+                    if (depth >= filterCnt && (m_fileFilter.empty() || m_fileMatch.Matches(fileData.cFileName)))
+                    {
+                        batch.push_back(fileData);
+                        if (batch.size() >= sScanBatch && !m_filesFirst)
+                        {
+                            AddEntries(pJob->dir.c_str(), batch.data(), batch.size(), depth);
+                            batch.clear();
+                        }
+                    }
+                }
+            } while ( !m_abort && (findNext++, FindNextFile(hSearch, &fileData) != 0));
+
+            DWORD err = GetLastError();
+            FindClose(hSearch);
+            InterlockedExchangeAdd64(&m_stats.findNext, findNext);
+            InterlockedIncrement64(&m_stats.findClose);
+
+            AddEntries(pJob->dir.c_str(), batch.data(), batch.size(), depth);
+            batch.clear();
+
+            // Files first, sub-directories are queued after all files are presented.
+            // Newest job is popped first, so push in reverse to walk them in order.
+            for (size_t idx = worker.subDirs.size(); idx != 0; idx--)
+                PushJob(worker, worker.subDirs[idx - 1]);
+            worker.subDirs.clear();
+
+            if (err != ERROR_NO_MORE_FILES && !m_abort)
+            {
+                EnterCriticalSection(&m_cbLock);
+                LLMsg::PresentError(err, "DirScan ", "\n");
+                LeaveCriticalSection(&m_cbLock);
+            }
+        }
+    }
+
+    InterlockedExchangeAdd64(&m_parFileCnt, (LONGLONG)fileCnt);
+    ScanJobDone(pJob);
+}
+
+//-----------------------------------------------------------------------------
+// Release one reference on job, when its subtree is finished report end-of-directory
+// and release the parent. Like the serial scan, every directory walked into gets its
+// end-of-directory, also after m_abort is set.
+void DirectoryScan::ScanJobDone(ScanJob* pJob)
+{
+    while (pJob != nullptr && InterlockedDecrement(&pJob->pending) == 0)
+    {
+        if (pJob->scanned && m_add_cb != nullptr
+            && (m_dirFilters.size() == 0 || pJob->depth >= (int)m_dirFilters.size() || m_addAllDepths))
+        {
+            WIN32_FIND_DATA endData;
+            memset(&endData, 0, sizeof(endData));
+            endData.dwFileAttributes = GetFileAttributes(pJob->dir.c_str());
+            EnterCriticalSection(&m_cbLock);
+            m_add_cb(m_cb_data, pJob->dir.c_str(), &endData, -1 - pJob->depth);
+            LeaveCriticalSection(&m_cbLock);
+        }
+
+        ScanJob* pParent = pJob->pParent;
+        delete pJob;
+        InterlockedDecrement(&m_jobCnt);
+        pJob = pParent;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Classic enumeration, one entry per FindNextFile and alternate 8.3 name filled in.
+HANDLE DirectoryScan::FindFirstClassic(const char* pDirPat, WIN32_FIND_DATA* pFileData)
+{
+    return FindFirstFile(pDirPat, pFileData);
+}
+
+//-----------------------------------------------------------------------------
+// Skip short 8.3 name lookup and let the file system return entries in large
+// batches, FindNextFile is then mostly served from the buffered batch.
+// Falls back to classic enumeration if the OS does not support these flags.
+HANDLE DirectoryScan::FindFirstLarge(const char* pDirPat, WIN32_FIND_DATA* pFileData)
+{
+    HANDLE hSearch = FindFirstFileEx(pDirPat, FindExInfoBasic, pFileData,
+        FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+    if (hSearch == INVALID_HANDLE_VALUE && GetLastError() == ERROR_INVALID_PARAMETER)
+        hSearch = FindFirstFile(pDirPat, pFileData);
+    return hSearch;
+}
+
 // ---------------------------------------------------------------------------
 // Dangerous - uses partial filename to find matching wide character filename.
 WCHAR* DirectoryScan::getFullName_W(const char* inDir, size_t inDirLen, const WIN32_FIND_DATA* pFileData, WCHAR* dstW, size_t dstSizeW) {
@@ -543,6 +1115,11 @@ void DirectoryScan::Init(
 
     strcpy_s(m_dir, ARRAYSIZE(m_dir), defDir);
 
+    m_fileMatch.Compile(m_fileFilter);
+    m_dirMatch.clear();
+    for (const char* pDirFilter : m_dirFilters)
+        m_dirMatch.push_back(CompiledPattern(pDirFilter));
+
     if (m_disableWow64Redirection)
         Wow64DisableWow64FsRedirection(&m_oldWow64Redirection);
 }
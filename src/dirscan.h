@@ -34,6 +34,7 @@
 #include <windows.h>
 #undef byte  
 #include <vector>
+#include <deque>
 #include <string>
 #include <ctype.h>
 #include "ll_stdhdr.h"
@@ -44,6 +45,48 @@
 //          *        ; zero or more characters
 bool PatternMatch(const std::string& pattern, const char* str);
 
+// Pattern prepared once for repeated matching, same rules as PatternMatch.
+// Pattern is split on '*' into segments, first and last segments are anchored
+// and middle segments are found left most, so there is no backtracking and cost
+// is bounded by O(str * pattern), typically linear.
+class CompiledPattern
+{
+public:
+    CompiledPattern() noexcept;
+    explicit CompiledPattern(const std::string& pattern);
+
+    void Compile(const std::string& pattern);
+    bool Matches(const char* str) const;
+
+    const std::string& Pattern() const noexcept
+    { return m_pattern; }
+
+    // Case fold table for current DirectoryScan::ChrCmp, indexed by unsigned char.
+    static const unsigned char* FoldTable();
+    // Lower case fold table if ignoreCase else identity, indexed by unsigned char.
+    static const unsigned char* FoldTable(bool ignoreCase);
+
+private:
+    struct Segment
+    {
+        unsigned    off;        // Offset in m_wild
+        unsigned    len;
+        bool        literal;    // true if no '?' in segment
+    };
+
+    bool MatchAt(const char* str, const Segment& seg) const;
+    const char* FindSegment(const char* str, const char* strEnd, const Segment& seg) const;
+
+    std::string             m_pattern;      // Original pattern
+    std::string             m_wild;         // Pattern without '!', case folded
+    std::vector<Segment>    m_segments;
+    const unsigned char*    m_fold;         // Case fold table
+    size_t                  m_minLen;       // Sum of segment lengths
+    bool                    m_negate;       // Pattern starts with '!'
+    bool                    m_leadStar;
+    bool                    m_trailStar;
+};
+
 struct PatInfo
 {
     unsigned  rawLen;
@@ -65,26 +108,32 @@ public:
 
     // Initialize base directory, appendStar adds "\*" to end if FromFiles is a directory
     void Init(const char* pFromFiles, const char* pCwd, bool appendStar = true);
+    // Iterative scan, explicit stack of open directories, each directory is enumerated once.
     size_t GetFilesInDirectory(int depth=0);
-    size_t GetFilesInDirectory2(int depth=0);
+
+    // Multi-threaded scan, directories are spread across m_threads workers
+    // with work stealing. Callbacks are serialized so m_add_cb is never re-entered.
+    size_t GetFilesInDirectoryParallel();
     
     // Convert MB dir name to Wide char, return nullptr if fails.
     static WCHAR* getFullName_W(const char* dirPath, size_t dirLen, const WIN32_FIND_DATA* FileData, WCHAR* dstW, size_t dstSizeW);
 
 
-    // If m_fileFirst true, then process only files in first pass, directories only
-    // in 2nd pass, else both in one pass.
+    // If m_fileFirst true, then present files first and sub-directories after,
+    // else both in directory order. Sub-directories are buffered so each
+    // directory is still enumerated only once.
     bool        m_filesFirst;
-    enum  EntryType { eFilesDir, eFile, eDir };
-    EntryType   m_entryType;
 
     char        m_dir[LL_MAX_PATH];
     std::string m_fileFilter;
     std::vector<const char*> m_dirFilters;
+    CompiledPattern m_fileMatch;                // m_fileFilter compiled by Init
+    std::vector<CompiledPattern> m_dirMatch;    // m_dirFilters compiled by Init
     bool        m_recurse;
     bool        m_skipJunction;
     bool        m_addAllDepths;
-    bool        m_abort;
+    volatile bool m_abort;
+    unsigned    m_threads;          // -j=<threads>, 0 or 1 is serial scan.
     bool        m_disableWow64Redirection;
     PVOID       m_oldWow64Redirection;
 
@@ -92,6 +141,13 @@ public:
     Add_cb      m_add_cb;
     void *      m_cb_data;
 
+    // Optional, return true to skip a sub-directory and its entire subtree.
+    // Called before walking into each sub-directory with m_prune_data, pDir is its parent.
+    // Parallel scan calls it from worker threads without m_cbLock.
+    typedef bool (*Prune_cb)(void *, const char* pDir, const WIN32_FIND_DATA * pFileData, int depth);
+    Prune_cb    m_prune_cb;
+    void *      m_prune_data;
+
     // Number of slashes in source pattern.
     int         m_subDirCnt;
 
@@ -99,6 +155,14 @@ public:
     // Pointers to this are stored in the m_dirFilters list.
     std::string m_pathPat;
 
+    // Directory enumeration backend, returns search handle for FindNextFile/FindClose.
+    //   FindFirstClassic   ; FindFirstFile, includes short 8.3 names.
+    //   FindFirstLarge     ; FindFirstFileEx basic info with large fetch (default)
+    typedef HANDLE (*FindFirst_fn)(const char* pDirPat, WIN32_FIND_DATA* pFileData);
+    static HANDLE FindFirstClassic(const char* pDirPat, WIN32_FIND_DATA* pFileData);
+    static HANDLE FindFirstLarge(const char* pDirPat, WIN32_FIND_DATA* pFileData);
+    FindFirst_fn m_findFirst;
+
     // Text comparison functions.
     static constexpr bool YCaseChrCmp(char c1, char c2)  noexcept { return c1 == c2; }
     static bool NCaseChrCmp(char c1, char c2) { return ToLower(c1) == ToLower(c2); }
@@ -112,4 +176,71 @@ public:
 
     // Return FileId of exiting file, else -1.
     static LONGLONG GetFileId(const char* srcFile);
+
+    // Directory enumeration counters, accumulate across scans.
+    struct ScanStats
+    {
+        LONGLONG    findFirst;  // FindFirstFile calls (directories opened)
+        LONGLONG    findNext;   // FindNextFile calls
+        LONGLONG    findClose;  // FindClose calls
+        LONGLONG    pruned;     // Sub-directories skipped by m_prune_cb
+    };
+    ScanStats   m_stats;
+
+private:
+    // Serial scan state, one frame per open directory, see GetFilesInDirectory.
+    struct ScanFrame
+    {
+        HANDLE      hSearch;    // Open while walking directory, closed once sub-dirs are buffered.
+        size_t      dirLen;     // Length of this directory in m_dir.
+        int         depth;
+        bool        haveEntry;  // m_findData holds next entry, FindNextFile not needed.
+        size_t      childBeg;   // Buffered sub-directories m_dirArena[childBeg..childEnd)
+        size_t      childNext;
+        size_t      childEnd;
+    };
+
+    bool     PushScanDir(int depth, size_t& fileCnt);
+    bool     IsScanSubDir(const WIN32_FIND_DATA& fileData, int depth);
+    bool     ScanFile(const WIN32_FIND_DATA& fileData, int depth);
+    void     CloseScanDir(ScanFrame& frame);
+    void     PopScanDir();
+
+    std::vector<ScanFrame>        m_frames;
+    std::vector<WIN32_FIND_DATA>  m_dirArena;
+    WIN32_FIND_DATA               m_findData;
+
+    // Parallel scan state, see GetFilesInDirectoryParallel.
+    struct ScanJob
+    {
+        ScanJob*        pParent;
+        volatile LONG   pending;    // this directory plus unfinished child jobs.
+        int             depth;
+        bool            haveData;   // fileData valid, deliver directory entry on start.
+        bool            scanned;    // Walked into, deliver end-of-directory when done.
+        std::string     dir;
+        WIN32_FIND_DATA fileData;
+    };
+
+    struct ScanWorker
+    {
+        DirectoryScan*        pScan;
+        unsigned              index;
+        SRWLOCK               lock;
+        std::deque<ScanJob*>  jobs;
+        std::vector<WIN32_FIND_DATA> batch;     // entries waiting for callback.
+        std::vector<ScanJob*> subDirs;          // m_filesFirst, queued after files.
+    };
+
+    static DWORD WINAPI ScanWorkerThread(LPVOID pData);
+    void     ScanJobDir(ScanWorker& worker, ScanJob* pJob);
+    void     ScanJobDone(ScanJob* pJob);
+    void     PushJob(ScanWorker& worker, ScanJob* pJob);
+    ScanJob* PopJob(ScanWorker& worker);
+    void     AddEntries(const char* pDir, const WIN32_FIND_DATA* pFileData, size_t count, int depth);
+
+    std::vector<ScanWorker*> m_workers;
+    CRITICAL_SECTION    m_cbLock;
+    volatile LONG       m_jobCnt;
+    volatile LONGLONG   m_parFileCnt;
 };
\ No newline at end of file
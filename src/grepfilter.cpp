@@ -0,0 +1,240 @@
+//-----------------------------------------------------------------------------
+// grepfilter - Literal prefilter for grep regular expressions.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+
+#include <string.h>
+#include <ctype.h>
+
+#define byte win_byte_override  // Fix for c++ v17
+#include <windows.h>
+#undef byte
+#include <intrin.h>
+#include <emmintrin.h>
+
+#include "grepfilter.h"
+
+//-----------------------------------------------------------------------------
+// Return index past ')' closing group which starts at pattern[idx] == '('.
+static size_t SkipGroup(const std::string& pattern, size_t idx)
+{
+    int depth = 0;
+    bool inClass = false;
+    for ( ; idx < pattern.size(); idx++)
+    {
+        const char chr = pattern[idx];
+        if (chr == '\\')
+            idx++;
+        else if (inClass)
+            inClass = (chr != ']');
+        else if (chr == '[')
+            inClass = true;
+        else if (chr == '(')
+            depth++;
+        else if (chr == ')' && --depth == 0)
+            return idx + 1;
+    }
+    return idx;
+}
+
+//-----------------------------------------------------------------------------
+// Return index past ']' closing class which starts at pattern[idx] == '['.
+static size_t SkipClass(const std::string& pattern, size_t idx)
+{
+    idx++;
+    if (idx < pattern.size() && pattern[idx] == '^')
+        idx++;
+    if (idx < pattern.size() && pattern[idx] == ']')
+        idx++;      // Leading ] is a member.
+    for ( ; idx < pattern.size(); idx++)
+    {
+        if (pattern[idx] == '\\')
+            idx++;
+        else if (pattern[idx] == ']')
+            return idx + 1;
+    }
+    return idx;
+}
+
+//-----------------------------------------------------------------------------
+void GrepPrefilter::Init(const std::string& pattern, bool ignoreCase)
+{
+    m_literal.clear();
+    m_ignoreCase = ignoreCase;
+
+    // Escapes and negated classes which can match a line break.
+    m_spansLines = pattern.find_first_of("\r\n") != std::string::npos ||
+        pattern.find("[^") != std::string::npos;
+    for (size_t idx = 0; idx + 1 < pattern.size(); idx++)
+    {
+        if (pattern[idx] == '\\')
+        {
+            if (strchr("sSDWnrvfxuc0", pattern[++idx]) != NULL)
+                m_spansLines = true;
+        }
+    }
+
+    std::string run;
+    std::string best;
+    size_t idx = 0;
+    while (idx < pattern.size())
+    {
+        const char chr = pattern[idx];
+        bool endRun = true;
+        switch (chr)
+        {
+        case '|':
+            return;     // Alternatives, nothing is required.
+        case '(':
+            idx = SkipGroup(pattern, idx);
+            break;
+        case '[':
+            idx = SkipClass(pattern, idx);
+            break;
+        case '*':
+        case '?':
+        case '{':
+            // Previous character is optional.
+            if ( !run.empty())
+                run.erase(run.size() - 1);
+            if (chr == '{')
+                idx = pattern.find('}', idx);
+            idx = (idx == std::string::npos) ? pattern.size() : idx + 1;
+            break;
+        case '+':
+        case '.':
+        case '^':
+        case '$':
+            idx++;
+            break;
+        case '\\':
+            if (idx + 1 < pattern.size() && !isalnum((unsigned char)pattern[idx + 1]))
+            {
+                run += pattern[idx + 1];
+                endRun = false;
+                idx += 2;
+            }
+            else
+            {
+                // Class, assertion, back reference or escaped control character.
+                const char esc = (idx + 1 < pattern.size()) ? pattern[idx + 1] : 0;
+                idx += 2 + (esc == 'x' ? 2 : esc == 'u' ? 4 : esc == 'c' ? 1 : 0);
+            }
+            break;
+        default:
+            run += chr;
+            endRun = false;
+            idx++;
+            break;
+        }
+
+        if (endRun || idx >= pattern.size())
+        {
+            if (run.size() > best.size())
+                best = run;
+            run.clear();
+        }
+    }
+
+    if (ignoreCase)
+    {
+        // Case folding of non ascii depends on locale, don't filter.
+        for (char& chr : best)
+        {
+            if ((unsigned char)chr >= 0x80)
+                return;
+            chr = (char)tolower((unsigned char)chr);
+        }
+    }
+    m_literal = best;
+}
+
+//-----------------------------------------------------------------------------
+inline bool GrepPrefilter::Verify(const char* ptr) const
+{
+    if ( !m_ignoreCase)
+        return memcmp(ptr, m_literal.data(), m_literal.size()) == 0;
+
+    for (size_t idx = 0; idx < m_literal.size(); idx++)
+    {
+        if (tolower((unsigned char)ptr[idx]) != (unsigned char)m_literal[idx])
+            return false;
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Candidates have the first and last character of the literal in place,
+// tested 16 positions at a time, then verified.
+const char* GrepPrefilter::Find(const char* beg, const char* end) const
+{
+    const size_t len = m_literal.size();
+    if (len == 0)
+        return beg;
+    if ((size_t)(end - beg) < len)
+        return NULL;
+
+    const char* lastBeg = end - len;
+    const char* ptr = beg;
+    const unsigned char first = (unsigned char)m_literal[0];
+    const unsigned char last = (unsigned char)m_literal[len - 1];
+    const unsigned char firstAlt = m_ignoreCase ? (unsigned char)toupper(first) : first;
+    const unsigned char lastAlt = m_ignoreCase ? (unsigned char)toupper(last) : last;
+
+#if defined(_M_IX86) || defined(_M_X64)
+    const __m128i first1 = _mm_set1_epi8((char)first);
+    const __m128i first2 = _mm_set1_epi8((char)firstAlt);
+    const __m128i last1 = _mm_set1_epi8((char)last);
+    const __m128i last2 = _mm_set1_epi8((char)lastAlt);
+    for ( ; ptr + 16 <= lastBeg + 1; ptr += 16)
+    {
+        const __m128i head = _mm_loadu_si128((const __m128i*)ptr);
+        const __m128i tail = _mm_loadu_si128((const __m128i*)(ptr + len - 1));
+        const __m128i isFirst = _mm_or_si128(_mm_cmpeq_epi8(head, first1), _mm_cmpeq_epi8(head, first2));
+        const __m128i isLast = _mm_or_si128(_mm_cmpeq_epi8(tail, last1), _mm_cmpeq_epi8(tail, last2));
+        unsigned long mask = (unsigned long)_mm_movemask_epi8(_mm_and_si128(isFirst, isLast));
+        while (mask != 0)
+        {
+            unsigned long bit;
+            _BitScanForward(&bit, mask);
+            if (Verify(ptr + bit))
+                return ptr + bit;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for ( ; ptr <= lastBeg; ptr++)
+    {
+        const unsigned char chr = (unsigned char)*ptr;
+        if ((chr == first || chr == firstAlt) && Verify(ptr))
+            return ptr;
+    }
+    return NULL;
+}
@@ -0,0 +1,68 @@
+//-----------------------------------------------------------------------------
+// grepfilter - Literal prefilter for grep regular expressions.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <string>
+
+// Longest literal run every match of an ECMAScript pattern must contain,
+// for example "foo" in foo.*bar. Text without the literal can't match so
+// the regex only runs where Find has a hit.
+//
+// Extraction is conservative, alternation at the top level, optional
+// characters and anything inside groups or classes end a run.
+class GrepPrefilter
+{
+public:
+    GrepPrefilter() : m_ignoreCase(false), m_spansLines(true)
+    { }
+
+    void Init(const std::string& pattern, bool ignoreCase);
+
+    // No literal, every position may match.
+    bool empty() const noexcept
+    { return m_literal.empty(); }
+    const std::string& Literal() const noexcept
+    { return m_literal; }
+    // True if a match may include a line break.
+    bool SpansLines() const noexcept
+    { return m_spansLines; }
+
+    // Return first occurrence of literal in [beg, end), NULL if none.
+    const char* Find(const char* beg, const char* end) const;
+
+private:
+    bool Verify(const char* ptr) const;
+
+    std::string m_literal;      // Lower case when m_ignoreCase
+    bool        m_ignoreCase;
+    bool        m_spansLines;
+};
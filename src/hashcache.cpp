@@ -0,0 +1,266 @@
+//-----------------------------------------------------------------------------
+// hashcache - Persistent file content hash cache.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+
+#include <algorithm>
+
+#include "hashcache.h"
+#include "MemMapFile.h"
+#include "Handle.h"
+
+static const DWORD sMagic = 0x43484c4c;     // "LLHC"
+static const DWORD sVersion = 1;
+static const size_t sMinCapacity = 1024;
+
+//-----------------------------------------------------------------------------
+HashCache::HashCache() :
+    m_maxEntries(sDefMaxEntries),
+    m_count(0),
+    m_generation(1),
+    m_hits(0),
+    m_misses(0)
+{
+    InitializeSRWLock(&m_lock);
+    m_slots.resize(sMinCapacity);
+}
+
+//-----------------------------------------------------------------------------
+HashCache::~HashCache()
+{
+}
+
+//-----------------------------------------------------------------------------
+bool HashCache::Load(const char* path, size_t maxEntries)
+{
+    m_path = path;
+    m_maxEntries = (maxEntries < 16) ? 16 : maxEntries;
+    m_generation = 1;
+    m_count = 0;
+    m_slots.assign(sMinCapacity, Record());
+
+    MemMapFile mapFile;
+    if ( !mapFile.Open(path))
+        return false;
+
+    SIZE_T viewLen = 0;
+    const Header* pHeader = (const Header*)mapFile.MapView(0, viewLen);
+    if (pHeader == NULL || viewLen < sizeof(Header) ||
+        pHeader->magic != sMagic || pHeader->version != sVersion ||
+        (viewLen - sizeof(Header)) / sizeof(Record) < pHeader->count)
+        return false;
+
+    const Record* pRecords = (const Record*)(pHeader + 1);
+    const size_t count = (size_t)pHeader->count;
+    size_t capacity = sMinCapacity;
+    while (capacity < count * 2)
+        capacity *= 2;
+    m_slots.assign(capacity, Record());
+    for (size_t idx = 0; idx != count; idx++)
+    {
+        if (pRecords[idx].flags != 0)
+            Place(pRecords[idx]);
+    }
+    m_generation = pHeader->generation + 1;
+
+    while (m_count > m_maxEntries)
+        Evict();
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Write to temporary file and replace, so an interrupted save keeps the old cache.
+bool HashCache::Save()
+{
+    if (m_path.empty())
+        return false;
+
+    std::string tmpPath = m_path + ".tmp";
+    Handle fHnd = CreateFile(tmpPath.c_str(), GENERIC_WRITE, 0, 0,
+            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (fHnd.NotValid())
+        return false;
+
+    AcquireSRWLockShared(&m_lock);
+    Header header = { sMagic, sVersion, m_generation, m_count };
+    DWORD wlen;
+    bool ok = WriteFile(fHnd, &header, sizeof(header), &wlen, 0) != 0;
+
+    // Pack occupied slots, written in blocks.
+    std::vector<Record> block;
+    block.reserve(4096);
+    for (size_t idx = 0; ok && idx <= m_slots.size(); idx++)
+    {
+        if (idx == m_slots.size() || block.size() == block.capacity())
+        {
+            ok = block.empty() ||
+                WriteFile(fHnd, block.data(), DWORD(block.size() * sizeof(Record)), &wlen, 0) != 0;
+            block.clear();
+        }
+        if (idx != m_slots.size() && m_slots[idx].flags != 0)
+            block.push_back(m_slots[idx]);
+    }
+    ReleaseSRWLockShared(&m_lock);
+
+    fHnd.Close();
+    if (ok)
+        ok = MoveFileEx(tmpPath.c_str(), m_path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+    if ( !ok)
+        DeleteFile(tmpPath.c_str());
+    return ok;
+}
+
+//-----------------------------------------------------------------------------
+bool HashCache::GetKey(HANDLE hFile, Key& key)
+{
+    BY_HANDLE_FILE_INFORMATION fileInfo;
+    if (GetFileInformationByHandle(hFile, &fileInfo) == 0 ||
+        (fileInfo.nFileIndexHigh == 0 && fileInfo.nFileIndexLow == 0))
+        return false;
+
+    key.volume = fileInfo.dwVolumeSerialNumber;
+    key.indexHigh = fileInfo.nFileIndexHigh;
+    key.indexLow = fileInfo.nFileIndexLow;
+    key.size = ((ULONGLONG)fileInfo.nFileSizeHigh << 32) | fileInfo.nFileSizeLow;
+    key.writeTime = ((ULONGLONG)fileInfo.ftLastWriteTime.dwHighDateTime << 32) |
+        fileInfo.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+bool HashCache::Lookup(const Key& key, Kind kind, unsigned char digest[16])
+{
+    AcquireSRWLockShared(&m_lock);
+    Record& record = m_slots[FindSlot(key.volume, key.indexHigh, key.indexLow)];
+    const bool hit = (record.flags & kind) != 0 &&
+        record.size == key.size && record.writeTime == key.writeTime;
+    if (hit)
+    {
+        if (kind == eFull)
+            memcpy(digest, record.full, sizeof(record.full));
+        else
+            memcpy(digest, record.edges, sizeof(record.edges));
+        InterlockedExchange64(&record.lastUse, m_generation);
+    }
+    ReleaseSRWLockShared(&m_lock);
+
+    InterlockedIncrement64(hit ? &m_hits : &m_misses);
+    return hit;
+}
+
+//-----------------------------------------------------------------------------
+void HashCache::Insert(const Key& key, Kind kind, const unsigned char digest[16])
+{
+    AcquireSRWLockExclusive(&m_lock);
+    if (m_count >= m_maxEntries)
+        Evict();
+    if ((m_count + 1) * 2 > m_slots.size())
+        Rehash(m_slots.size() * 2);
+
+    Record& record = m_slots[FindSlot(key.volume, key.indexHigh, key.indexLow)];
+    if (record.flags == 0)
+        m_count++;
+    if (record.flags == 0 || record.size != key.size || record.writeTime != key.writeTime)
+    {
+        // New entry or file changed, drop old digests.
+        record.volume = key.volume;
+        record.indexHigh = key.indexHigh;
+        record.indexLow = key.indexLow;
+        record.flags = 0;
+        record.size = key.size;
+        record.writeTime = key.writeTime;
+    }
+
+    record.flags |= kind;
+    if (kind == eFull)
+        memcpy(record.full, digest, sizeof(record.full));
+    else
+        memcpy(record.edges, digest, sizeof(record.edges));
+    record.lastUse = m_generation;
+    ReleaseSRWLockExclusive(&m_lock);
+}
+
+//-----------------------------------------------------------------------------
+// Linear probe, return slot holding file or empty slot where it belongs.
+size_t HashCache::FindSlot(DWORD volume, DWORD indexHigh, DWORD indexLow) const noexcept
+{
+    ULONGLONG hash = (((ULONGLONG)indexHigh << 32) | indexLow) ^ ((ULONGLONG)volume << 17);
+    hash *= 0x9e3779b97f4a7c15ULL;
+    hash ^= hash >> 29;
+
+    const size_t mask = m_slots.size() - 1;
+    size_t idx = (size_t)hash & mask;
+    while (m_slots[idx].flags != 0 &&
+        (m_slots[idx].indexLow != indexLow || m_slots[idx].indexHigh != indexHigh ||
+         m_slots[idx].volume != volume))
+        idx = (idx + 1) & mask;
+    return idx;
+}
+
+//-----------------------------------------------------------------------------
+void HashCache::Place(const Record& record)
+{
+    m_slots[FindSlot(record.volume, record.indexHigh, record.indexLow)] = record;
+    m_count++;
+}
+
+//-----------------------------------------------------------------------------
+void HashCache::Rehash(size_t capacity)
+{
+    std::vector<Record> oldSlots(capacity);
+    oldSlots.swap(m_slots);
+    m_count = 0;
+    for (const Record& record : oldSlots)
+    {
+        if (record.flags != 0)
+            Place(record);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Drop least recently used quarter of entries.
+void HashCache::Evict()
+{
+    std::vector<Record> keep;
+    keep.reserve(m_count);
+    for (const Record& record : m_slots)
+    {
+        if (record.flags != 0)
+            keep.push_back(record);
+    }
+
+    const size_t drop = (keep.size() + 3) / 4;
+    std::nth_element(keep.begin(), keep.begin() + drop, keep.end(),
+        [](const Record& lhs, const Record& rhs) { return lhs.lastUse < rhs.lastUse; });
+
+    std::fill(m_slots.begin(), m_slots.end(), Record());
+    m_count = 0;
+    for (size_t idx = drop; idx < keep.size(); idx++)
+        Place(keep[idx]);
+}
@@ -0,0 +1,123 @@
+//-----------------------------------------------------------------------------
+// hashcache - Persistent file content hash cache.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#define byte win_byte_override  // Fix for c++ v17
+#include <windows.h>
+#undef byte
+
+// Content digests of files kept between runs, -H.
+// A file is identified by volume serial and file index and is only a hit
+// while its size and last write time are unchanged.
+//
+// Cache file is a header followed by packed Record entries, the same layout
+// as the in-memory table. Load reads the records from a file mapping and
+// inserts each into a new in-memory hash table, the map is closed after.
+// When the table reaches its entry limit the least recently used quarter
+// is evicted, use is tracked by a generation bumped on each load.
+class HashCache
+{
+public:
+    enum Kind { eFull = 1, eEdges = 2 };     // MD5 of all content, or of first and last 64K.
+
+    struct Key
+    {
+        DWORD       volume;
+        DWORD       indexHigh;
+        DWORD       indexLow;
+        ULONGLONG   size;
+        ULONGLONG   writeTime;
+    };
+
+    HashCache();
+    ~HashCache();
+
+    // Load cache file, missing or invalid file starts an empty cache.
+    bool Load(const char* path, size_t maxEntries = sDefMaxEntries);
+    // Write table back to file loaded from, return false on error.
+    bool Save();
+    bool IsOpen() const noexcept
+    { return !m_path.empty(); }
+
+    // Key of open file, false if file system has no stable file index.
+    static bool GetKey(HANDLE hFile, Key& key);
+
+    // Thread safe lookup and insert of MD5 digest, eEdges keeps first 8 bytes.
+    bool Lookup(const Key& key, Kind kind, unsigned char digest[16]);
+    void Insert(const Key& key, Kind kind, const unsigned char digest[16]);
+
+    LONGLONG Hits() const noexcept   { return m_hits; }
+    LONGLONG Misses() const noexcept { return m_misses; }
+    size_t   Count() const noexcept  { return m_count; }
+
+    static const size_t sDefMaxEntries = 1 << 20;
+
+private:
+    struct Header
+    {
+        DWORD       magic;
+        DWORD       version;
+        LONGLONG    generation;
+        ULONGLONG   count;
+    };
+
+    // 64 bytes, flags==0 is an empty slot.
+    struct Record
+    {
+        DWORD       volume;
+        DWORD       indexHigh;
+        DWORD       indexLow;
+        DWORD       flags;          // Kind bits with a valid digest
+        ULONGLONG   size;
+        ULONGLONG   writeTime;
+        unsigned char full[16];
+        unsigned char edges[8];
+        volatile LONGLONG lastUse;  // Generation of last hit or insert
+    };
+
+    size_t FindSlot(DWORD volume, DWORD indexHigh, DWORD indexLow) const noexcept;
+    void   Rehash(size_t capacity);
+    void   Place(const Record& record);
+    void   Evict();
+
+    std::string         m_path;
+    size_t              m_maxEntries;
+    size_t              m_count;
+    LONGLONG            m_generation;
+    std::vector<Record> m_slots;        // Power of two, at most half full
+    SRWLOCK             m_lock;
+    volatile LONGLONG   m_hits;
+    volatile LONGLONG   m_misses;
+};
@@ -0,0 +1,855 @@
+//-----------------------------------------------------------------------------
+// hashengine - Selectable file content hash, md5, xxh3 or crc32c.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+
+#include <string.h>
+
+#define byte win_byte_override  // Fix for c++ v17
+#include <windows.h>
+#undef byte
+#include <intrin.h>
+#include <immintrin.h>
+
+#include "hashengine.h"
+#include "hash.h"
+
+const char* HashEngine::sNames = "md5|xxh3|crc32c";
+
+//-----------------------------------------------------------------------------
+// Cpu features, checked once.
+
+#if defined(_M_IX86) || defined(_M_X64)
+static bool HaveSse42()
+{
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+}
+
+static bool HaveAvx2()
+{
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    // AVX2 needs os support for saving ymm registers.
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if ( !osxsave || !avx || (_xgetbv(0) & 6) != 6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+}
+
+static const bool sHaveSse42 = HaveSse42();
+static const bool sHaveAvx2 = HaveAvx2();
+#endif
+
+static inline unsigned __int64 Read64(const unsigned char* p)
+{
+    unsigned __int64 val;
+    memcpy(&val, p, sizeof(val));
+    return val;
+}
+
+static inline unsigned Read32(const unsigned char* p)
+{
+    unsigned val;
+    memcpy(&val, p, sizeof(val));
+    return val;
+}
+
+static inline void Write64BE(unsigned char* p, unsigned __int64 val)
+{
+    for (int idx = 7; idx >= 0; idx--, val >>= 8)
+        p[idx] = (unsigned char)val;
+}
+
+// ============================================================================
+// MD5, wraps hash.cpp
+
+class Md5Engine : public HashEngine
+{
+public:
+    const char* Name() const        { return "md5"; }
+    unsigned DigestSize() const     { return 16; }
+    void Init()                     { md5_init(&m_state); }
+
+    void Append(const void* pData, size_t len)
+    {
+        const md5_byte_t* pByte = (const md5_byte_t*)pData;
+        while (len != 0)
+        {
+            const int part = (len > 0x40000000) ? 0x40000000 : (int)len;
+            md5_append(&m_state, pByte, part);
+            pByte += part;
+            len -= part;
+        }
+    }
+
+    void Finish(unsigned char* pDigest)
+    { md5_finish(&m_state, pDigest); }
+
+private:
+    md5_state_t m_state;
+};
+
+// ============================================================================
+// CRC32C, Castagnoli polynomial, reflected.
+
+class Crc32cEngine : public HashEngine
+{
+public:
+    Crc32cEngine();
+
+    const char* Name() const        { return "crc32c"; }
+    unsigned DigestSize() const     { return 4; }
+    void Init()                     { m_crc = 0xffffffff; }
+    void Append(const void* pData, size_t len);
+
+    void Finish(unsigned char* pDigest)
+    {
+        const unsigned crc = ~m_crc;
+        pDigest[0] = (unsigned char)(crc >> 24);
+        pDigest[1] = (unsigned char)(crc >> 16);
+        pDigest[2] = (unsigned char)(crc >> 8);
+        pDigest[3] = (unsigned char)crc;
+    }
+
+private:
+    unsigned m_crc;
+    const unsigned* m_pTable;
+};
+
+//-----------------------------------------------------------------------------
+// Reflected crc32c table, built once by the first engine, static init is
+// thread safe so parallel workers may create engines.
+struct Crc32cTable
+{
+    unsigned table[256];
+
+    Crc32cTable()
+    {
+        for (unsigned idx = 0; idx < 256; idx++)
+        {
+            unsigned crc = idx;
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ ((crc & 1) ? 0x82f63b78 : 0);
+            table[idx] = crc;
+        }
+    }
+};
+
+//-----------------------------------------------------------------------------
+Crc32cEngine::Crc32cEngine() : m_crc(0xffffffff)
+{
+    static const Crc32cTable sTable;
+    m_pTable = sTable.table;
+}
+
+//-----------------------------------------------------------------------------
+void Crc32cEngine::Append(const void* pData, size_t len)
+{
+    const unsigned char* pByte = (const unsigned char*)pData;
+    unsigned crc = m_crc;
+
+#if defined(_M_X64)
+    if (sHaveSse42)
+    {
+        unsigned __int64 crc64 = crc;
+        for ( ; len >= 8; pByte += 8, len -= 8)
+            crc64 = _mm_crc32_u64(crc64, Read64(pByte));
+        crc = (unsigned)crc64;
+        for ( ; len != 0; pByte++, len--)
+            crc = _mm_crc32_u8(crc, *pByte);
+    }
+#endif
+
+    for ( ; len != 0; pByte++, len--)
+        crc = (crc >> 8) ^ m_pTable[(crc ^ *pByte) & 0xff];
+    m_crc = crc;
+}
+
+// ============================================================================
+// XXH3 64 bit, seed 0, default secret.
+//
+//  Inputs up to 240 bytes are hashed in one shot from the buffer, longer
+//  inputs are consumed in 64 byte stripes, 16 stripes per block, keeping
+//  at least one byte back so Finish can hash the last stripe.
+
+static const unsigned __int64 sPrime32_1 = 0x9e3779b1;
+static const unsigned __int64 sPrime32_2 = 0x85ebca77;
+static const unsigned __int64 sPrime32_3 = 0xc2b2ae3d;
+static const unsigned __int64 sPrime64_1 = 0x9e3779b185ebca87ULL;
+static const unsigned __int64 sPrime64_2 = 0xc2b2ae3d27d4eb4fULL;
+static const unsigned __int64 sPrime64_3 = 0x165667b19e3779f9ULL;
+static const unsigned __int64 sPrime64_4 = 0x85ebca77c2b2ae63ULL;
+static const unsigned __int64 sPrime64_5 = 0x27d4eb2f165667c5ULL;
+static const unsigned __int64 sPrimeMx1 = 0x165667919e3779f9ULL;
+static const unsigned __int64 sPrimeMx2 = 0x9fb21c651e98df25ULL;
+
+static const size_t sStripeLen = 64;
+static const size_t sSecretSize = 192;
+static const size_t sStripesPerBlock = (sSecretSize - sStripeLen) / 8;
+
+alignas(64) static const unsigned char sSecret[sSecretSize] =
+{
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+static inline unsigned __int64 Rotl64(unsigned __int64 val, int bits)
+{
+    return (val << bits) | (val >> (64 - bits));
+}
+
+static inline unsigned __int64 Swap64(unsigned __int64 val)
+{
+    val = ((val << 8) & 0xff00ff00ff00ff00ULL) | ((val >> 8) & 0x00ff00ff00ff00ffULL);
+    val = ((val << 16) & 0xffff0000ffff0000ULL) | ((val >> 16) & 0x0000ffff0000ffffULL);
+    return (val << 32) | (val >> 32);
+}
+
+// 64x64 multiply, xor of high and low halves of the 128 bit product.
+static inline unsigned __int64 MulFold64(unsigned __int64 lhs, unsigned __int64 rhs)
+{
+#if defined(_M_X64)
+    unsigned __int64 high;
+    const unsigned __int64 low = _umul128(lhs, rhs, &high);
+    return low ^ high;
+#else
+    const unsigned __int64 lo_lo = (lhs & 0xffffffff) * (rhs & 0xffffffff);
+    const unsigned __int64 hi_lo = (lhs >> 32) * (rhs & 0xffffffff);
+    const unsigned __int64 lo_hi = (lhs & 0xffffffff) * (rhs >> 32);
+    const unsigned __int64 hi_hi = (lhs >> 32) * (rhs >> 32);
+    const unsigned __int64 cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+    const unsigned __int64 high = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    const unsigned __int64 low = (cross << 32) | (lo_lo & 0xffffffff);
+    return low ^ high;
+#endif
+}
+
+static inline unsigned __int64 Xxh64Avalanche(unsigned __int64 hash)
+{
+    hash ^= hash >> 33;
+    hash *= sPrime64_2;
+    hash ^= hash >> 29;
+    hash *= sPrime64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+static inline unsigned __int64 Xxh3Avalanche(unsigned __int64 hash)
+{
+    hash ^= hash >> 37;
+    hash *= sPrimeMx1;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+static inline unsigned __int64 Mix16(const unsigned char* pIn, const unsigned char* pSecret)
+{
+    return MulFold64(Read64(pIn) ^ Read64(pSecret), Read64(pIn + 8) ^ Read64(pSecret + 8));
+}
+
+//-----------------------------------------------------------------------------
+// One shot hash of 0 to 240 bytes.
+static unsigned __int64 Xxh3Short(const unsigned char* pIn, size_t len)
+{
+    const unsigned char* pSecret = sSecret;
+
+    if (len == 0)
+        return Xxh64Avalanche(Read64(pSecret + 56) ^ Read64(pSecret + 64));
+
+    if (len <= 3)
+    {
+        const unsigned combined = ((unsigned)pIn[0] << 16) | ((unsigned)pIn[len >> 1] << 24)
+            | (unsigned)pIn[len - 1] | ((unsigned)len << 8);
+        const unsigned __int64 bitflip = Read32(pSecret) ^ Read32(pSecret + 4);
+        return Xxh64Avalanche(combined ^ bitflip);
+    }
+
+    if (len <= 8)
+    {
+        const unsigned __int64 bitflip = Read64(pSecret + 8) ^ Read64(pSecret + 16);
+        const unsigned __int64 input64 = Read32(pIn + len - 4) + ((unsigned __int64)Read32(pIn) << 32);
+        unsigned __int64 hash = input64 ^ bitflip;
+        hash ^= Rotl64(hash, 49) ^ Rotl64(hash, 24);
+        hash *= sPrimeMx2;
+        hash ^= (hash >> 35) + len;
+        hash *= sPrimeMx2;
+        return hash ^ (hash >> 28);
+    }
+
+    if (len <= 16)
+    {
+        const unsigned __int64 inputLo = Read64(pIn) ^ (Read64(pSecret + 24) ^ Read64(pSecret + 32));
+        const unsigned __int64 inputHi = Read64(pIn + len - 8) ^ (Read64(pSecret + 40) ^ Read64(pSecret + 48));
+        return Xxh3Avalanche(len + Swap64(inputLo) + inputHi + MulFold64(inputLo, inputHi));
+    }
+
+    unsigned __int64 acc = len * sPrime64_1;
+    if (len <= 128)
+    {
+        if (len > 32)
+        {
+            if (len > 64)
+            {
+                if (len > 96)
+                {
+                    acc += Mix16(pIn + 48, pSecret + 96);
+                    acc += Mix16(pIn + len - 64, pSecret + 112);
+                }
+                acc += Mix16(pIn + 32, pSecret + 64);
+                acc += Mix16(pIn + len - 48, pSecret + 80);
+            }
+            acc += Mix16(pIn + 16, pSecret + 32);
+            acc += Mix16(pIn + len - 32, pSecret + 48);
+        }
+        acc += Mix16(pIn, pSecret);
+        acc += Mix16(pIn + len - 16, pSecret + 16);
+        return Xxh3Avalanche(acc);
+    }
+
+    const size_t rounds = len / 16;
+    for (size_t idx = 0; idx < 8; idx++)
+        acc += Mix16(pIn + 16 * idx, pSecret + 16 * idx);
+    acc = Xxh3Avalanche(acc);
+    for (size_t idx = 8; idx < rounds; idx++)
+        acc += Mix16(pIn + 16 * idx, pSecret + 16 * (idx - 8) + 3);
+    acc += Mix16(pIn + len - 16, pSecret + 136 - 17);
+    return Xxh3Avalanche(acc);
+}
+
+//-----------------------------------------------------------------------------
+// Accumulate stripes, stripe n uses secret + 8n.
+static void Xxh3AccumulateScalar(unsigned __int64* pAcc, const unsigned char* pIn,
+    const unsigned char* pSecret, size_t stripes)
+{
+    for (size_t stripe = 0; stripe < stripes; stripe++, pIn += sStripeLen, pSecret += 8)
+    {
+        for (unsigned lane = 0; lane < 8; lane++)
+        {
+            const unsigned __int64 dataVal = Read64(pIn + 8 * lane);
+            const unsigned __int64 dataKey = dataVal ^ Read64(pSecret + 8 * lane);
+            pAcc[lane ^ 1] += dataVal;
+            pAcc[lane] += (dataKey & 0xffffffff) * (dataKey >> 32);
+        }
+    }
+}
+
+#if defined(_M_IX86) || defined(_M_X64)
+static void Xxh3AccumulateSse2(unsigned __int64* pAcc, const unsigned char* pIn,
+    const unsigned char* pSecret, size_t stripes)
+{
+    __m128i acc[4];
+    for (unsigned lane = 0; lane < 4; lane++)
+        acc[lane] = _mm_loadu_si128((const __m128i*)pAcc + lane);
+
+    for (size_t stripe = 0; stripe < stripes; stripe++, pIn += sStripeLen, pSecret += 8)
+    {
+        for (unsigned lane = 0; lane < 4; lane++)
+        {
+            const __m128i dataVal = _mm_loadu_si128((const __m128i*)pIn + lane);
+            const __m128i dataKey = _mm_xor_si128(dataVal, _mm_loadu_si128((const __m128i*)pSecret + lane));
+            const __m128i product = _mm_mul_epu32(dataKey, _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1)));
+            const __m128i swapped = _mm_shuffle_epi32(dataVal, _MM_SHUFFLE(1, 0, 3, 2));
+            acc[lane] = _mm_add_epi64(acc[lane], _mm_add_epi64(product, swapped));
+        }
+    }
+
+    for (unsigned lane = 0; lane < 4; lane++)
+        _mm_storeu_si128((__m128i*)pAcc + lane, acc[lane]);
+}
+
+static void Xxh3AccumulateAvx2(unsigned __int64* pAcc, const unsigned char* pIn,
+    const unsigned char* pSecret, size_t stripes)
+{
+    __m256i acc[2];
+    for (unsigned lane = 0; lane < 2; lane++)
+        acc[lane] = _mm256_loadu_si256((const __m256i*)pAcc + lane);
+
+    for (size_t stripe = 0; stripe < stripes; stripe++, pIn += sStripeLen, pSecret += 8)
+    {
+        for (unsigned lane = 0; lane < 2; lane++)
+        {
+            const __m256i dataVal = _mm256_loadu_si256((const __m256i*)pIn + lane);
+            const __m256i dataKey = _mm256_xor_si256(dataVal, _mm256_loadu_si256((const __m256i*)pSecret + lane));
+            const __m256i product = _mm256_mul_epu32(dataKey, _mm256_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1)));
+            const __m256i swapped = _mm256_shuffle_epi32(dataVal, _MM_SHUFFLE(1, 0, 3, 2));
+            acc[lane] = _mm256_add_epi64(acc[lane], _mm256_add_epi64(product, swapped));
+        }
+    }
+
+    for (unsigned lane = 0; lane < 2; lane++)
+        _mm256_storeu_si256((__m256i*)pAcc + lane, acc[lane]);
+    _mm256_zeroupper();
+}
+#endif
+
+typedef void (*Xxh3AccumulateFunc)(unsigned __int64*, const unsigned char*, const unsigned char*, size_t);
+
+#if defined(_M_IX86) || defined(_M_X64)
+static const Xxh3AccumulateFunc sXxh3Accumulate = sHaveAvx2 ? Xxh3AccumulateAvx2 : Xxh3AccumulateSse2;
+#else
+static const Xxh3AccumulateFunc sXxh3Accumulate = Xxh3AccumulateScalar;
+#endif
+
+static void Xxh3Scramble(unsigned __int64* pAcc)
+{
+    const unsigned char* pSecret = sSecret + sSecretSize - sStripeLen;
+    for (unsigned lane = 0; lane < 8; lane++)
+    {
+        unsigned __int64 acc = pAcc[lane];
+        acc ^= acc >> 47;
+        acc ^= Read64(pSecret + 8 * lane);
+        pAcc[lane] = acc * sPrime32_1;
+    }
+}
+
+//-----------------------------------------------------------------------------
+class Xxh3Engine : public HashEngine
+{
+public:
+    const char* Name() const        { return "xxh3"; }
+    unsigned DigestSize() const     { return 8; }
+    void Init();
+    void Append(const void* pData, size_t len);
+    void Finish(unsigned char* pDigest);
+
+private:
+    static void Consume(unsigned __int64* pAcc, size_t& stripesInBlock, const unsigned char* pIn, size_t stripes);
+
+    static const size_t sBufferSize = 256;
+
+    unsigned __int64    m_acc[8];
+    size_t              m_stripesInBlock;   // Stripes of current block already accumulated
+    unsigned __int64    m_totalLen;
+    size_t              m_bufLen;
+    unsigned char       m_buffer[sBufferSize];
+    unsigned char       m_lastStripe[sStripeLen];   // Consumed bytes before m_buffer
+};
+
+//-----------------------------------------------------------------------------
+void Xxh3Engine::Init()
+{
+    m_acc[0] = sPrime32_3;
+    m_acc[1] = sPrime64_1;
+    m_acc[2] = sPrime64_2;
+    m_acc[3] = sPrime64_3;
+    m_acc[4] = sPrime64_4;
+    m_acc[5] = sPrime32_2;
+    m_acc[6] = sPrime64_5;
+    m_acc[7] = sPrime32_1;
+    m_stripesInBlock = 0;
+    m_totalLen = 0;
+    m_bufLen = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Accumulate stripes, scramble at end of each block.
+void Xxh3Engine::Consume(unsigned __int64* pAcc, size_t& stripesInBlock,
+    const unsigned char* pIn, size_t stripes)
+{
+    while (stripes != 0)
+    {
+        size_t part = sStripesPerBlock - stripesInBlock;
+        if (part > stripes)
+            part = stripes;
+        sXxh3Accumulate(pAcc, pIn, sSecret + 8 * stripesInBlock, part);
+        pIn += part * sStripeLen;
+        stripes -= part;
+        stripesInBlock += part;
+        if (stripesInBlock == sStripesPerBlock)
+        {
+            Xxh3Scramble(pAcc);
+            stripesInBlock = 0;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void Xxh3Engine::Append(const void* pData, size_t len)
+{
+    const unsigned char* pIn = (const unsigned char*)pData;
+    m_totalLen += len;
+
+    if (m_bufLen + len <= sBufferSize)
+    {
+        memcpy(m_buffer + m_bufLen, pIn, len);
+        m_bufLen += len;
+        return;
+    }
+
+    // More input follows the buffer, so all of it can be consumed.
+    if (m_bufLen != 0)
+    {
+        const size_t fill = sBufferSize - m_bufLen;
+        memcpy(m_buffer + m_bufLen, pIn, fill);
+        pIn += fill;
+        len -= fill;
+        Consume(m_acc, m_stripesInBlock, m_buffer, sBufferSize / sStripeLen);
+        memcpy(m_lastStripe, m_buffer + sBufferSize - sStripeLen, sStripeLen);
+        m_bufLen = 0;
+    }
+
+    // Consume directly from input, keep at least one byte.
+    if (len > sBufferSize)
+    {
+        const size_t stripes = (len - 1) / sStripeLen;
+        Consume(m_acc, m_stripesInBlock, pIn, stripes);
+        pIn += stripes * sStripeLen;
+        len -= stripes * sStripeLen;
+        memcpy(m_lastStripe, pIn - sStripeLen, sStripeLen);
+    }
+
+    memcpy(m_buffer, pIn, len);
+    m_bufLen = len;
+}
+
+//-----------------------------------------------------------------------------
+void Xxh3Engine::Finish(unsigned char* pDigest)
+{
+    unsigned __int64 hash;
+    if (m_totalLen <= 240)
+    {
+        hash = Xxh3Short(m_buffer, (size_t)m_totalLen);
+    }
+    else
+    {
+        unsigned __int64 acc[8];
+        memcpy(acc, m_acc, sizeof(acc));
+        size_t stripesInBlock = m_stripesInBlock;
+
+        const unsigned char* pLast;
+        unsigned char lastStripe[sStripeLen];
+        if (m_bufLen >= sStripeLen)
+        {
+            Consume(acc, stripesInBlock, m_buffer, (m_bufLen - 1) / sStripeLen);
+            pLast = m_buffer + m_bufLen - sStripeLen;
+        }
+        else
+        {
+            const size_t catchup = sStripeLen - m_bufLen;
+            memcpy(lastStripe, m_lastStripe + m_bufLen, catchup);
+            memcpy(lastStripe + catchup, m_buffer, m_bufLen);
+            pLast = lastStripe;
+        }
+        sXxh3Accumulate(acc, pLast, sSecret + sSecretSize - sStripeLen - 7, 1);
+
+        hash = m_totalLen * sPrime64_1;
+        for (unsigned idx = 0; idx < 4; idx++)
+            hash += MulFold64(acc[2 * idx] ^ Read64(sSecret + 11 + 16 * idx),
+                acc[2 * idx + 1] ^ Read64(sSecret + 11 + 16 * idx + 8));
+        hash = Xxh3Avalanche(hash);
+    }
+
+    Write64BE(pDigest, hash);
+}
+
+// ============================================================================
+// Multi-buffer MD5, eight messages advance together in the 32 bit lanes of
+// AVX2 registers. A lane takes the next message when its message is done,
+// lanes without a message hash a dummy block.
+
+#if defined(_M_IX86) || defined(_M_X64)
+
+#define MD5_F(b, c, d)  _mm256_xor_si256(d, _mm256_and_si256(b, _mm256_xor_si256(c, d)))
+#define MD5_G(b, c, d)  _mm256_xor_si256(c, _mm256_and_si256(d, _mm256_xor_si256(b, c)))
+#define MD5_H(b, c, d)  _mm256_xor_si256(_mm256_xor_si256(b, c), d)
+#define MD5_I(b, c, d)  _mm256_xor_si256(c, _mm256_or_si256(b, _mm256_xor_si256(d, ones)))
+#define MD5_STEP(f, a, b, c, d, k, s, t) \
+    a = _mm256_add_epi32(_mm256_add_epi32(a, f(b, c, d)), _mm256_add_epi32(w[k], _mm256_set1_epi32((int)t))); \
+    a = _mm256_add_epi32(b, _mm256_or_si256(_mm256_slli_epi32(a, s), _mm256_srli_epi32(a, 32 - s)))
+
+// Transpose 8 rows of 8 words, row n word m => out m lane n.
+static inline void Transpose8x8(const __m256i* pRow, __m256i* pOut)
+{
+    __m256i t0 = _mm256_unpacklo_epi32(pRow[0], pRow[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(pRow[0], pRow[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(pRow[2], pRow[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(pRow[2], pRow[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(pRow[4], pRow[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(pRow[4], pRow[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(pRow[6], pRow[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(pRow[6], pRow[7]);
+
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    pOut[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    pOut[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    pOut[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    pOut[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    pOut[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    pOut[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    pOut[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    pOut[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+// One 64 byte block per lane, pState is a[8], b[8], c[8], d[8].
+static void Md5Blocks8(unsigned* pState, const unsigned char* const* ppBlock)
+{
+    __m256i rows[8];
+    __m256i w[16];
+    for (unsigned half = 0; half < 2; half++)
+    {
+        for (unsigned lane = 0; lane < 8; lane++)
+            rows[lane] = _mm256_loadu_si256((const __m256i*)(ppBlock[lane] + 32 * half));
+        Transpose8x8(rows, w + 8 * half);
+    }
+
+    const __m256i ones = _mm256_set1_epi32(-1);
+    const __m256i a0 = _mm256_loadu_si256((const __m256i*)pState + 0);
+    const __m256i b0 = _mm256_loadu_si256((const __m256i*)pState + 1);
+    const __m256i c0 = _mm256_loadu_si256((const __m256i*)pState + 2);
+    const __m256i d0 = _mm256_loadu_si256((const __m256i*)pState + 3);
+    __m256i a = a0, b = b0, c = c0, d = d0;
+
+    MD5_STEP(MD5_F, a, b, c, d,  0,  7, 0xd76aa478);
+    MD5_STEP(MD5_F, d, a, b, c,  1, 12, 0xe8c7b756);
+    MD5_STEP(MD5_F, c, d, a, b,  2, 17, 0x242070db);
+    MD5_STEP(MD5_F, b, c, d, a,  3, 22, 0xc1bdceee);
+    MD5_STEP(MD5_F, a, b, c, d,  4,  7, 0xf57c0faf);
+    MD5_STEP(MD5_F, d, a, b, c,  5, 12, 0x4787c62a);
+    MD5_STEP(MD5_F, c, d, a, b,  6, 17, 0xa8304613);
+    MD5_STEP(MD5_F, b, c, d, a,  7, 22, 0xfd469501);
+    MD5_STEP(MD5_F, a, b, c, d,  8,  7, 0x698098d8);
+    MD5_STEP(MD5_F, d, a, b, c,  9, 12, 0x8b44f7af);
+    MD5_STEP(MD5_F, c, d, a, b, 10, 17, 0xffff5bb1);
+    MD5_STEP(MD5_F, b, c, d, a, 11, 22, 0x895cd7be);
+    MD5_STEP(MD5_F, a, b, c, d, 12,  7, 0x6b901122);
+    MD5_STEP(MD5_F, d, a, b, c, 13, 12, 0xfd987193);
+    MD5_STEP(MD5_F, c, d, a, b, 14, 17, 0xa679438e);
+    MD5_STEP(MD5_F, b, c, d, a, 15, 22, 0x49b40821);
+    MD5_STEP(MD5_G, a, b, c, d,  1,  5, 0xf61e2562);
+    MD5_STEP(MD5_G, d, a, b, c,  6,  9, 0xc040b340);
+    MD5_STEP(MD5_G, c, d, a, b, 11, 14, 0x265e5a51);
+    MD5_STEP(MD5_G, b, c, d, a,  0, 20, 0xe9b6c7aa);
+    MD5_STEP(MD5_G, a, b, c, d,  5,  5, 0xd62f105d);
+    MD5_STEP(MD5_G, d, a, b, c, 10,  9, 0x02441453);
+    MD5_STEP(MD5_G, c, d, a, b, 15, 14, 0xd8a1e681);
+    MD5_STEP(MD5_G, b, c, d, a,  4, 20, 0xe7d3fbc8);
+    MD5_STEP(MD5_G, a, b, c, d,  9,  5, 0x21e1cde6);
+    MD5_STEP(MD5_G, d, a, b, c, 14,  9, 0xc33707d6);
+    MD5_STEP(MD5_G, c, d, a, b,  3, 14, 0xf4d50d87);
+    MD5_STEP(MD5_G, b, c, d, a,  8, 20, 0x455a14ed);
+    MD5_STEP(MD5_G, a, b, c, d, 13,  5, 0xa9e3e905);
+    MD5_STEP(MD5_G, d, a, b, c,  2,  9, 0xfcefa3f8);
+    MD5_STEP(MD5_G, c, d, a, b,  7, 14, 0x676f02d9);
+    MD5_STEP(MD5_G, b, c, d, a, 12, 20, 0x8d2a4c8a);
+    MD5_STEP(MD5_H, a, b, c, d,  5,  4, 0xfffa3942);
+    MD5_STEP(MD5_H, d, a, b, c,  8, 11, 0x8771f681);
+    MD5_STEP(MD5_H, c, d, a, b, 11, 16, 0x6d9d6122);
+    MD5_STEP(MD5_H, b, c, d, a, 14, 23, 0xfde5380c);
+    MD5_STEP(MD5_H, a, b, c, d,  1,  4, 0xa4beea44);
+    MD5_STEP(MD5_H, d, a, b, c,  4, 11, 0x4bdecfa9);
+    MD5_STEP(MD5_H, c, d, a, b,  7, 16, 0xf6bb4b60);
+    MD5_STEP(MD5_H, b, c, d, a, 10, 23, 0xbebfbc70);
+    MD5_STEP(MD5_H, a, b, c, d, 13,  4, 0x289b7ec6);
+    MD5_STEP(MD5_H, d, a, b, c,  0, 11, 0xeaa127fa);
+    MD5_STEP(MD5_H, c, d, a, b,  3, 16, 0xd4ef3085);
+    MD5_STEP(MD5_H, b, c, d, a,  6, 23, 0x04881d05);
+    MD5_STEP(MD5_H, a, b, c, d,  9,  4, 0xd9d4d039);
+    MD5_STEP(MD5_H, d, a, b, c, 12, 11, 0xe6db99e5);
+    MD5_STEP(MD5_H, c, d, a, b, 15, 16, 0x1fa27cf8);
+    MD5_STEP(MD5_H, b, c, d, a,  2, 23, 0xc4ac5665);
+    MD5_STEP(MD5_I, a, b, c, d,  0,  6, 0xf4292244);
+    MD5_STEP(MD5_I, d, a, b, c,  7, 10, 0x432aff97);
+    MD5_STEP(MD5_I, c, d, a, b, 14, 15, 0xab9423a7);
+    MD5_STEP(MD5_I, b, c, d, a,  5, 21, 0xfc93a039);
+    MD5_STEP(MD5_I, a, b, c, d, 12,  6, 0x655b59c3);
+    MD5_STEP(MD5_I, d, a, b, c,  3, 10, 0x8f0ccc92);
+    MD5_STEP(MD5_I, c, d, a, b, 10, 15, 0xffeff47d);
+    MD5_STEP(MD5_I, b, c, d, a,  1, 21, 0x85845dd1);
+    MD5_STEP(MD5_I, a, b, c, d,  8,  6, 0x6fa87e4f);
+    MD5_STEP(MD5_I, d, a, b, c, 15, 10, 0xfe2ce6e0);
+    MD5_STEP(MD5_I, c, d, a, b,  6, 15, 0xa3014314);
+    MD5_STEP(MD5_I, b, c, d, a, 13, 21, 0x4e0811a1);
+    MD5_STEP(MD5_I, a, b, c, d,  4,  6, 0xf7537e82);
+    MD5_STEP(MD5_I, d, a, b, c, 11, 10, 0xbd3af235);
+    MD5_STEP(MD5_I, c, d, a, b,  2, 15, 0x2ad7d2bb);
+    MD5_STEP(MD5_I, b, c, d, a,  9, 21, 0xeb86d391);
+
+    _mm256_storeu_si256((__m256i*)pState + 0, _mm256_add_epi32(a, a0));
+    _mm256_storeu_si256((__m256i*)pState + 1, _mm256_add_epi32(b, b0));
+    _mm256_storeu_si256((__m256i*)pState + 2, _mm256_add_epi32(c, c0));
+    _mm256_storeu_si256((__m256i*)pState + 3, _mm256_add_epi32(d, d0));
+}
+
+#undef MD5_F
+#undef MD5_G
+#undef MD5_H
+#undef MD5_I
+#undef MD5_STEP
+
+//-----------------------------------------------------------------------------
+static void Md5BatchAvx2(const unsigned char* const* ppData, const size_t* pLen,
+    size_t count, unsigned char (*pDigest)[16])
+{
+    struct Lane
+    {
+        size_t          msgIdx;
+        size_t          block;
+        size_t          dataBlocks;     // Whole blocks read from message
+        size_t          blocks;         // Including padding blocks in tail
+        unsigned char   tail[128];
+    };
+
+    static const unsigned char sDummy[64] = { 0 };
+    const size_t sNone = (size_t)-1;
+
+    Lane lanes[8];
+    alignas(32) unsigned state[4][8];
+    const unsigned char* pBlocks[8];
+    size_t nextMsg = 0;
+    size_t active = 0;
+
+    for (unsigned lane = 0; lane < 8; lane++)
+        lanes[lane].msgIdx = sNone;
+
+    for (;;)
+    {
+        // Start next message in idle lanes.
+        for (unsigned lane = 0; lane < 8; lane++)
+        {
+            Lane& cur = lanes[lane];
+            if (cur.msgIdx == sNone && nextMsg < count)
+            {
+                const size_t len = pLen[nextMsg];
+                const size_t rest = len % 64;
+                cur.msgIdx = nextMsg++;
+                cur.block = 0;
+                cur.dataBlocks = len / 64;
+                cur.blocks = cur.dataBlocks + ((rest < 56) ? 1 : 2);
+
+                // Last partial block, 0x80, zeros and bit length.
+                const size_t tailLen = (cur.blocks - cur.dataBlocks) * 64;
+                memcpy(cur.tail, ppData[cur.msgIdx] + cur.dataBlocks * 64, rest);
+                cur.tail[rest] = 0x80;
+                memset(cur.tail + rest + 1, 0, tailLen - rest - 1);
+                const unsigned __int64 bits = (unsigned __int64)len * 8;
+                memcpy(cur.tail + tailLen - 8, &bits, 8);
+
+                state[0][lane] = 0x67452301;
+                state[1][lane] = 0xefcdab89;
+                state[2][lane] = 0x98badcfe;
+                state[3][lane] = 0x10325476;
+                active++;
+            }
+        }
+
+        if (active == 0)
+            break;
+
+        for (unsigned lane = 0; lane < 8; lane++)
+        {
+            const Lane& cur = lanes[lane];
+            if (cur.msgIdx == sNone)
+                pBlocks[lane] = sDummy;
+            else if (cur.block < cur.dataBlocks)
+                pBlocks[lane] = ppData[cur.msgIdx] + cur.block * 64;
+            else
+                pBlocks[lane] = cur.tail + (cur.block - cur.dataBlocks) * 64;
+        }
+
+        Md5Blocks8(&state[0][0], pBlocks);
+
+        for (unsigned lane = 0; lane < 8; lane++)
+        {
+            Lane& cur = lanes[lane];
+            if (cur.msgIdx != sNone && ++cur.block == cur.blocks)
+            {
+                for (unsigned word = 0; word < 4; word++)
+                    memcpy(pDigest[cur.msgIdx] + 4 * word, &state[word][lane], 4);
+                cur.msgIdx = sNone;
+                active--;
+            }
+        }
+    }
+    _mm256_zeroupper();
+}
+#endif
+
+//-----------------------------------------------------------------------------
+void Md5Batch(const unsigned char* const* ppData, const size_t* pLen,
+    size_t count, unsigned char (*pDigest)[16])
+{
+#if defined(_M_IX86) || defined(_M_X64)
+    if (sHaveAvx2 && count > 1)
+    {
+        Md5BatchAvx2(ppData, pLen, count, pDigest);
+        return;
+    }
+#endif
+
+    md5_state_t state;
+    for (size_t idx = 0; idx < count; idx++)
+    {
+        md5_init(&state);
+        md5_append(&state, ppData[idx], (int)pLen[idx]);
+        md5_finish(&state, pDigest[idx]);
+    }
+}
+
+// ============================================================================
+HashEngine* HashEngine::Create(const char* name)
+{
+    HashEngine* pEngine = NULL;
+    if (_stricmp(name, "md5") == 0)
+        pEngine = new Md5Engine();
+    else if (_stricmp(name, "xxh3") == 0)
+        pEngine = new Xxh3Engine();
+    else if (_stricmp(name, "crc32c") == 0)
+        pEngine = new Crc32cEngine();
+
+    if (pEngine != NULL)
+        pEngine->Init();
+    return pEngine;
+}
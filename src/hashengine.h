@@ -0,0 +1,62 @@
+//-----------------------------------------------------------------------------
+// hashengine - Selectable file content hash, md5, xxh3 or crc32c.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <stddef.h>
+
+// File content hash selected by name, see llcmp -h=<name>.
+//      md5     ; RFC 1321, default and what older output used
+//      xxh3    ; XXH3 64 bit, seed 0, same value as xxhsum -H3
+//      crc32c  ; Castagnoli crc, SSE4.2 crc32 instruction when available
+// Digest bytes are in the order printed, most significant first.
+class HashEngine
+{
+public:
+    virtual ~HashEngine() { }
+
+    virtual const char* Name() const = 0;
+    virtual unsigned DigestSize() const = 0;     // bytes, at most sMaxDigest
+    virtual void Init() = 0;
+    virtual void Append(const void* pData, size_t len) = 0;
+    virtual void Finish(unsigned char* pDigest) = 0;
+
+    // Return new engine or NULL if name unknown.
+    static HashEngine* Create(const char* name);
+
+    static const char* sNames;      // "md5|xxh3|crc32c"
+    static const unsigned sMaxDigest = 16;
+};
+
+// MD5 of count small messages, eight at a time with AVX2 when available.
+// Messages must be under 2GB.
+void Md5Batch(const unsigned char* const* ppData, const size_t* pLen,
+    size_t count, unsigned char (*pDigest)[16]);
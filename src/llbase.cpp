@@ -52,6 +52,7 @@ bool LLBase::ParseBaseCmds(const char*& cmdOpts)
         "  F(l|f)  force byLine or byFile \n"
         "  U(i|b)  update inplace or backup \n"
         "  I       ignore case \n"
+        "  E(s|d)  regex engine std::regex or dfa \n"
         ;
     const char missingAttrMsg[] = "Filter on attributes, syntax -A=[nrhs]";
     const char optSepErrMsg[] = "Additional field separators, -B=<separators>";
@@ -59,6 +60,7 @@ bool LLBase::ParseBaseCmds(const char*& cmdOpts)
     const char excludeEmptyMsg[] = "Invalid exclude syntax. Use -X=<pattern>[,<pattern> with no spaces\n";
     const char missingExitMsg[] = "Missing exit options. Use -E=<opts>\n";
     const char missingDepthMsg[] = "Depth, -d=0 (all), -d=-n (less), -d=+n (more)";
+    const char threadsMsg[] = "Parallel directory scan, -j=<threads>";
 
     std::string str;
     bool valid;
@@ -105,6 +107,11 @@ bool LLBase::ParseBaseCmds(const char*& cmdOpts)
         cmdOpts = LLSup::ParseString(cmdOpts+1, str, optRangeMsg);
         m_grepOpt.Parse(str);
         break;
+    case 'j':   // Parallel directory scan, -j=<threads>, used with -r
+                // Documented by ld, lf, lc, lm, le, lg, lr and llcmp (which also compares
+                // in parallel). lr keeps plain -j for follow junctions.
+        cmdOpts = LLSup::ParseNum(cmdOpts+1, m_dirScan.m_threads, threadsMsg);
+        break;
     case '0':   
     case 'I':   // Input list of files, -I=<inFilePath>, or -I=-
         cmdOpts = LLSup::ParseString(cmdOpts+1, m_inFile, missingInFileMsg);
@@ -143,6 +150,7 @@ bool LLBase::ParseBaseCmds(const char*& cmdOpts)
         break;
     case 'X':   // Exclude, -X=<pathPat>[,<pathPat>...]
         cmdOpts = LLSup::ParseList(cmdOpts+1, m_excludeList, excludeEmptyMsg);
+        SetPruneList();
         break;
     case 'Z':   // if siZe  -Z=1000K  or -Z<1M or -Z>1G
         cmdOpts = LLSup::ParseSizeOp(cmdOpts+1, m_onlySizeOp, m_onlySize);
@@ -183,13 +191,8 @@ bool LLBase::FilterDir(
     // if (depth < 0)
     //     return false;         // ignore end-of-directory
            
-    if (m_depthLimit != 0)
-    {
-        if (m_depthLimit > 0 && depth < m_depthLimit)
-            return false;
-        if (m_depthLimit < 0 && depth > -m_depthLimit)
-            return false;
-    }
+    if ( !InDepthLimit(depth))
+        return false;
 
     LARGE_INTEGER fileSize;
     fileSize.HighPart = pFileData->nFileSizeHigh;
@@ -203,26 +206,68 @@ bool LLBase::FilterDir(
         return false;
 
     if (m_isDir)
-    {
         m_countInDir++;
-		
+    else
+        m_countInFile++;
+
+    return FilterEntry(pFileData, m_srcPath);
+}
+
+// ---------------------------------------------------------------------------
+// FilterDir tests without side effects, for callers which filter entries
+// ahead of FilterDir (ld -Q keeps only the top sorted entries).
+bool LLBase::AcceptDir(
+        const char* pDir,
+        const WIN32_FIND_DATA* pFileData,
+        int depth) const
+{
+    if ( !InDepthLimit(depth))
+        return false;
+
+    const lstring srcPath = LLPath::Join(pDir, pFileData->cFileName);
+    if (LLSup::PatternListMatches(m_excludeList, srcPath))
+        return false;
+
+    return FilterEntry(pFileData, srcPath);
+}
+
+// ---------------------------------------------------------------------------
+// Depth limit -d, see FilterDir.
+bool LLBase::InDepthLimit(int depth) const
+{
+    if (m_depthLimit != 0)
+    {
+        if (m_depthLimit > 0 && depth < m_depthLimit)
+            return false;
+        if (m_depthLimit < 0 && depth > -m_depthLimit)
+            return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Filter tests after -X and the scan counts, see FilterDir.
+bool LLBase::FilterEntry(const WIN32_FIND_DATA* pFileData, const lstring& srcPath) const
+{
+    if ((pFileData->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+    {
 		if (!LLSup::PatternListMatches(m_includeDirList, pFileData->cFileName, true))
 			return false;
 
-		if (m_grepSrcPathPat.flags() != 0 &&
-			!std::regex_search(m_srcPath.begin(), m_srcPath.end(), m_grepSrcPathPat))
+		if (!m_grepSrcPathPat.empty() && !m_grepSrcPathPat.Search(srcPath))
 			return false;
     }
     else
     {
-        m_countInFile++;
+        LARGE_INTEGER fileSize;
+        fileSize.HighPart = pFileData->nFileSizeHigh;
+        fileSize.LowPart  = pFileData->nFileSizeLow;
 
         if ( !LLSup::PatternListMatches(m_includeFileList, pFileData->cFileName, true))
             return false;
-        if (m_grepSrcPathPat.flags() != 0 &&
-            !std::regex_search(m_srcPath.begin(), m_srcPath.end(), m_grepSrcPathPat))
+        if (!m_grepSrcPathPat.empty() && !m_grepSrcPathPat.Search(srcPath))
             return false;
-        if ( !SizeOperation(m_fileSize, m_onlySizeOp, m_onlySize))
+        if ( !SizeOperation(fileSize.QuadPart, m_onlySizeOp, m_onlySize))
             return false;
     }
 
@@ -230,14 +275,55 @@ bool LLBase::FilterDir(
         return false;
     if ( !LLSup::CompareRhsBits(pFileData->dwFileAttributes, m_onlyRhs))
         return false;
-    if (LLSup::PatternListMatches(m_excludeList, m_srcPath))
-        return false;
     if ( !TimeOperation(pFileData, m_timeOp, m_testTimeFields, m_testTime))
         return false;
 
     return true;
 }
 
+// ---------------------------------------------------------------------------
+// Collect -X subtree patterns <pat>\* as <pat>. Every path below a directory
+// matching <pat> matches <pat>\*, so that directory need not be scanned.
+// Negated patterns are left out, their subtree may hold included paths.
+void LLBase::SetPruneList()
+{
+    m_pruneList.clear();
+    for (size_t patIdx = 0; patIdx < m_excludeList.size(); patIdx++)
+    {
+        const std::string& pattern = m_excludeList[patIdx].Pattern();
+        const size_t len = pattern.length();
+        if (len > 2 && pattern[0] != '!' && pattern[len-2] == '\\' && pattern[len-1] == '*')
+            m_pruneList.push_back(CompiledPattern(pattern.substr(0, len-2)));
+    }
+    m_pruneList.Build();
+}
+
+// ---------------------------------------------------------------------------
+// Skip walking into directories excluded by -X, so excluding a directory
+// path also excludes everything below it. A directory is also skipped if
+// a -X=<pat>\* pattern would exclude everything below it, see SetPruneList.
+bool LLBase::PruneDir(const char* pDir, const WIN32_FIND_DATA* pFileData, int depth) const
+{
+    if (m_excludeList.empty())
+        return false;
+
+    const std::string dirPath = LLPath::Join(pDir, pFileData->cFileName);
+    return LLSup::PatternListMatches(m_excludeList, dirPath.c_str())
+        || LLSup::PatternListMatches(m_pruneList, dirPath.c_str());
+}
+
+// ---------------------------------------------------------------------------
+// File metadata needed by FilterDir, attributes are always available.
+unsigned LLBase::FilterMetaDemand() const noexcept
+{
+    unsigned metaDemand = LLSup::eMetaAttr;
+    if (m_onlySizeOp != LLSup::eOpNone)
+        metaDemand |= LLSup::eMetaSize;
+    if (m_timeOp != LLSup::eOpNone)
+        metaDemand |= LLSup::eMetaTime;
+    return metaDemand;
+}
+
 // ---------------------------------------------------------------------------
 // Populate m_dstPath, replace #n and *n patterns.
 // If m_dstPath contains a plan '*' it is not replaced.
@@ -322,8 +408,7 @@ bool LLBase::FilterGrep()
 {
     if ( !m_isDir)
     {
-        int flags = m_grepLinePat.flags();
-        if (flags != 0)
+        if (!m_grepLinePat.empty())
         {
             bool match = false;
             size_t lineCnt = 0;
@@ -333,7 +418,7 @@ bool LLBase::FilterGrep()
                 std::string str;
                 while (std::getline(in, str))
                 {
-                    if (std::regex_search(str.begin(), str.end(), m_grepLinePat))
+                    if (m_grepLinePat.Search(str))
                     {
                         return true;
                     }
@@ -429,6 +514,7 @@ bool LLBase::GrepOpt::Parse(const std::string& str)
     //  U(i|b)  Update inplace or make backup.
     //  I ignore case
 	//  R repeat replace
+    //  E(s|d)  Regex engine std::regex or dfa
     char* strPtr = (char*)str.c_str();
     while (*strPtr)
     {
@@ -456,6 +542,11 @@ bool LLBase::GrepOpt::Parse(const std::string& str)
 		case 'R':
 			repeatReplace = true;
 			break;
+        case 'E':   // Es std::regex, Ed dfa, E alone is Es
+            LLRegex::sEngine = (*strPtr == 'd') ? LLRegex::eDfa : LLRegex::eStd;
+            if (*strPtr == 'd' || *strPtr == 's')
+                strPtr++;
+            break;
         case 'H':	// hide
             while (islower(*strPtr))
             {
@@ -36,6 +36,7 @@
 #include "llmsg.h"
 #include "llerrMsgs.h"
 #include "Handle.h"
+#include "llregex.h"
 
 #define HAVE_REGEX
 #include <regex>
@@ -111,6 +112,8 @@ public:
     {
         m_dirScan.m_add_cb  = EntryCb;
         m_dirScan.m_cb_data = this;
+        m_dirScan.m_prune_cb = PruneCb;
+        m_dirScan.m_prune_data = this;      // Not m_cb_data, LLDirSort replaces it.
 
         // sConfigp = &GetConfig();
     }
@@ -147,6 +150,32 @@ public:
         return  pBase->ProcessEntry(pDir, pFileData, depth);
     }
 
+    // Return true to skip directory and its subtree, default skips -X matches.
+    // May be called from parallel scan workers, must not modify members.
+    virtual bool PruneDir(const char* pDir, const WIN32_FIND_DATA* pFileData, int depth) const;
+
+    static bool PruneCb(
+        void* cbData,
+        const char* pDir,
+        const WIN32_FIND_DATA* pFileData,
+        int depth)
+    {
+        const LLBase* pBase = (const LLBase*)cbData;
+        assert(pBase != nullptr);
+        return pBase->PruneDir(pDir, pFileData, depth);
+    }
+
+    static bool AcceptDirCb(
+        void* cbData,
+        const char* pDir,
+        const WIN32_FIND_DATA* pFileData,
+        int depth)
+    {
+        const LLBase* pBase = (const LLBase*)cbData;
+        assert(pBase != nullptr);
+        return pBase->AcceptDir(pDir, pFileData, depth);
+    }
+
     // Common pre-filter, called by client ProcessEntry
     //  Filter on:
     //      m_onlyAttr      File or Directory, -F or -D
@@ -160,6 +189,20 @@ public:
     //  If pass, populate m_srcPath
     bool FilterDir(const char* pDir, const WIN32_FIND_DATA* pFileData, int depth);
 
+    // Same tests as FilterDir without updating m_srcPath or the scan counts,
+    // used to pre-filter entries which FilterDir sees again later (ld -Q sort).
+    bool AcceptDir(const char* pDir, const WIN32_FIND_DATA* pFileData, int depth) const;
+    bool InDepthLimit(int depth) const;
+    bool FilterEntry(const WIN32_FIND_DATA* pFileData, const lstring& srcPath) const;
+    void SetPruneList();
+
+    // File metadata (LLSup::MetaDemand bits) used by FilterDir.
+    unsigned FilterMetaDemand() const noexcept;
+
+    // File metadata used by command, lets ReadFileList skip lookups.
+    virtual unsigned MetaDemand() const
+    { return LLSup::eMetaAll; }
+
     // Increment m_countOut and return true if execeeded output limit.
     bool IsQuit() noexcept
     {
@@ -203,9 +246,10 @@ public:
     LONGLONG            m_onlySize;             // -Z<op><value>
     LLSup::SizeOp       m_onlySizeOp;           //    op=(Greater|Less|Equal) value=num<units G|M|K>, ex -Zg100M
 
-    LLSup::StringList   m_excludeList;          // -X<pathPat>[,<pathPat>
-    LLSup::StringList   m_includeFileList;      // -F[<filePat>][,<filePat>]
-	LLSup::StringList   m_includeDirList;       // -D[<dirPat>][,<dirPat>]
+    LLSup::PatternList  m_excludeList;          // -X<pathPat>[,<pathPat>
+    LLSup::PatternList  m_pruneList;            // -X<pathPat>\* less the \*, see SetPruneList
+    LLSup::PatternList  m_includeFileList;      // -F[<filePat>][,<filePat>]
+	LLSup::PatternList  m_includeDirList;       // -D[<dirPat>][,<dirPat>]
 
     // Example  -TmcEnow        Select if modify or create time Equal to now\n"
     //          -TmG-4.5        Select if modify time Greater than 4.5 hours ago\n"
@@ -249,8 +293,8 @@ public:
     bool                m_byLine;           // true if grep pattern contains ^ or $
     bool                m_backRef;
 
-    std::regex          m_grepSrcPathPat;   // -P=<filePattern>  ex:  -P=\\\\build\\\\.*[.]png 
-    std::regex          m_grepLinePat;      // -G=<fileContentPattern>
+    LLRegex             m_grepSrcPathPat;   // -P=<filePattern>  ex:  -P=\\\\build\\\\.*[.]png 
+    LLRegex             m_grepLinePat;      // -G=<fileContentPattern>
     std::string         m_grepLineStr;
 
     struct GrepOpt
@@ -33,7 +33,8 @@
 #include <iomanip>
 #include <assert.h>
 #include <sstream>
-#include <set>
+#include <algorithm>
+#include <memory>
 
 #define byte win_byte_override  // Fix for c++ v17
 #include <windows.h>
@@ -42,12 +43,16 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <intrin.h>
+#include <immintrin.h>
 
 #include "llcmp.h"
 #include "llpath.h"
 #include "llprintf.h"
 #include "Security.h"
 #include "comma.h"
+#include "MemMapFile.h"
+#include "hashengine.h"
 
 
 // ---------------------------------------------------------------------------
@@ -111,25 +116,38 @@ static const char sHelp[] =
 "   -qp                 ; Hide file compare progress \n"
 "   -Q=n                ; Quit after 'n' lines output\n"
 "   -t                  ; Text compare, ignore white and eol\n"
+"                       ;  with -v or -V=<count> show changed lines like diff,\n"
+"                       ;  up to 'count' lines from each file\n"
 "   -1=<output>         ; Redirect output to file \n"
 "   -,                  ; Disable commas in size and numeric output\n"
 "\n"
 "  !0eFile selection:!0f\n"
 "   -A=[nrhs]           ; Limit files by attribute (n=normal r=readonly, h=hidden, s=system)\n"
 "   -D                  ; Force subdirectories and name to match before comparing\n"
+"   -u                  ; Find duplicate content, any name or directory, empty files ignored\n"
+"                       ;  Groups by size, hash of first and last 64K, then compares\n"
+"                       ;  Use -d=e2 to delete the copies, -j to hash in parallel\n"
 "   -F                  ; Match just the filename, size and date and not its contents\n"
 "   -I=<infile>         ; Read filenames from infile or stdin if -\n"
 "   -r                  ; Recurse directories\n"
+"   -j=<threads>        ; Scan and compare files in parallel, output order unchanged\n"
+"                       ;  Compare is serial when deleting (-d=...)\n"
 "   -l=<levels>         ; Directory levels to include in path matching, default is 30\n"
 "                       ;  Set to small number if files unique and dir trees different \n"
 "   -o=<offset>         ; Start binary file compare at file offset, default is 0 \n"
 "   -X=<pathPat>,...    ; Exclude patterns  -X=*.lib,*.obj,*.exe\n"
 "                       ;  No space in patterns. Pattern applied against fullpath\n"
 "                       ;  So *\\ma will exclude a directory ma or file ma \n"
+"                       ;  Directories matching *\\ma or *\\ma\\* are not scanned \n"
 "   -Z=<op><value>      ; siZe op=(Greater|Less|Equal) value=num<units G|M|K>, ex -Zg100M \n"
 "\n"
 "  !0eSpecial actions:!0f !0c(files to delete are sorted, not argument order)!0f\n"
 "   -h                  ; Show MD5 hash only, no compare \n"
+"   -h=<hash>           ; Show hash md5, xxh3 or crc32c, reports MB/s \n"
+"   -c[=<chunkMB>]      ; Tree hash, hash chunks (default 8MB) on -j threads and show \n"
+"                       ;  hash of chunk digests, -v also shows each chunk digest \n"
+"   -H[=<cacheFile>]    ; Keep MD5 of unchanged files between runs for -h and -u\n"
+"                       ;  default cache file %TEMP%\\llcmp.hcache \n"
 "   -d=e1 | -d=n1       ; Delete matching (-d=e) or not matching files (-d=n) \n"
 "                       ;   -d=e all files, -d=e1 first file, -d=e2 second file \n"
 "   -d=g | -d=l         ; Delete greatest size file or least size file \n"
@@ -148,28 +166,62 @@ LLCmpConfig LLCmp::sConfig;
 DWORD SHARE_ALL = FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE;
 
 // ---------------------------------------------------------------------------
-static bool CmpMatchName(const LLDirEntry* p1, const LLDirEntry* p2, unsigned levels)
+// Last 'levels' directories of entry relative to its scan directory,
+// levels=0 returns empty string so only names are matched.
+static const char* MatchDir(const LLDirEntry* pDirEnt, unsigned levels)
 {
-    bool equal = (_stricmp(p1->filenameLStr, p2->filenameLStr) == 0);
-    if (levels == 0 || !equal)
-        return equal;
-    return (_stricmp(p1->szDir+p1->baseDirLen, p2->szDir+p2->baseDirLen) == 0);
+    const char* pDirBeg = pDirEnt->szDir + pDirEnt->baseDirLen;
+    const char* pDirStr = pDirBeg + strlen(pDirBeg);
+    if (levels == 0)
+        return pDirStr;
+
+    while (pDirStr != pDirBeg)
+    {
+        if (*--pDirStr == '\\' && --levels == 0)
+            break;
+    }
+    return pDirStr;
 }
 
 // ---------------------------------------------------------------------------
-static bool CmpMatchPath(const LLDirEntry* p1, const LLDirEntry* p2, unsigned /* levels */)
+// FNV-1a hash of case-folded name and match directory.
+static size_t MatchHash(const LLDirEntry* pDirEnt, unsigned levels)
 {
-    if (_stricmp(p1->filenameLStr, p2->filenameLStr) == 0)
-    {
-        return (_stricmp(p1->szDir+p1->baseDirLen, p2->szDir+p2->baseDirLen) == 0);
-    }
+    const unsigned char* pLowerFold = CompiledPattern::FoldTable(true);   // Same fold as _stricmp
+
+    size_t hash = 14695981039346656037ULL;
+    for (const char* pStr = pDirEnt->filenameLStr; *pStr != 0; pStr++)
+        hash = (hash ^ pLowerFold[(unsigned char)*pStr]) * 1099511628211ULL;
+    hash *= 1099511628211ULL;     // Name terminator
+    for (const char* pStr = MatchDir(pDirEnt, levels); *pStr != 0; pStr++)
+        hash = (hash ^ pLowerFold[(unsigned char)*pStr]) * 1099511628211ULL;
+    return hash;
+}
 
-    return false;
+// ---------------------------------------------------------------------------
+static bool SameMatch(const LLDirEntry* p1, const LLDirEntry* p2, unsigned levels)
+{
+    return _stricmp(p1->filenameLStr, p2->filenameLStr) == 0
+        && _stricmp(MatchDir(p1, levels), MatchDir(p2, levels)) == 0;
+}
+
+// ---------------------------------------------------------------------------
+static std::string FormatHash(const unsigned char* digest, unsigned digestSize, ULONGLONG totSize)
+{
+    char hex_output[HashEngine::sMaxDigest*2 + 1 + 32];
+    for (unsigned idx = 0; idx < digestSize; ++idx)
+	    sprintf(hex_output + idx * 2, "%02x", digest[idx]);
+
+    sprintf(hex_output + digestSize * 2, ", %8llu,", totSize);
+    return hex_output;
 }
 
 // ---------------------------------------------------------------------------
-// Uses static buffers, not thread safe.
-static const char* DisplayMD4Hash(const char* filePath)
+// Return "hash, size," of file, digest taken from pCache when file is unchanged,
+// pCache must be NULL unless engine is md5. fHnd is opened here unless the
+// caller already has the file open.
+static std::string DisplayHash(const char* filePath, Handle& fHnd, HashEngine& engine,
+    std::vector<Byte>& buffer, HashCache* pCache, ULONGLONG& totSize)
 {
     // Invalid characters in filename -
     //     5 wildcard characters ( *?"<> ), 
@@ -178,7 +230,8 @@ static const char* DisplayMD4Hash(const char* filePath)
     //
     //  \\?\ just bypasses file path processing in the user-mode runtime library, on full path
     // 
-    Handle fHnd = CreateFile(filePath, GENERIC_READ, SHARE_ALL, 0,
+    if (fHnd.NotValid())
+        fHnd = CreateFile(filePath, GENERIC_READ, SHARE_ALL, 0,
             OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN | FILE_FLAG_POSIX_SEMANTICS, 0);
 
     if (fHnd.NotValid()) {
@@ -195,31 +248,290 @@ static const char* DisplayMD4Hash(const char* filePath)
 #endif
     }
 
-    const uint sBufSize = 4096*16;
-    static std::vector<Byte> vBuffer(sBufSize);
-    char* buffer = (char*)vBuffer.data();
+    unsigned char digest[HashEngine::sMaxDigest];
+    totSize = 0;
+    HashCache::Key key;
+    const bool haveKey = (pCache != NULL) && HashCache::GetKey(fHnd, key);
 
-    md5_state_t state;
-    md5_init(&state);
+    if (haveKey && pCache->Lookup(key, HashCache::eFull, digest))
+    {
+        totSize = key.size;
+    }
+    else
+    {
+        const DWORD bufSize = (DWORD)buffer.size();
+        engine.Init();
+
+        DWORD rlen = bufSize;
+        while (rlen == bufSize && 
+            ReadFile(fHnd, buffer.data(), bufSize, &rlen, 0) != 0)
+        {
+            engine.Append(buffer.data(), rlen);
+            totSize += rlen;
+        }
+        engine.Finish(digest);
+
+        if (haveKey && totSize == key.size)
+            pCache->Insert(key, HashCache::eFull, digest);
+    }
+
+    return FormatHash(digest, engine.DigestSize(), totSize);
+}
+
+// ---------------------------------------------------------------------------
+// Small files for -h md5, read whole and hashed together by Md5Batch.
+// Output keeps directory order, Flush before printing any other file.
+class SmallHashBatch
+{
+public:
+    SmallHashBatch(HashCache* pCache) : m_pCache(pCache)
+    { }
+
+    // Return false if file is not small or can't be read. A file that is
+    // not small is left open in fHnd for DisplayHash.
+    bool Add(const char* filePath, Handle& fHnd);
+    bool Full() const
+    { return m_items.size() >= 256 || m_data.size() >= 4 * 1024 * 1024; }
+    // Hash and print pending files.
+    void Flush(ULONGLONG& totSize);
+
+    static const LONGLONG sSmallSize = 64 * 1024;
+
+private:
+    struct Item
+    {
+        std::string     path;
+        size_t          offset;     // in m_data
+        size_t          size;
+        bool            haveKey;
+        bool            cached;
+        HashCache::Key  key;
+        unsigned char   digest[16];
+    };
+
+    HashCache*          m_pCache;
+    std::vector<Item>   m_items;
+    std::vector<Byte>   m_data;
+};
 
-    DWORD totSize = 0;
-    DWORD rlen=sBufSize;
-    while (rlen == sBufSize && 
-        ReadFile(fHnd, buffer, sBufSize, &rlen, 0) != 0)
+// ---------------------------------------------------------------------------
+bool SmallHashBatch::Add(const char* filePath, Handle& fHnd)
+{
+    fHnd = CreateFile(filePath, GENERIC_READ, SHARE_ALL, 0,
+            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN | FILE_FLAG_POSIX_SEMANTICS, 0);
+    LARGE_INTEGER fileSize;
+    if (fHnd.NotValid() || GetFileSizeEx(fHnd, &fileSize) == 0 || fileSize.QuadPart > sSmallSize)
+        return false;
+
+    Item item;
+    item.path = filePath;
+    item.offset = m_data.size();
+    item.size = (size_t)fileSize.QuadPart;
+    item.haveKey = (m_pCache != NULL) && HashCache::GetKey(fHnd, item.key);
+    item.cached = item.haveKey && m_pCache->Lookup(item.key, HashCache::eFull, item.digest);
+
+    if ( !item.cached)
     {
-        md5_append(&state, (const md5_byte_t *)buffer, rlen);
-        totSize += rlen;
+        DWORD rlen = 0;
+        m_data.resize(item.offset + item.size);
+        if (item.size != 0 &&
+            ReadFile(fHnd, m_data.data() + item.offset, (DWORD)item.size, &rlen, 0) == 0)
+        {
+            m_data.resize(item.offset);
+            fHnd.Close();       // DisplayHash opens it again and reports the error.
+            return false;
+        }
+        item.size = rlen;       // File may have shrunk since size taken.
+        m_data.resize(item.offset + rlen);
     }
 
-    md5_byte_t digest[16];
-    md5_finish(&state, digest);
+    m_items.push_back(item);
+    return true;
+}
 
-    static char hex_output[16*2 + 1 + 15];
-    for (int idx = 0; idx < 16; ++idx)
-	    sprintf(hex_output + idx * 2, "%02x", digest[idx]);
+// ---------------------------------------------------------------------------
+void SmallHashBatch::Flush(ULONGLONG& totSize)
+{
+    if (m_items.empty())
+        return;
 
-    sprintf(hex_output + 32, ", %8u,", totSize);
-    return hex_output;
+    std::vector<const unsigned char*> msgData;
+    std::vector<size_t> msgLen;
+    for (const Item& item : m_items)
+    {
+        if ( !item.cached)
+        {
+            msgData.push_back(m_data.data() + item.offset);
+            msgLen.push_back(item.size);
+        }
+    }
+
+    std::vector<Byte> digests(msgData.size() * 16);
+    Md5Batch(msgData.data(), msgLen.data(), msgData.size(), (unsigned char (*)[16])digests.data());
+
+    size_t msgIdx = 0;
+    for (Item& item : m_items)
+    {
+        if ( !item.cached)
+        {
+            memcpy(item.digest, digests.data() + 16 * msgIdx++, 16);
+            if (item.haveKey && item.size == item.key.size)
+                m_pCache->Insert(item.key, HashCache::eFull, item.digest);
+        }
+        LLMsg::Out() << FormatHash(item.digest, 16, item.size) << " " << item.path << std::endl;
+        totSize += item.size;
+    }
+
+    m_items.clear();
+    m_data.clear();
+}
+
+// ---------------------------------------------------------------------------
+// Tree hash, -c=<chunkMB>
+//
+//  File is cut in fixed size chunks which -j workers hash, each with its own
+//  handle. Root is the hash of the chunk digests in file order, so it does
+//  not depend on thread count. An empty file has no chunks.
+
+struct TreeHashWork
+{
+    const char*         filePath;
+    const char*         hashName;
+    ULONGLONG           fileSize;
+    ULONGLONG           chunkSize;
+    LONGLONG            chunkCnt;
+    unsigned            digestSize;
+    bool                disableWow64;
+    std::vector<Byte>&  chunkDigests;
+    volatile LONGLONG   nextChunk;
+    volatile LONG       error;
+};
+
+static DWORD WINAPI TreeHashThread(LPVOID pData)
+{
+    TreeHashWork& work = *(TreeHashWork*)pData;
+
+    // Wow64 redirection is per thread.
+    PVOID oldWow64Redirection = 0;
+    if (work.disableWow64)
+        Wow64DisableWow64FsRedirection(&oldWow64Redirection);
+
+    std::unique_ptr<HashEngine> pEngine(HashEngine::Create(work.hashName));
+    std::vector<Byte> buffer(1024 * 1024);
+    Handle fHnd = CreateFile(work.filePath, GENERIC_READ, SHARE_ALL, 0,
+            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (fHnd.NotValid())
+        InterlockedCompareExchange(&work.error, (LONG)GetLastError(), 0);
+
+    while (work.error == 0)
+    {
+        const LONGLONG chunkIdx = InterlockedIncrement64(&work.nextChunk) - 1;
+        if (chunkIdx >= work.chunkCnt)
+            break;
+
+        LARGE_INTEGER filePos;
+        filePos.QuadPart = chunkIdx * work.chunkSize;
+        ULONGLONG remain = min(work.chunkSize, work.fileSize - filePos.QuadPart);
+        if (SetFilePointerEx(fHnd, filePos, NULL, FILE_BEGIN) == 0)
+        {
+            InterlockedCompareExchange(&work.error, (LONG)GetLastError(), 0);
+            break;
+        }
+
+        pEngine->Init();
+        while (remain != 0)
+        {
+            DWORD rlen = 0;
+            const DWORD want = (DWORD)min(remain, (ULONGLONG)buffer.size());
+            if (ReadFile(fHnd, buffer.data(), want, &rlen, 0) == 0)
+            {
+                InterlockedCompareExchange(&work.error, (LONG)GetLastError(), 0);
+                break;
+            }
+            if (rlen == 0)
+            {
+                // File shrunk since its size was taken.
+                InterlockedCompareExchange(&work.error, ERROR_HANDLE_EOF, 0);
+                break;
+            }
+            pEngine->Append(buffer.data(), rlen);
+            remain -= rlen;
+        }
+        pEngine->Finish(work.chunkDigests.data() + chunkIdx * work.digestSize);
+    }
+
+    if (work.disableWow64)
+        Wow64RevertWow64FsRedirection(oldWow64Redirection);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Print "root, size, file" and with showChunks the digest of each chunk.
+// Return false on error, already reported.
+static bool DisplayTreeHash(const char* filePath, HashEngine& engine, ULONGLONG chunkSize,
+    unsigned threads, bool disableWow64, bool showChunks, ULONGLONG& fileSize)
+{
+    fileSize = 0;
+    {
+        Handle fHnd = CreateFile(filePath, GENERIC_READ, SHARE_ALL, 0, OPEN_EXISTING, 0, 0);
+        LARGE_INTEGER size;
+        if (fHnd.NotValid() || GetFileSizeEx(fHnd, &size) == 0)
+        {
+            LLMsg::PresentError(GetLastError(), "Open failed,", filePath);
+            return false;
+        }
+        fileSize = size.QuadPart;
+    }
+
+    const unsigned digestSize = engine.DigestSize();
+    const LONGLONG chunkCnt = (LONGLONG)((fileSize + chunkSize - 1) / chunkSize);
+    std::vector<Byte> chunkDigests((size_t)chunkCnt * digestSize);
+    TreeHashWork work = { filePath, engine.Name(), fileSize, chunkSize, chunkCnt,
+        digestSize, disableWow64, chunkDigests, 0, 0 };
+
+    std::vector<HANDLE> threadHnds;
+    if (threads > MAXIMUM_WAIT_OBJECTS)
+        threads = MAXIMUM_WAIT_OBJECTS;
+    for (unsigned idx = 0; threads > 1 && idx < threads && (LONGLONG)idx < chunkCnt; idx++)
+    {
+        HANDLE hThread = CreateThread(NULL, 0, TreeHashThread, &work, 0, NULL);
+        if (hThread != NULL)
+            threadHnds.push_back(hThread);
+    }
+
+    if (threadHnds.empty())
+    {
+        TreeHashThread(&work);
+    }
+    else
+    {
+        WaitForMultipleObjects((DWORD)threadHnds.size(), threadHnds.data(), TRUE, INFINITE);
+        for (HANDLE hThread : threadHnds)
+            CloseHandle(hThread);
+    }
+
+    if (work.error != 0)
+    {
+        LLMsg::PresentError(work.error, "Read failed,", filePath);
+        return false;
+    }
+
+    unsigned char root[HashEngine::sMaxDigest];
+    engine.Init();
+    engine.Append(chunkDigests.data(), chunkDigests.size());
+    engine.Finish(root);
+    LLMsg::Out() << FormatHash(root, digestSize, fileSize) << " " << filePath << std::endl;
+
+    if (showChunks)
+    {
+        for (LONGLONG chunkIdx = 0; chunkIdx < chunkCnt; chunkIdx++)
+        {
+            const ULONGLONG chunkPos = chunkIdx * chunkSize;
+            LLMsg::Out() << FormatHash(chunkDigests.data() + chunkIdx * digestSize, digestSize,
+                min(chunkSize, fileSize - chunkPos)) << "   chunk " << chunkIdx << " at " << chunkPos << std::endl;
+        }
+    }
+    return true;
 }
 
 // ---------------------------------------------------------------------------
@@ -231,6 +543,8 @@ LLCmp::LLCmp() :
     m_quiet(false),         // no stats, no color
     m_progress(true),
     m_showMD5hash(false),
+    m_hashName("md5"),
+    m_treeChunkMB(0),
 	m_printFmt("%s"),
 	m_pushArgs("p"),
     m_compareDataMode(eCompareBinary),
@@ -249,6 +563,7 @@ LLCmp::LLCmp() :
     m_delFiles(-1),         // if eq or ne deleting, delete all files in group.
     m_noDel(false)
 {
+    m_pPipe = nullptr;
     m_sizeFile0 = 0;
     m_sizeFileN = 0;
     m_skipCount[0] = m_skipCount[1] = 0;
@@ -260,6 +575,22 @@ LLCmp::LLCmp() :
     sConfigp = &GetConfig();
 }
 
+// ---------------------------------------------------------------------------
+// Save -H cache and report its use.
+void LLCmp::SaveHashCache()
+{
+    if (HashCachePtr() == NULL)
+        return;
+
+    if ( !m_hashCache.Save())
+        ErrorMsg() << "Failed to save hash cache " << m_hashCacheFile << std::endl;
+
+    if ( !m_quiet)
+        LLMsg::Out() << " Hash cache hits:" << m_hashCache.Hits()
+            << ", misses:" << m_hashCache.Misses()
+            << ", entries:" << m_hashCache.Count() << std::endl;
+}
+
 // ---------------------------------------------------------------------------
 LLConfig& LLCmp::GetConfig() 
 {
@@ -338,6 +669,12 @@ int LLCmp::Run(const char* cmdOpts, int argc, const char* pDirs[])
         case 'D':    // force directory and name to match before comparing contents.
             m_matchMode = ePathAndData;
             break;
+        case 'u':    // duplicate content, ignore names and directories.
+            m_matchMode = eDataOnly;
+            m_showEqual = true;
+            m_showDiff = true;
+            m_showSkipLeft = m_showSkipRight = false;
+            break;
         case 'F':   // compare just filename, date and size and not its contents.
                     // -F=<filePat>[,<filePat>]...
             cmdOpts = LLSup::ParseList(cmdOpts+1, m_includeFileList, NULL);
@@ -383,8 +720,28 @@ int LLCmp::Run(const char* cmdOpts, int argc, const char* pDirs[])
             m_showDiff = false;
             m_showSkipLeft = m_showSkipRight = false;
             break;      
-        case 'h':
+        case 'c':   // -c or -c=<chunkMB>, tree hash
+            m_treeChunkMB = 8;
+            cmdOpts = LLSup::ParseNum(cmdOpts+1, m_treeChunkMB, NULL);
+            if (m_treeChunkMB == 0 || m_treeChunkMB > 1024)
+            {
+                ErrorMsg() << "Tree hash chunk must be 1 to 1024 MB, -c=<chunkMB>\n";
+                return sError;
+            }
+            m_showMD5hash = true;
+            break;
+        case 'h':   // -h or -h=<hashName>
             m_showMD5hash = true;
+            cmdOpts = LLSup::ParseString(cmdOpts+1, m_hashName, NULL);
+            break;
+        case 'H':   // -H or -H=<cacheFile>
+            cmdOpts = LLSup::ParseString(cmdOpts+1, m_hashCacheFile, NULL);
+            if (m_hashCacheFile.empty())
+            {
+                char tmpDir[MAX_PATH];
+                DWORD tmpLen = GetTempPath(ARRAYSIZE(tmpDir), tmpDir);
+                m_hashCacheFile = std::string(tmpDir, (tmpLen < ARRAYSIZE(tmpDir)) ? tmpLen : 0) + "llcmp.hcache";
+            }
             break;
         case 'q':
 			if (cmdOpts[1] == 'p')
@@ -445,7 +802,8 @@ int LLCmp::Run(const char* cmdOpts, int argc, const char* pDirs[])
         LLSup::AdvCmd(cmdOpts);
     }
 
-    m_dirSort.SetSort(m_dirScan, "n", false, true);
+    // Duplicate search groups by size, keep just the size column.
+    m_dirSort.SetSort(m_dirScan, (m_matchMode == eDataOnly) ? "s" : "n", false, true);
     m_dirSort.SetSortAttr(FILE_ATTRIBUTE_NORMAL | FILE_ATTRIBUTE_ARCHIVE);  // Only show files.
     m_dirSort.SetSortData(m_compareDataMode == eCompareSpecs);
 
@@ -469,27 +827,13 @@ int LLCmp::Run(const char* cmdOpts, int argc, const char* pDirs[])
         m_dirScan.GetFilesInDirectory();
     }
 
-    if (m_showMD5hash)
-    {
-        char filePath[LL_MAX_PATH];
-        unsigned fileIdx = 0;
-        LLDirEntry*  pDirEntry = m_dirSort.m_pFirst;
-        LLMsg::Out() << "                             MD5, FileSize, File\n";
-        while (pDirEntry)
-        {
-			sprintf_s(filePath, ARRAYSIZE(filePath), "%s\\%s", pDirEntry->szDir, pDirEntry->filenameLStr);
-            if ( !LLSup::PatternListMatches(m_excludeList, filePath) &&
-				LLSup::PatternListMatches(m_includeFileList, pDirEntry->filenameLStr, true) &&
-                LLSup::CompareRhsBits(pDirEntry->dwFileAttributes, m_onlyRhs))
-            {
-                LLMsg::Out() << DisplayMD4Hash(filePath) << " " << filePath << std::endl;
-            }
-            pDirEntry = pDirEntry->pNext;
-            fileIdx++;
-        }
+    m_dirSort.Sort();
 
-        return 0;
-    }
+    if ( !m_hashCacheFile.empty())
+        m_hashCache.Load(m_hashCacheFile.c_str());
+
+    if (m_showMD5hash)
+        return HashFiles();
 
     try
     {
@@ -498,10 +842,11 @@ int LLCmp::Run(const char* cmdOpts, int argc, const char* pDirs[])
         switch (m_matchMode)
         {
         case eNameAndData:
-            DoCmp(CmpMatchName);
+        case eDataOnly:
+            DoCmp(m_levels);
             break;
         case ePathAndData:
-            DoCmp(CmpMatchPath);
+            DoCmp(UINT_MAX);    // Entire relative directory.
             break;
         }
     }
@@ -550,6 +895,8 @@ int LLCmp::Run(const char* cmdOpts, int argc, const char* pDirs[])
         LLMsg::Out() << " " << dirScaned  << std::endl;
     }
 
+    SaveHashCache();
+
     // Decide what to exit code to return, see -E=<opts> command.
     //      -Ee = return #equal
     //      -Ed = return #diff
@@ -584,6 +931,84 @@ int LLCmp::Run(const char* cmdOpts, int argc, const char* pDirs[])
 	return ExitStatus(retValue);
 }
 
+// ---------------------------------------------------------------------------
+// Hash sorted files, -h=<name> and -c=<chunkMB>. Return 0 or sError.
+int LLCmp::HashFiles()
+{
+    std::unique_ptr<HashEngine> pEngine(HashEngine::Create(m_hashName.c_str()));
+    if ( !pEngine)
+    {
+        ErrorMsg() << "Unknown hash " << m_hashName << ", use -h=" << HashEngine::sNames << std::endl;
+        return sError;
+    }
+
+    // Cache only holds md5 digests, small md5 files are hashed in batches.
+    const bool isMd5 = (strcmp(pEngine->Name(), "md5") == 0) && m_treeChunkMB == 0;
+    HashCache* pCache = isMd5 ? HashCachePtr() : NULL;
+    SmallHashBatch batch(pCache);
+    std::vector<Byte> buffer(1024 * 1024);
+    ULONGLONG fileSize;
+    ULONGLONG totSize = 0;
+    size_t hashCnt = 0;
+    DWORD startTick = GetTickCount();
+
+    std::string title = pEngine->Name();
+    for (char& chr : title)
+        chr = ToUpper(chr);
+    char filePath[LL_MAX_PATH];
+    unsigned fileIdx = 0;
+    LLDirEntry*  pDirEntry = m_dirSort.m_pFirst;
+    if (m_treeChunkMB != 0)
+        title += " TREE/" + std::to_string(m_treeChunkMB) + "M";
+    LLMsg::Out() << std::setw(pEngine->DigestSize() * 2) << title << ", FileSize, File\n";
+    while (pDirEntry)
+    {
+        if (AcceptCmpEntry(pDirEntry))
+        {
+            sprintf_s(filePath, ARRAYSIZE(filePath), "%s\\%s", pDirEntry->szDir, pDirEntry->filenameLStr);
+            hashCnt++;
+            if (m_treeChunkMB != 0)
+            {
+                if (DisplayTreeHash(filePath, *pEngine, m_treeChunkMB * 1024ULL * 1024, m_dirScan.m_threads,
+                        m_dirScan.m_disableWow64Redirection, m_verbose, fileSize))
+                    totSize += fileSize;
+                else
+                    m_errorCount++;
+            }
+            else
+            {
+                Handle fHnd;
+                if (isMd5 && batch.Add(filePath, fHnd))
+                {
+                    if (batch.Full())
+                        batch.Flush(totSize);
+                }
+                else
+                {
+                    batch.Flush(totSize);
+                    LLMsg::Out() << DisplayHash(filePath, fHnd, *pEngine, buffer, pCache, fileSize) << " " << filePath << std::endl;
+                    totSize += fileSize;
+                }
+            }
+        }
+        pDirEntry = pDirEntry->pNext;
+        fileIdx++;
+    }
+    batch.Flush(totSize);
+
+    if ( !m_quiet)
+    {
+        DWORD mseconds = GetTickCount() - startTick;
+        LLMsg::Out() << "\n Hashed Files:" << hashCnt << ", Bytes:" << totSize;
+        if (mseconds != 0)
+            LLMsg::Out() << ", Files/s:" << hashCnt * 1000 / mseconds
+                << ", MB/s:" << totSize / 1000 / mseconds;
+        LLMsg::Out() << " (" << pEngine->Name() << ")" << std::endl;
+    }
+    SaveHashCache();
+    return 0;
+}
+
 // ---------------------------------------------------------------------------
 static bool GetFileSizeLL(Handle& hnd, LONGLONG& fileSizeLL)
 {
@@ -598,165 +1023,1138 @@ static bool GetFileSizeLL(Handle& hnd, LONGLONG& fileSizeLL)
 }
 
 // ---------------------------------------------------------------------------
-// return:  -2 skip, -1 error, 0 identical, 1 differ
-LLCmp::CompareResult LLCmp::CompareDataBinary(
-        const char* filePath1,
-        const char* filePath2,
-        LLCmp::CompareInfo& compareInfo,
-        unsigned quitAfter,
-        std::ostream& wout)
+// Open file for compare, retries while server is out of memory.
+static HANDLE OpenCmpFile(const char* filePath)
 {
-    compareInfo.differAt = 0;
-    compareInfo.diffCnt = 0;
-
-    struct _stat statResult;
-    if (0 == _stat(filePath1, &statResult) && (statResult.st_mode & _S_IFREG) != _S_IFREG)
-        return eCmpEqual;   // Can only compare files, return as if identical.
-
     const unsigned sMaxRetry = 10;
-    Handle f1;
-
+    HANDLE hFile = INVALID_HANDLE_VALUE;
     for (unsigned retry = 0; retry != sMaxRetry; retry++)
     {
-        f1 = CreateFile(filePath1, GENERIC_READ, SHARE_ALL, 0,
+        hFile = CreateFile(filePath, GENERIC_READ, SHARE_ALL, 0,
                 OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
-        if (f1.NotValid() && GetLastError() == ERROR_NOT_ENOUGH_SERVER_MEMORY)
+        if (hFile == INVALID_HANDLE_VALUE && GetLastError() == ERROR_NOT_ENOUGH_SERVER_MEMORY)
             Sleep(1000 * retry);
         else
-            break;;
+            break;
     }
+    return hFile;
+}
 
-    if (f1.NotValid())
+// ---------------------------------------------------------------------------
+// Binary compare kernel
+//
+//  FirstDiff finds the first differing byte and CountDiffs counts differing
+//  bytes, 32 bytes per step with AVX2 when the cpu and os support it, else
+//  16 with SSE2, else a word at a time.
+
+#if defined(_M_IX86) || defined(_M_X64)
+static bool HaveAvx2()
+{
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    // AVX2 needs os support for saving ymm registers.
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if ( !osxsave || !avx || (_xgetbv(0) & 6) != 6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+}
+
+static const bool sHaveAvx2 = HaveAvx2();
+
+// ---------------------------------------------------------------------------
+// Return offset of first differing 32 byte block, or of the tail.
+static size_t FirstDiffAvx2(const Byte* p1, const Byte* p2, size_t len)
+{
+    size_t idx = 0;
+    for ( ; idx + 32 <= len; idx += 32)
     {
-        LLMsg::PresentError(GetLastError(), "Open failed,", filePath1);
-        return eCmpErr;
+        __m256i eq = _mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i*)(p1 + idx)),
+            _mm256_loadu_si256((const __m256i*)(p2 + idx)));
+        if ((unsigned)_mm256_movemask_epi8(eq) != 0xffffffff)
+            break;
     }
+    _mm256_zeroupper();
+    return idx;
+}
 
-    Handle f2;
-    for (unsigned retry = 0; retry != sMaxRetry; retry++)
+// ---------------------------------------------------------------------------
+// Return offset of first differing 16 byte block, or of the tail.
+static size_t FirstDiffSse2(const Byte* p1, const Byte* p2, size_t len)
+{
+    size_t idx = 0;
+    for ( ; idx + 16 <= len; idx += 16)
     {
-        f2 = CreateFile(filePath2, GENERIC_READ, SHARE_ALL, 0,
-                OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
-        if (f2.NotValid() && GetLastError() == ERROR_NOT_ENOUGH_SERVER_MEMORY)
-            Sleep(1000 * retry);
-        else
+        __m128i eq = _mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i*)(p1 + idx)),
+            _mm_loadu_si128((const __m128i*)(p2 + idx)));
+        if (_mm_movemask_epi8(eq) != 0xffff)
             break;
     }
+    return idx;
+}
 
-    if (f2.NotValid())
+// ---------------------------------------------------------------------------
+// Count equal bytes in whole 32 byte blocks, idx set to start of tail.
+static size_t CountEqualAvx2(const Byte* p1, const Byte* p2, size_t len, size_t& idx)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i sums = zero;
+    for (idx = 0; idx + 32 <= len; )
     {
-        LLMsg::PresentError(GetLastError(), "Open failed,", filePath2);
-        // CloseHandle(f1);
-        return eCmpErr;
+        // Byte counters hold at most 255 blocks before summing.
+        const size_t blockEnd = min((len & ~(size_t)31), idx + 255 * 32);
+        __m256i counts = zero;
+        for ( ; idx < blockEnd; idx += 32)
+        {
+            __m256i eq = _mm256_cmpeq_epi8(
+                _mm256_loadu_si256((const __m256i*)(p1 + idx)),
+                _mm256_loadu_si256((const __m256i*)(p2 + idx)));
+            counts = _mm256_sub_epi8(counts, eq);
+        }
+        sums = _mm256_add_epi64(sums, _mm256_sad_epu8(counts, zero));
     }
 
-    CompareResult result = eCmpDiff;
-    if ( !GetFileSizeLL(f1, compareInfo.fileSize1))
-        result = eCmpErr;
-
-    if ( !GetFileSizeLL(f2, compareInfo.fileSize2))
-        result = eCmpErr;
+    ULONGLONG lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, sums);
+    _mm256_zeroupper();
+    return (size_t)(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+}
 
-    if (result != eCmpErr)
+// ---------------------------------------------------------------------------
+// Count equal bytes in whole 16 byte blocks, idx set to start of tail.
+static size_t CountEqualSse2(const Byte* p1, const Byte* p2, size_t len, size_t& idx)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sums = zero;
+    for (idx = 0; idx + 16 <= len; )
     {
-        result = (compareInfo.fileSize1 == compareInfo.fileSize2) ? eCmpEqual : eCmpDiff;
-        if (m_verbose &&  result != 0)
-            wout << " File sizes differ: " << compareInfo.fileSize1 << " != "
-                << compareInfo.fileSize2 << std::endl;
+        const size_t blockEnd = min((len & ~(size_t)15), idx + 255 * 16);
+        __m128i counts = zero;
+        for ( ; idx < blockEnd; idx += 16)
+        {
+            __m128i eq = _mm_cmpeq_epi8(
+                _mm_loadu_si128((const __m128i*)(p1 + idx)),
+                _mm_loadu_si128((const __m128i*)(p2 + idx)));
+            counts = _mm_sub_epi8(counts, eq);
+        }
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(counts, zero));
     }
 
-    if (result == eCmpEqual)
+    ULONGLONG lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, sums);
+    return (size_t)(lanes[0] + lanes[1]);
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Return offset of first differing byte, len if equal.
+static size_t FirstDiff(const Byte* p1, const Byte* p2, size_t len)
+{
+    size_t idx = 0;
+#if defined(_M_IX86) || defined(_M_X64)
+    idx = sHaveAvx2 ? FirstDiffAvx2(p1, p2, len) : FirstDiffSse2(p1, p2, len);
+#endif
+    for ( ; idx + sizeof(ULONGLONG) <= len; idx += sizeof(ULONGLONG))
     {
-        if ( !SizeOperation(compareInfo.fileSize1, m_onlySizeOp, m_onlySize))
-            result = eCmpSkip;
-        if ( !SizeOperation(compareInfo.fileSize2, m_onlySizeOp, m_onlySize))
-            result = eCmpSkip;
+        ULONGLONG word1, word2;
+        memcpy(&word1, p1 + idx, sizeof(word1));
+        memcpy(&word2, p2 + idx, sizeof(word2));
+        if (word1 != word2)
+            break;
     }
+    while (idx < len && p1[idx] == p2[idx])
+        idx++;
+    return idx;
+}
 
-    if (result == eCmpEqual)
+// ---------------------------------------------------------------------------
+// Return offset of last differing byte, len if equal.
+static size_t LastDiff(const Byte* p1, const Byte* p2, size_t len)
+{
+    size_t end = len;
+    while (end >= sizeof(ULONGLONG))
+    {
+        ULONGLONG word1, word2;
+        memcpy(&word1, p1 + end - sizeof(ULONGLONG), sizeof(word1));
+        memcpy(&word2, p2 + end - sizeof(ULONGLONG), sizeof(word2));
+        if (word1 != word2)
+            break;
+        end -= sizeof(ULONGLONG);
+    }
+    while (end != 0)
+    {
+        end--;
+        if (p1[end] != p2[end])
+            return end;
+    }
+    return len;
+}
+
+// ---------------------------------------------------------------------------
+// Return number of differing bytes.
+static size_t CountDiffs(const Byte* p1, const Byte* p2, size_t len)
+{
+    size_t idx = 0;
+    size_t diffs = 0;
+#if defined(_M_IX86) || defined(_M_X64)
+    const size_t equal = sHaveAvx2 ? CountEqualAvx2(p1, p2, len, idx) : CountEqualSse2(p1, p2, len, idx);
+    diffs = idx - equal;
+#endif
+    for ( ; idx + sizeof(ULONGLONG) <= len; idx += sizeof(ULONGLONG))
+    {
+        ULONGLONG word1, word2;
+        memcpy(&word1, p1 + idx, sizeof(word1));
+        memcpy(&word2, p2 + idx, sizeof(word2));
+
+        // Fold each byte of xor to its low bit, then add the low bits.
+        ULONGLONG diff = word1 ^ word2;
+        diff |= diff >> 4;
+        diff |= diff >> 2;
+        diff |= diff >> 1;
+        diff &= 0x0101010101010101ULL;
+        diffs += (size_t)((diff * 0x0101010101010101ULL) >> 56);
+    }
+    for ( ; idx < len; idx++)
+        diffs += (p1[idx] != p2[idx]);
+    return diffs;
+}
+
+// ---------------------------------------------------------------------------
+// Compare block at filePos. Stops at the first difference unless verbose,
+// which shows the first quitAfter differences and counts all of them per 1%
+// of the file in whereCnt.
+void LLCmp::CompareBlock(
+        const Byte* p1,
+        const Byte* p2,
+        size_t len,
+        LONGLONG filePos,
+        unsigned& quitAfter,
+        LLCmp::CompareInfo& compareInfo,
+        std::ostream& wout) const
+{
+    if ( !m_verbose)
+    {
+        const size_t idx = FirstDiff(p1, p2, len);
+        if (idx != len)
+        {
+            compareInfo.diffCnt++;
+            compareInfo.differAt = filePos + idx;
+        }
+        return;
+    }
+
+    // Tiny files have whereSize 0, keep bucket in range.
+    const LONGLONG whereSize = max(compareInfo.fileSize2 / 100, 1LL);
+    auto whereIdx = [whereSize](LONGLONG pos)
+    { return (unsigned)min(pos / whereSize, 99LL); };
+
+    size_t idx = 0;
+    while (quitAfter != 0 && idx < len)
+    {
+        idx += FirstDiff(p1 + idx, p2 + idx, len - idx);
+        if (idx == len)
+            break;
+
+        compareInfo.differAt = filePos + idx;
+        compareInfo.diffCnt++;
+        compareInfo.whereCnt[whereIdx(compareInfo.differAt)]++;
+
+        quitAfter--;
+        wout << "Differ at: " <<  filePos + idx
+            << " Data: "
+            << std::setw(3) << (unsigned)p1[idx] << " != "
+            << std::setw(3) << (unsigned)p2[idx]
+            << std::endl;
+        idx++;
+    }
+
+    // Count remaining differences a 1% bucket at a time.
+    size_t lastBeg = 0;
+    size_t lastLen = 0;     // Last segment with differences
+    while (idx < len)
+    {
+        const LONGLONG pos = filePos + idx;
+        const unsigned where = whereIdx(pos);
+        size_t segLen = len - idx;
+        if (where < 99)
+            segLen = (size_t)min((LONGLONG)segLen, (where + 1) * whereSize - pos);
+
+        const size_t diffs = CountDiffs(p1 + idx, p2 + idx, segLen);
+        if (diffs != 0)
+        {
+            compareInfo.diffCnt += (ULONG)diffs;
+            compareInfo.whereCnt[where] += (DWORD)diffs;
+            lastBeg = idx;
+            lastLen = segLen;
+        }
+        idx += segLen;
+    }
+
+    if (lastLen != 0)
+        compareInfo.differAt = filePos + lastBeg + LastDiff(p1 + lastBeg, p2 + lastBeg, lastLen);
+}
+
+// ---------------------------------------------------------------------------
+// CompareBlock on mapped views. Files are opened with full sharing, so they
+// can be truncated or their share can drop while mapped, and touching a page
+// then raises EXCEPTION_IN_PAGE_ERROR. Return false if that happens.
+// No C++ objects here, __try can't unwind them.
+bool LLCmp::CompareView(
+        const Byte* p1,
+        const Byte* p2,
+        size_t len,
+        LONGLONG filePos,
+        unsigned& quitAfter,
+        LLCmp::CompareInfo& compareInfo,
+        std::ostream& wout) const
+{
+    __try
+    {
+        CompareBlock(p1, p2, len, filePos, quitAfter, compareInfo, wout);
+    }
+    __except (GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR
+        ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH)
+    {
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// return:  -2 skip, -1 error, 0 identical, 1 differ
+LLCmp::CompareResult LLCmp::CompareDataBinary(
+        const char* filePath1,
+        const char* filePath2,
+        LLCmp::CompareInfo& compareInfo,
+        unsigned quitAfter,
+        std::ostream& wout)
+{
+    compareInfo.differAt = 0;
+    compareInfo.diffCnt = 0;
+
+    struct _stat statResult;
+    if (0 == _stat(filePath1, &statResult) && (statResult.st_mode & _S_IFREG) != _S_IFREG)
+        return eCmpEqual;   // Can only compare files, return as if identical.
+
+    Handle f1 = OpenCmpFile(filePath1);
+    if (f1.NotValid())
+    {
+        compareInfo.openError = GetLastError();
+        compareInfo.openErrorFile = 1;
+        return eCmpErr;
+    }
+
+    Handle f2 = OpenCmpFile(filePath2);
+    if (f2.NotValid())
+    {
+        compareInfo.openError = GetLastError();
+        compareInfo.openErrorFile = 2;
+        // CloseHandle(f1);
+        return eCmpErr;
+    }
+
+    CompareResult result = eCmpDiff;
+    if ( !GetFileSizeLL(f1, compareInfo.fileSize1))
+        result = eCmpErr;
+
+    if ( !GetFileSizeLL(f2, compareInfo.fileSize2))
+        result = eCmpErr;
+
+    if (result != eCmpErr)
+    {
+        result = (compareInfo.fileSize1 == compareInfo.fileSize2) ? eCmpEqual : eCmpDiff;
+        if (m_verbose &&  result != 0)
+            wout << " File sizes differ: " << compareInfo.fileSize1 << " != "
+                << compareInfo.fileSize2 << std::endl;
+    }
+
+    if (result == eCmpEqual)
+    {
+        if ( !SizeOperation(compareInfo.fileSize1, m_onlySizeOp, m_onlySize))
+            result = eCmpSkip;
+        if ( !SizeOperation(compareInfo.fileSize2, m_onlySizeOp, m_onlySize))
+            result = eCmpSkip;
+    }
+
+    if (result == eCmpEqual)
     {
-        DWORD whereSize = DWORD(compareInfo.fileSize2 / 100);
         memset(compareInfo.whereCnt, 0, sizeof(compareInfo.whereCnt));
 
-        const uint sBufSize = 4096*16;
-        Byte buffer1[sBufSize];
-        Byte buffer2[sBufSize];
+        // Compare mapped windows of both files, no copy into buffers. Falls
+        // back to reading at filePos if the files or a window can't be mapped,
+        // or a window's pages can't be read in.
+        const LONGLONG sMapWindow = 32*1024*1024;
+        LONGLONG filePos = m_offset;
+        MemMapFile map1, map2;
+        bool mapped = (filePos < compareInfo.fileSize1) && map1.Open(f1) && map2.Open(f2);
+        while (mapped && (compareInfo.diffCnt == 0 || m_verbose) && filePos < compareInfo.fileSize1)
+        {
+            SIZE_T viewLen1 = (SIZE_T)min(sMapWindow, compareInfo.fileSize1 - filePos);
+            SIZE_T viewLen2 = viewLen1;
+            const size_t len = viewLen1;
+            const Byte* p1 = (const Byte*)map1.MapView(filePos, viewLen1);
+            const Byte* p2 = (const Byte*)map2.MapView(filePos, viewLen2);
+            if (p1 == NULL || p2 == NULL)
+            {
+                mapped = false;
+                break;
+            }
+
+            // Window is compared again by ReadFile if it faults, undo its counts.
+            const LLCmp::CompareInfo windowInfo = compareInfo;
+            const unsigned windowQuit = quitAfter;
+            if ( !CompareView(p1, p2, len, filePos, quitAfter, compareInfo, wout))
+            {
+                compareInfo = windowInfo;
+                quitAfter = windowQuit;
+                mapped = false;
+                break;
+            }
+            filePos += len;
+
+            if (m_progress && m_pPipe == nullptr && compareInfo.fileSize1 > 1024*1024)
+                std::cerr << std::fixed << std::setw(6) << std::setprecision(2)
+                    << (filePos * 100.0) /  compareInfo.fileSize1 << " %\r";
+        }
+        map1.Close();
+        map2.Close();
+
         DWORD rlen1=0, rlen2=0;
+        if ( !mapped && (compareInfo.diffCnt == 0 || m_verbose))
+        {
+            // Heap buffers sized to the file, up to 1MB, fewer reads on large files
+            // and small stacks on ComparePipe workers.
+            const LONGLONG sMaxBufSize = 1024*1024;
+            const DWORD bufSize = (DWORD)((compareInfo.fileSize1 < sMaxBufSize)
+                ? (compareInfo.fileSize1 | 4095) + 1 : sMaxBufSize);
+            std::unique_ptr<Byte[]> buffers(new Byte[bufSize * 2]);
+            Byte* buffer1 = buffers.get();
+            Byte* buffer2 = buffer1 + bufSize;
+
+            if (filePos != 0)
+            {
+                DWORD moved = 0;
+                LARGE_INTEGER fileOffset;
+                fileOffset.QuadPart = filePos;
+                SetFilePointer(f1, fileOffset.LowPart, &fileOffset.HighPart, moved);
+                fileOffset.QuadPart = filePos;
+                SetFilePointer(f2, fileOffset.LowPart, &fileOffset.HighPart, moved);
+            }
+
+            while (
+                (compareInfo.diffCnt == 0 || m_verbose) &&
+                ReadFile(f1, buffer1, bufSize, &rlen1, 0) != 0 &&
+                ReadFile(f2, buffer2, bufSize, &rlen2, 0) != 0 &&
+                rlen1 == rlen2 &&
+                rlen1 != 0)
+            {
+                CompareBlock(buffer1, buffer2, rlen1, filePos, quitAfter, compareInfo, wout);
+                filePos += rlen1;
+
+                if (m_progress && m_pPipe == nullptr && compareInfo.fileSize1 > 1024*1024)
+                    std::cerr << std::fixed << std::setw(6) << std::setprecision(2)
+                        << (filePos * 100.0) /  compareInfo.fileSize1 << " %\r";
+            }
+        }
+
+        result = (rlen1 == rlen2 && compareInfo.diffCnt == 0) ? eCmpEqual : eCmpDiff;
+    }
+
+    // CloseHandle(f1);
+    // CloseHandle(f2);
+
+    return result;
+}
+
+
+// ---------------------------------------------------------------------------
+// Text compare engine
+//
+//  Each file is read once through mapped windows and every line is reduced
+//  to a 64-bit hash of its bytes less IgnoreChar bytes, scanning 16 bytes a
+//  step for line ends and ignored bytes. The line hashes are then diffed with
+//  Myers' linear space algorithm, so inserted or deleted lines are reported
+//  as hunks instead of misaligning the rest of the file.
+
+struct TextLines
+{
+    std::vector<ULONGLONG>  hashes;
+    std::vector<ULONGLONG>  starts;     // File offset of each line, plus end of file.
+};
+
+class LineHasher
+{
+public:
+    LineHasher(const IgnoreChar& ignoreChar, TextLines& lines) :
+        m_lines(lines), m_simdCnt(0)
+    {
+        for (unsigned chr = 0; chr < 256; chr++)
+        {
+            m_kind[chr] = (chr == '\n') ? eEol : (ignoreChar.m_charSet[chr] ? eIgnore : eKeep);
+            if (m_kind[chr] != eKeep && m_simdCnt <= sMaxSimdChars)
+            {
+                if (m_simdCnt < sMaxSimdChars)
+                    m_simdChars[m_simdCnt] = (Byte)chr;
+                m_simdCnt++;
+            }
+        }
+        m_lines.hashes.clear();
+        m_lines.starts.assign(1, 0);
+        m_lineStart = 0;
+        m_stageLen = 0;
+        StartLine();
+    }
+
+    void Add(const Byte* pData, size_t len, ULONGLONG filePos)
+    {
+        // Local stage length, stage stores could alias a member.
+        size_t stageLen = m_stageLen;
+        size_t idx = 0;
+#if defined(_M_IX86) || defined(_M_X64)
+        if (m_simdCnt <= sMaxSimdChars)
+        {
+            // Unused compare slots repeat '\n'.
+            __m128i special[sMaxSimdChars];
+            for (unsigned slot = 0; slot < sMaxSimdChars; slot++)
+                special[slot] = _mm_set1_epi8((char)((slot < m_simdCnt) ? m_simdChars[slot] : '\n'));
+
+            // Runs are copied 16 bytes at a time, stop a block early so
+            // copies never read past the data.
+            for ( ; idx + 32 <= len; idx += 16)
+            {
+                const __m128i data = _mm_loadu_si128((const __m128i*)(pData + idx));
+                const __m128i hit = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(data, special[0]), _mm_cmpeq_epi8(data, special[1])),
+                    _mm_or_si128(_mm_cmpeq_epi8(data, special[2]), _mm_cmpeq_epi8(data, special[3])));
+                unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+
+                // Compact kept bytes into the stage without branching on run
+                // length, each copy is 16 bytes but the stage end only
+                // advances by the run length.
+                unsigned pos = 0;
+                while (mask != 0)
+                {
+                    unsigned long bit;
+                    _BitScanForward(&bit, mask);
+                    mask &= mask - 1;
+                    memcpy(m_stage + stageLen, pData + idx + pos, 16);
+                    stageLen += bit - pos;
+                    if (m_kind[pData[idx + bit]] == eEol)
+                        EndLine(stageLen, filePos + idx + bit + 1);
+                    pos = bit + 1;
+                }
+                memcpy(m_stage + stageLen, pData + idx + pos, 16);
+                stageLen += 16 - pos;
+                if (stageLen >= sStageSize)
+                    FlushWords(stageLen);
+            }
+        }
+#endif
+        for ( ; idx < len; idx++)
+        {
+            switch (m_kind[pData[idx]])
+            {
+            case eKeep:
+                m_stage[stageLen++] = pData[idx];
+                if (stageLen >= sStageSize)
+                    FlushWords(stageLen);
+                break;
+            case eIgnore:
+                break;
+            case eEol:
+                EndLine(stageLen, filePos + idx + 1);
+                break;
+            }
+        }
+        m_stageLen = stageLen;
+    }
+
+    // Last line need not end with '\n'.
+    void Finish(ULONGLONG fileSize)
+    {
+        if (m_lineStart < fileSize)
+            EndLine(m_stageLen, fileSize);
+    }
+
+private:
+    enum Kind { eKeep, eIgnore, eEol };
+    static const unsigned sMaxSimdChars = 4;
+    static const size_t sStageSize = 4096;
+
+    void StartLine()
+    {
+        m_hash = 0x243F6A8885A308D3ULL;
+        m_len = 0;
+    }
+
+    void Mix(ULONGLONG word)
+    {
+        m_hash = (m_hash ^ word) * 0x9E3779B97F4A7C15ULL;
+        m_hash ^= m_hash >> 29;
+    }
+
+    // Hash whole words of the stage, kept bytes are hashed 8 at a time so
+    // the hash depends only on the kept bytes and not on where ignored
+    // bytes fell.
+    void FlushWords(size_t& stageLen)
+    {
+        const size_t words = stageLen / 8;
+        for (size_t word = 0; word < words; word++)
+        {
+            ULONGLONG value;
+            memcpy(&value, m_stage + word * 8, sizeof(value));
+            Mix(value);
+        }
+        m_len += words * 8;
+        stageLen -= words * 8;
+        memmove(m_stage, m_stage + words * 8, stageLen);
+    }
+
+    void EndLine(size_t& stageLen, ULONGLONG nextStart)
+    {
+        FlushWords(stageLen);
+        ULONGLONG tail = 0;
+        memcpy(&tail, m_stage, stageLen);
+        Mix(tail);
+        Mix(m_len + stageLen);
+        stageLen = 0;
+        m_lines.hashes.push_back(m_hash);
+        m_lines.starts.push_back(nextStart);
+        m_lineStart = nextStart;
+        StartLine();
+    }
+
+    TextLines&  m_lines;
+    Byte        m_kind[256];
+    Byte        m_simdChars[sMaxSimdChars];
+    unsigned    m_simdCnt;
+    ULONGLONG   m_lineStart;
+    ULONGLONG   m_hash;
+    ULONGLONG   m_len;          // Kept bytes hashed
+    size_t      m_stageLen;     // Kept bytes waiting in m_stage
+    Byte        m_stage[sStageSize + 32];
+};
+
+// ---------------------------------------------------------------------------
+// Hash lines of file through mapped windows, reads what can't be mapped.
+// Return false on read error.
+static bool HashTextFile(HANDLE hFile, LONGLONG fileSize, LineHasher& hasher)
+{
+    const LONGLONG sMapWindow = 32*1024*1024;
+    LONGLONG filePos = 0;
+    MemMapFile mapFile;
+    bool mapped = (fileSize != 0) && mapFile.Open(hFile);
+    while (mapped && filePos < fileSize)
+    {
+        SIZE_T viewLen = (SIZE_T)min(sMapWindow, fileSize - filePos);
+        const size_t len = viewLen;
+        const Byte* pData = (const Byte*)mapFile.MapView(filePos, viewLen);
+        if (pData == NULL)
+            break;
+        hasher.Add(pData, len, filePos);
+        filePos += len;
+    }
+    mapFile.Close();
+
+    if (filePos < fileSize)
+    {
+        LARGE_INTEGER fileOffset;
+        fileOffset.QuadPart = filePos;
+        if (SetFilePointerEx(hFile, fileOffset, NULL, FILE_BEGIN) != 0)
+        {
+            const DWORD sBufSize = 1024*1024;
+            std::unique_ptr<Byte[]> buffer(new Byte[sBufSize]);
+            DWORD rlen = 0;
+            while (filePos < fileSize &&
+                ReadFile(hFile, buffer.get(), sBufSize, &rlen, 0) != 0 && rlen != 0)
+            {
+                hasher.Add(buffer.get(), rlen, filePos);
+                filePos += rlen;
+            }
+        }
+    }
+
+    hasher.Finish(filePos);
+    return filePos >= fileSize;
+}
+
+// ---------------------------------------------------------------------------
+// Kept bytes of a file, line by line on the line starts LineHasher found,
+// read sequentially.
+class KeptByteReader
+{
+public:
+    static const int sEndLine = -1;
+    static const int sEndFile = -2;
+
+    KeptByteReader(HANDLE hFile, const TextLines& lines, const IgnoreChar& ignoreChar) :
+        m_hFile(hFile), m_starts(lines.starts), m_ignoreChar(ignoreChar),
+        m_buffer(new Byte[sBufSize]), m_filePos(0), m_bufPos(0), m_bufLen(0), m_line(0), m_error(false)
+    {
+        LARGE_INTEGER fileOffset;
+        fileOffset.QuadPart = 0;
+        m_error = (SetFilePointerEx(hFile, fileOffset, NULL, FILE_BEGIN) == 0);
+    }
+
+    // Return next kept byte of line, sEndLine at end of each line,
+    // sEndFile after last line or on read error.
+    int Next()
+    {
+        for (;;)
+        {
+            if (m_error || m_line + 1 >= m_starts.size())
+                return sEndFile;
+            if (m_filePos == m_starts[m_line + 1])
+            {
+                m_line++;
+                return sEndLine;
+            }
+            if (m_bufPos == m_bufLen && !Fill())
+                return sEndFile;
+
+            const Byte chr = m_buffer[m_bufPos++];
+            m_filePos++;
+            if (chr != '\n' && !m_ignoreChar.m_charSet[chr])
+                return chr;
+        }
+    }
+
+    bool Error() const noexcept
+    { return m_error; }
+
+private:
+    static const DWORD sBufSize = 1024*1024;
+
+    bool Fill()
+    {
+        DWORD rlen = 0;
+        if (ReadFile(m_hFile, m_buffer.get(), sBufSize, &rlen, 0) == 0 || rlen == 0)
+        {
+            m_error = true;
+            return false;
+        }
+        m_bufPos = 0;
+        m_bufLen = rlen;
+        return true;
+    }
+
+    HANDLE                      m_hFile;
+    const std::vector<ULONGLONG>& m_starts;
+    const IgnoreChar&           m_ignoreChar;
+    std::unique_ptr<Byte[]>     m_buffer;
+    ULONGLONG                   m_filePos;
+    DWORD                       m_bufPos;
+    DWORD                       m_bufLen;
+    size_t                      m_line;
+    bool                        m_error;
+};
+
+// ---------------------------------------------------------------------------
+// Confirm files whose line hashes all match have the same lines less
+// IgnoreChar bytes, the hashes are not collision free. Without ignored
+// bytes, files of equal size have equal lines only if their bytes match.
+// Return 0 if lines are the same, 1 if they differ, -1 on read error.
+static int SameTextLines(HANDLE hFile1, const TextLines& lines1, LONGLONG fileSize1,
+    HANDLE hFile2, const TextLines& lines2, LONGLONG fileSize2, const IgnoreChar& ignoreChar)
+{
+    bool anyIgnored = false;
+    for (unsigned chr = 0; chr < 256; chr++)
+        anyIgnored |= (chr != '\n' && ignoreChar.m_charSet[chr]);
+
+    if ( !anyIgnored && fileSize1 == fileSize2)
+    {
+        LARGE_INTEGER fileOffset;
+        fileOffset.QuadPart = 0;
+        if (SetFilePointerEx(hFile1, fileOffset, NULL, FILE_BEGIN) == 0 ||
+            SetFilePointerEx(hFile2, fileOffset, NULL, FILE_BEGIN) == 0)
+            return -1;
+
+        const DWORD sBufSize = 1024*1024;
+        std::unique_ptr<Byte[]> buffer1(new Byte[sBufSize]);
+        std::unique_ptr<Byte[]> buffer2(new Byte[sBufSize]);
+        LONGLONG filePos = 0;
+        while (filePos < fileSize1)
+        {
+            const DWORD len = (DWORD)min((LONGLONG)sBufSize, fileSize1 - filePos);
+            DWORD rlen1 = 0, rlen2 = 0;
+            if (ReadFile(hFile1, buffer1.get(), len, &rlen1, 0) == 0 || rlen1 != len ||
+                ReadFile(hFile2, buffer2.get(), len, &rlen2, 0) == 0 || rlen2 != len)
+                return -1;
+            if (memcmp(buffer1.get(), buffer2.get(), len) != 0)
+                return 1;
+            filePos += len;
+        }
+        return 0;
+    }
+
+    KeptByteReader reader1(hFile1, lines1, ignoreChar);
+    KeptByteReader reader2(hFile2, lines2, ignoreChar);
+    int chr1, chr2;
+    do
+    {
+        chr1 = reader1.Next();
+        chr2 = reader2.Next();
+    } while (chr1 == chr2 && chr1 != KeptByteReader::sEndFile);
+
+    if (reader1.Error() || reader2.Error())
+        return -1;
+    return (chr1 == chr2) ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+// Files with equal line hashes which SameTextLines found different, a hash
+// collision. Lines pair up one to one, mark each pair whose kept bytes differ.
+// Return false on read error.
+static bool CollidedTextLines(HANDLE hFile1, const TextLines& lines1,
+    HANDLE hFile2, const TextLines& lines2, const IgnoreChar& ignoreChar,
+    std::vector<char>& changed1, std::vector<char>& changed2)
+{
+    changed1.assign(lines1.hashes.size(), 0);
+    changed2.assign(lines2.hashes.size(), 0);
+
+    KeptByteReader reader1(hFile1, lines1, ignoreChar);
+    KeptByteReader reader2(hFile2, lines2, ignoreChar);
+    for (size_t line = 0; line < changed1.size() && line < changed2.size(); line++)
+    {
+        int chr1, chr2;
+        do
+        {
+            chr1 = reader1.Next();
+            chr2 = reader2.Next();
+        } while (chr1 == chr2 && chr1 >= 0);
+
+        if (chr1 != chr2)
+        {
+            changed1[line] = changed2[line] = 1;
+            while (chr1 >= 0)
+                chr1 = reader1.Next();
+            while (chr2 >= 0)
+                chr2 = reader2.Next();
+        }
+    }
+    return !reader1.Error() && !reader2.Error();
+}
+
+// ---------------------------------------------------------------------------
+// Myers' O(ND) diff in linear space, "An O(ND) Difference Algorithm and Its
+// Variations", E. Myers 1986. Forward and backward searches meet on a middle
+// snake which splits the problem in two, like GNU diff's diffseq.
+//
+// Lines found on only one side are marked changed up front and left out of
+// the search, which keeps very different files from costing O(N*D).
+class LineDiff
+{
+public:
+    // Set changed1[i] and changed2[j] for lines not on the common subsequence.
+    static void Diff(const std::vector<ULONGLONG>& lines1, const std::vector<ULONGLONG>& lines2,
+        std::vector<char>& changed1, std::vector<char>& changed2)
+    {
+        changed1.assign(lines1.size(), 0);
+        changed2.assign(lines2.size(), 0);
+
+        // Common head and tail need no search.
+        size_t head = 0;
+        while (head < lines1.size() && head < lines2.size() && lines1[head] == lines2[head])
+            head++;
+        size_t tail1 = lines1.size();
+        size_t tail2 = lines2.size();
+        while (tail1 > head && tail2 > head && lines1[tail1 - 1] == lines2[tail2 - 1])
+            tail1--, tail2--;
+
+        std::vector<ULONGLONG> keep1, keep2;
+        std::vector<size_t> index1, index2;
+        Discard(lines1, head, tail1, lines2, head, tail2, changed1, keep1, index1);
+        Discard(lines2, head, tail2, lines1, head, tail1, changed2, keep2, index2);
+
+        LineDiff diff(keep1, keep2);
+        diff.Compare(0, (int)keep1.size(), 0, (int)keep2.size());
+        for (size_t idx = 0; idx < keep1.size(); idx++)
+            changed1[index1[idx]] = diff.m_changed1[idx];
+        for (size_t idx = 0; idx < keep2.size(); idx++)
+            changed2[index2[idx]] = diff.m_changed2[idx];
+    }
+
+private:
+    LineDiff(const std::vector<ULONGLONG>& lines1, const std::vector<ULONGLONG>& lines2) :
+        m_a(lines1.data()), m_b(lines2.data()),
+        m_changed1(lines1.size(), 0), m_changed2(lines2.size(), 0),
+        m_fwd(lines1.size() + lines2.size() + 3), m_bwd(lines1.size() + lines2.size() + 3)
+    {
+        // Diagonals run from -(size2+1) to size1+1.
+        m_fd = m_fwd.data() + lines2.size() + 1;
+        m_bd = m_bwd.data() + lines2.size() + 1;
+
+        // Give up on an optimal split after about sqrt(diagonals) steps.
+        m_tooExpensive = 1;
+        for (size_t diags = m_fwd.size(); diags != 0; diags >>= 2)
+            m_tooExpensive <<= 1;
+        m_tooExpensive = max(m_tooExpensive, 4096);
+    }
+
+    static size_t SlotOf(ULONGLONG hash, size_t mask)
+    {
+        return (size_t)(hash ^ (hash >> 32)) & mask;
+    }
+
+    static void PrefetchSlot(const std::vector<ULONGLONG>& table, ULONGLONG hash, size_t mask)
+    {
+#if defined(_M_IX86) || defined(_M_X64)
+        _mm_prefetch((const char*)&table[SlotOf(hash | 1, mask)], _MM_HINT_T0);
+#endif
+    }
+
+    // Mark lines of [beg,end) with no match in other [otherBeg,otherEnd)
+    // as changed, keep the rest and their line index.
+    static void Discard(const std::vector<ULONGLONG>& lines, size_t beg, size_t end,
+        const std::vector<ULONGLONG>& other, size_t otherBeg, size_t otherEnd,
+        std::vector<char>& changed, std::vector<ULONGLONG>& keep, std::vector<size_t>& index)
+    {
+        // Open addressed set of other hashes, line hashes are made odd so
+        // 0 marks an empty slot. Slots are prefetched a few lines ahead as
+        // large tables miss the cache on nearly every probe.
+        const size_t sAhead = 16;
+        size_t tableSize = 16;
+        while (tableSize < (otherEnd - otherBeg) * 2)
+            tableSize *= 2;
+        std::vector<ULONGLONG> table(tableSize, 0);
+        const size_t mask = tableSize - 1;
+        for (size_t idx = otherBeg; idx < otherEnd; idx++)
+        {
+            if (idx + sAhead < otherEnd)
+                PrefetchSlot(table, other[idx + sAhead], mask);
+            const ULONGLONG hash = other[idx] | 1;
+            size_t slot = SlotOf(hash, mask);
+            while (table[slot] != 0 && table[slot] != hash)
+                slot = (slot + 1) & mask;
+            table[slot] = hash;
+        }
+
+        keep.reserve(end - beg);
+        index.reserve(end - beg);
+        for (size_t idx = beg; idx < end; idx++)
+        {
+            if (idx + sAhead < end)
+                PrefetchSlot(table, lines[idx + sAhead], mask);
+            const ULONGLONG hash = lines[idx] | 1;
+            size_t slot = SlotOf(hash, mask);
+            while (table[slot] != 0 && table[slot] != hash)
+                slot = (slot + 1) & mask;
+            if (table[slot] == 0)
+            {
+                changed[idx] = 1;
+            }
+            else
+            {
+                keep.push_back(lines[idx]);
+                index.push_back(idx);
+            }
+        }
+    }
+
+    // Find midpoint of shortest edit script of a[xoff,xlim) and b[yoff,ylim).
+    void Diag(int xoff, int xlim, int yoff, int ylim, int& xmid, int& ymid)
+    {
+        int* const fd = m_fd;
+        int* const bd = m_bd;
+        const int dmin = xoff - ylim;
+        const int dmax = xlim - yoff;
+        const int fmid = xoff - yoff;
+        const int bmid = xlim - ylim;
+        int fmin = fmid, fmax = fmid;
+        int bmin = bmid, bmax = bmid;
+        const bool odd = ((fmid - bmid) & 1) != 0;
+
+        fd[fmid] = xoff;
+        bd[bmid] = xlim;
+
+        for (int cost = 1; ; cost++)
+        {
+            // Extend forward search by one edit on each diagonal.
+            if (fmin > dmin)
+                fd[--fmin - 1] = -1;
+            else
+                ++fmin;
+            if (fmax < dmax)
+                fd[++fmax + 1] = -1;
+            else
+                --fmax;
+            for (int d = fmax; d >= fmin; d -= 2)
+            {
+                const int tlo = fd[d - 1];
+                const int thi = fd[d + 1];
+                int x = (tlo < thi) ? thi : tlo + 1;
+                int y = x - d;
+                while (x < xlim && y < ylim && m_a[x] == m_b[y])
+                    x++, y++;
+                fd[d] = x;
+                if (odd && bmin <= d && d <= bmax && bd[d] <= x)
+                {
+                    xmid = x;
+                    ymid = y;
+                    return;
+                }
+            }
+
+            // Extend backward search.
+            if (bmin > dmin)
+                bd[--bmin - 1] = INT_MAX;
+            else
+                ++bmin;
+            if (bmax < dmax)
+                bd[++bmax + 1] = INT_MAX;
+            else
+                --bmax;
+            for (int d = bmax; d >= bmin; d -= 2)
+            {
+                const int tlo = bd[d - 1];
+                const int thi = bd[d + 1];
+                int x = (tlo < thi) ? tlo : thi - 1;
+                int y = x - d;
+                while (xoff < x && yoff < y && m_a[x - 1] == m_b[y - 1])
+                    x--, y--;
+                bd[d] = x;
+                if ( !odd && fmin <= d && d <= fmax && x <= fd[d])
+                {
+                    xmid = x;
+                    ymid = y;
+                    return;
+                }
+            }
+
+            if (cost >= m_tooExpensive)
+            {
+                // Split at the furthest reaching forward or backward path.
+                int fxybest = -1, fxbest = xoff;
+                for (int d = fmax; d >= fmin; d -= 2)
+                {
+                    int x = min(fd[d], xlim);
+                    int y = x - d;
+                    if (ylim < y)
+                        x = ylim + d, y = ylim;
+                    if (fxybest < x + y)
+                        fxybest = x + y, fxbest = x;
+                }
+
+                int bxybest = INT_MAX, bxbest = xlim;
+                for (int d = bmax; d >= bmin; d -= 2)
+                {
+                    int x = max(xoff, bd[d]);
+                    int y = x - d;
+                    if (y < yoff)
+                        x = yoff + d, y = yoff;
+                    if (x + y < bxybest)
+                        bxybest = x + y, bxbest = x;
+                }
+
+                if ((xlim + ylim) - bxybest < fxybest - (xoff + yoff))
+                {
+                    xmid = fxbest;
+                    ymid = fxybest - fxbest;
+                }
+                else
+                {
+                    xmid = bxbest;
+                    ymid = bxybest - bxbest;
+                }
+                return;
+            }
+        }
+    }
+
+    // Mark changed lines of a[xoff,xlim) and b[yoff,ylim), ranges are kept
+    // on a stack rather than recursing.
+    void Compare(int xoff, int xlim, int yoff, int ylim)
+    {
+        struct Range
+        {
+            int xoff, xlim, yoff, ylim;
+        };
+        std::vector<Range> todo(1, Range{ xoff, xlim, yoff, ylim });
 
-        if (m_offset != 0)
+        while ( !todo.empty())
         {
-            DWORD moved = 0;
-            LARGE_INTEGER fileOffset;
-            fileOffset.QuadPart = m_offset;
-            SetFilePointer(f1, fileOffset.LowPart, &fileOffset.HighPart, moved);
-            SetFilePointer(f2, fileOffset.LowPart, &fileOffset.HighPart, moved);
-        }
+            Range range = todo.back();
+            todo.pop_back();
 
-        LONGLONG filePos = m_offset;
-        while (
-            (compareInfo.diffCnt == 0 || m_verbose) &&
-            ReadFile(f1, buffer1, sizeof(buffer1), &rlen1, 0) != 0 &&
-            ReadFile(f2, buffer2, sizeof(buffer2), &rlen2, 0) != 0 &&
-            rlen1 == rlen2 &&
-            rlen1 != 0)
-        {
-            if (m_verbose)
-            {
-                for (unsigned idx = 0; idx < rlen1; idx++)
-                {
-                    if (buffer1[idx] != buffer2[idx])
-                    {
-                        compareInfo.differAt = filePos + idx;
-                        compareInfo.diffCnt++;
-                        compareInfo.whereCnt[compareInfo.differAt/whereSize]++;
+            while (range.xoff < range.xlim && range.yoff < range.ylim && m_a[range.xoff] == m_b[range.yoff])
+                range.xoff++, range.yoff++;
+            while (range.xoff < range.xlim && range.yoff < range.ylim && m_a[range.xlim - 1] == m_b[range.ylim - 1])
+                range.xlim--, range.ylim--;
 
-                        if (quitAfter != 0)
-                        {
-                            quitAfter--;
-                            wout << "Differ at: " <<  filePos + idx
-                                << " Data: "
-                                << std::setw(3) << (unsigned)buffer1[idx] << " != "
-                                << std::setw(3) << (unsigned)buffer2[idx]
-                                << std::endl;
-                        }
-                    }
-                }
-            }
-            else
+            if (range.xoff == range.xlim || range.yoff == range.ylim)
             {
-#if 1
-                if (memcmp(buffer1, buffer2, rlen1) != 0)
-#endif
-                {
-                    unsigned idx;
-                    for (idx = 0; idx < rlen1; idx++)
-                    {
-                        if (buffer1[idx] != buffer2[idx])
-                        {
-                            compareInfo.diffCnt++;
-                            break;
-                        }
-                    }
-
-                    compareInfo.differAt = filePos + idx;
-                }
+                std::fill(m_changed1.begin() + range.xoff, m_changed1.begin() + range.xlim, 1);
+                std::fill(m_changed2.begin() + range.yoff, m_changed2.begin() + range.ylim, 1);
+                continue;
             }
-            filePos += rlen1;
 
-            if (m_progress && compareInfo.fileSize1 > 1024*1024)
-                std::cerr << std::fixed << std::setw(6) << std::setprecision(2)
-                    << (filePos * 100.0) /  compareInfo.fileSize1 << " %\r";
+            int xmid, ymid;
+            Diag(range.xoff, range.xlim, range.yoff, range.ylim, xmid, ymid);
+            if ((xmid == range.xoff && ymid == range.yoff) || (xmid == range.xlim && ymid == range.ylim))
+            {
+                // No progress, should not happen, treat range as replaced.
+                std::fill(m_changed1.begin() + range.xoff, m_changed1.begin() + range.xlim, 1);
+                std::fill(m_changed2.begin() + range.yoff, m_changed2.begin() + range.ylim, 1);
+                continue;
+            }
+            todo.push_back(Range{ xmid, range.xlim, ymid, range.ylim });
+            todo.push_back(Range{ range.xoff, xmid, range.yoff, ymid });
         }
-
-        result = (rlen1 == rlen2 && compareInfo.diffCnt == 0) ? eCmpEqual : eCmpDiff;
     }
 
-    // CloseHandle(f1);
-    // CloseHandle(f2);
+    const ULONGLONG*    m_a;
+    const ULONGLONG*    m_b;
+    std::vector<char>   m_changed1;
+    std::vector<char>   m_changed2;
+    std::vector<int>    m_fwd;
+    std::vector<int>    m_bwd;
+    int*                m_fd;       // Furthest x per diagonal, forward
+    int*                m_bd;       // Nearest x per diagonal, backward
+    int                 m_tooExpensive;
+};
 
-    return result;
+// ---------------------------------------------------------------------------
+// Print line text from file offsets, long lines are cut.
+static void PrintTextLine(std::ostream& wout, const char* prefix, HANDLE hFile,
+    ULONGLONG lineStart, ULONGLONG lineEnd)
+{
+    char line[256];
+    const DWORD len = (DWORD)min(lineEnd - lineStart, (ULONGLONG)sizeof(line));
+    DWORD rlen = 0;
+    LARGE_INTEGER fileOffset;
+    fileOffset.QuadPart = lineStart;
+    if (SetFilePointerEx(hFile, fileOffset, NULL, FILE_BEGIN) == 0 ||
+        ReadFile(hFile, line, len, &rlen, 0) == 0)
+        rlen = 0;
+    while (rlen != 0 && (line[rlen - 1] == '\n' || line[rlen - 1] == '\r'))
+        rlen--;
+
+    wout << prefix;
+    wout.write(line, rlen);
+    if (lineEnd - lineStart > sizeof(line))
+        wout << "...";
+    wout << std::endl;
 }
 
+// ---------------------------------------------------------------------------
+// Line range of hunk as diff shows it, first,last or just first.
+static std::string HunkRange(size_t beg, size_t end)
+{
+    std::ostringstream range;
+    if (end - beg <= 1)
+        range << ((end == beg) ? beg : end);
+    else
+        range << beg + 1 << "," << end;
+    return range.str();
+}
 
 // ---------------------------------------------------------------------------
 // return:  -2 skip, -1 error, 0 identical, 1 differ
@@ -767,44 +2165,101 @@ LLCmp::CompareResult  LLCmp::CompareDataText(
         unsigned quitAfter,
         std::ostream& wout)
 {
-	std::ifstream in1(filePath1);
-	std::ifstream in2(filePath2);
-
-	std::string line1, line2;
-	unsigned int lineCnt = 0;
-    unsigned int diffLineCnt = 0;
-
-    LLCmp::CompareResult status = eCmpEqual;
     compareInfo.differAt = 0;
     compareInfo.diffCnt = 0;
 
-	while (std::getline(in1, line1) && std::getline(in2, line2))
-	{
-		lineCnt++;
+    struct _stat statResult;
+    if (0 == _stat(filePath1, &statResult) && (statResult.st_mode & _S_IFREG) != _S_IFREG)
+        return eCmpEqual;   // Can only compare files, return as if identical.
 
-		unsigned int idx1=0, idx2=0;
-		while (idx1 < line1.length() && idx2 < line2.length())
-		{
-			while (m_ignoreChar.Is(line1[idx1]) && idx1 < line1.length())
-				idx1++;
-			while (m_ignoreChar.Is(line2[idx2]) && idx2 < line2.length())
-				idx2++;
+    Handle f1 = OpenCmpFile(filePath1);
+    if (f1.NotValid())
+    {
+        compareInfo.openError = GetLastError();
+        compareInfo.openErrorFile = 1;
+        return eCmpErr;
+    }
 
-			if (line1[idx1++] != line2[idx2++])
-			{
-                if (diffLineCnt++ == 0) 
-                    compareInfo.differAt = lineCnt;
-                status = eCmpDiff;
-                break;
-			}
-		}
+    Handle f2 = OpenCmpFile(filePath2);
+    if (f2.NotValid())
+    {
+        compareInfo.openError = GetLastError();
+        compareInfo.openErrorFile = 2;
+        return eCmpErr;
+    }
 
-        // if (compareInfo.diffCnt == 0)
-        //    compareInfo.differAt = in1.tellg().seekpos;
-	}
+    if ( !GetFileSizeLL(f1, compareInfo.fileSize1) || !GetFileSizeLL(f2, compareInfo.fileSize2))
+        return eCmpErr;
+
+    TextLines lines1, lines2;
+    LineHasher hasher1(m_ignoreChar, lines1);
+    LineHasher hasher2(m_ignoreChar, lines2);
+    if ( !HashTextFile(f1, compareInfo.fileSize1, hasher1) ||
+         !HashTextFile(f2, compareInfo.fileSize2, hasher2))
+        return eCmpErr;
+
+    // Equal line hashes are only a fast path, confirm with the bytes. On a
+    // hash collision the hunks come from the bytes of each line pair.
+    std::vector<char> changed1, changed2;
+    if (lines1.hashes == lines2.hashes)
+    {
+        const int same = SameTextLines(f1, lines1, compareInfo.fileSize1,
+            f2, lines2, compareInfo.fileSize2, m_ignoreChar);
+        if (same < 0)
+            return eCmpErr;
+        if (same == 0)
+            return eCmpEqual;
+        if ( !CollidedTextLines(f1, lines1, f2, lines2, m_ignoreChar, changed1, changed2))
+            return eCmpErr;
+    }
+    else
+    {
+        LineDiff::Diff(lines1.hashes, lines2.hashes, changed1, changed2);
+    }
+
+    // Hunks are runs of changed lines on either side, shown like diff.
+    // Each side shows up to quitAfter of its own lines.
+    unsigned quit1 = quitAfter;
+    unsigned quit2 = quitAfter;
+    const size_t lineCnt1 = lines1.hashes.size();
+    const size_t lineCnt2 = lines2.hashes.size();
+    size_t idx1 = 0, idx2 = 0;
+    while (idx1 < lineCnt1 || idx2 < lineCnt2)
+    {
+        if (idx1 < lineCnt1 && idx2 < lineCnt2 && !changed1[idx1] && !changed2[idx2])
+        {
+            idx1++;
+            idx2++;
+            continue;
+        }
+
+        const size_t beg1 = idx1;
+        const size_t beg2 = idx2;
+        while (idx1 < lineCnt1 && changed1[idx1])
+            idx1++;
+        while (idx2 < lineCnt2 && changed2[idx2])
+            idx2++;
+        if (idx1 == beg1 && idx2 == beg2)
+            break;      // Unmatched line, not possible from LineDiff.
+
+        if (compareInfo.diffCnt == 0)
+            compareInfo.differAt = beg1 + 1;
+        compareInfo.diffCnt += (ULONG)max(idx1 - beg1, idx2 - beg2);
 
-    compareInfo.diffCnt = diffLineCnt;
-    return status;     // 0=equal, 1..n = different line count
+        if (m_verbose && (quit1 != 0 || quit2 != 0))
+        {
+            const char op = (beg1 == idx1) ? 'a' : ((beg2 == idx2) ? 'd' : 'c');
+            wout << HunkRange(beg1, idx1) << op << HunkRange(beg2, idx2) << std::endl;
+            for (size_t line = beg1; line < idx1 && quit1 != 0; line++, quit1--)
+                PrintTextLine(wout, "< ", f1, lines1.starts[line], lines1.starts[line + 1]);
+            if (op == 'c' && quit2 != 0)
+                wout << "---" << std::endl;
+            for (size_t line = beg2; line < idx2 && quit2 != 0; line++, quit2--)
+                PrintTextLine(wout, "> ", f2, lines2.starts[line], lines2.starts[line + 1]);
+        }
+    }
+
+    return eCmpDiff;
 }
 
 // ---------------------------------------------------------------------------
@@ -843,7 +2298,7 @@ std::ostream& LLCmp::PrintPath(const char* msg, const LLDirEntry* dirEntry0, con
 	sprintf_s(filePath, ARRAYSIZE(filePath), "%s\\%s",
 		dirEntry0->szDir,
 		dirEntry0->filenameLStr);
-	m_dirSort.m_fillFindData(fileData, *dirEntry0, m_dirSort);
+	m_dirSort.FillFindData(fileData, *dirEntry0);
 	strncpy(fileData.cFileName, dirEntry0->filenameLStr, MAX_PATH);
         LLPrintf::PrintFile(m_pushArgs, m_printFmt, dirEntry0->szDir, filePath, &fileData, depth);
 
@@ -851,12 +2306,164 @@ std::ostream& LLCmp::PrintPath(const char* msg, const LLDirEntry* dirEntry0, con
 	sprintf_s(filePath, ARRAYSIZE(filePath), "%s\\%s",
 		dirEntry1->szDir,
 		dirEntry1->filenameLStr);
-	m_dirSort.m_fillFindData(fileData, *dirEntry1, m_dirSort);
+	m_dirSort.FillFindData(fileData, *dirEntry1);
     strncpy(fileData.cFileName, dirEntry1->filenameLStr, MAX_PATH);
         LLPrintf::PrintFile(m_pushArgs, m_printFmt, dirEntry1->szDir, filePath, &fileData, depth);
 	return LLMsg::Out();
 }
 
+// ---------------------------------------------------------------------------
+// Return:  -2 skip, -1 error, 0 identical, 1 differ
+LLCmp::CompareResult LLCmp::ComparePair(
+        const char* filePath1,
+        const char* filePath2,
+        CompareInfo& compareInfo,
+        std::string& cmpResults)
+{
+    std::ostringstream cmpOut;
+
+    // Enable comma formatting of numbers.
+    char sep = ',';
+    int group = 3;
+    cmpOut.imbue(std::locale(std::locale(), new numfmt<char>(sep, group)));
+
+    compareInfo.openError = 0;
+    CompareResult cmpResult =
+        (this->*compareFileMethod)(filePath1, filePath2, compareInfo, m_quitByteLimit, cmpOut);
+    cmpResults = cmpOut.str();
+    return cmpResult;
+}
+
+// ---------------------------------------------------------------------------
+// Parallel compare, -j=<threads>
+//
+//  Workers claim file pairs in group order and compare them into a ring of
+//  result slots, at most a window of slots ahead of the oldest unreported
+//  pair. CompareFileData takes results in pair order with Next(), so output,
+//  counters and deletes are handled on the calling thread as in a serial run.
+//
+struct LLCmp::ComparePipe
+{
+    struct Slot
+    {
+        volatile LONG   done;
+        CompareResult   result;
+        CompareInfo     compareInfo;
+        std::string     cmpResults;
+    };
+
+    ComparePipe(LLCmp& cmp, DirEntryList&& pairs, unsigned threads) :
+        m_cmp(cmp), m_pairs(std::move(pairs)), m_slots(threads * 16),
+        m_nextPair(0), m_reported(0), m_abort(false)
+    {
+        for (Slot& slot : m_slots)
+            slot.done = 0;
+    }
+
+    // Start workers, after LLCmp::m_pPipe and compareFileMethod are set
+    // since workers read both. Return number of workers started, if none
+    // Next() would wait forever so the caller must not use the pipe.
+    unsigned Start(unsigned threads)
+    {
+        for (unsigned idx = 0; idx < threads; idx++)
+        {
+            HANDLE hThread = CreateThread(NULL, 0, WorkerThread, this, 0, NULL);
+            if (hThread != NULL)
+                m_threadHnds.push_back(hThread);
+        }
+        return (unsigned)m_threadHnds.size();
+    }
+
+    ~ComparePipe()
+    {
+        m_abort = true;
+        if ( !m_threadHnds.empty())
+            WaitForMultipleObjects((DWORD)m_threadHnds.size(), m_threadHnds.data(), TRUE, INFINITE);
+        for (HANDLE hThread : m_threadHnds)
+            CloseHandle(hThread);
+    }
+
+    // Result of next pair in order, waits for its worker.
+    CompareResult Next(CompareInfo& compareInfo, std::string& cmpResults)
+    {
+        Slot& slot = m_slots[m_reported % m_slots.size()];
+        unsigned idleCnt = 0;
+        while (InterlockedCompareExchange(&slot.done, 0, 0) == 0)   // Slot written before done is read
+        {
+            if (++idleCnt < 64)
+                SwitchToThread();
+            else
+                Sleep(1);
+        }
+
+        compareInfo = slot.compareInfo;
+        cmpResults.swap(slot.cmpResults);
+        const CompareResult result = slot.result;
+        InterlockedExchange(&slot.done, 0);
+        InterlockedIncrement64(&m_reported);
+        return result;
+    }
+
+    // Pairs taken by Next, interlocked read so a slot is reused only after
+    // Next has copied its result out.
+    LONGLONG Reported()
+    { return InterlockedCompareExchange64(&m_reported, 0, 0); }
+
+    static DWORD WINAPI WorkerThread(LPVOID pData)
+    {
+        ComparePipe& pipe = *(ComparePipe*)pData;
+        LLCmp& cmp = pipe.m_cmp;
+        const LONGLONG pairCnt = (LONGLONG)pipe.m_pairs.size() / 2;
+        const LONGLONG window = (LONGLONG)pipe.m_slots.size();
+        char filePath1[LL_MAX_PATH];
+        char filePath2[LL_MAX_PATH];
+
+        // Wow64 redirection is per thread.
+        PVOID oldWow64Redirection = 0;
+        if (cmp.m_dirScan.m_disableWow64Redirection)
+            Wow64DisableWow64FsRedirection(&oldWow64Redirection);
+
+        for (;;)
+        {
+            const LONGLONG pairIdx = InterlockedIncrement64(&pipe.m_nextPair) - 1;
+            if (pairIdx >= pairCnt)
+                break;
+
+            unsigned idleCnt = 0;
+            while (pairIdx >= pipe.Reported() + window && !pipe.m_abort)
+            {
+                if (++idleCnt < 64)
+                    SwitchToThread();
+                else
+                    Sleep(1);
+            }
+            if (pipe.m_abort)
+                break;
+
+            const LLDirEntry* pEntry1 = pipe.m_pairs[pairIdx * 2];
+            const LLDirEntry* pEntry2 = pipe.m_pairs[pairIdx * 2 + 1];
+            sprintf_s(filePath1, ARRAYSIZE(filePath1), "%s\\%s", pEntry1->szDir, pEntry1->filenameLStr);
+            sprintf_s(filePath2, ARRAYSIZE(filePath2), "%s\\%s", pEntry2->szDir, pEntry2->filenameLStr);
+
+            Slot& slot = pipe.m_slots[pairIdx % window];
+            slot.result = cmp.ComparePair(filePath1, filePath2, slot.compareInfo, slot.cmpResults);
+            InterlockedExchange(&slot.done, 1);
+        }
+
+        if (cmp.m_dirScan.m_disableWow64Redirection)
+            Wow64RevertWow64FsRedirection(oldWow64Redirection);
+        return 0;
+    }
+
+    LLCmp&              m_cmp;
+    DirEntryList        m_pairs;        // First and second entry of each pair
+    std::vector<Slot>   m_slots;
+    volatile LONGLONG   m_nextPair;     // Next pair to claim
+    volatile LONGLONG   m_reported;     // Pairs taken by Next
+    volatile bool       m_abort;
+    std::vector<HANDLE> m_threadHnds;
+};
+
 // ---------------------------------------------------------------------------
 int LLCmp::CompareFileData(DirEntryList& dirEntryList)
 {
@@ -894,21 +2501,19 @@ int LLCmp::CompareFileData(DirEntryList& dirEntryList)
             dirEntryList[fileIdx]->filenameLStr);
 
         CompareInfo compareInfo;
-        unsigned quitAfter = m_quitByteLimit;
-        std::ostringstream cmpResults;
+        std::string cmpResults;
+        CompareResult cmpResult = (m_pPipe != nullptr)
+            ? m_pPipe->Next(compareInfo, cmpResults)
+            : ComparePair(filePath1, filePath2, compareInfo, cmpResults);
 
-        // Enable comma formatting of numbers.
-        char sep = ',';
-        int group = 3;
-        cmpResults.imbue(std::locale(std::locale(), new numfmt<char>(sep, group)));
+        if (compareInfo.openError != 0)
+            LLMsg::PresentError(compareInfo.openError, "Open failed,",
+                (compareInfo.openErrorFile == 1) ? filePath1 : filePath2);
 
         isLeft = (_strnicmp(m_dirs[0].c_str(),  dirEntryList[0]->szDir, m_dirs[0].length()) == 0);
 
         bool okayToSkip = ((isLeft && m_showSkipLeft) || ( !isLeft && m_showSkipRight));
 
-        unsigned cmpResult = 
-                (this->*compareFileMethod)(filePath1, filePath2, compareInfo, quitAfter, cmpResults);
-
 
         switch (cmpResult)
         {
@@ -918,7 +2523,7 @@ int LLCmp::CompareFileData(DirEntryList& dirEntryList)
             {
                 // LLMsg::Out() << "Skip, " << filePath1 << ", " << filePath2 << std::endl;
 				PrintPath("Skip, ", dirEntryList[0], dirEntryList[fileIdx]) << std::endl;
-                LLMsg::Out() << cmpResults.str();
+                LLMsg::Out() << cmpResults;
                 resultStatus = sOkay;
             }
             break;
@@ -934,7 +2539,7 @@ int LLCmp::CompareFileData(DirEntryList& dirEntryList)
             {
                 // LLMsg::Out() << "==, " << filePath1 << ", " << filePath2 << std::endl;
 				PrintPath("==, ", dirEntryList[0], dirEntryList[fileIdx]) << std::endl;
-                LLMsg::Out() << cmpResults.str();
+                LLMsg::Out() << cmpResults;
                 resultStatus = sOkay;
             }
 
@@ -977,6 +2582,7 @@ int LLCmp::CompareFileData(DirEntryList& dirEntryList)
                         << ", DiffLineCnt: " << compareInfo.diffCnt
                         << ", FirstDiffLine:" << compareInfo.differAt 
                         << std::endl;
+                    LLMsg::Out() << cmpResults;
                 }
                 else
                 {
@@ -990,11 +2596,11 @@ int LLCmp::CompareFileData(DirEntryList& dirEntryList)
                             << " (" << compareInfo.diffCnt*100/compareInfo.fileSize1
                             << "%)";
                     LLMsg::Out() << std::endl;
-                    LLMsg::Out() << cmpResults.str();
+                    LLMsg::Out() << cmpResults;
                     if (m_verbose && compareInfo.diffCnt != 0)
                     {
                         LLMsg::Out() << " Where:";
-                        DWORD whereSize = DWORD(compareInfo.fileSize2 / 100);
+                        DWORD whereSize = max(DWORD(compareInfo.fileSize2 / 100), DWORD(1));
                         for (unsigned whIdx = 0; whIdx != 100; whIdx++)
                         {
                             if (compareInfo.whereCnt[whIdx] == 0)
@@ -1077,7 +2683,7 @@ int LLCmp::CompareFileSpecs(DirEntryList& dirEntryList)
             dirEntryList[0]->szDir,
             dirEntryList[0]->filenameLStr);
     WIN32_FIND_DATA fileData0;
-    m_dirSort.m_fillFindData(fileData0, *dirEntryList[0], m_dirSort);
+    m_dirSort.FillFindData(fileData0, *dirEntryList[0]);
 
     bool allEqual = true;
     bool allDiff = true;
@@ -1106,7 +2712,7 @@ int LLCmp::CompareFileSpecs(DirEntryList& dirEntryList)
 
     for (size_t fileIdx = 1; fileIdx < dirEntryList.size(); fileIdx++)
     {
-        m_dirSort.m_fillFindData(fileDataN, *dirEntryList[fileIdx], m_dirSort);
+        m_dirSort.FillFindData(fileDataN, *dirEntryList[fileIdx]);
         largeN.LowPart = fileDataN.nFileSizeLow;
         largeN.HighPart = fileDataN.nFileSizeHigh;
 
@@ -1137,7 +2743,7 @@ int LLCmp::CompareFileSpecs(DirEntryList& dirEntryList)
         sprintf_s(filePathN, ARRAYSIZE(filePath0), "%s\\%s",
             dirEntryList[fileIdx]->szDir,
             dirEntryList[fileIdx]->filenameLStr);
-        m_dirSort.m_fillFindData(fileDataN, *dirEntryList[fileIdx], m_dirSort);
+        m_dirSort.FillFindData(fileDataN, *dirEntryList[fileIdx]);
         largeN.LowPart = fileDataN.nFileSizeLow;
         largeN.HighPart = fileDataN.nFileSizeHigh;
 
@@ -1264,114 +2870,388 @@ void LLCmp::ReportCompareFileSpecs() const
 }
 
 // ---------------------------------------------------------------------------
+// Return true if entry passes the -X exclude, -F include and -A attribute
+// filters, applied to scanned entries before they are hashed or compared.
+bool LLCmp::AcceptCmpEntry(const LLDirEntry* pDirEntry) const
+{
+    if ( !m_excludeList.empty())
+    {
+        char filePath[LL_MAX_PATH];
+        sprintf_s(filePath, ARRAYSIZE(filePath), "%s\\%s", pDirEntry->szDir, pDirEntry->filenameLStr);
+        if (LLSup::PatternListMatches(m_excludeList, filePath))
+            return false;
+    }
+    return LLSup::PatternListMatches(m_includeFileList, pDirEntry->filenameLStr, true) &&
+        LLSup::CompareRhsBits(m_dirSort.Attributes(*pDirEntry), m_onlyRhs);
+}
+
 // ---------------------------------------------------------------------------
-class CompareDirLevels
+// Group entries which match on name and last 'levels' directories, in one
+// pass with a hash table. Groups are in order of their first entry in the
+// name sorted list, entries in a group are sorted by directory.
+// Entries rejected by the -X, -F and -A filters are dropped.
+void LLCmp::GroupDirEntries(unsigned levels, DirEntryList& entries, std::vector<size_t>& groupEnds)
 {
-public:
-    static bool Compare(LLDirEntry* pDirEnt1, LLDirEntry* pDirEnt2);
-    static void SetLevels(unsigned levels, std::vector<std::string> dirs)
+    DirEntryList matched;
+    std::vector<size_t> hashes;
+    matched.reserve(m_dirSort.m_count);
+    hashes.reserve(m_dirSort.m_count);
+    for (LLDirEntry* pDirEntry = m_dirSort.m_pFirst; pDirEntry != NULL; pDirEntry = pDirEntry->pNext)
+    {
+        if (AcceptCmpEntry(pDirEntry))
+        {
+            matched.push_back(pDirEntry);
+            hashes.push_back(MatchHash(pDirEntry, levels));
+        }
+    }
+
+    // Open addressed table, slot holds upper hash bits to skip most
+    // mismatches without touching the entries.
+    struct Slot
+    {
+        DWORD       tag;
+        DWORD       group;      // Group index + 1, 0 is empty
+    };
+    size_t tableSize = 16;
+    while (tableSize < matched.size() + matched.size() / 2)
+        tableSize *= 2;
+    std::vector<Slot> table(tableSize, Slot{ 0, 0 });
+    const size_t mask = tableSize - 1;
+
+    std::vector<size_t> groupFirst;     // Index in matched of first entry
+    std::vector<DWORD> groupOf(matched.size());
+    for (size_t idx = 0; idx < matched.size(); idx++)
+    {
+        const size_t hash = hashes[idx];
+        const DWORD tag = (DWORD)(hash >> 32);
+        size_t slotIdx = hash & mask;
+        while (table[slotIdx].group != 0)
+        {
+            const Slot& slot = table[slotIdx];
+            if (slot.tag == tag && SameMatch(matched[groupFirst[slot.group - 1]], matched[idx], levels))
+                break;
+            slotIdx = (slotIdx + 1) & mask;
+        }
+
+        if (table[slotIdx].group == 0)
+        {
+            groupFirst.push_back(idx);
+            table[slotIdx] = Slot{ tag, (DWORD)groupFirst.size() };
+        }
+        groupOf[idx] = table[slotIdx].group - 1;
+    }
+    std::vector<Slot>().swap(table);
+
+    // Place entries by group, then sort each group by directory.
+    std::vector<size_t> groupPos(groupFirst.size(), 0);
+    for (DWORD group : groupOf)
+        groupPos[group]++;
+
+    groupEnds.resize(groupPos.size());
+    size_t end = 0;
+    for (size_t group = 0; group < groupPos.size(); group++)
+    {
+        const size_t count = groupPos[group];
+        groupPos[group] = end;
+        end += count;
+        groupEnds[group] = end;
+    }
+
+    entries.resize(matched.size());
+    for (size_t idx = 0; idx < matched.size(); idx++)
+        entries[groupPos[groupOf[idx]]++] = matched[idx];
+
+    size_t beg = 0;
+    for (size_t grpEnd : groupEnds)
     {
-        s_levels = levels;
-        s_dirs = dirs;
-        std::sort(s_dirs.begin(), s_dirs.end(),  CmpLen);
+        if (grpEnd - beg > 1)
+        {
+            std::stable_sort(entries.begin() + beg, entries.begin() + grpEnd,
+                [](const LLDirEntry* p1, const LLDirEntry* p2)
+                { return _stricmp(p1->szDir, p2->szDir) < 0; });
+        }
+        beg = grpEnd;
     }
-    static bool CmpLen(const std::string& a, const std::string& b)
-    {   return a.length() > b.length();    }
-    static const char* GetDir(const LLDirEntry* pDirEnt);
+}
+
+// ---------------------------------------------------------------------------
+// Duplicate search, -u
+//
+//  Stage 1 keeps files which share a size with another file, stage 2 hashes
+//  the first and last 64K of those and stage 3 hashes the full content of
+//  groups with more than two large files. Survivors are compared directly,
+//  first file of a group against the others, by CompareFileData.
+//
+static const DWORD sEdgeSize = 64 * 1024;
 
-    static unsigned s_levels;
-    static std::vector<std::string> s_dirs;
+struct DupKey
+{
+    ULONGLONG       size;
+    ULONGLONG       hash;
+    LLDirEntry*     pDirEntry;
 };
 
-unsigned CompareDirLevels::s_levels = 0;
-std::vector<std::string> CompareDirLevels::s_dirs;
+static bool DupKeyLess(const DupKey& lhs, const DupKey& rhs)
+{
+    return (lhs.size != rhs.size) ? (lhs.size < rhs.size) : (lhs.hash < rhs.hash);
+}
 
 // ---------------------------------------------------------------------------
-const char* CompareDirLevels::GetDir(const LLDirEntry* pDirEnt)
+// Sort by size and hash, drop keys without a match.
+static void KeepDupRuns(std::vector<DupKey>& keys)
 {
-    const int sMaxLevels = 50;
-    const char* dirs[sMaxLevels];
-    int dirLevel = 0;
-    const char* pDirStr = pDirEnt->szDir;
-    for (unsigned dirIdx = 0; dirIdx != s_dirs.size(); dirIdx++)
+    std::sort(keys.begin(), keys.end(), DupKeyLess);
+
+    size_t outIdx = 0;
+    size_t beg = 0;
+    while (beg < keys.size())
     {
-        if (_strnicmp(s_dirs[dirIdx].c_str(), pDirStr,  s_dirs[dirIdx].length()) == 0)
+        size_t end = beg + 1;
+        while (end < keys.size() && keys[end].size == keys[beg].size && keys[end].hash == keys[beg].hash)
+            end++;
+        if (end - beg > 1)
         {
-            pDirStr += s_dirs[dirIdx].length();
-            if (*pDirStr != '\\')
-                pDirStr--;        // backup so it starts on slash
-            break;
+            while (beg < end)
+                keys[outIdx++] = keys[beg++];
         }
+        beg = end;
+    }
+    keys.resize(outIdx);
+}
+
+// ---------------------------------------------------------------------------
+// MD5 of file content, edges=true only hashes the first and last sEdgeSize.
+// Return 0 or error code.
+static DWORD HashFileContent(const LLDirEntry* pDirEntry, ULONGLONG fileSize,
+    bool edges, std::vector<Byte>& buffer, HashCache* pCache, ULONGLONG& hash)
+{
+    char filePath[LL_MAX_PATH];
+    sprintf_s(filePath, ARRAYSIZE(filePath), "%s\\%s", pDirEntry->szDir, pDirEntry->filenameLStr);
+
+    Handle fHnd = CreateFile(filePath, GENERIC_READ, SHARE_ALL, 0,
+            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (fHnd.NotValid())
+        return GetLastError();
+
+    md5_byte_t digest[16];
+    const HashCache::Kind kind = edges ? HashCache::eEdges : HashCache::eFull;
+    HashCache::Key key;
+    const bool haveKey = (pCache != NULL) && HashCache::GetKey(fHnd, key) && key.size == fileSize;
+    if (haveKey && pCache->Lookup(key, kind, digest))
+    {
+        memcpy(&hash, digest, sizeof(hash));
+        return 0;
     }
 
-    while (*pDirStr != 0 && dirLevel < sMaxLevels)
+    md5_state_t state;
+    md5_init(&state);
+
+    const bool split = edges && fileSize > 2 * (ULONGLONG)sEdgeSize;
+    ULONGLONG remain = split ? sEdgeSize : fileSize;
+    for (unsigned part = 0; part != (split ? 2u : 1u); part++)
     {
-        if (*pDirStr == '\\')
-            dirs[dirLevel++] = pDirStr;
-        pDirStr++;
+        if (part == 1)
+        {
+            LARGE_INTEGER tailPos;
+            tailPos.QuadPart = fileSize - sEdgeSize;
+            if (SetFilePointerEx(fHnd, tailPos, NULL, FILE_BEGIN) == 0)
+                return GetLastError();
+            remain = sEdgeSize;
+        }
+
+        while (remain != 0)
+        {
+            DWORD rlen = 0;
+            DWORD want = (DWORD)min(remain, (ULONGLONG)buffer.size());
+            if (ReadFile(fHnd, buffer.data(), want, &rlen, 0) == 0)
+                return GetLastError();
+            if (rlen == 0)
+                break;      // File shrunk since scan.
+            md5_append(&state, (const md5_byte_t*)buffer.data(), (int)rlen);
+            remain -= rlen;
+        }
     }
 
-    dirLevel--;
-    if (dirLevel >= (int)s_levels)
-        return dirs[dirLevel - s_levels];
-    return (dirLevel < 0) ? "" : dirs[0];
+    md5_finish(&state, digest);
+    memcpy(&hash, digest, sizeof(hash));
+
+    if (haveKey)
+    {
+        pCache->Insert(key, kind, digest);
+        if ( !split && edges)
+            pCache->Insert(key, HashCache::eFull, digest);   // Small file, edges cover it all.
+    }
+    return 0;
 }
 
 // ---------------------------------------------------------------------------
-bool CompareDirLevels::Compare(LLDirEntry* pDirEnt1, LLDirEntry* pDirEnt2)
+struct DupHashWork
+{
+    std::vector<DupKey>&    keys;
+    std::vector<DWORD>&     errors;
+    HashCache*              pCache;
+    bool                    edges;
+    bool                    disableWow64;
+    volatile LONGLONG       nextKey;
+};
+
+static DWORD WINAPI DupHashThread(LPVOID pData)
 {
-    // 5/4/2013 - Change order from dir,name to name then dir to allow
-    // matching in uneaven directories.
-    // Also add s_dir list to this sorting object to peel off the root directories.
+    DupHashWork& work = *(DupHashWork*)pData;
+    std::vector<Byte> buffer(work.edges ? sEdgeSize : 1024 * 1024);
 
+    // Wow64 redirection is per thread.
+    PVOID oldWow64Redirection = 0;
+    if (work.disableWow64)
+        Wow64DisableWow64FsRedirection(&oldWow64Redirection);
 
-    int nameCmp =  _stricmp(pDirEnt1->filenameLStr, pDirEnt2->filenameLStr);
-	
-	if (nameCmp == 0)
-	{
-		const char* pDir1 = GetDir(pDirEnt1);
-		const char* pDir2 = GetDir(pDirEnt2);
-		nameCmp = _stricmp(pDir1, pDir2);
-	}
-    int fullCmp =  (nameCmp != 0) ? nameCmp : _stricmp(pDirEnt1->szDir, pDirEnt2->szDir);
-    return fullCmp < 0;
+    for (;;)
+    {
+        const LONGLONG keyIdx = InterlockedIncrement64(&work.nextKey) - 1;
+        if (keyIdx >= (LONGLONG)work.keys.size())
+            break;
+        DupKey& key = work.keys[keyIdx];
+        work.errors[keyIdx] = HashFileContent(key.pDirEntry, key.size, work.edges, buffer, work.pCache, key.hash);
+    }
+
+    if (work.disableWow64)
+        Wow64RevertWow64FsRedirection(oldWow64Redirection);
+    return 0;
 }
 
 // ---------------------------------------------------------------------------
-// ---------------------------------------------------------------------------
-void  LLCmp::SortDirEntries()
+// Hash keys on -j workers, keys which fail to open or read are reported
+// and removed.
+void LLCmp::HashDuplicates(std::vector<DupKey>& keys, bool edges)
 {
-    if (m_levels == 0 || m_dirSort.m_pFirst == NULL)
-        return;
+    if (keys.empty())
+        return;     // Nothing to hash, no threads, no progress divide by zero.
 
-    CompareDirLevels::SetLevels(m_levels, m_dirs);
-    typedef std::set<LLDirEntry*, bool(*)(LLDirEntry*, LLDirEntry*)> SortedSet;
-    SortedSet sortedSet(CompareDirLevels::Compare);
+    std::vector<DWORD> errors(keys.size(), 0);
+    DupHashWork work = { keys, errors, HashCachePtr(), edges, m_dirScan.m_disableWow64Redirection, 0 };
 
-    LLDirEntry*  pDirEntry = m_dirSort.m_pFirst;
-    while (pDirEntry)
+    std::vector<HANDLE> threadHnds;
+    unsigned threads = (m_dirScan.m_threads < MAXIMUM_WAIT_OBJECTS) ? m_dirScan.m_threads : MAXIMUM_WAIT_OBJECTS;
+    for (unsigned idx = 0; threads > 1 && idx < threads; idx++)
     {
-        sortedSet.insert(pDirEntry);
-        pDirEntry = pDirEntry->pNext;
+        HANDLE hThread = CreateThread(NULL, 0, DupHashThread, &work, 0, NULL);
+        if (hThread != NULL)
+            threadHnds.push_back(hThread);
+    }
+
+    if (threadHnds.empty())
+    {
+        DupHashThread(&work);
+    }
+    else
+    {
+        while (WaitForMultipleObjects((DWORD)threadHnds.size(), threadHnds.data(), TRUE, 500) == WAIT_TIMEOUT)
+        {
+            if (m_progress)
+                std::cerr << (edges ? "Edge hash " : "Full hash ")
+                    << min(work.nextKey, (LONGLONG)keys.size()) * 100 / keys.size() << "%  \r";
+        }
+        for (HANDLE hThread : threadHnds)
+            CloseHandle(hThread);
+    }
+
+    char filePath[LL_MAX_PATH];
+    size_t outIdx = 0;
+    for (size_t idx = 0; idx < keys.size(); idx++)
+    {
+        if (errors[idx] != 0)
+        {
+            sprintf_s(filePath, ARRAYSIZE(filePath), "%s\\%s", keys[idx].pDirEntry->szDir, keys[idx].pDirEntry->filenameLStr);
+            LLMsg::PresentError(errors[idx], "Open failed,", filePath);
+            m_errorCount++;
+        }
+        else
+        {
+            keys[outIdx++] = keys[idx];
+        }
     }
+    keys.resize(outIdx);
+}
 
-    pDirEntry = m_dirSort.m_pFirst = *sortedSet.begin();
-    // LLMsg::Out() << pDirEntry->szDir << pDirEntry->filenameLStr.m_str << std::endl;
-    SortedSet::iterator iter = sortedSet.begin();
-    if (iter != sortedSet.end())
+// ---------------------------------------------------------------------------
+// Group entries with the same content, groups are in increasing size order
+// and entries in a group are sorted by directory and name.
+// Entries rejected by the -X, -F and -A filters and empty files are dropped.
+void LLCmp::GroupDuplicates(DirEntryList& entries, std::vector<size_t>& groupEnds)
+{
+    std::vector<DupKey> keys;
+    keys.reserve(m_dirSort.m_count);
+    for (LLDirEntry* pDirEntry = m_dirSort.m_pFirst; pDirEntry != NULL; pDirEntry = pDirEntry->pNext)
     {
-        iter++;
-        for ( ; iter != sortedSet.end(); ++iter)
+        const ULONGLONG fileSize = m_dirSort.FileSize(*pDirEntry);
+        if (fileSize != 0 && AcceptCmpEntry(pDirEntry))
         {
-            // LLMsg::Out() << (*iter)->filenameLStr << " " << (*iter)->szDir <<  std::endl;
+            keys.push_back(DupKey{ fileSize, 0, pDirEntry });
+        }
+    }
 
-            pDirEntry->pNext = *iter;
-            (*iter)->pPrev = pDirEntry;
-            pDirEntry = *iter;
-            (*iter)->pNext = NULL;
-            // LLMsg::Out() << pDirEntry->szDir << pDirEntry->filenameLStr.m_str << std::endl;
+    // Stage 1, same size.
+    const size_t fileCnt = keys.size();
+    KeepDupRuns(keys);
+    const size_t sizeCnt = keys.size();
+
+    // Stage 2, same first and last 64K.
+    HashDuplicates(keys, true);
+    KeepDupRuns(keys);
+    const size_t edgeCnt = keys.size();
+
+    // Stage 3, full hash of groups with more than one pair to compare,
+    // a lone pair is compared directly. Small files were fully hashed.
+    std::vector<DupKey> fullKeys;
+    size_t outIdx = 0;
+    size_t beg = 0;
+    while (beg < keys.size())
+    {
+        size_t end = beg + 1;
+        while (end < keys.size() && keys[end].size == keys[beg].size && keys[end].hash == keys[beg].hash)
+            end++;
+        const bool needFull = (end - beg > 2 && keys[beg].size > 2 * (ULONGLONG)sEdgeSize);
+        while (beg < end)
+        {
+            if (needFull)
+                fullKeys.push_back(keys[beg++]);
+            else
+                keys[outIdx++] = keys[beg++];
         }
     }
+    keys.resize(outIdx);
+
+    if ( !fullKeys.empty())
+    {
+        HashDuplicates(fullKeys, false);
+        keys.insert(keys.end(), fullKeys.begin(), fullKeys.end());
+        std::vector<DupKey>().swap(fullKeys);
+        KeepDupRuns(keys);
+    }
+
+    if (m_progress)
+        std::cerr << "Files:" << fileCnt << ", Same size:" << sizeCnt
+            << ", Same edges:" << edgeCnt << ", Same hash:" << keys.size() << "    \n";
+
+    entries.resize(keys.size());
+    groupEnds.clear();
+    beg = 0;
+    while (beg < keys.size())
+    {
+        size_t end = beg + 1;
+        while (end < keys.size() && keys[end].size == keys[beg].size && keys[end].hash == keys[beg].hash)
+            end++;
+        for (size_t idx = beg; idx < end; idx++)
+            entries[idx] = keys[idx].pDirEntry;
+        std::sort(entries.begin() + beg, entries.begin() + end,
+            [](const LLDirEntry* p1, const LLDirEntry* p2)
+            {
+                int diff = _stricmp(p1->szDir, p2->szDir);
+                return (diff != 0) ? (diff < 0) : (_stricmp(p1->filenameLStr, p2->filenameLStr) < 0);
+            });
+        groupEnds.push_back(end);
+        beg = end;
+    }
 }
 
 // ---------------------------------------------------------------------------
@@ -1384,12 +3264,11 @@ int LLCmp::ProcessEntry(const char* pDir, const WIN32_FIND_DATA* pFileData, int
 
 
 // ---------------------------------------------------------------------------
-void  LLCmp::DoCmp(CmpMatch cmpMatch)
+void  LLCmp::DoCmp(unsigned levels)
 {
     int resultStatus = sIgnore;
     LLDirEntry* pDirEntry = m_dirSort.m_pFirst;
     DirEntryList cmpList;
-	char filePath[LL_MAX_PATH]; 
 
     size_t dirEntryCnt = 0;
     while (pDirEntry)
@@ -1398,21 +3277,15 @@ void  LLCmp::DoCmp(CmpMatch cmpMatch)
         pDirEntry = pDirEntry->pNext;
     }
 
-    if (dirEntryCnt == 2)
+    if (dirEntryCnt == 2 && m_matchMode != eDataOnly)
     {
         // Special Case, don't match filenames.
 
         pDirEntry = m_dirSort.m_pFirst;
         while (pDirEntry)
         {
-			sprintf_s(filePath, ARRAYSIZE(filePath), "%s\\%s", pDirEntry->szDir, pDirEntry->filenameLStr);
-
-            if ( !LLSup::PatternListMatches(m_excludeList, filePath) &&
-                LLSup::PatternListMatches(m_includeFileList, pDirEntry->filenameLStr, true) &&
-                LLSup::CompareRhsBits(pDirEntry->dwFileAttributes, m_onlyRhs))
-            {
+            if (AcceptCmpEntry(pDirEntry))
                 cmpList.push_back(pDirEntry);
-            }
             pDirEntry = pDirEntry->pNext;
         }
 
@@ -1457,30 +3330,57 @@ void  LLCmp::DoCmp(CmpMatch cmpMatch)
             break;
         }
 
-        SortDirEntries();
-        unsigned fileIdx = 0;
-        pDirEntry = m_dirSort.m_pFirst;
-        while (pDirEntry)
+        DirEntryList entries;
+        std::vector<size_t> groupEnds;
+        if (m_matchMode == eDataOnly)
+            GroupDuplicates(entries, groupEnds);
+        else
+            GroupDirEntries(levels, entries, groupEnds);
+
+        // Compare file contents on -j workers, results are taken in order.
+        // Deletes change files later pairs may read, so they stay serial.
+        // Duplicate groups never share files and -d=e2 only deletes the
+        // second file of a pair, so that case can still run in parallel.
+        const bool serialDel = (m_delCmd != eNoDel)
+            && !(m_matchMode == eDataOnly && m_delCmd == eMatchDel && m_delFiles == 1);
+        compareFileMethod = (m_compareDataMode == eCompareText)
+            ? &LLCmp::CompareDataText : &LLCmp::CompareDataBinary;
+        std::unique_ptr<ComparePipe> pipe;
+        if (m_dirScan.m_threads > 1 && m_compareDataMode != eCompareSpecs && !serialDel)
         {
-            cmpList.clear();
-
-            do
+            DirEntryList pairs;
+            size_t beg = 0;
+            for (size_t grpEnd : groupEnds)
             {
-				sprintf_s(filePath, ARRAYSIZE(filePath), "%s\\%s", pDirEntry->szDir, pDirEntry->filenameLStr);
-                if ( !LLSup::PatternListMatches(m_excludeList, filePath) &&
-					LLSup::PatternListMatches(m_includeFileList, pDirEntry->filenameLStr, true) &&
-                    LLSup::CompareRhsBits(pDirEntry->dwFileAttributes, m_onlyRhs))
+                for (size_t idx = beg + 1; idx < grpEnd; idx++)
                 {
-                    cmpList.push_back(pDirEntry);
+                    pairs.push_back(entries[beg]);
+                    pairs.push_back(entries[idx]);
                 }
-                pDirEntry = pDirEntry->pNext;
-                fileIdx++;
-            } while (pDirEntry && cmpMatch(pDirEntry, cmpList[0], m_levels));
+                beg = grpEnd;
+            }
+
+            unsigned threads = (m_dirScan.m_threads < MAXIMUM_WAIT_OBJECTS) ? m_dirScan.m_threads : MAXIMUM_WAIT_OBJECTS;
+            pipe.reset(new ComparePipe(*this, std::move(pairs), threads));
+            m_pPipe = pipe.get();
+            if (pipe->Start(threads) == 0)
+            {
+                // No worker thread, compare serially.
+                pipe.reset();
+                m_pPipe = nullptr;
+            }
+        }
+
+        size_t fileIdx = 0;
+        for (size_t grpEnd : groupEnds)
+        {
+            cmpList.assign(entries.begin() + fileIdx, entries.begin() + grpEnd);
+            fileIdx = grpEnd;
 
             if (m_progress)
             {
                 // Show file compare progress.
-                std::cerr << fileIdx * 100 / m_inFileCnt << "% ";
+                std::cerr << fileIdx * 100 / entries.size() << "% ";
                 std::cerr << " Eq:" << m_equalCount;
                 if (m_diffCount != 0)
                     std::cerr << ", Ne:" << m_diffCount;
@@ -1495,24 +3395,19 @@ void  LLCmp::DoCmp(CmpMatch cmpMatch)
                 std::cerr << "  \r";
             }
 
-            switch (m_compareDataMode)
-            {
-            case eCompareSpecs:
+            // compareFileMethod is set above, workers read it.
+            if (m_compareDataMode == eCompareSpecs)
                 resultStatus = CompareFileSpecs(cmpList);
-                break;
-            case eCompareBinary:
-                compareFileMethod = &LLCmp::CompareDataBinary;
-                resultStatus = CompareFileData(cmpList);
-                break;
-            case eCompareText:
-                compareFileMethod = &LLCmp::CompareDataText;
+            else
                 resultStatus = CompareFileData(cmpList);
-                break;
-            }
 
             if (resultStatus != sIgnore && IsQuit())
                 break;
         }
+
+        // Stop workers before they can see m_pPipe cleared.
+        pipe.reset();
+        m_pPipe = nullptr;
     }
 
     switch (m_compareDataMode)
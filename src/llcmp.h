@@ -32,10 +32,11 @@
 #pragma once
 
 #include "llbase.h"
+#include "hashcache.h"
 
 // Forward declaration
 struct DirectoryScan;
-typedef bool (*CmpMatch)(const LLDirEntry* p1, const LLDirEntry* p2, unsigned levels);
+struct DupKey;
 typedef std::vector<LLDirEntry*> DirEntryList;
 
 // ---------------------------------------------------------------------------
@@ -92,8 +93,15 @@ public:
 
     int ProcessEntry(const char* pDir, const WIN32_FIND_DATA* pFileData, int depth);
 
-    void DoCmp(CmpMatch cmpMatch);
-    void SortDirEntries();
+    // Compare groups of files matching on name and last 'levels' directories.
+    void DoCmp(unsigned levels);
+    // Hash sorted files, -h and -c.
+    int HashFiles();
+    // Entry passes -X, -F and -A filters.
+    bool AcceptCmpEntry(const LLDirEntry* pDirEntry) const;
+    void GroupDirEntries(unsigned levels, DirEntryList& entries, std::vector<size_t>& groupEnds);
+    // Group entries with the same content regardless of name, -u.
+    void GroupDuplicates(DirEntryList& entries, std::vector<size_t>& groupEnds);
 
     static LLCmpConfig sConfig;
     LLConfig&       GetConfig();
@@ -109,13 +117,18 @@ protected:
     bool        m_quiet;              // no stats, no color
     bool        m_progress;
     bool        m_showMD5hash;
+    lstring     m_hashName;         // -h=<name>, md5 xxh3 or crc32c
+    uint        m_treeChunkMB;      // -c=<chunkMB>, tree hash when not 0
+
+    lstring         m_hashCacheFile;    // -H, empty if no hash cache
+    HashCache       m_hashCache;
 
 	lstring         m_printFmt;
 	lstring			m_pushArgs;
 
     CompareDataMode m_compareDataMode;
 
-    enum MatchMode{ eNameAndData, ePathAndData };
+    enum MatchMode{ eNameAndData, ePathAndData, eDataOnly };
     MatchMode       m_matchMode;
 
     LONGLONG        m_offset;           // file offset
@@ -145,8 +158,18 @@ private:
         LONGLONG    differAt;
         ULONG       diffCnt;
         DWORD       whereCnt[100];
+        DWORD       openError;      // Open failed, reported by CompareFileData
+        unsigned    openErrorFile;  // 1 or 2
     };
 
+    HashCache* HashCachePtr()
+    { return m_hashCacheFile.empty() ? NULL : &m_hashCache; }
+    void SaveHashCache();
+
+    // Parallel compare of file pairs, -j=<threads>
+    struct ComparePipe;
+    ComparePipe*    m_pPipe;
+
     enum CompareResult { eCmpSkip = -2, eCmpErr = -1, eCmpEqual = 0, eCmpDiff = 1 };
 
     typedef CompareResult (LLCmp::*CompareFileMethod)(
@@ -167,13 +190,24 @@ private:
     // Return sIgnore, sOkay or sError
     int CompareFileData(DirEntryList& dirEntryList);
 
+    // Compare file contents, safe to call from ComparePipe workers.
+    CompareResult ComparePair(const char* filePath1, const char* filePath2,
+        CompareInfo& compareInfo, std::string& cmpResults);
+
     CompareResult CompareDataBinary(const char* filePath1, const char* filePath2,
         CompareInfo& comapreInfo, unsigned quitAfter, std::ostream&);
+    void CompareBlock(const Byte* p1, const Byte* p2, size_t len, LONGLONG filePos,
+        unsigned& quitAfter, CompareInfo& compareInfo, std::ostream& wout) const;
+    bool CompareView(const Byte* p1, const Byte* p2, size_t len, LONGLONG filePos,
+        unsigned& quitAfter, CompareInfo& compareInfo, std::ostream& wout) const;
     CompareResult CompareDataText(const char* filePath1, const char* filePath2,
         CompareInfo& comapreInfo, unsigned quitAfter, std::ostream&);
 
     void DeleteCmpFile(const char* fileToDel);
 
+    // Hash content of duplicate candidates, -u.
+    void HashDuplicates(std::vector<DupKey>& keys, bool edges);
+
 	IgnoreChar          m_ignoreChar;	// Text compare
 
     double              m_minPercentChg;
@@ -64,12 +64,14 @@ static const char sHelp[] =
 "   -A=[nrhs]           ; Limit files by attribute (n=normal r=readonly, h=hidden, s=system)\n"
 "   -D                  ; Copy directory tree if destination does not exist\n"
 "   -r                  ; Recurse starting at from directory, matching file pattern\n"
+"   -j=<threads>        ; Scan directories in parallel (use with -r)\n"
 "   -I=<file>           ; Read list of files from <file> or - for stdin \n"
 "   -W                  ; Watch (follow) source file \n"
 "   -F=<filePat>,...    ; Limit to matching file patterns \n"
 "   -X=<pathPat>,...    ; Exclude patterns  -X=*.lib,*.obj,*.exe\n"
 "                       ;  No space in patterns. Pattern applied against fullpath\n"
 "                       ;  So *\\ma will exclude a directory ma or file ma \n"
+"                       ;  Directories matching *\\ma or *\\ma\\* are not scanned \n"
 "   -Z<op><value>       ; siZe op=(Greater|Less|Equal) value=num<units G|M|K>, ex -Zg100M \n"
 "  !0eMisc options:!0f\n"
 "   -B=c                ; Add additional field separators to use with #n selection\n"
@@ -51,6 +51,7 @@ static const char sHelp[] =
 "   -f                  ; Force delete even if destination is set to read only\n"
 "   -I=<infile>         ; Read filenames from infile or stdin if -\n"
 "   -j                  ; Follow junctions (default: skip junctions)\n"
+"   -j=<threads>        ; Scan directories in parallel (use with -r)\n"
 "   -n                  ; No delete, just echo command\n"
 "   -o or -O            ; Over write file before deletion for security\n"
 "   -p                  ; Prompt before delete\n"
@@ -72,6 +73,7 @@ static const char sHelp[] =
 "   -X=<pathPat>,...    ; Exclude patterns  -X=*.lib,*.obj,*.exe\n"
 "                       ;  No space in patterns. Pattern applied against fullpath\n"
 "                       ;  So *\\ma will exclude a directory ma or file ma \n"
+"                       ;  Directories matching *\\ma or *\\ma\\* are not scanned \n"
 "   -Z<op><value>       ; siZe op=(Greater|Less|Equal) value=num<units G|M|K>, ex -Zg100M \n"
 "   -1=<output>         ; Redirect output to file \n"
 "   -?                  ; Show this help\n"
@@ -157,6 +159,7 @@ int LLDel::Run(const char* cmdOpts, int argc, const char* pDirs[])
     // Initialize stuff
     size_t nFiles = 0;
     m_dirScan.m_skipJunction = true;
+    m_dirScan.m_findFirst = DirectoryScan::FindFirstClassic;  // Need 8.3 name to remove bad names.
     bool sortNeedAllData = m_showSize;
 
     if (argc == 0 && *cmdOpts == '\0')
@@ -171,6 +174,13 @@ int LLDel::Run(const char* cmdOpts, int argc, const char* pDirs[])
             m_force = true;
             break;
         case 'j':
+            if (cmdOpts[1] == sEQchr)
+            {
+                // -j=<threads> parallel scan
+                if ( !ParseBaseCmds(cmdOpts))
+                    return sError;
+                break;
+            }
             m_dirScan.m_skipJunction = false;
             break;
 
@@ -236,7 +246,7 @@ int LLDel::Run(const char* cmdOpts, int argc, const char* pDirs[])
 
     if (m_inFile.length() != 0)
     {
-        LLSup::ReadFileList(m_inFile.c_str(), EntryCb, this);
+        LLSup::ReadFileList(m_inFile.c_str(), EntryCb, this, 0, MetaDemand());
     }
 
     // Iterate over dir patterns.
@@ -329,6 +339,16 @@ static int reportProcessOpenFile(const char* filePath) {
 }
 
 
+// ---------------------------------------------------------------------------
+unsigned LLDel::MetaDemand() const
+{
+    // Size always needed for deleted bytes summary.
+    unsigned metaDemand = FilterMetaDemand() | m_dirSort.MetaDemand() | LLSup::eMetaSize;
+    if (m_showCtime || m_showMtime || m_showAtime)
+        metaDemand |= LLSup::eMetaTime;
+    return metaDemand;
+}
+
 // ---------------------------------------------------------------------------
 int LLDel::ProcessEntry(
         const char* pDir,
@@ -101,6 +101,9 @@ protected:
 protected:
     // Return 1 if output anything, 0 if nothing, -1 if error.
     virtual int ProcessEntry(const char* pDir, const WIN32_FIND_DATA* pFileData, int depth);
+
+    // File metadata needed by filters, sort and shown columns.
+    virtual unsigned MetaDemand() const;
 };
 
 
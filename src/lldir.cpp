@@ -106,6 +106,7 @@ static const char sHelp[] =
 "   -D                  ; Show only directories\n"
 "   -F                  ; Show only files\n"
 "   -i                  ; Show fileId (use with -L)\n"
+"   -j=<threads>        ; Scan directories in parallel (use with -r), output order not sorted\n"
 "   -L                  ; Show hard link count and any Alternate Data Streams\n"
 "   -N or -n            ; Show just names, same as -h -s -tn -q\n"
 "   -p                  ; Show full file path\n"
@@ -113,6 +114,7 @@ static const char sHelp[] =
 "   -q                  ; Quiet, dont show stats, no color\n"
 "   -Q=n                ; Quit after 'n' lines output\n"
 "   -S=[-][acmnenpst]   ; Sort on a=access,c=creation,m=modify time, e=ext, n=name, p=path, s=size or t=type. -=reverse\n"
+"   -S=s:mem=<size>     ; Sort in <size>[KMG] memory, larger listings spill sorted runs to temp files\n"
 "   -t=[acm]            ; Show Time a=access, c=creation, m=modified, n=none\n"
 "   -T=[acm]<op><value> ; Test Time a=access, c=creation, m=modified\n"
 "                       ; op=(Greater|Less|Equal)  Value= now|+/-num[d|h|m]|yyyy:mm:dd:hh:mm:ss \n"
@@ -127,6 +129,7 @@ static const char sHelp[] =
 "   -X=<pathPat>,...    ; Exclude patterns  -X=*.lib,*.obj,*.exe\n"
 "                       ;  No space in patterns. Pattern applied against fullpath\n"
 "                       ;  So *\\ma will exclude a directory ma or file ma \n"
+"                       ;  Directories matching *\\ma or *\\ma\\* are not scanned \n"
 "   -Z<op><value>       ; siZe op=(Greater|Less|Equal) value=num<units G|M|K>, ex -Zg100M \n"
 "   -C=<colorOpt>       ; Set colors, colors are red,green,blue,intensity, add bg to end of color for background\n"
 "    -C=r<colors>       ;   readonly  ex -C=r+red+blue or -C=r+bluebg\n"
@@ -1019,6 +1022,37 @@ int LLDir::Run(const char* cmdOpts, int argc, const char* pDirs[])
                 case 'c':   // create Time
                     m_dirSort.SetSort(m_dirScan, sortOpt, sortNeedAllData, sortInc);
                     break;
+
+                case ':':   // Memory budget, :mem=<size>[KMG]
+                    if (_strnicmp(cmdOpts+1, "mem=", 4) == 0 && isdigit((unsigned char)cmdOpts[5]))
+                    {
+                        char* endPtr = (char*)cmdOpts;
+                        errno = 0;
+                        ULONGLONG memBudget = _strtoui64(cmdOpts+5, &endPtr, 10);
+                        unsigned shift = 0;
+                        switch (ToLower(*endPtr))
+                        {
+                        case 'k':   shift = 10;   endPtr++;   break;
+                        case 'm':   shift = 20;   endPtr++;   break;
+                        case 'g':   shift = 30;   endPtr++;   break;
+                        }
+
+                        // Zero or too large would spill every entry, report as bad option.
+                        if (errno == ERANGE || memBudget == 0 || memBudget > (SIZE_MAX >> shift))
+                        {
+                            unknownOpt = true;
+                            cmdOpts--;
+                            break;
+                        }
+                        m_dirSort.SetMemoryBudget((size_t)(memBudget << shift));
+                        cmdOpts = endPtr - 1;
+                    }
+                    else
+                    {
+                        unknownOpt = true;
+                        cmdOpts--;
+                    }
+                    break;
                 default:    unknownOpt = true;   cmdOpts--; break;
                 }
             }
@@ -1150,8 +1184,16 @@ int LLDir::Run(const char* cmdOpts, int argc, const char* pDirs[])
     }
 
     m_dirSort.SetSortAttr(m_onlyAttr);
+
+    // Sorted output limited by -Q only needs to keep the top entries.
+    if (m_dirScan.m_add_cb == LLDirSort::SortCb && m_limitOut != 0 && !m_showUsage)
+        m_dirSort.SetTopLimit(m_limitOut, AcceptDirCb, this);
     m_dirScan.m_filesFirst = m_dirScan.m_recurse && !m_showUsage;
 
+    // Usage summary and inverted lists track directory depth order, need serial scan.
+    if (m_showUsage || !m_invertedList.empty())
+        m_dirScan.m_threads = 1;
+
     // If just showing path, remove leading space.
     if (m_showPath && !m_showSize && !m_showAttr && !m_showAtime  && !m_showCtime && !m_showMtime)
         LLDir::sConfig.m_dirFieldSep = "";
@@ -1167,11 +1209,11 @@ int LLDir::Run(const char* cmdOpts, int argc, const char* pDirs[])
     if (m_inFile.length() != 0)
     {
         if (m_invertedList.empty()) 
-            LLSup::ReadFileList(m_inFile.c_str(), EntryCb, this);
+            LLSup::ReadFileList(m_inFile.c_str(), EntryCb, this, 0, MetaDemand());
         else 
         {
             // Handle inverted search.
-            LLSup::ReadFileList(m_inFile.c_str(), InvertEntryCb, this);
+            LLSup::ReadFileList(m_inFile.c_str(), InvertEntryCb, this, 0, MetaDemand());
         }
     }
 
@@ -1204,7 +1246,10 @@ int LLDir::Run(const char* cmdOpts, int argc, const char* pDirs[])
     }
 
     if (m_dirScan.m_add_cb != EntryCb && m_dirScan.m_add_cb != InvertEntryCb)
+    {
         m_dirSort.ShowSorted(EntryCb, this);
+        m_dirSort.Clear();      // Release sorted entries before a long -W watch.
+    }
 
     if ( !m_quiet)
     {
@@ -1217,6 +1262,10 @@ int LLDir::Run(const char* cmdOpts, int argc, const char* pDirs[])
             LLMsg::Out() << " MinCreationTime:", LLSup::Format(LLMsg::Out(), m_minCTime) << " " ;
         if (m_showAtime)
             LLMsg::Out() << " MaxAccessTime:", LLSup::Format(LLMsg::Out(), m_maxATime) << " ";
+        if (m_verbose)
+            LLMsg::Out() << " FindFirst:" << m_dirScan.m_stats.findFirst
+                << " FindNext:" << m_dirScan.m_stats.findNext
+                << " Pruned:" << m_dirScan.m_stats.pruned;
 
         LLMsg::Out() << std::endl;
         // SetColor(sConfig.m_colorNormal);
@@ -1555,6 +1604,16 @@ void LLDir::ShowHeader(const char* pDir, const WIN32_FIND_DATA* pFileData)
 #pragma warning(pop)
 
 
+// ---------------------------------------------------------------------------
+unsigned LLDir::MetaDemand() const
+{
+    unsigned metaDemand = FilterMetaDemand() | m_dirSort.MetaDemand();
+    if (m_showSize || m_showUsage)
+        metaDemand |= LLSup::eMetaSize;
+    if (m_showCtime || m_showMtime || m_showAtime)
+        metaDemand |= LLSup::eMetaTime;
+    return metaDemand;
+}
 
 // ---------------------------------------------------------------------------
 // Return 1 if output anything, 0 if nothing, -1 if error.
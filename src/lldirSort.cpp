@@ -30,43 +30,31 @@
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 #include "lldirSort.h"
 #include "llsupport.h"
+#include "llmsg.h"
 
 
 LLPool<const char> LLString::m_pool;
 
+// Tie break used by extension sort, see LLDirSort::Sort
 int (*CompareData)(const LLDirEntry* pDirLeft, const LLDirEntry* pDirRight) = 0;
 
 // ---------------------------------------------------------------------------
-void FillEntryName(LLDirEntry& dirEntry, const WIN32_FIND_DATA& findData, const LLDirSort& dirSort)
+// Compare extension then name, names without extension first.
+static int CompareNameExt(const char* pLeftName, const char* pRightName)
 {
-    dirEntry.lvalue[0].ft = findData.ftCreationTime;
-    dirEntry.lvalue[1].ft = findData.ftLastAccessTime;
-    dirEntry.lvalue[2].ft = findData.ftLastWriteTime;
-    dirEntry.lvalue[3].li.HighPart = findData.nFileSizeHigh;
-    dirEntry.lvalue[3].li.LowPart = findData.nFileSizeLow;
-}
-
-// ---------------------------------------------------------------------------
-void FillFindDataName(WIN32_FIND_DATA& findData, const LLDirEntry& dirEntry, const LLDirSort& dirSort)
-{
-    findData.ftCreationTime   = dirEntry.lvalue[0].ft;
-    findData.ftLastAccessTime = dirEntry.lvalue[1].ft;
-    findData.ftLastWriteTime  = dirEntry.lvalue[2].ft;
-    findData.nFileSizeHigh    = dirEntry.lvalue[3].li.HighPart;
-    findData.nFileSizeLow     = dirEntry.lvalue[3].li.LowPart;
+    const char* pLeftExt = strrchr(pLeftName, '.');
+    const char* pRightExt = strrchr(pRightName, '.');
+    int diffExt = _stricmp(pLeftExt ? pLeftExt : "", pRightExt ? pRightExt : "");
+    return diffExt ? diffExt : _stricmp(pLeftName, pRightName);
 }
 
 // ---------------------------------------------------------------------------
 int CompareDataExtInc(const LLDirEntry* pDirLeft, const LLDirEntry* pDirRight)
 {
-    const char* pLeftExt = strrchr(pDirLeft->filenameLStr, '.');
-    const char* pRightExt = strrchr(pDirRight->filenameLStr, '.');
-    if (pLeftExt == 0 || pRightExt == 0)
-        return (int)((size_t)pLeftExt & 0x8fff) - (int)((size_t)pRightExt & 0x8fff);
-    int diffExt = _stricmp(pLeftExt, pRightExt);
-    return diffExt ? diffExt : _stricmp(pDirLeft->filenameLStr, pDirRight->filenameLStr);
+    return CompareNameExt(pDirLeft->filenameLStr, pDirRight->filenameLStr);
 }
 
 // ---------------------------------------------------------------------------
@@ -88,445 +76,1023 @@ int CompareDataNameDec(const LLDirEntry* pDirLeft, const LLDirEntry* pDirRight)
 }
 
 // ---------------------------------------------------------------------------
-int CompareDataPathInc(const LLDirEntry* pDirLeft, const LLDirEntry* pDirRight)
+static ULONGLONG FileTimeValue(const FILETIME& fileTime)
 {
-    // int dirCmp = _stricmp(pDirLeft->szDir, pDirRight->szDir);
-    // return (dirCmp == 0) ? _stricmp(pDirLeft->filenameLStr, pDirRight->filenameLStr) : dirCmp;
-    return _stricmp(pDirLeft->filenameLStr, pDirRight->filenameLStr);
+    return ((ULONGLONG)fileTime.dwHighDateTime << 32) | fileTime.dwLowDateTime;
 }
 
 // ---------------------------------------------------------------------------
-int CompareDataPathDec(const LLDirEntry* pDirLeft, const LLDirEntry* pDirRight)
+static void SetFileTime(FILETIME& fileTime, ULONGLONG value)
 {
-    return -CompareDataPathInc(pDirLeft, pDirRight);
+    fileTime.dwHighDateTime = (DWORD)(value >> 32);
+    fileTime.dwLowDateTime  = (DWORD)value;
 }
 
 // ---------------------------------------------------------------------------
-int CompareDataTypeInc(const LLDirEntry* pDirLeft, const LLDirEntry* pDirRight)
+// First 8 characters lower cased, big endian so integer order matches _stricmp.
+static ULONGLONG NameKey(const char* name)
 {
-    int attCmp = pDirLeft->dwFileAttributes - pDirRight->dwFileAttributes;
-    return (attCmp == 0) ? CompareDataNameInc(pDirLeft, pDirRight) : attCmp;
+    ULONGLONG key = 0;
+    unsigned idx = 0;
+    for (; idx < 8 && name[idx] != '\0'; idx++)
+        key = (key << 8) | (unsigned char)tolower((unsigned char)name[idx]);
+    for (; idx < 8; idx++)
+        key <<= 8;
+    return key;
 }
 
 // ---------------------------------------------------------------------------
-int CompareDataTypeDec(const LLDirEntry* pDirLeft, const LLDirEntry* pDirRight)
+LLDirEntry::LLDirEntry(
+        const char* fileName,
+        const char* dir,
+        int baseDirLength,
+        DWORD entryRow,
+        LLPool<const char>& namePool) :
+    pPrev(0),
+    pNext(0),
+    filenameLStr(fileName, namePool),
+    szDir(dir),
+    baseDirLen(baseDirLength),
+    row(entryRow)
 {
-    return -CompareDataTypeInc(pDirLeft, pDirRight);
 }
 
-
 // ---------------------------------------------------------------------------
-void FillEntryAtime(LLDirEntry& dirEntry, const WIN32_FIND_DATA& findData, const LLDirSort& dirSort)
+int LLDirSort::SortCb(
+        void* cbData,
+        const char* pDir,
+        const WIN32_FIND_DATA* pFileData,
+        int depth)
 {
-    // Sort on value[0], set to accessTime
-    dirEntry.lvalue[0].ft = findData.ftLastAccessTime;
+    LLDirSort* pDirSort = (LLDirSort*)cbData;
+
+    if (depth < 0)
+        return 0;     // ignore end-of-directory
 
-    // Also copy non-sort fields
-    assert(dirSort.m_values == 0 || dirSort.m_values == 4);
-    if (dirSort.m_values == 4)
+    LLDirEntry* pDirEntry = NULL;
+    try
     {
-        dirEntry.lvalue[1].ft = findData.ftCreationTime;
-        dirEntry.lvalue[2].ft = findData.ftLastWriteTime;
-        dirEntry.lvalue[3].li.HighPart = findData.nFileSizeHigh;
-        dirEntry.lvalue[3].li.LowPart  = findData.nFileSizeLow;
+		if ((pFileData->dwFileAttributes & pDirSort->m_onlyAttr) != 0)
+		{
+			if (pDirSort->m_topLimit != 0)
+			{
+				if (pDirSort->m_acceptCb == nullptr
+					|| pDirSort->m_acceptCb(pDirSort->m_acceptData, pDir, pFileData, depth))
+					pDirSort->AddTop(pDir, *pFileData);
+				return 1;
+			}
+
+			_CrtCheckMemory( );
+			// Create dir entry (adds string to pool), metadata goes in columns.
+			const DWORD row = (DWORD)pDirSort->m_entries.size();
+			pDirEntry = pDirSort->NewEntry(pDir, pFileData->cFileName, row);
+			pDirSort->AddRow(*pFileData);
+			pDirSort->m_entries.push_back(pDirEntry);
+			pDirSort->m_count++;
+			_CrtCheckMemory( );
+
+			if (pDirSort->m_memBudget != 0 && (pDirSort->m_entries.size() & 0xfff) == 0
+				&& pDirSort->MemoryUsed() > pDirSort->m_memBudget
+				&& !pDirSort->SpillRun())
+				pDirSort->m_memBudget = 0;      // Spill failed, keep rest in memory.
+		}
     }
+    catch (...)
+    {
+        delete pDirEntry;
+    }
+
+    return 1;
 }
 
 // ---------------------------------------------------------------------------
-void FillFindDataAtime(WIN32_FIND_DATA& findData, const LLDirEntry& dirEntry, const LLDirSort& dirSort)
+// Return pooled copy of directory, made once per distinct directory so
+// interleaved directories (-I lists, parallel scan batches) are not duplicated.
+const char* LLDirSort::InternDir(const char* pDir)
 {
-    findData.ftLastAccessTime = dirEntry.lvalue[0].ft;
+    // Keep table at most half full.
+    if (m_dirCount * 2 >= m_dirSlots.size())
+    {
+        std::vector<DirSlot> oldSlots(m_dirSlots.empty() ? 1024 : m_dirSlots.size() * 2);
+        oldSlots.swap(m_dirSlots);
+        for (const DirSlot& slot : oldSlots)
+        {
+            if (slot.pDir != nullptr)
+            {
+                size_t idx = slot.hash & (m_dirSlots.size() - 1);
+                while (m_dirSlots[idx].pDir != nullptr)
+                    idx = (idx + 1) & (m_dirSlots.size() - 1);
+                m_dirSlots[idx] = slot;
+            }
+        }
+    }
+
+    // FNV-1a
+    size_t hash = 14695981039346656037ULL;
+    for (const char* pChr = pDir; *pChr != '\0'; pChr++)
+        hash = (hash ^ (unsigned char)*pChr) * 1099511628211ULL;
 
-    assert(dirSort.m_values == 0 || dirSort.m_values == 4);
-    if (dirSort.m_values == 4)
+    size_t idx = hash & (m_dirSlots.size() - 1);
+    for (; m_dirSlots[idx].pDir != nullptr; idx = (idx + 1) & (m_dirSlots.size() - 1))
     {
-        findData.ftCreationTime   = dirEntry.lvalue[1].ft;
-        findData.ftLastWriteTime  = dirEntry.lvalue[2].ft;
-        findData.nFileSizeHigh    = dirEntry.lvalue[3].li.HighPart;
-        findData.nFileSizeLow     = dirEntry.lvalue[3].li.LowPart;
+        if (m_dirSlots[idx].hash == hash && strcmp(m_dirSlots[idx].pDir, pDir) == 0)
+            return m_dirSlots[idx].pDir;
     }
+
+    m_dirSlots[idx].hash = hash;
+    m_dirSlots[idx].pDir = LLString(pDir, m_namePool);
+    m_dirCount++;
+    return m_dirSlots[idx].pDir;
 }
 
 // ---------------------------------------------------------------------------
-void FillEntryCtime(LLDirEntry& dirEntry, const WIN32_FIND_DATA& findData, const LLDirSort& dirSort)
+// Create dir entry, name and directory go in m_namePool.
+LLDirEntry* LLDirSort::NewEntry(const char* pDir, const char* pName, DWORD row)
 {
-    // Sort on value[0], set to creationTime
-    dirEntry.lvalue[0].ft = findData.ftCreationTime;
-
-    // Also copy non-sort fields
-    assert(dirSort.m_values == 0 || dirSort.m_values == 4);
-    if (dirSort.m_values == 4)
+    if (m_commonDir == nullptr || strcmp(pDir, m_commonDir) != 0)
     {
-        dirEntry.lvalue[1].ft = findData.ftLastWriteTime;
-        dirEntry.lvalue[2].ft = findData.ftLastAccessTime;
-        dirEntry.lvalue[3].li.HighPart = findData.nFileSizeHigh;
-        dirEntry.lvalue[3].li.LowPart  = findData.nFileSizeLow;
+        m_commonDir = InternDir(pDir);
     }
+
+    return new (m_pool) LLDirEntry(pName, m_commonDir, m_baseDirLen, row, m_namePool);
 }
 
 // ---------------------------------------------------------------------------
-void FillFindDataCtime(WIN32_FIND_DATA& findData, const LLDirEntry& dirEntry, const LLDirSort& dirSort)
+void LLDirSort::AddRow(const WIN32_FIND_DATA& findData)
 {
-    findData.ftCreationTime = dirEntry.lvalue[0].ft;
+    m_attributes.push_back(findData.dwFileAttributes);
+    if (HasColumn('s'))
+        m_sizes.push_back(((ULONGLONG)findData.nFileSizeHigh << 32) | findData.nFileSizeLow);
+    if (HasColumn('c'))
+        m_ctimes.push_back(FileTimeValue(findData.ftCreationTime));
+    if (HasColumn('a'))
+        m_atimes.push_back(FileTimeValue(findData.ftLastAccessTime));
+    if (HasColumn('m'))
+        m_mtimes.push_back(FileTimeValue(findData.ftLastWriteTime));
+}
+
+// ---------------------------------------------------------------------------
+void LLDirSort::SetRow(DWORD row, const WIN32_FIND_DATA& findData)
+{
+    m_attributes[row] = findData.dwFileAttributes;
+    if (HasColumn('s'))
+        m_sizes[row] = ((ULONGLONG)findData.nFileSizeHigh << 32) | findData.nFileSizeLow;
+    if (HasColumn('c'))
+        m_ctimes[row] = FileTimeValue(findData.ftCreationTime);
+    if (HasColumn('a'))
+        m_atimes[row] = FileTimeValue(findData.ftLastAccessTime);
+    if (HasColumn('m'))
+        m_mtimes[row] = FileTimeValue(findData.ftLastWriteTime);
+}
+
+// ---------------------------------------------------------------------------
+// Heap order, higher ranked entry first so heap front is the lowest ranked.
+bool LLDirSort::TopLess(const TopItem& lhs, const TopItem& rhs) const
+{
+    int diff = CompareOrder(lhs.key, m_entries[lhs.row]->filenameLStr,
+        rhs.key, m_entries[rhs.row]->filenameLStr);
+    return (diff != 0) ? (diff < 0) : (lhs.seq < rhs.seq);
+}
+
+// ---------------------------------------------------------------------------
+// Add entry if it ranks in the top m_topLimit, replacing the lowest ranked.
+// Replaced entries stay in the pools until CompactTop.
+void LLDirSort::AddTop(const char* pDir, const WIN32_FIND_DATA& findData)
+{
+    auto topLess = [this](const TopItem& lhs, const TopItem& rhs) { return TopLess(lhs, rhs); };
+
+    const ULONGLONG key = SortKey(findData);
+    DWORD row;
+    if (m_top.size() >= m_topLimit)
+    {
+        // Ties keep earlier entry.
+        const TopItem& lowest = m_top.front();
+        if (CompareOrder(key, findData.cFileName, lowest.key, m_entries[lowest.row]->filenameLStr) >= 0)
+            return;
 
-    assert(dirSort.m_values == 0 || dirSort.m_values == 4);
-    if (dirSort.m_values == 4)
+        row = lowest.row;
+        std::pop_heap(m_top.begin(), m_top.end(), topLess);
+        m_top.pop_back();
+        m_entries[row] = NewEntry(pDir, findData.cFileName, row);
+        SetRow(row, findData);
+        m_topReplaced++;
+    }
+    else
     {
-        findData.ftLastWriteTime  = dirEntry.lvalue[1].ft;
-        findData.ftLastAccessTime = dirEntry.lvalue[2].ft;
-        findData.nFileSizeHigh    = dirEntry.lvalue[3].li.HighPart;
-        findData.nFileSizeLow     = dirEntry.lvalue[3].li.LowPart;
+        row = (DWORD)m_entries.size();
+        m_entries.push_back(NewEntry(pDir, findData.cFileName, row));
+        AddRow(findData);
     }
+
+    m_top.push_back(TopItem{ key, m_count++, row });
+    std::push_heap(m_top.begin(), m_top.end(), topLess);
+    m_sortedCount = 0;
+
+    if (m_topReplaced > m_topLimit + 4096)
+        CompactTop();
 }
 
 // ---------------------------------------------------------------------------
-void FillEntryMtime(LLDirEntry& dirEntry, const WIN32_FIND_DATA& findData, const LLDirSort& dirSort)
+// Rebuild kept top entries in scan order, releasing replaced entries.
+void LLDirSort::CompactTop()
 {
-    // Sort on value[0], set to writeTime
-    dirEntry.lvalue[0].ft = findData.ftLastWriteTime;
+    struct TopEntry
+    {
+        ULONGLONG       seq;
+        std::string     dir;
+        WIN32_FIND_DATA findData;
+    };
 
-    // Also copy non-sort fields
-    assert(dirSort.m_values == 0 || dirSort.m_values == 4);
-    if (dirSort.m_values == 4)
+    std::vector<TopEntry> topEntries(m_top.size());
+    for (size_t idx = 0; idx < m_top.size(); idx++)
     {
-        dirEntry.lvalue[1].ft = findData.ftCreationTime;
-        dirEntry.lvalue[2].ft = findData.ftLastAccessTime;
-        dirEntry.lvalue[3].li.HighPart = findData.nFileSizeHigh;
-        dirEntry.lvalue[3].li.LowPart = findData.nFileSizeLow;
+        const LLDirEntry& dirEntry = *m_entries[m_top[idx].row];
+        TopEntry& topEntry = topEntries[idx];
+        topEntry.seq = m_top[idx].seq;
+        topEntry.dir = dirEntry.szDir;
+        ClearMemory(&topEntry.findData, sizeof(topEntry.findData));
+        strncpy_s(topEntry.findData.cFileName, ARRAYSIZE(topEntry.findData.cFileName), dirEntry.filenameLStr, _TRUNCATE);
+        FillFindData(topEntry.findData, dirEntry);
     }
+    std::sort(topEntries.begin(), topEntries.end(),
+        [](const TopEntry& lhs, const TopEntry& rhs) { return lhs.seq < rhs.seq; });
+
+    ReleaseEntries();
+    for (const TopEntry& topEntry : topEntries)
+    {
+        const DWORD row = (DWORD)m_entries.size();
+        m_entries.push_back(NewEntry(topEntry.dir.c_str(), topEntry.findData.cFileName, row));
+        AddRow(topEntry.findData);
+        m_top.push_back(TopItem{ SortKey(row), topEntry.seq, row });
+    }
+    std::make_heap(m_top.begin(), m_top.end(),
+        [this](const TopItem& lhs, const TopItem& rhs) { return TopLess(lhs, rhs); });
 }
 
 // ---------------------------------------------------------------------------
-void FillFindDataMtime(WIN32_FIND_DATA& findData, const LLDirEntry& dirEntry, const LLDirSort& dirSort)
+// Packed sort key, integer order agrees with sort order:
+//      a,c,m   ; file time
+//      s       ; size
+//      t       ; attributes and first 4 name characters
+//      e       ; none, extension sort uses CompareData
+//      other   ; first 8 name characters, see NameKey
+// Decreasing sort inverts the key.
+ULONGLONG LLDirSort::SortKey(ULONGLONG fieldValue, DWORD attributes, const char* pName) const
 {
-    findData.ftLastWriteTime = dirEntry.lvalue[0].ft;
+    ULONGLONG key;
+    switch (m_sortKey)
+    {
+    case 'a':
+    case 'c':
+    case 'm':
+    case 's':
+        key = fieldValue;
+        break;
+    case 't':
+        key = ((ULONGLONG)attributes << 32) | (NameKey(pName) >> 32);
+        break;
+    case 'e':
+        return 0;
+    default:
+        key = NameKey(pName);
+        break;
+    }
 
-    assert(dirSort.m_values == 0 || dirSort.m_values == 4);
-    if (dirSort.m_values == 4)
+    return m_sortIncreasing ? key : ~key;
+}
+
+// ---------------------------------------------------------------------------
+ULONGLONG LLDirSort::SortKey(DWORD row) const
+{
+    ULONGLONG fieldValue = 0;
+    switch (m_sortKey)
     {
-        findData.ftCreationTime   = dirEntry.lvalue[1].ft;
-        findData.ftLastAccessTime = dirEntry.lvalue[2].ft;
-        findData.nFileSizeHigh    = dirEntry.lvalue[3].li.HighPart;
-        findData.nFileSizeLow     = dirEntry.lvalue[3].li.LowPart;
+    case 'a':
+        fieldValue = m_atimes[row];
+        break;
+    case 'c':
+        fieldValue = m_ctimes[row];
+        break;
+    case 'm':
+        fieldValue = m_mtimes[row];
+        break;
+    case 's':
+        fieldValue = m_sizes[row];
+        break;
     }
+
+    return SortKey(fieldValue, m_attributes[row], m_entries[row]->filenameLStr);
 }
 
 // ---------------------------------------------------------------------------
-int CompareDataFtimeInc(const LLDirEntry* pDirLeft, const LLDirEntry* pDirRight)
+ULONGLONG LLDirSort::SortKey(const WIN32_FIND_DATA& findData) const
 {
-    int tmDiff =  CompareFileTime(&pDirLeft->lvalue[0].ft, &pDirRight->lvalue[0].ft);
-    return (tmDiff == 0) ? CompareDataNameInc(pDirLeft, pDirRight) : tmDiff;
+    ULONGLONG fieldValue = 0;
+    switch (m_sortKey)
+    {
+    case 'a':
+        fieldValue = FileTimeValue(findData.ftLastAccessTime);
+        break;
+    case 'c':
+        fieldValue = FileTimeValue(findData.ftCreationTime);
+        break;
+    case 'm':
+        fieldValue = FileTimeValue(findData.ftLastWriteTime);
+        break;
+    case 's':
+        fieldValue = ((ULONGLONG)findData.nFileSizeHigh << 32) | findData.nFileSizeLow;
+        break;
+    }
+
+    return SortKey(fieldValue, findData.dwFileAttributes, findData.cFileName);
 }
 
 // ---------------------------------------------------------------------------
-int CompareDataFtimeDec(const LLDirEntry* pDirLeft, const LLDirEntry* pDirRight)
+// Full sort order of two entries given their SortKey and name, ties are left
+// to the caller (scan order).
+int LLDirSort::CompareOrder(
+        ULONGLONG leftKey, const char* pLeftName,
+        ULONGLONG rightKey, const char* pRightName) const
 {
-    return -CompareDataFtimeInc(pDirLeft, pDirRight);
+    if (leftKey != rightKey)
+        return (leftKey < rightKey) ? -1 : 1;
+    int diff = (m_sortKey == 'e') ? CompareNameExt(pLeftName, pRightName) : _stricmp(pLeftName, pRightName);
+    return m_sortIncreasing ? diff : -diff;
 }
 
 // ---------------------------------------------------------------------------
-void FillEntrySize(LLDirEntry& dirEntry, const WIN32_FIND_DATA& findData, const LLDirSort& dirSort)
+void LLDirSort::FillFindData(WIN32_FIND_DATA& findData, const LLDirEntry& dirEntry) const
 {
-    // Sort on value[0], set to file size.
-    dirEntry.lvalue[0].li.HighPart = findData.nFileSizeHigh;
-    dirEntry.lvalue[0].li.LowPart = findData.nFileSizeLow;
+    const DWORD row = dirEntry.row;
+    const ULONGLONG size = HasColumn('s') ? m_sizes[row] : 0;
 
-    // Also copy non-sort fields
-    assert(dirSort.m_values == 4);
-    if (dirSort.m_values == 4)
+    findData.dwFileAttributes = m_attributes[row];
+    findData.nFileSizeHigh    = (DWORD)(size >> 32);
+    findData.nFileSizeLow     = (DWORD)size;
+    SetFileTime(findData.ftCreationTime, HasColumn('c') ? m_ctimes[row] : 0);
+    SetFileTime(findData.ftLastAccessTime, HasColumn('a') ? m_atimes[row] : 0);
+    SetFileTime(findData.ftLastWriteTime, HasColumn('m') ? m_mtimes[row] : 0);
+}
+
+// ---------------------------------------------------------------------------
+void LLDirSort::SetSort(
+        DirectoryScan& dirScan,
+        const char* sortOpt,
+        bool needAllData,
+        bool sortIncreasing)
+{
+    m_values = -1;
+
+    m_sortIncreasing = sortIncreasing;
+    for (; sortOpt && *sortOpt; sortOpt++)
+    {
+        m_sortKey = *sortOpt;
+        switch (*sortOpt)
+        {
+        case 'a':   // Sort access time
+        case 'c':   // Sort creation time
+        case 'm':   // Sort modify time
+        case 's':   // Sort size
+            m_values = needAllData ? 4 : 1;
+            CompareData = sortIncreasing ? CompareDataNameInc : CompareDataNameDec;
+            break;
+        case 'e':
+            // Sort extension
+            m_values = needAllData ? 4 : 0;
+            CompareData = sortIncreasing ? CompareDataExtInc : CompareDataExtDec;
+            break;
+        case 'n':   // Sort fileName
+        case 'p':   // Sort file path  (dir+name)
+        case 't':   // Sort attributes, type (file, dir, etc)
+        default:
+            m_values = needAllData ? 4 : 0;
+            CompareData = sortIncreasing ? CompareDataNameInc : CompareDataNameDec;
+            break;
+        }
+    }
+
+    assert(m_values != -1);
+
+    if (m_values != -1)
     {
-        dirEntry.lvalue[1].ft = findData.ftCreationTime;
-        dirEntry.lvalue[2].ft = findData.ftLastAccessTime;
-        dirEntry.lvalue[3].ft = findData.ftLastWriteTime;
+        dirScan.m_add_cb     = LLDirSort::SortCb;
+        dirScan.m_cb_data    = this;
     }
 }
 
 // ---------------------------------------------------------------------------
-void FillFindDataSize(WIN32_FIND_DATA& findData, const LLDirEntry& dirEntry, const LLDirSort& dirSort)
+void LLDirSort::SetSortData(bool needAllData)
 {
-    findData.nFileSizeHigh = dirEntry.lvalue[0].li.HighPart;
-    findData.nFileSizeLow = dirEntry.lvalue[0].li.LowPart;
+    if (needAllData)
+        m_values = 4;
+}
 
-    assert(dirSort.m_values == 4);
-    if (dirSort.m_values == 4)
+// ---------------------------------------------------------------------------
+unsigned LLDirSort::MetaDemand() const
+{
+    if (m_values == 4)
+        return LLSup::eMetaAll;
+
+    switch (m_sortKey)
     {
-        findData.ftCreationTime   = dirEntry.lvalue[1].ft;
-        findData.ftLastAccessTime = dirEntry.lvalue[2].ft;
-        findData.ftLastWriteTime  = dirEntry.lvalue[3].ft;
+    case 's':
+        return LLSup::eMetaSize;
+    case 'a':
+    case 'c':
+    case 'm':
+        return LLSup::eMetaTime;
     }
+    return LLSup::eMetaAttr;
 }
 
 // ---------------------------------------------------------------------------
-int CompareDataSizeInc(const LLDirEntry* pDirLeft, const LLDirEntry* pDirRight)
+/// Set which Directory attributes we care about.
+
+void LLDirSort::SetSortAttr(DWORD showOnlyAttr)
 {
-    if (pDirLeft->lvalue[0].li.QuadPart >  pDirRight->lvalue[0].li.QuadPart)
-        return 1;
-    if (pDirLeft->lvalue[0].li.QuadPart ==  pDirRight->lvalue[0].li.QuadPart)
-        return CompareDataNameInc(pDirLeft, pDirRight);
-    return -1;
+    const DWORD FILE_DEVICE_BITS = FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_ARCHIVE |
+            FILE_ATTRIBUTE_DEVICE |FILE_ATTRIBUTE_NORMAL;
+
+    m_onlyAttr = showOnlyAttr & FILE_DEVICE_BITS;
 }
 
 // ---------------------------------------------------------------------------
-int CompareDataSizeDec(const LLDirEntry* pDirLeft, const LLDirEntry* pDirRight)
+void LLDirSort::Clear()
 {
-    return -CompareDataSizeInc(pDirLeft, pDirRight);
+    ReleaseEntries();
+    for (HANDLE hRunFile : m_runFiles)
+        CloseHandle(hRunFile);
+    m_runFiles.clear();
+    m_count = 0;
 }
 
 // ---------------------------------------------------------------------------
-LLDirEntry::LLDirEntry(
-        const char* fileName,
-        const char* dir,
-        int baseDirLength,
-        const WIN32_FIND_DATA& findData,
-        FillEntryData_t fillEntryData,
-        LLDirSort& dirSort) :
-    pPrev(dirSort.m_pLast),
-    pNext(0),
-    filenameLStr(fileName),
-    szDir(dir),
-    baseDirLen(baseDirLength),
-    dwFileAttributes(findData.dwFileAttributes)
+// Release entries in memory, spilled runs are kept.
+void LLDirSort::ReleaseEntries()
 {
-    if ((findData.dwFileAttributes & dirSort.m_onlyAttr) == 0)
-        return;
+    for (LLDirEntry* pDirEntry : m_entries)
+        delete pDirEntry;
 
-        _CrtCheckMemory( );
-    fillEntryData(*this, findData, dirSort);
-        _CrtCheckMemory( );
+    // Swap with empty columns to release their memory, clear() keeps it.
+    std::vector<LLDirEntry*>().swap(m_entries);
+    std::vector<DWORD>().swap(m_attributes);
+    std::vector<ULONGLONG>().swap(m_sizes);
+    std::vector<ULONGLONG>().swap(m_ctimes);
+    std::vector<ULONGLONG>().swap(m_atimes);
+    std::vector<ULONGLONG>().swap(m_mtimes);
+    std::vector<DirSlot>().swap(m_dirSlots);
+    m_top.clear();
+    m_topReplaced = 0;
+    m_dirCount = 0;
+    m_pool.Clear();
+    m_namePool.Clear();
+    m_commonDir = nullptr;
+    m_sortedCount = 0;
+    m_pFirst = m_pLast = nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// Sort helpers
+//
+//  Sorting works on (key, row) items in a contiguous array. Equal keys are
+//  refined by radix sorting the next 8 name characters, precomputed per row
+//  for name keys and taken from the entry name after that, until names
+//  differ or end.
+//  Only extension sort compares entries, as a parallel merge sort when large.
+
+#pragma pack(push, 4)
+struct SortItem
+{
+    ULONGLONG       key;
+    DWORD           row;
+};
+#pragma pack(pop)
+
+struct SortRange
+{
+    SortItem*       pBeg;
+    SortItem*       pMid;       // nullptr to sort, else merge [pBeg,pMid) and [pMid,pEnd)
+    SortItem*       pEnd;
+    LLDirEntry* const* pEntries;
+};
 
-    if (dirSort.m_pFirst == NULL)
-        dirSort.m_pFirst = dirSort.m_pLast = this;
+static const size_t sParallelSortMin = 1 << 16;    // Smaller ranges sort on one thread.
+static const DWORD  sMaxSortThreads = 8;
+static const size_t sRadixSortMin = 256;            // Smaller ranges use comparison sort on key.
+
+// ---------------------------------------------------------------------------
+static DWORD WINAPI SortRangeThread(LPVOID pData)
+{
+    const SortRange& range = *(const SortRange*)pData;
+    LLDirEntry* const* pEntries = range.pEntries;
+    auto itemLess = [pEntries](const SortItem& lhs, const SortItem& rhs)
+        { return CompareData(pEntries[lhs.row], pEntries[rhs.row]) < 0; };
+
+    if (range.pMid == nullptr)
+        std::stable_sort(range.pBeg, range.pEnd, itemLess);
     else
+        std::inplace_merge(range.pBeg, range.pMid, range.pEnd, itemLess);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Run each range on its own thread, first range on calling thread.
+static void RunSortRanges(std::vector<SortRange>& ranges)
+{
+    std::vector<HANDLE> threadHnds;
+    for (size_t idx = 1; idx < ranges.size(); idx++)
+    {
+        HANDLE hThread = CreateThread(NULL, 0, SortRangeThread, &ranges[idx], 0, NULL);
+        if (hThread != NULL)
+            threadHnds.push_back(hThread);
+        else
+            SortRangeThread(&ranges[idx]);
+    }
+
+    SortRangeThread(&ranges[0]);
+
+    if ( !threadHnds.empty())
+        WaitForMultipleObjects((DWORD)threadHnds.size(), threadHnds.data(), TRUE, INFINITE);
+    for (HANDLE hThread : threadHnds)
+        CloseHandle(hThread);
+}
+
+// ---------------------------------------------------------------------------
+// Stable sort with CompareData, above sParallelSortMin sort chunks in parallel
+// then merge neighbouring runs in parallel until one run remains.
+static void ParallelStableSort(SortItem* pBeg, SortItem* pEnd, LLDirEntry* const* pEntries)
+{
+    const size_t count = pEnd - pBeg;
+    SYSTEM_INFO sysInfo;
+    GetSystemInfo(&sysInfo);
+    const size_t chunks = (count < sParallelSortMin) ? 1
+        : (sysInfo.dwNumberOfProcessors < sMaxSortThreads) ? sysInfo.dwNumberOfProcessors : sMaxSortThreads;
+
+    std::vector<SortItem*> bounds;
+    std::vector<SortRange> ranges;
+    for (size_t idx = 0; idx <= chunks; idx++)
+        bounds.push_back(pBeg + count * idx / chunks);
+    for (size_t idx = 0; idx < chunks; idx++)
+        ranges.push_back(SortRange{ bounds[idx], nullptr, bounds[idx + 1], pEntries });
+    RunSortRanges(ranges);
+
+    while (bounds.size() > 2)
     {
-        // Insertion sort
-        //   1. If less then first, replace first
-        //   2. If greater then last, replace last
-        //   3. Scan list using cloest starting point (first or last)
-        int dFirst = CompareData(this, dirSort.m_pFirst);
-        if (dFirst <= 0)
+        std::vector<SortItem*> merged;
+        ranges.clear();
+        for (size_t idx = 0; idx + 2 < bounds.size(); idx += 2)
         {
-            // Replace first
-            pNext = dirSort.m_pFirst;
-            dirSort.m_pFirst->pPrev = this;
-            dirSort.m_pFirst = this;
-            return;
+            ranges.push_back(SortRange{ bounds[idx], bounds[idx + 1], bounds[idx + 2], pEntries });
+            merged.push_back(bounds[idx]);
         }
+        if (bounds.size() % 2 == 0)
+            merged.push_back(bounds[bounds.size() - 2]);    // Odd run carried to next pass
+        merged.push_back(bounds.back());
 
-        int dLast  = CompareData(dirSort.m_pLast, this);
-        if (dLast <= 0)
+        RunSortRanges(ranges);
+        bounds.swap(merged);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Sort on key, equal keys stay in row order. LSD radix sort with all byte
+// counts taken in one pass, bytes which are the same in every key are
+// skipped. Small ranges use a comparison sort, rows in a range are in
+// increasing order for equal keys so (key, row) order is stable.
+static void SortByKey(SortItem* pBeg, SortItem* pEnd, std::vector<SortItem>& tmp)
+{
+    const size_t count = pEnd - pBeg;
+    if (count < sRadixSortMin)
+    {
+        std::sort(pBeg, pEnd, [](const SortItem& lhs, const SortItem& rhs)
+            { return lhs.key < rhs.key || (lhs.key == rhs.key && lhs.row < rhs.row); });
+        return;
+    }
+
+    if (tmp.size() < count)
+        tmp.resize(count);
+
+    size_t counts[8][256] = {0};
+    for (const SortItem* pItem = pBeg; pItem != pEnd; pItem++)
+    {
+        for (unsigned byteIdx = 0; byteIdx < 8; byteIdx++)
+            counts[byteIdx][(pItem->key >> (byteIdx * 8)) & 0xff]++;
+    }
+
+    SortItem* pSrc = pBeg;
+    SortItem* pDst = tmp.data();
+    for (unsigned byteIdx = 0; byteIdx < 8; byteIdx++)
+    {
+        const unsigned shift = byteIdx * 8;
+        size_t* pCounts = counts[byteIdx];
+        if (pCounts[(pSrc->key >> shift) & 0xff] == count)
+            continue;
+
+        size_t offset = 0;
+        for (unsigned bucket = 0; bucket < 256; bucket++)
         {
-            // Replace Last
-            pPrev = dirSort.m_pLast;
-            dirSort.m_pLast->pNext = this;
-            dirSort.m_pLast = this;
-            return;
+            const size_t bucketCnt = pCounts[bucket];
+            pCounts[bucket] = offset;
+            offset += bucketCnt;
+        }
+
+        for (const SortItem* pItem = pSrc; pItem != pSrc + count; pItem++)
+            pDst[pCounts[(pItem->key >> shift) & 0xff]++] = *pItem;
+        std::swap(pSrc, pDst);
+    }
+
+    if (pSrc != pBeg)
+        memcpy(pBeg, pSrc, count * sizeof(SortItem));
+}
+
+// ---------------------------------------------------------------------------
+void LLDirSort::Sort()
+{
+    if (m_topReplaced != 0)
+        CompactTop();   // Restore scan order so ties keep it.
+
+    if (m_sortedCount == m_entries.size())
+        return;
+
+    const size_t count = m_entries.size();
+    std::vector<SortItem> items(count);
+    std::vector<SortItem> tmp;
+    std::vector<ULONGLONG> nextKeys;   // Name characters after those in key.
+
+    // Name characters already in key, numeric and extension keys have none.
+    const unsigned keyChars = strchr("acmse", m_sortKey) ? 0 : (m_sortKey == 't' ? 4 : 8);
+    const ULONGLONG invert = m_sortIncreasing ? 0 : ~0ULL;
+
+    for (size_t row = 0; row < count; row++)
+    {
+        items[row].key = SortKey((DWORD)row);
+        items[row].row = (DWORD)row;
+    }
+
+    // Name keys take the next 8 characters now, while reading names in scan
+    // order. Numeric keys rarely tie so read names only for ties.
+    if (keyChars != 0)
+    {
+        nextKeys.resize(count);
+        for (size_t row = 0; row < count; row++)
+        {
+            const char* pName = m_entries[row]->filenameLStr;
+            nextKeys[row] = NameKey(pName + strnlen(pName, keyChars)) ^ invert;
         }
+    }
+
+    if (m_sortKey == 'e')
+    {
+        ParallelStableSort(items.data(), items.data() + count, m_entries.data());
+    }
+    else
+    {
+        struct Run
+        {
+            size_t      beg;
+            size_t      end;
+            unsigned    nameOff;    // Name characters ordered by key.
+        };
+        std::vector<Run> runs;
 
-        if (dFirst < dLast)
+        // Push runs of equal keys which need the next 8 name characters.
+        // Names which end inside the key are equal, leave in scan order.
+        auto pushRuns = [&](size_t beg, size_t end, unsigned nameOff)
         {
-            LLDirEntry* pDirEntry = dirSort.m_pFirst;
-            while (pDirEntry->pNext)
+            size_t runBeg = beg;
+            for (size_t idx = beg + 1; idx <= end; idx++)
             {
-                pDirEntry = pDirEntry->pNext;
-                if (CompareData(pDirEntry, this) >= 0)
+                if (idx == end || items[idx].key != items[runBeg].key)
                 {
-                    pNext = pDirEntry;
-                    pPrev = pDirEntry->pPrev;
-                    pDirEntry->pPrev = this;
-                    if (pPrev)
-                        pPrev->pNext = this;
-                    return;
+                    const bool nameEnded = nameOff != 0 && ((items[runBeg].key ^ invert) & 0xff) == 0;
+                    if (idx - runBeg > 1 && !nameEnded)
+                        runs.push_back(Run{ runBeg, idx, nameOff });
+                    runBeg = idx;
                 }
             }
-        }
-        else
+        };
+
+        SortByKey(items.data(), items.data() + count, tmp);
+        pushRuns(0, count, keyChars);
+
+        while ( !runs.empty())
         {
-            LLDirEntry* pDirEntry = dirSort.m_pLast;
-            while (pDirEntry->pPrev)
+            const Run run = runs.back();
+            runs.pop_back();
+
+            for (size_t idx = run.beg; idx < run.end; idx++)
             {
-                pDirEntry = pDirEntry->pPrev;
-                if (CompareData(pDirEntry, this) <= 0)
-                {
-                    pPrev = pDirEntry;
-                    pNext = pDirEntry->pNext;
-                    pDirEntry->pNext = this;
-                    if (pNext)
-                        pNext->pPrev = this;
-                    return;
-                }
+                if (run.nameOff == keyChars && keyChars != 0)
+                    items[idx].key = nextKeys[items[idx].row];
+                else
+                    items[idx].key = NameKey(m_entries[items[idx].row]->filenameLStr + run.nameOff) ^ invert;
             }
+            SortByKey(items.data() + run.beg, items.data() + run.end, tmp);
+            pushRuns(run.beg, run.end, run.nameOff + 8);
         }
     }
+
+    // Link sorted list.
+    LLDirEntry* pPrev = nullptr;
+    for (const SortItem& item : items)
+    {
+        LLDirEntry* pEntry = m_entries[item.row];
+        pEntry->pPrev = pPrev;
+        pEntry->pNext = nullptr;
+        if (pPrev != nullptr)
+            pPrev->pNext = pEntry;
+        pPrev = pEntry;
+    }
+
+    m_pFirst = m_entries[items.front().row];
+    m_pLast  = m_entries[items.back().row];
+    m_sortedCount = count;
 }
 
 // ---------------------------------------------------------------------------
-int LLDirSort::SortCb(
-        void* cbData,
-        const char* pDir,
-        const WIN32_FIND_DATA* pFileData,
-        int depth)
+// Spilled runs
+//
+//  A run is a temp file of entries in sorted order, each a fixed size
+//  SpillRecord followed by its directory and name. ShowSorted merges the
+//  runs with a loser tree, equal entries come from the earliest run so the
+//  merge keeps scan order like the in memory sort.
+
+struct SpillRecord
 {
-    static LLString commonDir(pDir);
-    LLDirSort* pDirSort = (LLDirSort*)cbData;
+    ULONGLONG       key;            // LLDirSort::SortKey
+    ULONGLONG       size;
+    ULONGLONG       ctime;
+    ULONGLONG       atime;
+    ULONGLONG       mtime;
+    DWORD           attributes;
+    WORD            dirLen;         // Directory and name follow, each with '\0'
+    WORD            nameLen;
+};
 
-    if (depth < 0)
-        return 0;     // ignore end-of-directory
+static const size_t sRunBufferMin = 1 << 16;
+static const size_t sRunBufferMax = 1 << 22;
 
-    if (strcmp(pDir, commonDir) != 0)
+// ---------------------------------------------------------------------------
+// Bytes held by entries in memory, including Sort's working arrays.
+size_t LLDirSort::MemoryUsed() const
+{
+    const LLPoolStats entryStats = m_pool.Stats();
+    const LLPoolStats nameStats = m_namePool.Stats();
+    return entryStats.used + entryStats.wasted + nameStats.used + nameStats.wasted
+        + m_entries.capacity() * (sizeof(LLDirEntry*) + 2 * sizeof(SortItem) + sizeof(ULONGLONG))
+        + m_attributes.capacity() * sizeof(DWORD)
+        + (m_sizes.capacity() + m_ctimes.capacity() + m_atimes.capacity() + m_mtimes.capacity())
+            * sizeof(ULONGLONG)
+        + m_dirSlots.capacity() * sizeof(DirSlot);
+}
+
+// ---------------------------------------------------------------------------
+// Spill record of entry, without the directory and name which follow it.
+void LLDirSort::FillRecord(SpillRecord& record, const LLDirEntry& dirEntry) const
+{
+    const DWORD row = dirEntry.row;
+    record.key        = SortKey(row);
+    record.size       = HasColumn('s') ? m_sizes[row] : 0;
+    record.ctime      = HasColumn('c') ? m_ctimes[row] : 0;
+    record.atime      = HasColumn('a') ? m_atimes[row] : 0;
+    record.mtime      = HasColumn('m') ? m_mtimes[row] : 0;
+    record.attributes = m_attributes[row];
+    record.dirLen     = (WORD)strlen(dirEntry.szDir);
+    record.nameLen    = (WORD)strlen(dirEntry.filenameLStr);
+}
+
+// ---------------------------------------------------------------------------
+// Sort entries in memory, write them to a new temp file run and release them.
+bool LLDirSort::SpillRun()
+{
+    char tmpDir[LL_MAX_PATH];
+    char tmpPath[LL_MAX_PATH];
+    if (GetTempPath(ARRAYSIZE(tmpDir), tmpDir) == 0
+        || GetTempFileName(tmpDir, "lls", 0, tmpPath) == 0)
     {
-        commonDir = LLString(pDir);
+        LLMsg::PresentError(GetLastError(), "Failed to create sort run in ", tmpDir);
+        return false;
     }
 
-    LLDirEntry* pDirEntry = NULL;
-    try
+    HANDLE hRunFile = CreateFile(tmpPath, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hRunFile == INVALID_HANDLE_VALUE)
     {
-		if ((pFileData->dwFileAttributes & pDirSort->m_onlyAttr) != 0)
-		{
-			_CrtCheckMemory( );
-			// Create dir entry (adds string to pool, and dir to link list.
-			pDirEntry = new (pDirSort->m_pool, pDirSort->m_ourSize)
-				LLDirEntry(pFileData->cFileName, commonDir, pDirSort->m_baseDirLen, *pFileData,
-				pDirSort->m_fillEntryData, *pDirSort);
-			pDirSort->m_count++;
-			_CrtCheckMemory( );
-		}
+        LLMsg::PresentError(GetLastError(), "Failed to create sort run, ", tmpPath);
+        DeleteFile(tmpPath);
+        return false;
     }
-    catch (...)
+
+    Sort();
+
+    std::vector<char> buffer;
+    buffer.reserve(sRunBufferMax);
+    bool okay = true;
+    for (const LLDirEntry* pDirEntry = m_pFirst; pDirEntry != nullptr && okay; pDirEntry = pDirEntry->pNext)
     {
-        delete pDirEntry;
+        SpillRecord record;
+        FillRecord(record, *pDirEntry);
+
+        buffer.insert(buffer.end(), (const char*)&record, (const char*)(&record + 1));
+        buffer.insert(buffer.end(), pDirEntry->szDir, pDirEntry->szDir + record.dirLen + 1);
+        buffer.insert(buffer.end(), pDirEntry->filenameLStr.c_str(), pDirEntry->filenameLStr.c_str() + record.nameLen + 1);
+
+        if (buffer.size() >= sRunBufferMax - sizeof(SpillRecord) - 2 * LL_MAX_PATH || pDirEntry->pNext == nullptr)
+        {
+            DWORD written = 0;
+            okay = WriteFile(hRunFile, buffer.data(), (DWORD)buffer.size(), &written, NULL) != 0
+                && written == buffer.size();
+            buffer.clear();
+        }
     }
 
-    return 1;
+    if ( !okay || SetFilePointer(hRunFile, 0, NULL, FILE_BEGIN) == INVALID_SET_FILE_POINTER)
+    {
+        LLMsg::PresentError(GetLastError(), "Failed to write sort run, ", tmpPath);
+        CloseHandle(hRunFile);
+        return false;
+    }
+
+    m_runFiles.push_back(hRunFile);
+    ReleaseEntries();
+    return true;
 }
 
 // ---------------------------------------------------------------------------
-void LLDirSort::SetSort(
-        DirectoryScan& dirScan,
-        const char* sortOpt,
-        bool needAllData,
-        bool sortIncreasing)
+// Buffered reader of one spilled run, or of the sorted entries still in memory.
+class RunReader
 {
-    m_values = -1;
+public:
+    RunReader(HANDLE hRunFile, size_t bufferSize) :
+        m_pRecord(nullptr), m_pDir(nullptr), m_pName(nullptr),
+        m_hRunFile(hRunFile), m_buffer(bufferSize), m_pos(0), m_len(0),
+        m_pDirSort(nullptr), m_pEntry(nullptr)
+    { }
 
-    for (; sortOpt && *sortOpt; sortOpt++)
+    RunReader(const LLDirSort& dirSort) :
+        m_pRecord(nullptr), m_pDir(nullptr), m_pName(nullptr),
+        m_hRunFile(INVALID_HANDLE_VALUE), m_buffer(), m_pos(0), m_len(0),
+        m_pDirSort(&dirSort), m_pEntry(dirSort.m_pFirst)
+    { }
+
+    // Move to next entry, false at end of run.
+    bool Next()
     {
-        switch (*sortOpt)
+        if (m_pDirSort != nullptr)
         {
-        case 'a':
-            // Sort access time
-            m_values = needAllData ? 4 : 1;
-            m_fillFindData  = FillFindDataAtime;
-            m_fillEntryData = FillEntryAtime;
-            CompareData     = sortIncreasing ? CompareDataFtimeInc : CompareDataFtimeDec;
-            break;
-        case 'c':
-            // Sort creation time
-            m_values = needAllData ? 4 : 1;
-            m_fillFindData  = FillFindDataCtime;
-            m_fillEntryData = FillEntryCtime;
-            CompareData     = sortIncreasing ? CompareDataFtimeInc : CompareDataFtimeDec;
-            break;
-        case 'm':
-            // Sort modify time
-            m_values = needAllData ? 4 : 1;
-            m_fillFindData  = FillFindDataMtime;
-            m_fillEntryData = FillEntryMtime;
-            CompareData     = sortIncreasing ? CompareDataFtimeInc : CompareDataFtimeDec;
-            break;
-        case 's':
-            // Sort size
-            m_values = needAllData ? 4 : 1;
-            m_fillFindData  = FillFindDataSize;
-            m_fillEntryData = FillEntrySize;
-            CompareData     = sortIncreasing ? CompareDataSizeInc : CompareDataSizeDec;
-            break;
-        case 'n':
-        default:
-            // Sort fileName
-            m_values = needAllData ? 4 : 0;
-            m_fillFindData  = FillFindDataMtime;
-            m_fillEntryData = FillEntryMtime;
-            CompareData     = sortIncreasing ? CompareDataNameInc : CompareDataNameDec;
-            break;
-        case 'e':
-            // Sort extension
-            m_values = needAllData ? 4 : 0;
-            m_fillFindData  = FillFindDataMtime;
-            m_fillEntryData = FillEntryMtime;
-            CompareData     = sortIncreasing ? CompareDataExtInc : CompareDataExtDec;
-            break;
-        case 'p':
-            // Sort file path  (dir+name)
-            m_values = needAllData ? 4 : 0;
-            m_fillFindData  = FillFindDataMtime;
-            m_fillEntryData = FillEntryMtime;
-            CompareData     = sortIncreasing ? CompareDataPathInc : CompareDataPathDec;
-            break;
-        case 't':
-            // Sort attributes, type (file, dir, etc)
-            m_values = needAllData ? 4 : 0;
-            m_fillFindData  = FillFindDataMtime;
-            m_fillEntryData = FillEntryMtime;
-            CompareData     = sortIncreasing ? CompareDataTypeInc : CompareDataTypeDec;
-            break;
+            m_pRecord = nullptr;
+            if (m_pEntry == nullptr)
+                return false;
+            m_pDirSort->FillRecord(m_entryRecord, *m_pEntry);
+            m_pRecord = &m_entryRecord;
+            m_pDir    = m_pEntry->szDir;
+            m_pName   = m_pEntry->filenameLStr;
+            m_pEntry  = m_pEntry->pNext;
+            return true;
         }
+
+        m_pos += EntrySize();
+        m_pRecord = nullptr;
+
+        if ( !Fill(sizeof(SpillRecord)))
+            return false;
+        const SpillRecord* pRecord = (const SpillRecord*)(m_buffer.data() + m_pos);
+        if ( !Fill(sizeof(SpillRecord) + pRecord->dirLen + 1 + pRecord->nameLen + 1))
+            return false;
+
+        m_pRecord = (const SpillRecord*)(m_buffer.data() + m_pos);
+        m_pDir    = (const char*)(m_pRecord + 1);
+        m_pName   = m_pDir + m_pRecord->dirLen + 1;
+        return true;
     }
 
-    assert(m_values != -1);
+    const SpillRecord*  m_pRecord;      // nullptr at end of run
+    const char*         m_pDir;
+    const char*         m_pName;
 
-    if (m_values != -1)
+private:
+    size_t EntrySize() const
     {
-        LLDirEntry* pDirEntry = NULL;
-        m_ourSize  = sizeof(LLDirEntry) - sizeof(pDirEntry->lvalue);
-        m_ourSize += sizeof(pDirEntry->lvalue[0]) * m_values;
-        dirScan.m_add_cb     = LLDirSort::SortCb;
-        dirScan.m_cb_data    = this;
+        return m_pRecord ? sizeof(SpillRecord) + m_pRecord->dirLen + 1 + m_pRecord->nameLen + 1 : 0;
+    }
+
+    // Make sure length bytes are buffered at m_pos.
+    bool Fill(size_t length)
+    {
+        if (m_pos + length <= m_len)
+            return true;
+
+        memmove(m_buffer.data(), m_buffer.data() + m_pos, m_len - m_pos);
+        m_len -= m_pos;
+        m_pos = 0;
+
+        DWORD readLen = 0;
+        if ( !ReadFile(m_hRunFile, m_buffer.data() + m_len, (DWORD)(m_buffer.size() - m_len), &readLen, NULL))
+            return false;
+        m_len += readLen;
+        return length <= m_len;
     }
-}
+
+    HANDLE              m_hRunFile;
+    std::vector<char>   m_buffer;
+    size_t              m_pos;
+    size_t              m_len;
+
+    // Entries in memory, m_pRecord points at m_entryRecord.
+    const LLDirSort*    m_pDirSort;
+    const LLDirEntry*   m_pEntry;
+    SpillRecord         m_entryRecord;
+};
 
 // ---------------------------------------------------------------------------
-void LLDirSort::SetSortData(bool needAllData)
+// Stream the k-way merge of all runs to dirCb. Entries still in memory are
+// sorted and merged as the last run, they are not spilled so a full disk
+// (earlier SpillRun failed) does not lose them.
+void LLDirSort::MergeRuns(DirCb dirCb, void* cbData)
 {
-    // TODO - should decide size based on currently active sort field.
-    //      - need to save sort field id and use it in a switch statement.
+    const size_t fileCnt = m_runFiles.size();
+    size_t bufferSize = m_memBudget / fileCnt;
+    bufferSize = (bufferSize < sRunBufferMin) ? sRunBufferMin : (bufferSize > sRunBufferMax) ? sRunBufferMax : bufferSize;
 
-    if (needAllData)
+    // Memory run points into its own reader, reserve so readers do not move.
+    const size_t runCnt = fileCnt + (m_entries.empty() ? 0 : 1);
+    std::vector<RunReader> runs;
+    runs.reserve(runCnt);
+    for (HANDLE hRunFile : m_runFiles)
     {
-        m_values = 4;
-        LLDirEntry* pDirEntry = NULL;
-        m_ourSize  = sizeof(LLDirEntry) - sizeof(pDirEntry->lvalue);
-        m_ourSize += sizeof(pDirEntry->lvalue[0]) * m_values;
+        runs.push_back(RunReader(hRunFile, bufferSize));
+        runs.back().Next();
+    }
+    if ( !m_entries.empty())
+    {
+        Sort();
+        runs.push_back(RunReader(*this));
+        runs.back().Next();
     }
-}
-
-// ---------------------------------------------------------------------------
-/// Set which Directory attributes we care about.
 
-void LLDirSort::SetSortAttr(DWORD showOnlyAttr)
-{
-    const DWORD FILE_DEVICE_BITS = FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_ARCHIVE |
-            FILE_ATTRIBUTE_DEVICE |FILE_ATTRIBUTE_NORMAL;
+    // Run order, ended runs last and ties to the earlier run.
+    auto runLess = [this, &runs](size_t left, size_t right)
+    {
+        const RunReader& lhs = runs[left];
+        const RunReader& rhs = runs[right];
+        if (lhs.m_pRecord == nullptr || rhs.m_pRecord == nullptr)
+            return rhs.m_pRecord == nullptr && (lhs.m_pRecord != nullptr || left < right);
+        int diff = CompareOrder(lhs.m_pRecord->key, lhs.m_pName, rhs.m_pRecord->key, rhs.m_pName);
+        return (diff != 0) ? (diff < 0) : (left < right);
+    };
 
-    m_onlyAttr = showOnlyAttr & FILE_DEVICE_BITS;
-}
+    // Loser tree, leaves are runCnt..2*runCnt-1, losers[node] holds the run
+    // which lost at node, the overall winner is not stored in the tree.
+    std::vector<size_t> losers(runCnt);
+    std::vector<size_t> winners(2 * runCnt);
+    for (size_t run = 0; run < runCnt; run++)
+        winners[runCnt + run] = run;
+    for (size_t node = runCnt - 1; node > 0; node--)
+    {
+        const size_t left = winners[2 * node];
+        const size_t right = winners[2 * node + 1];
+        const bool rightWins = runLess(right, left);
+        winners[node] = rightWins ? right : left;
+        losers[node]  = rightWins ? left : right;
+    }
+    size_t winner = (runCnt > 1) ? winners[1] : 0;
 
-// ---------------------------------------------------------------------------
-void LLDirSort::Clear()
-{
-    LLDirEntry* pDirEntry = m_pFirst;
-    LLDirEntry* pTmpEntry = NULL;
+    WIN32_FIND_DATA findData;
+    ClearMemory(&findData, sizeof(findData));
 
-    while (pDirEntry)
+    while (runs[winner].m_pRecord != nullptr)
     {
-        pTmpEntry = pDirEntry;
-        pDirEntry = pDirEntry->pNext;
-        delete pTmpEntry;
+        const RunReader& run = runs[winner];
+        const SpillRecord& record = *run.m_pRecord;
+        strncpy_s(findData.cFileName, ARRAYSIZE(findData.cFileName), run.m_pName, _TRUNCATE);
+        findData.dwFileAttributes = record.attributes;
+        findData.nFileSizeHigh    = (DWORD)(record.size >> 32);
+        findData.nFileSizeLow     = (DWORD)record.size;
+        SetFileTime(findData.ftCreationTime, record.ctime);
+        SetFileTime(findData.ftLastAccessTime, record.atime);
+        SetFileTime(findData.ftLastWriteTime, record.mtime);
+        dirCb(cbData, run.m_pDir, &findData, 0);
+
+        // Replay winner's path to the root.
+        runs[winner].Next();
+        for (size_t node = (runCnt + winner) / 2; node > 0; node /= 2)
+        {
+            if (runLess(losers[node], winner))
+                std::swap(losers[node], winner);
+        }
     }
 }
 
 // ---------------------------------------------------------------------------
 void LLDirSort::ShowSorted(DirCb dirCb, void* cbData)
 {
+    if ( !m_runFiles.empty())
+    {
+        MergeRuns(dirCb, cbData);
+        return;
+    }
+
+    Sort();
     LLDirEntry* pDirEntry = m_pFirst;
 
     //
@@ -539,8 +1105,7 @@ void LLDirSort::ShowSorted(DirCb dirCb, void* cbData)
     {
         // Copy sorted data in to findData structure
         strncpy_s(findData.cFileName, ARRAYSIZE(findData.cFileName), pDirEntry->filenameLStr, _TRUNCATE);
-        findData.dwFileAttributes = pDirEntry->dwFileAttributes;
-        m_fillFindData(findData, *pDirEntry, *this);
+        FillFindData(findData, *pDirEntry);
 
         // Call standard display function.
         dirCb(cbData, pDirEntry->szDir, &findData, 0);
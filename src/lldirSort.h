@@ -33,6 +33,7 @@
 
 #include <iostream>
 #include <iomanip>
+#include <vector>
 #include "dirscan.h"
 
 #include "llstring.h"
@@ -40,40 +41,31 @@
 // Forward ref
 struct LLDirEntry;
 class LLDirSort;
-
-typedef void (*FillEntryData_t)(LLDirEntry& dirEntry, const WIN32_FIND_DATA& findData, const LLDirSort& dirSort);
-typedef void (*FillFindData_t)(WIN32_FIND_DATA& findData, const LLDirEntry& dirEntry, const LLDirSort& dirSort);
+struct SpillRecord;
 
 typedef LLPool<LLDirEntry>  LLDirEntryPool;
 
-// Forward declaration
-class LLDirSort;
-
 // ---------------------------------------------------------------------------
+// Name part of a sorted entry, metadata is kept by LLDirSort in columns
+// indexed by row, see LLDirSort::FillFindData.
 struct LLDirEntry
 {
-    LLDirEntry(const char* fileName, const char* dir, int baseDirLen,
-        const WIN32_FIND_DATA&, FillEntryData_t fillEntryData,
-        LLDirSort& dirSort);
+    LLDirEntry(const char* fileName, const char* dir, int baseDirLen, DWORD row,
+        LLPool<const char>& namePool);
 
     ~LLDirEntry()
     {}
 
-    LLDirEntry*     pPrev;
+    LLDirEntry*     pPrev;      // Sorted order, linked by LLDirSort::Sort
     LLDirEntry*     pNext;
     LLString        filenameLStr;
     const char*     szDir;
     int             baseDirLen;
-    DWORD           dwFileAttributes;
-    union
-    {
-        LARGE_INTEGER   li;
-        FILETIME        ft;
-    } lvalue[4];    // ctime, atime, mtime, size;
+    DWORD           row;        // Row in LLDirSort columns
 
-    void *operator new(size_t /* size */, LLDirEntryPool& pool, size_t ourSize)
+    void *operator new(size_t size, LLDirEntryPool& pool)
     {
-        return (void*)pool.Add(nullptr, ourSize);
+        return (void*)pool.Add(nullptr, size);
     }
 
     void operator delete(void*)
@@ -92,23 +84,56 @@ typedef int (*DirCb)(
         const WIN32_FIND_DATA* pFileData,
         int depth);
 
+typedef bool (*AcceptCb)(
+        void* cbData,
+        const char* pDir,
+        const WIN32_FIND_DATA* pFileData,
+        int depth);
+
 
 // ---------------------------------------------------------------------------
 class LLDirSort
 {
 public:
-    LLDirSort() : m_ourSize(0), m_count(0), m_baseDirLen(0), m_pool(),
+    LLDirSort() : m_count(0), m_baseDirLen(0),
         m_pFirst(nullptr), m_pLast(nullptr),
+        m_pool(), m_namePool(),
+        m_commonDir(nullptr),
         m_onlyAttr((DWORD)-1),
-        m_fillEntryData(nullptr),
-        m_fillFindData(nullptr),
-        m_values(0)
+        m_values(0),
+        m_sortKey('n'),
+        m_sortIncreasing(true),
+        m_sortedCount(0),
+        m_dirCount(0),
+        m_memBudget(0),
+        m_topLimit(0),
+        m_acceptCb(nullptr),
+        m_acceptData(nullptr),
+        m_topReplaced(0)
     {}
 
     ~LLDirSort() { Clear(); }
 
+    /// Release all entries and their memory, including spilled runs.
     void Clear();
 
+    /// When entries use more than memBudget bytes they are sorted and spilled
+    /// to a temp file run, ShowSorted merges the runs. 0 keeps all in memory.
+    /// Sort and m_pFirst only cover entries still in memory.
+    void SetMemoryBudget(size_t memBudget)
+    { m_memBudget = memBudget; }
+
+    /// Keep only the first topLimit entries in sort order, later entries
+    /// which rank lower are dropped as they arrive. acceptCb (optional)
+    /// filters entries first so kept entries are ones the display shows.
+    /// 0 keeps all entries.
+    void SetTopLimit(size_t topLimit, AcceptCb acceptCb, void* acceptData)
+    {
+        m_topLimit = topLimit;
+        m_acceptCb = acceptCb;
+        m_acceptData = acceptData;
+    }
+
     static int SortCb(
         void* cbData,
         const char* pDir,
@@ -124,22 +149,98 @@ public:
 
     void SetSortData(bool needAllData);
 
+    /// File metadata (LLSup::MetaDemand bits) used by active sort.
+    unsigned MetaDemand() const;
+
     /// Set which Directory attributes we care about (reduce memory usage)
     void SetSortAttr(DWORD showOnlyAttr);
 
     void SetColor(WORD& colorCfg, const char* colorOptStr);
+
+    /// Sort collected entries once and link m_pFirst..m_pLast in sorted order.
+    /// Called by ShowSorted, call directly before walking m_pFirst.
+    void Sort();
     void ShowSorted(DirCb dirCb, void* cbData);
 
+    /// Copy kept metadata of entry, fields not kept are zero.
+    void FillFindData(WIN32_FIND_DATA& findData, const LLDirEntry& dirEntry) const;
+    DWORD Attributes(const LLDirEntry& dirEntry) const
+    { return m_attributes[dirEntry.row]; }
+    /// File size, zero if size column not kept.
+    ULONGLONG FileSize(const LLDirEntry& dirEntry) const
+    { return HasColumn('s') ? m_sizes[dirEntry.row] : 0; }
+
 public:
-    size_t             m_ourSize;
     size_t             m_count;
     int                m_baseDirLen;
     LLDirEntry*        m_pFirst;
     LLDirEntry*        m_pLast;
     LLDirEntryPool     m_pool;
+    LLPool<const char> m_namePool;      // File names and directories of entries
+    const char*        m_commonDir;     // Directory of last entry, see InternDir
     DWORD              m_onlyAttr;
-    FillEntryData_t    m_fillEntryData;
-    FillFindData_t     m_fillFindData;
-    int                m_values;
+    int                m_values;        // 0=name, 1=name and sort field, 4=all fields
+    char               m_sortKey;
+    bool               m_sortIncreasing;
+
+private:
+    struct TopItem
+    {
+        ULONGLONG       key;
+        ULONGLONG       seq;        // Scan order, breaks ties
+        DWORD           row;
+    };
+
+    bool HasColumn(char field) const
+    { return m_values == 4 || (m_values == 1 && m_sortKey == field); }
+    void AddRow(const WIN32_FIND_DATA& findData);
+    LLDirEntry* NewEntry(const char* pDir, const char* pName, DWORD row);
+    void SetRow(DWORD row, const WIN32_FIND_DATA& findData);
+    void AddTop(const char* pDir, const WIN32_FIND_DATA& findData);
+    bool TopLess(const TopItem& lhs, const TopItem& rhs) const;
+    void CompactTop();
+    const char* InternDir(const char* pDir);
+    void ReleaseEntries();
+    size_t MemoryUsed() const;
+    void FillRecord(SpillRecord& record, const LLDirEntry& dirEntry) const;
+    bool SpillRun();
+    void MergeRuns(DirCb dirCb, void* cbData);
+    ULONGLONG SortKey(ULONGLONG fieldValue, DWORD attributes, const char* pName) const;
+    ULONGLONG SortKey(DWORD row) const;
+    friend class RunReader;
+    ULONGLONG SortKey(const WIN32_FIND_DATA& findData) const;
+    int CompareOrder(ULONGLONG leftKey, const char* pLeftName,
+        ULONGLONG rightKey, const char* pRightName) const;
+
+    // Entry columns, one row per entry in scan order.
+    // Size and time columns are only kept if HasColumn, the sort
+    // field is always kept so sort keys are built from the columns.
+    std::vector<LLDirEntry*>    m_entries;
+    std::vector<DWORD>          m_attributes;
+    std::vector<ULONGLONG>      m_sizes;
+    std::vector<ULONGLONG>      m_ctimes;
+    std::vector<ULONGLONG>      m_atimes;
+    std::vector<ULONGLONG>      m_mtimes;
+    size_t                      m_sortedCount;
+
+    // Each distinct directory is stored once in m_namePool, entries share it.
+    // Open addressed hash of pooled directories, see InternDir.
+    struct DirSlot
+    {
+        size_t          hash;
+        const char*     pDir;
+    };
+    std::vector<DirSlot>        m_dirSlots;
+    size_t                      m_dirCount;
+
+    size_t                      m_memBudget;
+    std::vector<HANDLE>         m_runFiles;     // Sorted runs, see SpillRun
+
+    // Top limit, m_top is a heap with the lowest ranked kept entry first.
+    size_t                      m_topLimit;
+    AcceptCb                    m_acceptCb;
+    void*                       m_acceptData;
+    std::vector<TopItem>        m_top;
+    size_t                      m_topReplaced;  // Rows reused since CompactTop
 };
 
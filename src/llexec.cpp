@@ -74,9 +74,11 @@ static const char sHelp[] =
 "   !02-q!0f                  ; Quiet, default is echo command\n"
 "   !02-Q!0f                  ; Quote argument before executing \n"
 "   !02-r!0f                  ; Recurse into subdirectories\n"
+"   !02-j=!0f<threads>        ; Scan directories in parallel (use with -r)\n"
 "   !02-X=!0f<pathPat>,...    ; Exclude patterns  -X=*.lib,*.obj,*.exe\n"
 "                       ;  No space in patterns. Pattern applied against fullpath\n"
 "                       ;  So *\\ma will exclude a directory ma or file ma \n"
+"                       ;  Directories matching *\\ma or *\\ma\\* are not scanned \n"
 "   !02-V!0f                  ; verbose mode\n"
 "   !02-W[bta]=!0fmseconds    ; Wait b=before,t=timeout,a=after milliseconds to exe commmand\n"
 "                       ;  Default for timeout -Wt=20000 \n"
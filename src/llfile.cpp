@@ -27,6 +27,7 @@
 //              g = grep    ; Find or Find and Replace
 //              i = install ; setup hardlinks between llfile.exe and its aliases
 //              m = move
+//              n = index   ; build, update or query saved directory index
 //              o = compare
 //              p = printf
 //              q = query (info) about file
@@ -112,6 +113,7 @@
 #include "llexec.h"
 #include "llmove.h"
 #include "llfind.h"
+#include "llindex.h"
 #include "llinfo.h"
 #include "llprintf.h"
 #include "llreplace.h"
@@ -152,6 +154,7 @@ static const char sHelp[] =
 "    le   or llexec     ; Execute command on files \n"
 "    p    or printf     ; Print file names \n"
 "    x    or llquery    ; Query (info) about executables \n"
+"    li   or llindex    ; Index directories, query index \n"
 "    s    or llsize     ; List device size \n"
 "\n"   
 "  !0eExample:!0f\n"
@@ -163,10 +166,10 @@ static const char sHelp[] =
 
 
 // Possible commands (not all are implemented)
-enum Cmd { eNone, eCmp, eCopy, eDir, eDel, eExec, eFind, eMove, eWhere, ePrintf, eGrep, eSize, eQuery, eInstall, eUninstall };
+enum Cmd { eNone, eCmp, eCopy, eDir, eDel, eExec, eFind, eMove, eWhere, ePrintf, eGrep, eSize, eQuery, eIndex, eInstall, eUninstall };
 const char* CmdName[] = { 
     "None", "Compare", "Copy", "Dir", "Delete", "Execute", "Find", "Move", "Where",
-    "Printf", "Grep", "Size", "Query", "Install", "Uninstall" };
+    "Printf", "Grep", "Size", "Query", "Index", "Install", "Uninstall" };
 
 //  Association between names and commands.
 struct CmdAlias
@@ -211,6 +214,9 @@ static CmdAlias sCmdAlias[] =
     {"x", eQuery},
     {"s", eSize},
     {"llsize", eSize},
+    {"llindex", eIndex},
+    {"li",      eIndex},
+    {"n",       eIndex},
     {"llinstall",eInstall},
     {"i",       eInstall},
 	{"llunstall",eUninstall},
@@ -392,6 +398,9 @@ int main(int argc, const char* argv[])
         case eQuery:
             exitStatus = LLInfo::StaticRun(cmdOpts, passArgc, passArgv);
             break;
+        case eIndex:
+            exitStatus = LLIndex::StaticRun(cmdOpts, passArgc, passArgv);
+            break;
         case eInstall:
             {
                 char dir[_MAX_DIR];
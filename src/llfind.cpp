@@ -57,6 +57,7 @@ static const char sHelp[] =
 "   -G=<grepPattern>    ; Find only if file contains grepPattern \n"
 "   -g=<grepRange>      ;  default is search entire file, +n=first n lines \n"
 "   -I=<file>           ; Read list of files from this file\n"
+"   -j=<threads>        ; Scan directories in parallel, output order not sorted\n"
 "   -p                  ; Search PATH environment directories for pattern\n"
 "   -p                  ; Short cut for -e=PATH, search path \n"
 "   -P=<srcPathPat>     ; RegEx pattern on source files full path, ex: -P=\\\\build\\\\.*[.]png  \n"
@@ -67,6 +68,7 @@ static const char sHelp[] =
 "   -X=<pathPat>,...    ; Exclude patterns  -X=*.lib,*.obj,*.exe\n"
 "                       ;  No space in patterns. Pattern applied against fullpath\n"
 "                       ;  So *\\ma will exclude a directory ma or file ma \n"
+"                       ;  Directories matching *\\ma or *\\ma\\* are not scanned \n"
 "   -V                  ; Verbose\n"
 "   -E=[cFDdsa]         ; Return exit code, c=file+dir count, F=file count, D=dir Count\n"
 "                       ;    d=depth, s=size, a=age \n"
@@ -303,8 +305,9 @@ int LLFind::Run(const char* cmdOpts, int argc, const char* pDirs[])
             for (unsigned idx = 0; idx < extCnt; idx++) {
                 lookFor.replace(pos, len, sExeExtn[idx]);
                 len = strlen(sExeExtn[idx]);
-                m_includeFileList.push_back(lookFor);
+                m_includeFileList.push_back(CompiledPattern(lookFor));
             }
+            m_includeFileList.Build();
         }
 
         // Iterate over env paths
@@ -478,7 +481,7 @@ int LLFind::ProcessEntry(
 
     if (m_isDir)
     {
-        if (PatternMatch(m_dirScan.m_fileFilter, pFileData->cFileName) == false)
+        if (m_dirScan.m_fileMatch.Matches(pFileData->cFileName) == false)
             return sIgnore;
 
 		if (m_onlyAttr == FILE_ATTRIBUTE_DIRECTORY &&
@@ -0,0 +1,658 @@
+//-----------------------------------------------------------------------------
+// llIndex - Persistent directory index, build, update and query
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <numeric>
+#include <assert.h>
+
+#include "llindex.h"
+#include "llpath.h"
+
+// ---------------------------------------------------------------------------
+
+static const char sHelp[] =
+" Index " LLVERSION "\n"
+"  Save directory listing to an index file and find files from it without rescanning\n"
+"\n"
+"  !0eSyntax:!0f\n"
+"    [<switches>] build <directory>... \n"
+"    [<switches>] update \n"
+"    [<switches>] query [<pattern>]... \n"
+"\n"
+"  !0eWhere commands are:!0f\n"
+"   build               ; Scan directories (recursive) and replace index\n"
+"   update              ; Rescan only directories whose modify time changed\n"
+"                       ;  Files modified in place (same directory entries) keep old size/time\n"
+"   query               ; List indexed entries, pattern matched against name,\n"
+"                       ;  or full path if pattern contains \\ \n"
+"\n"
+"  !0eWhere switches are:!0f\n"
+"   -?                  ; Show this help\n"
+"   -i=<indexFile>      ; Index file, default %LOCALAPPDATA%\\llfile.idx\n"
+"   -A=[nrhs]           ; Limit files by attribute (n=normal r=readonly, h=hidden, s=system)\n"
+"   -D                  ; Only directories in matching, default is all types\n"
+"   -D=<dirPattern>     ; Only directories matching dirPttern \n"
+"   -F                  ; Only files in matching, default is all types\n"
+"   -F=<filePat>,...    ; Limit to matching file patterns \n"
+"   -P=<srcPathPat>     ; RegEx pattern on source files full path, ex: -P=\\\\build\\\\.*[.]png  \n"
+"   -q                  ; Quiet, default is echo command\n"
+"   -Q=n                ; Quit after 'n' matches\n"
+"   -s                  ; Show file size size\n"
+"   -t[acm]             ; Show Time a=access, c=creation, m=modified, n=none\n"
+"   -T[acm]<op><value>  ; Limit by Time a=access, c=creation, m=modified\n"
+"   -X=<pathPat>,...    ; Exclude patterns  -X=*.lib,*.obj,*.exe\n"
+"                       ;  With build or update, directories matching <pathPat>\n"
+"                       ;  or <dirPat>\\* are not scanned or indexed\n"
+"   -Z<op><value>       ; Limit by size, op=(G)reater,(L)ess,(E)qual, value=num<units G|M|K>\n"
+"   -V                  ; Verbose\n"
+"   -1=<file>           ; Redirect output to file \n"
+"\n"
+"  !0eExamples:!0f\n"
+"   ; Index two drives, later refresh it and find all png files under a build directory\n"
+"   li build c:\\ d:\\ \n"
+"   li update \n"
+"   li query *\\build\\*.png \n"
+"\n"
+"\n";
+
+static const char sMagic[8] = "LLINDEX";
+static const DWORD sVersion = 1;
+
+LLIndexConfig LLIndex::sConfig;
+
+// ---------------------------------------------------------------------------
+LLIndex::LLIndex() :
+    m_showSize(false),
+    m_showCtime(false),
+    m_showMtime(false),
+    m_showAtime(false),
+    m_pHeader(nullptr),
+    m_pDirs(nullptr),
+    m_pEntries(nullptr),
+    m_pNames(nullptr),
+    m_countScanned(0),
+    m_countReused(0)
+{
+    sConfigp = &GetConfig();
+
+    const char* pAppData = getenv("LOCALAPPDATA");
+    m_indexPath = LLPath::Join((pAppData != nullptr) ? pAppData : ".", "llfile.idx");
+}
+
+// ---------------------------------------------------------------------------
+LLConfig& LLIndex::GetConfig()
+{
+    return sConfig;
+}
+
+// ---------------------------------------------------------------------------
+int LLIndex::StaticRun(const char* cmdOpts, int argc, const char* pDirs[])
+{
+    LLIndex llIndex;
+    return llIndex.Run(cmdOpts, argc, pDirs);
+}
+
+// ---------------------------------------------------------------------------
+int LLIndex::Run(const char* cmdOpts, int argc, const char* pDirs[])
+{
+    const char missingIndexMsg[] = "Missing index file, -i=<indexFile>\n";
+
+    if (argc == 0 && *cmdOpts == '\0')
+        cmdOpts = "?";
+
+    // Parse options
+    while (*cmdOpts)
+    {
+        switch (*cmdOpts)
+        {
+        case 'i':   // Index file, -i=<indexFile>
+            cmdOpts = LLSup::ParseString(cmdOpts+1, m_indexPath, missingIndexMsg);
+            break;
+        case 's':   // Show size
+            m_showSize = true;
+            break;
+        case 't':   // Display Time selection
+            {
+                bool unknownOpt = false;
+                while (cmdOpts[1] && !unknownOpt)
+                {
+                    cmdOpts++;
+                    switch (ToLower(*cmdOpts))
+                    {
+                    case 'a':
+                        m_showAtime = true;
+                        break;
+                    case 'c':
+                        m_showCtime = true;
+                        break;
+                    case 'm':
+                        m_showMtime = true;
+                        break;
+                    case 'n':   // NoTime
+                        m_showAtime = m_showCtime = m_showMtime = false;
+                        break;
+                    default:
+                        cmdOpts--;
+                        unknownOpt = true;
+                        break;
+                    }
+                }
+            }
+            break;
+        case '?':
+            Colorize(std::cout, sHelp);
+            return sIgnore;
+        default:
+            if ( !ParseBaseCmds(cmdOpts))
+                 return sError;
+            break;
+        }
+
+        // Advance to next parameter
+        LLSup::AdvCmd(cmdOpts);
+    }
+
+    if (argc == 0)
+    {
+        ErrorMsg() << "Missing index command, build, update or query\n";
+        return sError;
+    }
+
+    const char* pCmd = pDirs[0];
+    argc--;
+    pDirs++;
+
+    int result;
+    if (_stricmp(pCmd, "build") == 0)
+        result = Build(argc, pDirs);
+    else if (_stricmp(pCmd, "update") == 0)
+        result = Update();
+    else if (_stricmp(pCmd, "query") == 0)
+        result = Query(argc, pDirs);
+    else
+    {
+        ErrorMsg() << "Unknown index command " << pCmd << ", use build, update or query\n";
+        return sError;
+    }
+
+    if (m_verbose)
+    {
+        if (m_countScanned + m_countReused != 0)
+            LLMsg::Out() << "Scanned:" << m_countScanned << " Reused:" << m_countReused
+                << " Directories:" << m_buildDirs.size() << " Entries:" << m_buildEntries.size() << std::endl;
+        if (m_countError != 0)
+            LLMsg::Out() << m_countError << " Errors\n";
+
+        DWORD mseconds = GetTickCount() - m_startTick;
+        LLMsg::PresentMseconds(mseconds);
+    }
+
+    return ExitStatus(result);
+}
+
+// ---------------------------------------------------------------------------
+int LLIndex::Build(int argc, const char* pDirs[])
+{
+    const char* sDefDir[] = {"."};
+    if (argc == 0)
+    {
+        argc  = ARRAYSIZE(sDefDir);
+        pDirs = sDefDir;
+    }
+
+    for (int argn = 0; argn < argc; argn++)
+        ScanTree(pDirs[argn]);
+
+    return WriteIndex() ? (int)m_buildEntries.size() : sError;
+}
+
+// ---------------------------------------------------------------------------
+int LLIndex::Update()
+{
+    if ( !OpenIndex())
+    {
+        ErrorMsg() << "Missing or damaged index " << m_indexPath << ", use build first\n";
+        return sError;
+    }
+
+    // Copy roots, map is closed before index is replaced.
+    std::vector<std::string> roots;
+    for (DWORD dirIdx = 0; dirIdx < m_pHeader->dirCount; dirIdx++)
+    {
+        if (m_pDirs[dirIdx].depth == 0)
+            roots.push_back(Name(m_pDirs[dirIdx].pathOff));
+    }
+
+    for (const std::string& root : roots)
+        ScanTree(root.c_str());
+
+    return WriteIndex() ? (int)m_buildEntries.size() : sError;
+}
+
+// ---------------------------------------------------------------------------
+// Present index entries through ProcessEntry so the usual filters apply.
+int LLIndex::Query(int argc, const char* pPatterns[])
+{
+    if ( !OpenIndex())
+    {
+        ErrorMsg() << "Missing or damaged index " << m_indexPath << ", use build first\n";
+        return sError;
+    }
+
+    LLSup::PatternList nameMatch;
+    LLSup::PatternList pathMatch;
+    for (int argn = 0; argn < argc; argn++)
+    {
+        if (strchr(pPatterns[argn], '\\') != nullptr)
+            pathMatch.push_back(CompiledPattern(pPatterns[argn]));
+        else
+            nameMatch.push_back(CompiledPattern(pPatterns[argn]));
+    }
+    nameMatch.Build();
+    pathMatch.Build();
+
+    WIN32_FIND_DATA findData;
+    std::string filePath;
+
+    for (DWORD dirIdx = 0; dirIdx < m_pHeader->dirCount && !m_dirScan.m_abort; dirIdx++)
+    {
+        const LLIndexDir& dir = m_pDirs[dirIdx];
+        const char* pDir = Name(dir.pathOff);
+
+        for (DWORD entIdx = 0; entIdx < dir.entryCount && !m_dirScan.m_abort; entIdx++)
+        {
+            const LLIndexEntry& entry = m_pEntries[dir.firstEntry + entIdx];
+            const char* pName = Name(entry.nameOff);
+
+            if (argc != 0)
+            {
+                bool match = nameMatch.Matches(pName);
+                if ( !match && !pathMatch.empty())
+                {
+                    filePath = LLPath::Join(pDir, pName);
+                    match = pathMatch.Matches(filePath.c_str());
+                }
+                if ( !match)
+                    continue;
+            }
+
+            ToFindData(findData, entry, pName);
+            ProcessEntry(pDir, &findData, dir.depth);
+        }
+    }
+
+    if (m_verbose)
+    {
+        LLMsg::Out() << "Index:" << m_indexPath << " Built:";
+        LLSup::Format(LLMsg::Out(), m_pHeader->buildTime) << std::endl;
+        LLMsg::Out() << "Directories:" << m_countOutDir << " Files:" << m_countOutFiles << std::endl;
+    }
+
+    return (int)(m_countOutDir + m_countOutFiles);
+}
+
+// ---------------------------------------------------------------------------
+int LLIndex::ProcessEntry(
+        const char* pDir,
+        const WIN32_FIND_DATA* pFileData,
+        int depth)
+{
+    if ( !FilterDir(pDir, pFileData, depth))
+        return sIgnore;
+
+    if (m_echo && !IsQuit())
+    {
+        if (m_showCtime)
+            LLSup::Format(LLMsg::Out(), pFileData->ftCreationTime) << " ";
+        if (m_showMtime)
+            LLSup::Format(LLMsg::Out(), pFileData->ftLastWriteTime) << " ";
+        if (m_showAtime)
+            LLSup::Format(LLMsg::Out(), pFileData->ftLastAccessTime) << " ";
+        if (m_showSize)
+            LLMsg::Out() << std::setw(12) << m_fileSize << " ";
+        LLMsg::Out() << m_srcPath << std::endl;
+    }
+
+    if (m_isDir)
+        m_countOutDir++;
+    else
+        m_countOutFiles++;
+
+    return sOkay;
+}
+
+// ---------------------------------------------------------------------------
+void LLIndex::ToFindData(WIN32_FIND_DATA& findData, const LLIndexEntry& entry, const char* name)
+{
+    memset(&findData, 0, sizeof(findData));
+    findData.dwFileAttributes = entry.attributes;
+    findData.ftCreationTime   = entry.ctime;
+    findData.ftLastAccessTime = entry.atime;
+    findData.ftLastWriteTime  = entry.mtime;
+    findData.nFileSizeHigh    = (DWORD)(entry.size >> 32);
+    findData.nFileSizeLow     = (DWORD)entry.size;
+    strncpy_s(findData.cFileName, ARRAYSIZE(findData.cFileName), name, _TRUNCATE);
+}
+
+// ---------------------------------------------------------------------------
+bool LLIndex::OpenIndex()
+{
+    SIZE_T viewLength = 0;
+    const char* pView = nullptr;
+    if (m_map.Open(m_indexPath.c_str()))
+        pView = (const char*)m_map.MapView(0, viewLength);
+
+    const LLIndexHeader* pHeader = (const LLIndexHeader*)pView;
+    if (pView == nullptr || viewLength < sizeof(LLIndexHeader)
+        || memcmp(pHeader->magic, sMagic, sizeof(sMagic)) != 0
+        || pHeader->version != sVersion)
+    {
+        m_map.Close();
+        return false;
+    }
+
+    const ULONGLONG dirBytes   = (ULONGLONG)pHeader->dirCount * sizeof(LLIndexDir);
+    const ULONGLONG entryBytes = (ULONGLONG)pHeader->entryCount * sizeof(LLIndexEntry);
+    if (sizeof(LLIndexHeader) + dirBytes + entryBytes + pHeader->nameBytes != viewLength
+        || (pHeader->nameBytes != 0 && pView[viewLength - 1] != '\0'))
+    {
+        m_map.Close();
+        return false;
+    }
+
+    // Every table reference must stay inside the map, names are nul terminated
+    // by the last byte so an in range offset is a valid string.
+    const LLIndexDir* pDirs = (const LLIndexDir*)(pView + sizeof(LLIndexHeader));
+    const LLIndexEntry* pEntries = (const LLIndexEntry*)((const char*)pDirs + dirBytes);
+    for (DWORD dirIdx = 0; dirIdx < pHeader->dirCount; dirIdx++)
+    {
+        const LLIndexDir& dir = pDirs[dirIdx];
+        if (dir.pathOff >= pHeader->nameBytes
+            || (ULONGLONG)dir.firstEntry + dir.entryCount > pHeader->entryCount)
+        {
+            m_map.Close();
+            return false;
+        }
+    }
+    for (DWORD entIdx = 0; entIdx < pHeader->entryCount; entIdx++)
+    {
+        if (pEntries[entIdx].nameOff >= pHeader->nameBytes)
+        {
+            m_map.Close();
+            return false;
+        }
+    }
+
+    m_pHeader  = pHeader;
+    m_pDirs    = pDirs;
+    m_pEntries = pEntries;
+    m_pNames   = (const char*)pEntries + entryBytes;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Binary search of sorted directory table, return nullptr if not indexed.
+const LLIndexDir* LLIndex::FindDir(const char* dirPath) const
+{
+    if (m_pHeader == nullptr)
+        return nullptr;
+
+    const LLIndexDir* pEnd = m_pDirs + m_pHeader->dirCount;
+    const LLIndexDir* pDir = std::lower_bound(m_pDirs, pEnd, dirPath,
+        [this](const LLIndexDir& dir, const char* path)
+        { return _stricmp(Name(dir.pathOff), path) < 0; });
+
+    return (pDir != pEnd && _stricmp(Name(pDir->pathOff), dirPath) == 0) ? pDir : nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// Walk directory tree, explicit stack like DirectoryScan.
+//  Directory modify time changes when entries are added, removed or renamed,
+//  so an unchanged directory reuses its entries from the open index and only
+//  the sub-directories are checked.
+void LLIndex::ScanTree(const char* rootDir)
+{
+    struct PendingDir
+    {
+        std::string path;
+        DWORD       depth;
+    };
+
+    std::vector<PendingDir> todo;
+    todo.push_back(PendingDir{ DirectoryScan::GetFullPath(rootDir), 0 });
+    // Remove trailing slash, except on drive root
+    while (todo.back().path.length() > 3 && todo.back().path.back() == '\\')
+        todo.back().path.pop_back();
+
+    WIN32_FIND_DATA findData;
+
+    while ( !todo.empty())
+    {
+        const PendingDir pending = todo.back();
+        todo.pop_back();
+        const char* pDir = pending.path.c_str();
+
+        WIN32_FILE_ATTRIBUTE_DATA dirInfo;
+        if (GetFileAttributesEx(pDir, GetFileExInfoStandard, &dirInfo) == 0
+            || (dirInfo.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+        {
+            LLMsg::PresentError(GetLastError(), "Failed to open directory, ", pDir);
+            m_countError++;
+            continue;
+        }
+
+        BuildDir buildDir;
+        buildDir.firstEntry = (DWORD)m_buildEntries.size();
+        buildDir.depth      = pending.depth;
+        buildDir.mtime      = dirInfo.ftLastWriteTime;
+
+        const LLIndexDir* pOldDir = FindDir(pDir);
+        if (pOldDir != nullptr && CompareFileTime(&pOldDir->mtime, &buildDir.mtime) == 0)
+        {
+            m_countReused++;
+            for (DWORD entIdx = 0; entIdx < pOldDir->entryCount; entIdx++)
+            {
+                LLIndexEntry entry = m_pEntries[pOldDir->firstEntry + entIdx];
+                const char* pName = Name(entry.nameOff);
+                entry.nameOff = (DWORD)m_buildNames.size();
+                m_buildNames.append(pName, strlen(pName) + 1);
+                m_buildEntries.push_back(entry);
+            }
+        }
+        else
+        {
+            std::string dirPat = LLPath::Join(pending.path, "*");
+            HANDLE hSearch = m_dirScan.m_findFirst(dirPat.c_str(), &findData);
+            m_dirScan.m_stats.findFirst++;
+            if (hSearch == INVALID_HANDLE_VALUE)
+            {
+                LLMsg::PresentError(GetLastError(), "Failed to open directory, ", pDir);
+                m_countError++;
+                continue;
+            }
+
+            m_countScanned++;
+            do
+            {
+                // Skip if  "." or ".."
+                if ((findData.cFileName[0] == '.' && findData.cFileName[1] == '\0')
+                    || (findData.cFileName[0] == '.' && findData.cFileName[1] == '.' && findData.cFileName[2] == '\0'))
+                    continue;
+
+                LLIndexEntry entry;
+                entry.nameOff    = (DWORD)m_buildNames.size();
+                entry.attributes = findData.dwFileAttributes;
+                entry.ctime      = findData.ftCreationTime;
+                entry.atime      = findData.ftLastAccessTime;
+                entry.mtime      = findData.ftLastWriteTime;
+                entry.size       = ((ULONGLONG)findData.nFileSizeHigh << 32) | findData.nFileSizeLow;
+                m_buildNames.append(findData.cFileName, strlen(findData.cFileName) + 1);
+                m_buildEntries.push_back(entry);
+            } while (m_dirScan.m_stats.findNext++, FindNextFile(hSearch, &findData) != 0);
+
+            FindClose(hSearch);
+            m_dirScan.m_stats.findClose++;
+
+            const char* pNames = m_buildNames.c_str();
+            std::sort(m_buildEntries.begin() + buildDir.firstEntry, m_buildEntries.end(),
+                [pNames](const LLIndexEntry& lhs, const LLIndexEntry& rhs)
+                { return _stricmp(pNames + lhs.nameOff, pNames + rhs.nameOff) < 0; });
+        }
+
+        buildDir.entryCount = (DWORD)m_buildEntries.size() - buildDir.firstEntry;
+        buildDir.pathOff    = (DWORD)m_buildNames.size();
+        m_buildNames.append(pending.path.c_str(), pending.path.length() + 1);
+        m_buildDirs.push_back(buildDir);
+
+        // Queue sub-directories, junctions are not followed, -X prunes.
+        for (DWORD entIdx = buildDir.firstEntry; entIdx < m_buildEntries.size(); entIdx++)
+        {
+            const LLIndexEntry& entry = m_buildEntries[entIdx];
+            if ((entry.attributes & FILE_ATTRIBUTE_DIRECTORY) == 0
+                || (entry.attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0)
+                continue;
+
+            const char* pName = m_buildNames.c_str() + entry.nameOff;
+            ToFindData(findData, entry, pName);
+            if (PruneDir(pDir, &findData, pending.depth))
+            {
+                m_dirScan.m_stats.pruned++;
+                continue;
+            }
+
+            todo.push_back(PendingDir{ LLPath::Join(pending.path, pName), pending.depth + 1 });
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Write built index sorted by directory path to temporary file and replace index.
+bool LLIndex::WriteIndex()
+{
+    if (m_buildNames.size() > MAXDWORD)
+    {
+        ErrorMsg() << "Index too large, " << m_buildNames.size() << " bytes of names\n";
+        return false;
+    }
+
+    const char* pNames = m_buildNames.c_str();
+    std::vector<DWORD> order(m_buildDirs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+        [&](DWORD lhs, DWORD rhs)
+        { return _stricmp(pNames + m_buildDirs[lhs].pathOff, pNames + m_buildDirs[rhs].pathOff) < 0; });
+
+    std::vector<LLIndexDir> dirs;
+    std::vector<LLIndexEntry> entries;
+    dirs.reserve(m_buildDirs.size());
+    entries.reserve(m_buildEntries.size());
+
+    for (DWORD dirIdx : order)
+    {
+        const BuildDir& buildDir = m_buildDirs[dirIdx];
+        LLIndexDir dir;
+        dir.pathOff    = buildDir.pathOff;
+        dir.firstEntry = (DWORD)entries.size();
+        dir.entryCount = buildDir.entryCount;
+        dir.depth      = buildDir.depth;
+        dir.mtime      = buildDir.mtime;
+        dirs.push_back(dir);
+
+        entries.insert(entries.end(),
+            m_buildEntries.begin() + buildDir.firstEntry,
+            m_buildEntries.begin() + buildDir.firstEntry + buildDir.entryCount);
+    }
+
+    LLIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, sMagic, sizeof(sMagic));
+    header.version    = sVersion;
+    header.dirCount   = (DWORD)dirs.size();
+    header.entryCount = (DWORD)entries.size();
+    header.nameBytes  = (DWORD)m_buildNames.size();
+    GetSystemTimeAsFileTime(&header.buildTime);
+
+    const std::string tmpPath = m_indexPath + ".tmp";
+    Handle hFile = CreateFile(tmpPath.c_str(), GENERIC_WRITE, 0, NULL,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if ( !hFile.IsValid())
+    {
+        LLMsg::PresentError(GetLastError(), "Failed to create index, ", tmpPath.c_str());
+        return false;
+    }
+
+    struct Block
+    {
+        const void* pData;
+        size_t      length;
+    } blocks[] =
+    {
+        { &header, sizeof(header) },
+        { dirs.data(), dirs.size() * sizeof(LLIndexDir) },
+        { entries.data(), entries.size() * sizeof(LLIndexEntry) },
+        { m_buildNames.data(), m_buildNames.size() },
+    };
+
+    for (const Block& block : blocks)
+    {
+        const char* pData = (const char*)block.pData;
+        size_t remain = block.length;
+        while (remain != 0)
+        {
+            DWORD written = 0;
+            DWORD chunk = (DWORD)std::min<size_t>(remain, 64 << 20);
+            if (WriteFile(hFile, pData, chunk, &written, NULL) == 0 || written != chunk)
+            {
+                LLMsg::PresentError(GetLastError(), "Failed to write index, ", tmpPath.c_str());
+                hFile.Close();
+                DeleteFile(tmpPath.c_str());
+                return false;
+            }
+            pData  += written;
+            remain -= written;
+        }
+    }
+    hFile.Close();
+
+    // Release old index before replacing it.
+    m_map.Close();
+    m_pHeader = nullptr;
+
+    if (MoveFileEx(tmpPath.c_str(), m_indexPath.c_str(), MOVEFILE_REPLACE_EXISTING) == 0)
+    {
+        LLMsg::PresentError(GetLastError(), "Failed to replace index, ", m_indexPath.c_str());
+        DeleteFile(tmpPath.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,148 @@
+//-----------------------------------------------------------------------------
+// llIndex - Persistent directory index, build, update and query
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <iostream>
+#define byte win_byte_override  // Fix for c++ v17
+#include <windows.h>
+#undef byte  
+
+#include <string>
+#include <vector>
+
+#include "llbase.h"
+#include "MemMapFile.h"
+
+// ---------------------------------------------------------------------------
+// Index file layout, written once and read through a memory map.
+//
+//      LLIndexHeader
+//      LLIndexDir[dirCount]        ; sorted by path (case insensitive)
+//      LLIndexEntry[entryCount]    ; grouped by directory, sorted by name
+//      char names[nameBytes]       ; nul terminated directory paths and file names
+//
+#pragma pack(push, 8)
+struct LLIndexHeader
+{
+    char        magic[8];           // "LLINDEX"
+    DWORD       version;
+    DWORD       dirCount;
+    DWORD       entryCount;
+    DWORD       nameBytes;
+    FILETIME    buildTime;
+};
+
+struct LLIndexDir
+{
+    DWORD       pathOff;            // Full directory path in names
+    DWORD       firstEntry;
+    DWORD       entryCount;
+    DWORD       depth;              // 0 for directories given to build.
+    FILETIME    mtime;              // Directory modify time, changes when entries added or removed.
+};
+
+struct LLIndexEntry
+{
+    DWORD       nameOff;
+    DWORD       attributes;
+    FILETIME    ctime;              // Same fields as LLDirEntry
+    FILETIME    atime;
+    FILETIME    mtime;
+    ULONGLONG   size;
+};
+#pragma pack(pop)
+
+// ---------------------------------------------------------------------------
+struct LLIndexConfig  : public LLConfig
+{
+};
+
+class LLIndex : public LLBase
+{
+public:
+    LLIndex();
+
+    static int StaticRun(const char* cmdOpts, int argc, const char* pDirs[]);
+    int Run(const char* cmdOpts, int argc, const char* pDirs[]);
+
+    static LLIndexConfig sConfig;
+    LLConfig&       GetConfig();
+
+protected:
+    // Return 1 if output anything, 0 if nothing, -1 if error.
+    virtual int ProcessEntry(const char* pDir, const WIN32_FIND_DATA* pFileData, int depth);
+
+    // Open index read only, return false if missing, not an index or damaged.
+    bool OpenIndex();
+    const LLIndexDir* FindDir(const char* dirPath) const;
+    const char* Name(DWORD nameOff) const
+    { return m_pNames + nameOff; }
+
+    // Walk directory tree, reuse entries of unchanged directories from open index.
+    void ScanTree(const char* rootDir);
+    bool WriteIndex();
+
+    int  Build(int argc, const char* pDirs[]);
+    int  Update();
+    int  Query(int argc, const char* pPatterns[]);
+
+    static void ToFindData(WIN32_FIND_DATA& findData, const LLIndexEntry& entry, const char* name);
+
+    std::string     m_indexPath;        // -i=<indexFile>
+    bool            m_showSize;         // -s
+    bool            m_showCtime;        // -tc
+    bool            m_showMtime;        // -tm
+    bool            m_showAtime;        // -ta
+
+    // Open index
+    MemMapFile          m_map;
+    const LLIndexHeader* m_pHeader;
+    const LLIndexDir*   m_pDirs;
+    const LLIndexEntry* m_pEntries;
+    const char*         m_pNames;
+
+    // Index being built
+    struct BuildDir
+    {
+        DWORD       pathOff;
+        DWORD       firstEntry;
+        DWORD       entryCount;
+        DWORD       depth;
+        FILETIME    mtime;
+    };
+    std::vector<BuildDir>       m_buildDirs;
+    std::vector<LLIndexEntry>   m_buildEntries;
+    std::string                 m_buildNames;
+
+    LONGLONG        m_countScanned;     // Directories enumerated
+    LONGLONG        m_countReused;      // Directories copied from previous index
+};
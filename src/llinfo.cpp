@@ -308,8 +308,7 @@ int LLInfo::ProcessEntry(
         PrintBinaryInfo(sout, m_srcPath);
 
         std::string str = sout.str();
-        int flags = m_grepLinePat.flags();
-        if (flags == 0 || std::regex_search(str.begin(), str.end(), m_grepLinePat)) {
+        if (m_grepLinePat.empty() || m_grepLinePat.Search(str)) {
             std::cout << "File: " << m_srcPath << "\n";
             std::cout << str;
             std::cout << "\n";
@@ -61,6 +61,7 @@ static const char sHelp[] =
 "   -o                  ; Only move if destination is older than source (modify time)\n"
 "   -O                  ; Okay to over write existing destination regardless of time\n"
 "   -r                  ; Recurse starting at from directory, matching file pattern\n"
+"   -j=<threads>        ; Scan directories in parallel (use with -r)\n"
 "   -p                  ; Prompt before move\n"
 "   -pp                 ; Prevent prompt on Override or readonly, just skip file \n"
 "   -P=<srcPathPat>     ; Optional regular expression pattern on source files full path\n"
@@ -73,6 +74,7 @@ static const char sHelp[] =
 "   -X=<pathPat>,...    ; Exclude patterns  -X=*.lib,*.obj,*.exe\n"
 "                       ;  No space in patterns. Pattern applied against fullpath\n"
 "                       ;  So *\\ma will exclude a directory ma or file ma \n"
+"                       ;  Directories matching *\\ma or *\\ma\\* are not scanned \n"
 "   -Z<op><value>       ; siZe op=(Greater|Less|Equal) value=num<units G|M|K>, ex -Zg100M \n"
 "   -?                  ; Show this help\n"
 "\n"
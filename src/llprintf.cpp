@@ -107,6 +107,7 @@ static const char sHelp[] =
 "   -q                  ; Quiet, default is echo command\n"
 "   -Q=n                ; Quit after 'n' matches\n"
 "   -X=<pattern>        ; Exclude patterns  -X *.lib,*.obj,*.exe\n"
+"                       ;  Directories matching <pattern> or <dirPat>\\* are not scanned\n"
 "   -1=<outfile>        ; Redirect output to file\n"
 "\n"
 "  !0eNote:!0f\n"
@@ -1059,8 +1060,7 @@ int LLPrintf::Run(const char* cmdOpts, int argc, const char* pDirs[])
                 {
                     std::string envItem = pEnvList;
                     if (Count(envItem, '=') == 1 &&
-						(m_grepSrcPathPat.flags() == 0 ||
-                        std::regex_search(envItem.begin(), envItem.end(), m_grepSrcPathPat)))
+						(m_grepSrcPathPat.empty() || m_grepSrcPathPat.Search(envItem)))
                         inList.push(envItem);
                     pEnvList += envItem.length() + 1;
                 }
@@ -1275,8 +1275,7 @@ int LLPrintf::Run(const char* cmdOpts, int argc, const char* pDirs[])
             std::string listItem = inList.front();
             inList.pop();
 
-            if (m_grepSrcPathPat.flags() == 0 ||
-                std::regex_search(listItem.begin(), listItem.end(), m_grepSrcPathPat))
+            if (m_grepSrcPathPat.empty() || m_grepSrcPathPat.Search(listItem))
             {
                 matchResults.push(listItem);
                 SlitOnSeparators(matchResults, m_separators);
@@ -1318,7 +1317,7 @@ int LLPrintf::ProcessEntry(
 
     if (m_isDir)
     {
-        if (PatternMatch(m_dirScan.m_fileFilter, pFileData->cFileName) == false)
+        if (m_dirScan.m_fileMatch.Matches(pFileData->cFileName) == false)
             return sIgnore;
     }
 
@@ -0,0 +1,1678 @@
+//-----------------------------------------------------------------------------
+// llregex - Regular expression with selectable std::regex or linear time engine.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include <unordered_map>
+#include <new>
+
+#define byte win_byte_override  // Fix for c++ v17
+#include <windows.h>
+#undef byte
+
+#include "llregex.h"
+
+LLRegex::Engine LLRegex::sEngine = LLRegex::eStd;
+
+// Search flags used by the NFA engine.
+static const unsigned sNotBol     = 1;
+static const unsigned sNotEol     = 2;
+static const unsigned sPrevAvail  = 4;    // ptr[-1] is valid, used by ^ and \b
+static const unsigned sContinuous = 8;    // Match must start at beg
+static const unsigned sNotNull    = 16;   // Reject empty match
+static const unsigned sMatchEnd   = 32;   // Match must end at end
+
+static const size_t sMaxInsts = 20000;
+static const int    sMaxRepeat = 1000;
+static const size_t sMaxDfaStates = 4096;
+static const size_t sMaxDfaMemory = 8 << 20;
+static const size_t sMaxBitState = 256 * 1024;  // Backtrack visited bits, instructions * text
+
+// ---------------------------------------------------------------------------
+static bool IsWord(unsigned char chr)
+{
+    return isalnum(chr) || chr == '_';
+}
+
+static bool HasFlag(LLRegex::Flags flags, LLRegex::Flags bit)
+{
+    return (flags & bit) == bit;
+}
+
+static unsigned ToNfaFlags(LLRegex::Flags flags)
+{
+    unsigned nfaFlags = 0;
+    if (HasFlag(flags, std::regex_constants::match_not_bol))
+        nfaFlags |= sNotBol;
+    if (HasFlag(flags, std::regex_constants::match_not_eol))
+        nfaFlags |= sNotEol;
+    if (HasFlag(flags, std::regex_constants::match_prev_avail))
+        nfaFlags |= sPrevAvail;
+    if (HasFlag(flags, std::regex_constants::match_continuous))
+        nfaFlags |= sContinuous;
+    if (HasFlag(flags, std::regex_constants::match_not_null))
+        nfaFlags |= sNotNull;
+    return nfaFlags;
+}
+
+// ---------------------------------------------------------------------------
+// Set of bytes matched by a literal, class or escape.
+struct CharSet
+{
+    unsigned bits[8];
+
+    CharSet()
+    { memset(bits, 0, sizeof(bits)); }
+
+    bool Has(unsigned char chr) const
+    { return (bits[chr >> 5] & (1u << (chr & 31))) != 0; }
+    void Add(unsigned char chr)
+    { bits[chr >> 5] |= 1u << (chr & 31); }
+    void Add(unsigned lo, unsigned hi)
+    {
+        for (unsigned chr = lo; chr <= hi; chr++)
+            Add((unsigned char)chr);
+    }
+    void Add(const CharSet& rhs)
+    {
+        for (unsigned idx = 0; idx != 8; idx++)
+            bits[idx] |= rhs.bits[idx];
+    }
+    void Invert()
+    {
+        for (unsigned idx = 0; idx != 8; idx++)
+            bits[idx] = ~bits[idx];
+    }
+    void FoldCase()
+    {
+        for (unsigned chr = 'a'; chr <= 'z'; chr++)
+        {
+            if (Has((unsigned char)chr) || Has((unsigned char)toupper(chr)))
+            {
+                Add((unsigned char)chr);
+                Add((unsigned char)toupper(chr));
+            }
+        }
+    }
+    bool operator==(const CharSet& rhs) const
+    { return memcmp(bits, rhs.bits, sizeof(bits)) == 0; }
+};
+
+// NFA instructions, eSplit prefers x over y.
+enum InstOp { eChar, eSplit, eJmp, eSave, eAssert, eMatch };
+enum AssertKind { eBol, eEol, eWordB, eNotWordB };
+
+struct Inst
+{
+    InstOp op;
+    int    x;       // eChar set, eSplit/eJmp target, eSave slot, eAssert kind
+    int    y;       // eSplit second target
+};
+
+// Position context used by assertions.
+struct PosCtx
+{
+    bool bol;
+    bool eol;
+    bool prevWord;
+    bool nextWord;
+};
+
+static PosCtx MakeCtx(const char* ptr, const char* beg, const char* end, unsigned flags)
+{
+    PosCtx ctx;
+    ctx.bol = (ptr == beg && (flags & (sNotBol | sPrevAvail)) == 0);
+    ctx.eol = (ptr == end && (flags & sNotEol) == 0);
+    ctx.prevWord = (ptr != beg || (flags & sPrevAvail) != 0) && IsWord(ptr[-1]);
+    ctx.nextWord = ptr != end && IsWord(*ptr);
+    return ctx;
+}
+
+static bool AssertOkay(int kind, const PosCtx& ctx)
+{
+    switch (kind)
+    {
+    case eBol:      return ctx.bol;
+    case eEol:      return ctx.eol;
+    case eWordB:    return ctx.prevWord != ctx.nextWord;
+    case eNotWordB: return ctx.prevWord == ctx.nextWord;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Lazily built DFA over the NFA. A state is the set of instructions waiting
+// to consume the next byte plus the context assertions need. Transitions are
+// added on demand under m_lock and published with InterlockedExchangePointer
+// so searches on other threads read them without locking.
+struct DfaState
+{
+    std::vector<int> kernel;    // Sorted instruction indices
+    bool             bol;
+    bool             prevWord;
+    mutable volatile LONG endMatch[2];      // Match at end of text, [notEol], -1 unknown
+    DfaState* volatile next[ANYSIZE_ARRAY]; // Per byte class, NULL unknown, low bit set if matched
+};
+
+// Transition target, low bit of pointer is set if a match ends before the byte.
+static DfaState* NextState(DfaState* next)
+{
+    return (DfaState*)((ULONG_PTR)next & ~(ULONG_PTR)1);
+}
+
+static bool NextMatched(DfaState* next)
+{
+    return ((ULONG_PTR)next & 1) != 0;
+}
+
+class DfaCache
+{
+public:
+    DfaCache() : m_memory(0)
+    {
+        InitializeSRWLock(&m_lock);
+        for (unsigned idx = 0; idx != 4; idx++)
+            m_start[idx] = NULL;
+    }
+
+    ~DfaCache()
+    {
+        for (size_t idx = 0; idx != m_states.size(); idx++)
+        {
+            m_states[idx]->~DfaState();
+            operator delete(m_states[idx]);
+        }
+    }
+
+    SRWLOCK             m_lock;
+    size_t              m_memory;
+    DfaState* volatile  m_start[4];     // bol*2 + prevWord
+    std::vector<DfaState*> m_states;
+    std::unordered_map<std::string, DfaState*> m_index;
+};
+
+// ---------------------------------------------------------------------------
+// Compiled pattern, shared by copies of an LLRegex.
+class RegexProg
+{
+public:
+    RegexProg() : m_groups(0), m_classCnt(0), m_matchesNewline(false), m_wordAssert(false), m_haveAssert(false), 
+        m_haveFirst(false)
+    { }
+
+    // Return false if pattern uses syntax this engine does not support.
+    bool Compile(const std::string& pattern, bool ignoreCase);
+
+    size_t Slots() const noexcept
+    { return (m_groups + 1) * 2; }
+    // Return false if a match can't contain a line break.
+    bool MatchesNewline() const noexcept
+    { return m_matchesNewline; }
+
+    bool Exec(const char* beg, const char* end, unsigned flags, const char** subs) const;
+    bool BackSearch(const char* beg, const char* end, unsigned flags, const char** subs) const;
+    bool PikeSearch(const char* beg, const char* end, unsigned flags, const char** subs) const;
+    const char* DfaSearch(const char* beg, const char* end, unsigned flags, bool& failed) const;
+    int DfaMatchAll(const char* beg, const char* end, unsigned flags) const;
+
+private:
+    friend class RegexParser;
+
+    DfaState* DfaStart(DfaCache& cache, bool bol, bool prevWord) const;
+    DfaState* DfaStep(DfaCache& cache, bool anchored, DfaState& state, unsigned cls) const;
+    DfaState* DfaAddState(DfaCache& cache, std::vector<int>& kernel, bool bol, bool prevWord) const;
+    bool DfaEndMatches(const DfaState& state, unsigned flags) const;
+    template <typename Visit>
+    void Closure(const std::vector<int>& kernel, const PosCtx& ctx, Visit visit) const;
+
+    std::vector<Inst>    m_insts;
+    std::vector<CharSet> m_sets;
+    size_t               m_groups;
+    unsigned char        m_classMap[256];   // Byte to DFA byte class
+    std::vector<unsigned char> m_classRep;  // DFA byte class to a member byte
+    unsigned             m_classCnt;
+    bool                 m_matchesNewline;
+    bool                 m_wordAssert;
+    bool                 m_haveAssert;
+    CharSet              m_first;           // Bytes which can start a match
+    bool                 m_haveFirst;       // False if pattern starts with an assertion or matches empty
+    mutable DfaCache     m_dfa[2];          // Search, anchored match
+};
+
+// ---------------------------------------------------------------------------
+// Recursive descent parser for the ECMAScript subset, builds a syntax tree
+// which Emit turns into NFA instructions.
+class RegexParser
+{
+public:
+    // Thrown for syntax the NFA engine does not support.
+    struct Unsupported { };
+
+    RegexParser(const std::string& pattern, bool ignoreCase, RegexProg& prog) :
+        m_pattern(pattern), m_pos(0), m_ignoreCase(ignoreCase), m_prog(prog)
+    { }
+
+    void Compile();
+
+private:
+    struct Node
+    {
+        enum Type { eEmpty, eSet, eCat, eAlt, eRepeat, eGroup, eAssert };
+        Type type;
+        int  value;             // Set index, group number or assert kind
+        int  min;               // eRepeat
+        int  max;               // eRepeat, -1 is unbounded
+        bool greedy;            // eRepeat
+        std::vector<int> kids;
+    };
+
+    bool AtEnd() const
+    { return m_pos >= m_pattern.size(); }
+    unsigned char Peek() const
+    { return (unsigned char)m_pattern[m_pos]; }
+
+    int  NewNode(Node::Type type, int value = 0);
+    bool Nullable(int nodeIdx) const;
+    int  AddSet(CharSet& set, bool fold);
+    int  ParseAlt();
+    int  ParseCat();
+    int  ParseAtom();
+    bool ParseRepeat(int& min, int& max);
+    int  ParseNumber();
+    void ParseClass(CharSet& set);
+    int  ParseEscape(CharSet& set, bool inClass);
+    int  ParseHex(unsigned digits);
+    void GroupsIn(int nodeIdx, std::vector<int>& groups) const;
+    bool SetsGroup(int nodeIdx, int group) const;
+    int  Emit(int nodeIdx);
+    int  AddInst(InstOp op, int x = 0, int y = 0);
+
+    const std::string& m_pattern;
+    size_t             m_pos;
+    bool               m_ignoreCase;
+    RegexProg&         m_prog;
+    std::vector<Node>  m_nodes;
+};
+
+// ---------------------------------------------------------------------------
+int RegexParser::NewNode(Node::Type type, int value)
+{
+    Node node;
+    node.type = type;
+    node.value = value;
+    node.min = node.max = 0;
+    node.greedy = true;
+    m_nodes.push_back(node);
+    return (int)m_nodes.size() - 1;
+}
+
+// ---------------------------------------------------------------------------
+// True if node can match the empty string.
+bool RegexParser::Nullable(int nodeIdx) const
+{
+    const Node& node = m_nodes[nodeIdx];
+    switch (node.type)
+    {
+    case Node::eSet:
+        return false;
+    case Node::eCat:
+        for (size_t idx = 0; idx != node.kids.size(); idx++)
+            if (!Nullable(node.kids[idx]))
+                return false;
+        return true;
+    case Node::eAlt:
+        for (size_t idx = 0; idx != node.kids.size(); idx++)
+            if (Nullable(node.kids[idx]))
+                return true;
+        return false;
+    case Node::eRepeat:
+        return node.min == 0 || Nullable(node.kids[0]);
+    case Node::eGroup:
+        return Nullable(node.kids[0]);
+    default:
+        return true;
+    }
+}
+
+// ---------------------------------------------------------------------------
+int RegexParser::AddSet(CharSet& set, bool fold)
+{
+    if (fold && m_ignoreCase)
+        set.FoldCase();
+    for (size_t idx = 0; idx != m_prog.m_sets.size(); idx++)
+    {
+        if (m_prog.m_sets[idx] == set)
+            return (int)idx;
+    }
+    m_prog.m_sets.push_back(set);
+    return (int)m_prog.m_sets.size() - 1;
+}
+
+// ---------------------------------------------------------------------------
+int RegexParser::ParseAlt()
+{
+    int nodeIdx = ParseCat();
+    if (!AtEnd() && Peek() == '|')
+    {
+        int altIdx = NewNode(Node::eAlt);
+        m_nodes[altIdx].kids.push_back(nodeIdx);
+        while (!AtEnd() && Peek() == '|')
+        {
+            m_pos++;
+            nodeIdx = ParseCat();
+            m_nodes[altIdx].kids.push_back(nodeIdx);
+        }
+        nodeIdx = altIdx;
+    }
+    return nodeIdx;
+}
+
+// ---------------------------------------------------------------------------
+int RegexParser::ParseCat()
+{
+    int catIdx = NewNode(Node::eCat);
+    while (!AtEnd() && Peek() != '|' && Peek() != ')')
+    {
+        int atomIdx = ParseAtom();
+        int min, max;
+        if (ParseRepeat(min, max))
+        {
+            if (m_nodes[atomIdx].type == Node::eAssert)
+                throw Unsupported();
+            // Empty iterations, like (a|)+, differ between implementations.
+            if (max != 1 && Nullable(atomIdx))
+                throw Unsupported();
+            int repIdx = NewNode(Node::eRepeat);
+            m_nodes[repIdx].min = min;
+            m_nodes[repIdx].max = max;
+            if (!AtEnd() && Peek() == '?')
+            {
+                m_nodes[repIdx].greedy = false;
+                m_pos++;
+            }
+            m_nodes[repIdx].kids.push_back(atomIdx);
+            atomIdx = repIdx;
+        }
+        m_nodes[catIdx].kids.push_back(atomIdx);
+    }
+    return catIdx;
+}
+
+// ---------------------------------------------------------------------------
+int RegexParser::ParseAtom()
+{
+    CharSet set;
+    unsigned char chr = Peek();
+    m_pos++;
+
+    switch (chr)
+    {
+    case '^':
+        return NewNode(Node::eAssert, eBol);
+    case '$':
+        return NewNode(Node::eAssert, eEol);
+    case '.':
+        set.Add('\n');
+        set.Add('\r');
+        set.Invert();
+        return NewNode(Node::eSet, AddSet(set, false));
+    case '[':
+        ParseClass(set);
+        return NewNode(Node::eSet, AddSet(set, false));
+    case '(':
+    {
+        int groupNum = -1;
+        if (!AtEnd() && Peek() == '?')
+        {
+            // Only (?: is supported, not lookahead.
+            if (m_pos + 1 >= m_pattern.size() || m_pattern[m_pos + 1] != ':')
+                throw Unsupported();
+            m_pos += 2;
+        }
+        else
+        {
+            groupNum = (int)++m_prog.m_groups;
+        }
+        int bodyIdx = ParseAlt();
+        if (AtEnd() || Peek() != ')')
+            throw Unsupported();
+        m_pos++;
+        if (groupNum < 0)
+            return bodyIdx;
+        int groupIdx = NewNode(Node::eGroup, groupNum);
+        m_nodes[groupIdx].kids.push_back(bodyIdx);
+        return groupIdx;
+    }
+    case '\\':
+    {
+        int kind = ParseEscape(set, false);
+        if (kind >= 0)
+            return NewNode(Node::eAssert, kind);
+        return NewNode(Node::eSet, AddSet(set, true));
+    }
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+    case '}':
+    case ']':
+    case ')':
+        throw Unsupported();
+    default:
+        set.Add(chr);
+        return NewNode(Node::eSet, AddSet(set, true));
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Parse optional quantifier, max is -1 if unbounded.
+bool RegexParser::ParseRepeat(int& min, int& max)
+{
+    if (AtEnd())
+        return false;
+
+    switch (Peek())
+    {
+    case '*':
+        min = 0;
+        max = -1;
+        break;
+    case '+':
+        min = 1;
+        max = -1;
+        break;
+    case '?':
+        min = 0;
+        max = 1;
+        break;
+    case '{':
+        m_pos++;
+        min = max = ParseNumber();
+        if (!AtEnd() && Peek() == ',')
+        {
+            m_pos++;
+            max = (!AtEnd() && isdigit(Peek())) ? ParseNumber() : -1;
+        }
+        if (AtEnd() || Peek() != '}' || (max >= 0 && max < min))
+            throw Unsupported();
+        break;
+    default:
+        return false;
+    }
+
+    m_pos++;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+int RegexParser::ParseNumber()
+{
+    int num = 0;
+    if (AtEnd() || !isdigit(Peek()))
+        throw Unsupported();
+    while (!AtEnd() && isdigit(Peek()))
+    {
+        num = num * 10 + (Peek() - '0');
+        if (num > sMaxRepeat)
+            throw Unsupported();
+        m_pos++;
+    }
+    return num;
+}
+
+// ---------------------------------------------------------------------------
+// Parse class body after '[' through ']'.
+void RegexParser::ParseClass(CharSet& set)
+{
+    bool negate = false;
+    if (!AtEnd() && Peek() == '^')
+    {
+        negate = true;
+        m_pos++;
+    }
+    // Leading ']' and [: posix classes differ between implementations.
+    if (AtEnd() || Peek() == ']')
+        throw Unsupported();
+
+    while (!AtEnd() && Peek() != ']')
+    {
+        CharSet item;
+        int lo = Peek();
+        m_pos++;
+        if (lo == '[' && !AtEnd() && (Peek() == ':' || Peek() == '=' || Peek() == '.'))
+            throw Unsupported();
+        if (lo == '\\')
+            lo = ParseEscape(item, true);
+        else
+            item.Add((unsigned char)lo);
+
+        if (m_pos + 1 < m_pattern.size() && Peek() == '-' && m_pattern[m_pos + 1] != ']')
+        {
+            m_pos++;
+            int hi = Peek();
+            m_pos++;
+            if (hi == '\\')
+                hi = ParseEscape(item, true);
+            if (lo < 0 || hi < 0 || hi < lo)
+                throw Unsupported();
+            item.Add((unsigned)lo, (unsigned)hi);
+        }
+        set.Add(item);
+    }
+
+    if (AtEnd())
+        throw Unsupported();
+    m_pos++;
+
+    if (m_ignoreCase)
+        set.FoldCase();
+    if (negate)
+        set.Invert();
+}
+
+// ---------------------------------------------------------------------------
+// Parse escape after '\'. Outside a class return assert kind for \b \B,
+// else fill set and return -1. Inside a class return the byte value, or
+// -1 for class escapes like \d.
+int RegexParser::ParseEscape(CharSet& set, bool inClass)
+{
+    if (AtEnd())
+        throw Unsupported();
+
+    unsigned char chr = Peek();
+    m_pos++;
+    int value = -1;
+
+    switch (chr)
+    {
+    case 'b':
+        if (!inClass)
+        {
+            m_prog.m_wordAssert = true;
+            return eWordB;
+        }
+        value = '\b';
+        break;
+    case 'B':
+        if (inClass)
+            throw Unsupported();
+        m_prog.m_wordAssert = true;
+        return eNotWordB;
+    case 'd':
+    case 'D':
+        set.Add('0', '9');
+        if (chr == 'D')
+            set.Invert();
+        return -1;
+    case 'w':
+    case 'W':
+        set.Add('a', 'z');
+        set.Add('A', 'Z');
+        set.Add('0', '9');
+        set.Add('_');
+        if (chr == 'W')
+            set.Invert();
+        return -1;
+    case 's':
+    case 'S':
+        set.Add(' ');
+        set.Add('\t', '\r');
+        if (chr == 'S')
+            set.Invert();
+        return -1;
+    case 't': value = '\t'; break;
+    case 'n': value = '\n'; break;
+    case 'v': value = '\v'; break;
+    case 'f': value = '\f'; break;
+    case 'r': value = '\r'; break;
+    case '0':
+        if (!AtEnd() && isdigit(Peek()))
+            throw Unsupported();
+        value = 0;
+        break;
+    case 'x':
+        value = ParseHex(2);
+        break;
+    case 'u':
+        value = ParseHex(4);
+        break;
+    default:
+        // Back references, \c and unknown letter escapes go to std::regex.
+        if (isalnum(chr))
+            throw Unsupported();
+        value = chr;
+        break;
+    }
+
+    set.Add((unsigned char)value);
+    return inClass ? value : -1;
+}
+
+// ---------------------------------------------------------------------------
+int RegexParser::ParseHex(unsigned digits)
+{
+    int value = 0;
+    for (unsigned idx = 0; idx != digits; idx++)
+    {
+        if (AtEnd() || !isxdigit(Peek()))
+            throw Unsupported();
+        unsigned char chr = Peek();
+        value = value * 16 + (isdigit(chr) ? chr - '0' : (tolower(chr) - 'a' + 10));
+        m_pos++;
+    }
+    // Byte engine, wide characters go to std::regex.
+    if (value > 0xff)
+        throw Unsupported();
+    return value;
+}
+
+// ---------------------------------------------------------------------------
+int RegexParser::AddInst(InstOp op, int x, int y)
+{
+    if (m_prog.m_insts.size() >= sMaxInsts)
+        throw Unsupported();
+    Inst inst;
+    inst.op = op;
+    inst.x = x;
+    inst.y = y;
+    m_prog.m_insts.push_back(inst);
+    return (int)m_prog.m_insts.size() - 1;
+}
+
+// ---------------------------------------------------------------------------
+// Collect capture group numbers of node and its descendants.
+void RegexParser::GroupsIn(int nodeIdx, std::vector<int>& groups) const
+{
+    const Node& node = m_nodes[nodeIdx];
+    if (node.type == Node::eGroup)
+        groups.push_back(node.value);
+    for (size_t idx = 0; idx != node.kids.size(); idx++)
+        GroupsIn(node.kids[idx], groups);
+}
+
+// ---------------------------------------------------------------------------
+// True if every match of node sets capture group.
+bool RegexParser::SetsGroup(int nodeIdx, int group) const
+{
+    const Node& node = m_nodes[nodeIdx];
+    switch (node.type)
+    {
+    case Node::eGroup:
+        return node.value == group || SetsGroup(node.kids[0], group);
+    case Node::eCat:
+        for (size_t idx = 0; idx != node.kids.size(); idx++)
+            if (SetsGroup(node.kids[idx], group))
+                return true;
+        return false;
+    case Node::eAlt:
+        for (size_t idx = 0; idx != node.kids.size(); idx++)
+            if (!SetsGroup(node.kids[idx], group))
+                return false;
+        return true;
+    case Node::eRepeat:
+        return node.min != 0 && SetsGroup(node.kids[0], group);
+    default:
+        return false;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Emit instructions for node, return index of first instruction.
+int RegexParser::Emit(int nodeIdx)
+{
+    std::vector<Inst>& insts = m_prog.m_insts;
+    const int first = (int)insts.size();
+    const Node node = m_nodes[nodeIdx];
+
+    switch (node.type)
+    {
+    case Node::eEmpty:
+        break;
+    case Node::eSet:
+        AddInst(eChar, node.value);
+        break;
+    case Node::eAssert:
+        AddInst(eAssert, node.value);
+        break;
+    case Node::eCat:
+        for (size_t idx = 0; idx != node.kids.size(); idx++)
+            Emit(node.kids[idx]);
+        break;
+    case Node::eGroup:
+        AddInst(eSave, node.value * 2);
+        Emit(node.kids[0]);
+        AddInst(eSave, node.value * 2 + 1);
+        break;
+    case Node::eAlt:
+    {
+        std::vector<int> jumps;
+        for (size_t idx = 0; idx + 1 < node.kids.size(); idx++)
+        {
+            int split = AddInst(eSplit);
+            insts[split].x = split + 1;
+            Emit(node.kids[idx]);
+            jumps.push_back(AddInst(eJmp));
+            insts[split].y = (int)insts.size();
+        }
+        Emit(node.kids.back());
+        for (size_t idx = 0; idx != jumps.size(); idx++)
+            insts[jumps[idx]].x = (int)insts.size();
+        break;
+    }
+    case Node::eRepeat:
+    {
+        const int kid = node.kids[0];
+
+        // ECMAScript clears the captures inside a repeat on each iteration,
+        // the NFA keeps the last value set. Same result unless an iteration
+        // can leave a group unset, as (?:(a)|b)+ on "ab", run those on eStd.
+        if (node.max < 0 || node.max > 1)
+        {
+            std::vector<int> groups;
+            GroupsIn(kid, groups);
+            for (size_t idx = 0; idx != groups.size(); idx++)
+                if (!SetsGroup(kid, groups[idx]))
+                    throw Unsupported();
+        }
+        if (node.max < 0)
+        {
+            // x{n,} is n-1 copies then x+, x* is a loop.
+            for (int cnt = 1; cnt < node.min; cnt++)
+                Emit(kid);
+            if (node.min == 0)
+            {
+                int split = AddInst(eSplit);
+                Emit(kid);
+                AddInst(eJmp, split);
+                insts[split].x = split + 1;
+                insts[split].y = (int)insts.size();
+                if (!node.greedy)
+                    std::swap(insts[split].x, insts[split].y);
+            }
+            else
+            {
+                int body = Emit(kid);
+                int split = AddInst(eSplit, body);
+                insts[split].y = split + 1;
+                if (!node.greedy)
+                    std::swap(insts[split].x, insts[split].y);
+            }
+        }
+        else
+        {
+            for (int cnt = 0; cnt < node.min; cnt++)
+                Emit(kid);
+            std::vector<int> splits;
+            for (int cnt = node.min; cnt < node.max; cnt++)
+            {
+                int split = AddInst(eSplit);
+                insts[split].x = split + 1;
+                splits.push_back(split);
+                Emit(kid);
+            }
+            for (size_t idx = 0; idx != splits.size(); idx++)
+            {
+                insts[splits[idx]].y = (int)insts.size();
+                if (!node.greedy)
+                    std::swap(insts[splits[idx]].x, insts[splits[idx]].y);
+            }
+        }
+        break;
+    }
+    }
+
+    return first;
+}
+
+// ---------------------------------------------------------------------------
+void RegexParser::Compile()
+{
+    int root = ParseAlt();
+    if (!AtEnd())
+        throw Unsupported();    // Unbalanced ')'
+
+    AddInst(eSave, 0);
+    Emit(root);
+    AddInst(eSave, 1);
+    AddInst(eMatch);
+}
+
+// ---------------------------------------------------------------------------
+bool RegexProg::Compile(const std::string& pattern, bool ignoreCase)
+{
+    try
+    {
+        RegexParser parser(pattern, ignoreCase, *this);
+        parser.Compile();
+    }
+    catch (RegexParser::Unsupported&)
+    {
+        return false;
+    }
+
+    // Split bytes into classes no instruction can tell apart.
+    std::vector<const CharSet*> sets;
+    for (size_t idx = 0; idx != m_sets.size(); idx++)
+        sets.push_back(&m_sets[idx]);
+    CharSet wordSet;
+    if (m_wordAssert)
+    {
+        for (unsigned chr = 0; chr != 256; chr++)
+            if (IsWord((unsigned char)chr))
+                wordSet.Add((unsigned char)chr);
+        sets.push_back(&wordSet);
+    }
+
+    std::vector<std::string> signatures(256);
+    for (unsigned chr = 0; chr != 256; chr++)
+        for (size_t idx = 0; idx != sets.size(); idx++)
+            signatures[chr] += sets[idx]->Has((unsigned char)chr) ? '1' : '0';
+
+    std::unordered_map<std::string, unsigned> classes;
+    for (unsigned chr = 0; chr != 256; chr++)
+    {
+        std::unordered_map<std::string, unsigned>::const_iterator iter = classes.find(signatures[chr]);
+        if (iter == classes.end())
+        {
+            iter = classes.insert(std::make_pair(signatures[chr], (unsigned)m_classRep.size())).first;
+            m_classRep.push_back((unsigned char)chr);
+        }
+        m_classMap[chr] = (unsigned char)iter->second;
+    }
+    m_classCnt = (unsigned)m_classRep.size();
+
+    for (size_t idx = 0; idx != m_insts.size(); idx++)
+    {
+        if (m_insts[idx].op == eChar && m_sets[m_insts[idx].x].Has('\n'))
+            m_matchesNewline = true;
+        if (m_insts[idx].op == eAssert)
+            m_haveAssert = true;
+    }
+
+    // Follow empty transitions from start to collect first bytes.
+    m_haveFirst = true;
+    std::vector<bool> seen(m_insts.size());
+    std::vector<int> stack(1, 0);
+    while (!stack.empty())
+    {
+        int pc = stack.back();
+        stack.pop_back();
+        if (seen[pc])
+            continue;
+        seen[pc] = true;
+
+        const Inst& inst = m_insts[pc];
+        if (inst.op == eChar)
+            m_first.Add(m_sets[inst.x]);
+        else if (inst.op == eSplit)
+        {
+            stack.push_back(inst.x);
+            stack.push_back(inst.y);
+        }
+        else if (inst.op == eJmp)
+            stack.push_back(inst.x);
+        else if (inst.op == eSave)
+            stack.push_back(pc + 1);
+        else
+            m_haveFirst = false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Pike VM thread list, a sparse set of instructions each with capture slots.
+class ThreadList
+{
+public:
+    // Storage is owned by the caller, sparse needs no initialization.
+    ThreadList(unsigned* sparse, int* dense, const char** caps, size_t slots) :
+        m_cnt(0), m_slots(slots), m_sparse(sparse), m_dense(dense), m_caps(caps)
+    { }
+
+    bool Has(int pc) const
+    {
+        unsigned idx = m_sparse[pc];
+        return idx < m_cnt && m_dense[idx] == pc;
+    }
+    const char** Add(int pc)
+    {
+        m_sparse[pc] = m_cnt;
+        m_dense[m_cnt] = pc;
+        return &m_caps[m_cnt++ * m_slots];
+    }
+    void Clear()
+    { m_cnt = 0; }
+
+    unsigned     m_cnt;
+    size_t       m_slots;
+    unsigned*    m_sparse;
+    int*         m_dense;
+    const char** m_caps;
+};
+
+// Follow empty transitions from pc, adding threads in priority order.
+static void AddThread(
+    const std::vector<Inst>& insts,
+    ThreadList& list,
+    int pc,
+    const char** caps,
+    const char* ptr,
+    const PosCtx& ctx,
+    std::vector<std::pair<int, const char*> >& stack)
+{
+    // Stack entries are (pc, NULL) to visit or (-1 - slot, value) to restore a capture.
+    stack.clear();
+    stack.push_back(std::make_pair(pc, (const char*)NULL));
+    while (!stack.empty())
+    {
+        std::pair<int, const char*> entry = stack.back();
+        stack.pop_back();
+        if (entry.first < 0)
+        {
+            caps[-1 - entry.first] = entry.second;
+            continue;
+        }
+
+        pc = entry.first;
+        while (!list.Has(pc))
+        {
+            const char** threadCaps = list.Add(pc);
+            const Inst& inst = insts[pc];
+            if (inst.op == eJmp)
+            {
+                pc = inst.x;
+            }
+            else if (inst.op == eSplit)
+            {
+                stack.push_back(std::make_pair(inst.y, (const char*)NULL));
+                pc = inst.x;
+            }
+            else if (inst.op == eSave)
+            {
+                stack.push_back(std::make_pair(-1 - inst.x, caps[inst.x]));
+                caps[inst.x] = ptr;
+                pc++;
+            }
+            else if (inst.op == eAssert)
+            {
+                if (!AssertOkay(inst.x, ctx))
+                    break;
+                pc++;
+            }
+            else
+            {
+                memcpy(threadCaps, caps, list.m_slots * sizeof(*caps));
+                break;
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Leftmost match with ECMAScript priorities, in time linear in the text.
+bool RegexProg::PikeSearch(const char* beg, const char* end, unsigned flags, const char** subs) const
+{
+    const size_t slots = Slots();
+    const size_t instCnt = m_insts.size();
+    std::vector<unsigned> index(instCnt * 4);
+    std::vector<const char*> capsBuf(instCnt * slots * 2 + slots);
+    ThreadList list1(&index[0], (int*)&index[instCnt], &capsBuf[0], slots);
+    ThreadList list2(&index[instCnt * 2], (int*)&index[instCnt * 3], &capsBuf[instCnt * slots], slots);
+    ThreadList* curList = &list1;
+    ThreadList* nextList = &list2;
+    const char** caps = &capsBuf[instCnt * slots * 2];
+    std::vector<std::pair<int, const char*> > stack;
+    stack.reserve(instCnt * 2);
+    bool matched = false;
+    PosCtx ctx = PosCtx();
+
+    for (const char* ptr = beg; ; ptr++)
+    {
+        if (curList->m_cnt == 0 && !matched && m_haveFirst && (flags & sContinuous) == 0)
+        {
+            while (ptr != end && !m_first.Has((unsigned char)*ptr))
+                ptr++;
+        }
+        if (!matched && (ptr == beg || (flags & sContinuous) == 0))
+        {
+            std::fill(caps, caps + slots, (const char*)NULL);
+            if (m_haveAssert)
+                ctx = MakeCtx(ptr, beg, end, flags);
+            AddThread(m_insts, *curList, 0, caps, ptr, ctx, stack);
+        }
+        if (curList->m_cnt == 0 && (matched || (flags & sContinuous) != 0))
+            break;
+
+        if (m_haveAssert && ptr != end)
+            ctx = MakeCtx(ptr + 1, beg, end, flags);
+        nextList->Clear();
+        for (unsigned idx = 0; idx != curList->m_cnt; idx++)
+        {
+            const Inst& inst = m_insts[curList->m_dense[idx]];
+            const char** threadCaps = &curList->m_caps[idx * slots];
+            if (inst.op == eMatch)
+            {
+                if ((flags & sNotNull) != 0 && threadCaps[0] == ptr)
+                    continue;
+                if ((flags & sMatchEnd) != 0 && ptr != end)
+                    continue;
+                memcpy(subs, threadCaps, slots * sizeof(*subs));
+                matched = true;
+                break;      // Cut lower priority threads.
+            }
+            if (inst.op == eChar && ptr != end && m_sets[inst.x].Has((unsigned char)*ptr))
+            {
+                memcpy(caps, threadCaps, slots * sizeof(*caps));
+                AddThread(m_insts, *nextList, curList->m_dense[idx] + 1, caps, ptr + 1, ctx, stack);
+            }
+        }
+
+        std::swap(curList, nextList);
+        if (ptr == end)
+            break;
+    }
+
+    return matched;
+}
+
+// ---------------------------------------------------------------------------
+// Leftmost match with captures, backtrack on short text else Pike VM.
+bool RegexProg::Exec(const char* beg, const char* end, unsigned flags, const char** subs) const
+{
+    if (((size_t)(end - beg) + 1) * m_insts.size() <= sMaxBitState)
+        return BackSearch(beg, end, flags, subs);
+    return PikeSearch(beg, end, flags, subs);
+}
+
+// ---------------------------------------------------------------------------
+// Backtracking search which marks each (instruction, position) visited so
+// work is bounded by instructions * text, same result as the Pike VM.
+bool RegexProg::BackSearch(const char* beg, const char* end, unsigned flags, const char** subs) const
+{
+    const size_t len = end - beg + 1;
+    const size_t slots = Slots();
+    std::vector<unsigned> visited((m_insts.size() * len + 31) / 32);
+    std::vector<const char*> caps(slots);
+    // Entries are (pc, ptr) to try or (-1 - slot, value) to restore a capture.
+    std::vector<std::pair<int, const char*> > stack;
+
+    for (const char* start = beg; start <= end; start++)
+    {
+        if (start != beg && (flags & sContinuous) != 0)
+            break;
+        if (m_haveFirst && (flags & sContinuous) == 0)
+        {
+            while (start != end && !m_first.Has((unsigned char)*start))
+                start++;
+            if (start == end)
+                break;      // Pattern can't match empty
+        }
+        // Empty match rejection depends on start.
+        if (start != beg && (flags & sNotNull) != 0)
+            std::fill(visited.begin(), visited.end(), 0);
+
+        std::fill(caps.begin(), caps.end(), (const char*)NULL);
+        stack.clear();
+        stack.push_back(std::make_pair(0, start));
+        while (!stack.empty())
+        {
+            std::pair<int, const char*> entry = stack.back();
+            stack.pop_back();
+            if (entry.first < 0)
+            {
+                caps[-1 - entry.first] = entry.second;
+                continue;
+            }
+
+            int pc = entry.first;
+            const char* ptr = entry.second;
+            for (;;)
+            {
+                const size_t bit = pc * len + (ptr - beg);
+                if ((visited[bit >> 5] & (1u << (bit & 31))) != 0)
+                    break;
+                visited[bit >> 5] |= 1u << (bit & 31);
+
+                const Inst& inst = m_insts[pc];
+                if (inst.op == eChar)
+                {
+                    if (ptr == end || !m_sets[inst.x].Has((unsigned char)*ptr))
+                        break;
+                    pc++;
+                    ptr++;
+                }
+                else if (inst.op == eSplit)
+                {
+                    stack.push_back(std::make_pair(inst.y, ptr));
+                    pc = inst.x;
+                }
+                else if (inst.op == eJmp)
+                {
+                    pc = inst.x;
+                }
+                else if (inst.op == eSave)
+                {
+                    stack.push_back(std::make_pair(-1 - inst.x, caps[inst.x]));
+                    caps[inst.x] = ptr;
+                    pc++;
+                }
+                else if (inst.op == eAssert)
+                {
+                    if (!AssertOkay(inst.x, MakeCtx(ptr, beg, end, flags)))
+                        break;
+                    pc++;
+                }
+                else
+                {
+                    if ((flags & sNotNull) != 0 && ptr == start)
+                        break;
+                    if ((flags & sMatchEnd) != 0 && ptr != end)
+                        break;
+                    memcpy(subs, caps.data(), slots * sizeof(*subs));
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Visit instructions reachable from kernel by empty transitions.
+template <typename Visit>
+void RegexProg::Closure(const std::vector<int>& kernel, const PosCtx& ctx, Visit visit) const
+{
+    std::vector<bool> seen(m_insts.size());
+    std::vector<int> stack(kernel.rbegin(), kernel.rend());
+    while (!stack.empty())
+    {
+        int pc = stack.back();
+        stack.pop_back();
+        if (seen[pc])
+            continue;
+        seen[pc] = true;
+
+        const Inst& inst = m_insts[pc];
+        switch (inst.op)
+        {
+        case eJmp:
+            stack.push_back(inst.x);
+            break;
+        case eSplit:
+            stack.push_back(inst.y);
+            stack.push_back(inst.x);
+            break;
+        case eSave:
+            stack.push_back(pc + 1);
+            break;
+        case eAssert:
+            if (AssertOkay(inst.x, ctx))
+                stack.push_back(pc + 1);
+            break;
+        default:
+            visit(pc, inst);
+            break;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Return state for kernel, NULL if the cache is full.
+DfaState* RegexProg::DfaAddState(DfaCache& cache, std::vector<int>& kernel, bool bol, bool prevWord) const
+{
+    std::sort(kernel.begin(), kernel.end());
+    kernel.erase(std::unique(kernel.begin(), kernel.end()), kernel.end());
+
+    std::string key((const char*)kernel.data(), kernel.size() * sizeof(int));
+    key += char(bol * 2 + prevWord);
+    std::unordered_map<std::string, DfaState*>::const_iterator iter = cache.m_index.find(key);
+    if (iter != cache.m_index.end())
+        return iter->second;
+
+    const size_t size = sizeof(DfaState) + (m_classCnt - 1) * sizeof(DfaState*);
+    const size_t memory = size + kernel.size() * sizeof(int) + key.size() * 2;
+    if (cache.m_states.size() >= sMaxDfaStates || cache.m_memory + memory > sMaxDfaMemory)
+        return NULL;
+
+    DfaState* state = new (operator new(size)) DfaState;
+    state->kernel = kernel;
+    state->bol = bol;
+    state->prevWord = prevWord;
+    state->endMatch[0] = -1;
+    state->endMatch[1] = -1;
+    for (unsigned cls = 0; cls != m_classCnt; cls++)
+        state->next[cls] = NULL;
+
+    cache.m_memory += memory;
+    cache.m_states.push_back(state);
+    cache.m_index[key] = state;
+    return state;
+}
+
+// ---------------------------------------------------------------------------
+DfaState* RegexProg::DfaStart(DfaCache& cache, bool bol, bool prevWord) const
+{
+    DfaState* volatile& start = cache.m_start[bol * 2 + prevWord];
+    DfaState* state = start;
+    if (state == NULL)
+    {
+        AcquireSRWLockExclusive(&cache.m_lock);
+        std::vector<int> kernel(1, 0);
+        state = DfaAddState(cache, kernel, bol, prevWord);
+        if (state != NULL)
+            InterlockedExchangePointer((PVOID volatile*)&start, state);
+        ReleaseSRWLockExclusive(&cache.m_lock);
+    }
+    return state;
+}
+
+// ---------------------------------------------------------------------------
+// Add transition from state on byte class, return NULL if the cache is full.
+DfaState* RegexProg::DfaStep(DfaCache& cache, bool anchored, DfaState& state, unsigned cls) const
+{
+    AcquireSRWLockExclusive(&cache.m_lock);
+    DfaState* next = state.next[cls];
+    if (next == NULL)
+    {
+        const unsigned char chr = m_classRep[cls];
+        PosCtx ctx;
+        ctx.bol = state.bol;
+        ctx.eol = false;
+        ctx.prevWord = state.prevWord;
+        ctx.nextWord = IsWord(chr);
+
+        bool matched = false;
+        std::vector<int> kernel;
+        Closure(state.kernel, ctx, [&](int pc, const Inst& inst) {
+            if (inst.op == eMatch)
+                matched = true;
+            else if (m_sets[inst.x].Has(chr))
+                kernel.push_back(pc + 1);
+        });
+        if (!anchored)
+            kernel.push_back(0);
+
+        next = DfaAddState(cache, kernel, false, ctx.nextWord);
+        if (next != NULL)
+        {
+            next = (DfaState*)((ULONG_PTR)next | matched);
+            InterlockedExchangePointer((PVOID volatile*)&state.next[cls], next);
+        }
+    }
+    ReleaseSRWLockExclusive(&cache.m_lock);
+    return next;
+}
+
+// ---------------------------------------------------------------------------
+bool RegexProg::DfaEndMatches(const DfaState& state, unsigned flags) const
+{
+    volatile LONG& endMatch = state.endMatch[(flags & sNotEol) != 0];
+    if (endMatch >= 0)
+        return endMatch != 0;
+
+    PosCtx ctx;
+    ctx.bol = state.bol;
+    ctx.eol = (flags & sNotEol) == 0;
+    ctx.prevWord = state.prevWord;
+    ctx.nextWord = false;
+
+    bool matched = false;
+    Closure(state.kernel, ctx, [&](int, const Inst& inst) {
+        if (inst.op == eMatch)
+            matched = true;
+    });
+    InterlockedExchange(&endMatch, matched);
+    return matched;
+}
+
+// ---------------------------------------------------------------------------
+// Return end of the earliest ending match, NULL if none.
+// Sets failed if the DFA cache is full.
+const char* RegexProg::DfaSearch(const char* beg, const char* end, unsigned flags, bool& failed) const
+{
+    DfaCache& cache = m_dfa[0];
+    const PosCtx ctx = MakeCtx(beg, beg, end, flags);
+    failed = false;
+
+    DfaState* state = DfaStart(cache, ctx.bol, ctx.prevWord);
+    if (state == NULL)
+    {
+        failed = true;
+        return NULL;
+    }
+
+    for (const char* ptr = beg; ptr != end; ptr++)
+    {
+        const unsigned cls = m_classMap[(unsigned char)*ptr];
+        DfaState* next = state->next[cls];
+        if (next == NULL && (next = DfaStep(cache, false, *state, cls)) == NULL)
+        {
+            failed = true;
+            return NULL;
+        }
+        if (NextMatched(next))
+            return ptr;
+        state = NextState(next);
+    }
+
+    return DfaEndMatches(*state, flags) ? end : NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Return 1 if [beg, end) matches completely, 0 if not, -1 if cache is full.
+int RegexProg::DfaMatchAll(const char* beg, const char* end, unsigned flags) const
+{
+    DfaCache& cache = m_dfa[1];
+    const PosCtx ctx = MakeCtx(beg, beg, end, flags);
+
+    DfaState* state = DfaStart(cache, ctx.bol, ctx.prevWord);
+    if (state == NULL)
+        return -1;
+
+    for (const char* ptr = beg; ptr != end; ptr++)
+    {
+        if (state->kernel.empty())
+            return 0;       // Dead state
+        const unsigned cls = m_classMap[(unsigned char)*ptr];
+        DfaState* next = state->next[cls];
+        if (next == NULL && (next = DfaStep(cache, true, *state, cls)) == NULL)
+            return -1;
+        state = NextState(next);
+    }
+
+    return DfaEndMatches(*state, flags) ? 1 : 0;
+}
+
+// ---------------------------------------------------------------------------
+LLRegex::Span LLRegex::Match::prefix() const noexcept
+{
+    Span span;
+    span.first = m_beg;
+    span.second = m_subs.empty() ? m_end : m_subs[0].first;
+    span.matched = span.first != span.second;
+    return span;
+}
+
+// ---------------------------------------------------------------------------
+LLRegex::Span LLRegex::Match::suffix() const noexcept
+{
+    Span span;
+    span.first = m_subs.empty() ? m_end : m_subs[0].second;
+    span.second = m_end;
+    span.matched = span.first != span.second;
+    return span;
+}
+
+// ---------------------------------------------------------------------------
+void LLRegex::Assign(const std::string& pattern, bool ignoreCase)
+{
+    std::regex_constants::syntax_option_type options = std::regex_constants::ECMAScript;
+    if (ignoreCase)
+        options |= std::regex_constants::icase;
+    m_std = std::regex(pattern, options);
+
+    m_pattern = pattern;
+    m_ignoreCase = ignoreCase;
+    m_assigned = true;
+
+    std::shared_ptr<RegexProg> prog(new RegexProg());
+    if (prog->Compile(pattern, ignoreCase))
+        m_prog = prog;
+    else
+        m_prog.reset();
+}
+
+// ---------------------------------------------------------------------------
+LLRegex::Engine LLRegex::ActiveEngine() const noexcept
+{
+    return (sEngine == eDfa && m_prog) ? eDfa : eStd;
+}
+
+// ---------------------------------------------------------------------------
+bool LLRegex::Search(const char* beg, const char* end, Flags flags) const
+{
+    if (ActiveEngine() == eStd)
+        return std::regex_search(beg, end, m_std, flags);
+
+    const unsigned nfaFlags = ToNfaFlags(flags);
+    if ((nfaFlags & (sContinuous | sNotNull)) == 0)
+    {
+        bool failed;
+        const char* hitPtr = m_prog->DfaSearch(beg, end, nfaFlags, failed);
+        if (!failed)
+            return hitPtr != NULL;
+    }
+
+    std::vector<const char*> subs(m_prog->Slots());
+    return m_prog->Exec(beg, end, nfaFlags, subs.data());
+}
+
+// ---------------------------------------------------------------------------
+bool LLRegex::Search(const char* beg, const char* end, Match& match, Flags flags) const
+{
+    match.m_beg = beg;
+    match.m_end = end;
+    match.m_subs.clear();
+
+    if (ActiveEngine() == eStd)
+    {
+        std::match_results<const char*> stdMatch;
+        if (!std::regex_search(beg, end, stdMatch, m_std, flags))
+            return false;
+        match.m_subs.resize(stdMatch.size());
+        for (size_t idx = 0; idx != stdMatch.size(); idx++)
+        {
+            match.m_subs[idx].first = stdMatch[idx].first;
+            match.m_subs[idx].second = stdMatch[idx].second;
+            match.m_subs[idx].matched = stdMatch[idx].matched;
+        }
+        return true;
+    }
+
+    unsigned nfaFlags = ToNfaFlags(flags);
+    const char* fromPtr = beg;
+    const char* toPtr = end;
+    if ((nfaFlags & (sContinuous | sNotNull)) == 0)
+    {
+        // DFA finds the earliest match end, when a match can't span lines
+        // the leftmost match is on the same line.
+        bool failed;
+        const char* hitPtr = m_prog->DfaSearch(beg, end, nfaFlags, failed);
+        if (!failed)
+        {
+            if (hitPtr == NULL)
+                return false;
+            if (!m_prog->MatchesNewline())
+            {
+                fromPtr = hitPtr;
+                while (fromPtr != beg && fromPtr[-1] != '\n')
+                    fromPtr--;
+                if (fromPtr != beg)
+                    nfaFlags |= sPrevAvail;
+                toPtr = (const char*)memchr(hitPtr, '\n', end - hitPtr);
+                if (toPtr == NULL)
+                    toPtr = end;
+                else
+                    nfaFlags |= sNotEol;
+            }
+        }
+    }
+
+    std::vector<const char*> subs(m_prog->Slots());
+    if (!m_prog->Exec(fromPtr, toPtr, nfaFlags, subs.data()))
+        return false;
+
+    match.m_subs.resize(subs.size() / 2);
+    for (size_t idx = 0; idx != match.m_subs.size(); idx++)
+    {
+        Span& span = match.m_subs[idx];
+        span.first = subs[idx * 2];
+        span.second = subs[idx * 2 + 1];
+        span.matched = span.first != NULL && span.second != NULL;
+        if (!span.matched)
+            span.first = span.second = end;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+bool LLRegex::MatchAll(const char* beg, const char* end, Flags flags) const
+{
+    if (ActiveEngine() == eStd)
+        return std::regex_match(beg, end, m_std, flags);
+
+    const unsigned nfaFlags = ToNfaFlags(flags);
+    int result = ((nfaFlags & sNotNull) == 0) ? m_prog->DfaMatchAll(beg, end, nfaFlags) : -1;
+    if (result >= 0)
+        return result != 0;
+
+    std::vector<const char*> subs(m_prog->Slots());
+    return m_prog->Exec(beg, end, nfaFlags | sContinuous | sMatchEnd, subs.data());
+}
+
+// ---------------------------------------------------------------------------
+static void AppendOut(std::string& out, const char* ptr, size_t len)
+{
+    out.append(ptr, len);
+}
+
+static void AppendOut(std::ostream& out, const char* ptr, size_t len)
+{
+    out.write(ptr, len);
+}
+
+// ---------------------------------------------------------------------------
+// Expand ECMAScript format, $$ $& $` $' $n $nn
+template <typename Out>
+static void FormatMatch(Out& out, const LLRegex::Match& match, const std::string& fmt)
+{
+    for (size_t idx = 0; idx < fmt.size(); idx++)
+    {
+        if (fmt[idx] != '$' || idx + 1 == fmt.size())
+        {
+            AppendOut(out, &fmt[idx], 1);
+            continue;
+        }
+
+        const char chr = fmt[idx + 1];
+        LLRegex::Span span;
+        if (chr == '$')
+        {
+            AppendOut(out, "$", 1);
+            idx++;
+        }
+        else if (chr == '&' || chr == '`' || chr == '\'')
+        {
+            span = (chr == '&') ? match[0] : (chr == '`') ? match.prefix() : match.suffix();
+            AppendOut(out, span.first, span.second - span.first);
+            idx++;
+        }
+        else if (isdigit((unsigned char)chr))
+        {
+            size_t num = chr - '0';
+            idx++;
+            if (idx + 1 < fmt.size() && isdigit((unsigned char)fmt[idx + 1]))
+                num = num * 10 + (fmt[++idx] - '0');
+            if (num < match.size() && match[num].matched)
+                AppendOut(out, match[num].first, match[num].second - match[num].first);
+        }
+        else
+        {
+            AppendOut(out, "$", 1);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Replace loop following std::regex_iterator, an empty match is retried as
+// a non-empty match at the same position before stepping one character.
+template <typename Out>
+void LLRegex::ReplaceDfa(Out& out, const char* beg, const char* end, const std::string& fmt, Flags flags) const
+{
+    const bool copy = !HasFlag(flags, std::regex_constants::format_no_copy);
+    const bool firstOnly = HasFlag(flags, std::regex_constants::format_first_only);
+    const char* lastPtr = beg;
+    Match match;
+
+    bool found = Search(beg, end, match, flags);
+    while (found)
+    {
+        match.m_beg = lastPtr;
+        if (copy)
+            AppendOut(out, lastPtr, match[0].first - lastPtr);
+        FormatMatch(out, match, fmt);
+        lastPtr = match[0].second;
+        if (firstOnly)
+            break;
+
+        const char* startPtr = match[0].second;
+        if (match[0].first == match[0].second)
+        {
+            if (startPtr == end)
+                break;
+            Flags retryFlags = flags | std::regex_constants::match_not_null | std::regex_constants::match_continuous;
+            if (startPtr != beg)
+                retryFlags |= std::regex_constants::match_prev_avail;
+            found = Search(startPtr, end, match, retryFlags);
+            if (!found)
+                found = Search(++startPtr, end, match, flags | std::regex_constants::match_prev_avail);
+        }
+        else
+        {
+            found = Search(startPtr, end, match, flags | std::regex_constants::match_prev_avail);
+        }
+    }
+
+    if (copy)
+        AppendOut(out, lastPtr, end - lastPtr);
+}
+
+// ---------------------------------------------------------------------------
+std::string LLRegex::Replace(const std::string& str, const std::string& fmt, Flags flags) const
+{
+    if (ActiveEngine() == eStd)
+        return std::regex_replace(str, m_std, fmt, flags);
+
+    std::string out;
+    ReplaceDfa(out, str.data(), str.data() + str.size(), fmt, flags);
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+void LLRegex::Replace(std::ostream& out, const char* beg, const char* end, const std::string& fmt, Flags flags) const
+{
+    if (ActiveEngine() == eStd)
+        std::regex_replace(std::ostreambuf_iterator<char>(out), beg, end, m_std, fmt, flags);
+    else
+        ReplaceDfa(out, beg, end, fmt, flags);
+}
@@ -0,0 +1,155 @@
+//-----------------------------------------------------------------------------
+// llregex - Regular expression with selectable std::regex or linear time engine.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <regex>
+#include <string>
+#include <vector>
+#include <memory>
+#include <ostream>
+
+class RegexProg;    // Compiled program and DFA cache, see llregex.cpp
+
+// Regular expression used by grep, replace and path filters.
+//
+// Engine eStd runs std::regex, which backtracks and can take exponential
+// time on patterns like (a*)*b. Engine eDfa compiles the ECMAScript subset
+// grep uses into an NFA and runs it in linear time, a lazily built DFA
+// answers match-only queries and a Pike VM finds match positions and
+// captures. Patterns eDfa can't run (back references, lookahead, repeats
+// which can leave a group unset) quietly use std::regex.
+class LLRegex
+{
+public:
+    enum Engine { eStd, eDfa };
+    typedef std::regex_constants::match_flag_type Flags;
+
+    struct Span
+    {
+        const char* first;
+        const char* second;
+        bool        matched;
+
+        Span() noexcept : first(NULL), second(NULL), matched(false)
+        { }
+        ptrdiff_t length() const noexcept
+        { return matched ? second - first : 0; }
+        std::string str() const
+        { return matched ? std::string(first, second) : std::string(); }
+    };
+
+    // Match result, positions are relative to the start of the search.
+    class Match
+    {
+    public:
+        Match() noexcept : m_beg(NULL), m_end(NULL)
+        { }
+
+        size_t size() const noexcept
+        { return m_subs.size(); }
+        bool empty() const noexcept
+        { return m_subs.empty(); }
+        const Span& operator[](size_t idx) const noexcept
+        { return m_subs[idx]; }
+
+        Span prefix() const noexcept;
+        Span suffix() const noexcept;
+        ptrdiff_t position(size_t idx = 0) const noexcept
+        { return m_subs[idx].first - m_beg; }
+        ptrdiff_t length(size_t idx = 0) const noexcept
+        { return m_subs[idx].length(); }
+        std::string str(size_t idx = 0) const
+        { return m_subs[idx].str(); }
+
+    private:
+        friend class LLRegex;
+        const char*       m_beg;
+        const char*       m_end;
+        std::vector<Span> m_subs;
+    };
+
+    LLRegex() noexcept : m_assigned(false), m_ignoreCase(false)
+    { }
+
+    LLRegex& operator=(const std::string& pattern)
+    {
+        Assign(pattern, false);
+        return *this;
+    }
+
+    // Throw std::regex_error if pattern is invalid.
+    void Assign(const std::string& pattern, bool ignoreCase);
+
+    bool empty() const noexcept
+    { return !m_assigned; }
+    const std::string& Pattern() const noexcept
+    { return m_pattern; }
+    // Engine which runs this pattern, eStd if eDfa can't.
+    Engine ActiveEngine() const noexcept;
+
+    // Search for first match in [beg, end).
+    bool Search(const char* beg, const char* end, 
+        Flags flags = std::regex_constants::match_default) const;
+    bool Search(const char* beg, const char* end, Match& match, 
+        Flags flags = std::regex_constants::match_default) const;
+    bool Search(const std::string& str, 
+        Flags flags = std::regex_constants::match_default) const
+    { return Search(str.data(), str.data() + str.size(), flags); }
+    bool Search(const std::string& str, Match& match, 
+        Flags flags = std::regex_constants::match_default) const
+    { return Search(str.data(), str.data() + str.size(), match, flags); }
+
+    // True if pattern matches all of [beg, end), like std::regex_match.
+    bool MatchAll(const char* beg, const char* end, 
+        Flags flags = std::regex_constants::match_default) const;
+    bool MatchAll(const std::string& str, 
+        Flags flags = std::regex_constants::match_default) const
+    { return MatchAll(str.data(), str.data() + str.size(), flags); }
+
+    // Replace matches using ECMAScript format ($&, $1, ...), like std::regex_replace.
+    std::string Replace(const std::string& str, const std::string& fmt, 
+        Flags flags = std::regex_constants::match_default) const;
+    void Replace(std::ostream& out, const char* beg, const char* end, const std::string& fmt, 
+        Flags flags = std::regex_constants::match_default) const;
+
+    static Engine sEngine;      // -g=E(s|d), default eStd
+
+private:
+    template <typename Out>
+    void ReplaceDfa(Out& out, const char* beg, const char* end, const std::string& fmt, Flags flags) const;
+
+    std::string m_pattern;
+    bool        m_assigned;
+    bool        m_ignoreCase;
+    std::regex  m_std;
+    std::shared_ptr<const RegexProg> m_prog;    // NULL if eDfa can't run pattern
+};
@@ -175,6 +175,7 @@ static const char sHelp[] =
 "                       ;     An=show after n lines \n"
 "                       ;     F(l|f) force byLine or byFile \n"
 "                       ;     U(i|b) update inline or backup \n"
+"                       ;     E(s|d) regex engine std::regex or dfa \n"
 "   -i                  ; Ignore case, same as -g=I \n"
 "   -I=<file>           ; Read list of files from this file\n"
 "   -M=<file>           ; Match (and replace) list of patterns in file \n"
@@ -185,6 +186,7 @@ static const char sHelp[] =
 "   -q                  ; Quiet, default is echo command\n"
 "   -Q=n                ; Quit after 'n' file matches\n"
 "   -r                  ; Recurse into subdirectories\n"
+"   -j=<threads>        ; Scan directories in parallel (use with -r)\n"
 "   -R=<replacePattern> ; Use with -G to replace match\n"
 #if 0
 "   -Rbefore=<pattern>  ; TODO Use with -R to move a replacement\n"
@@ -195,6 +197,7 @@ static const char sHelp[] =
 "   -X=<pathPat>,...    ; Exclude patterns  -X=*.lib,*.obj,*.exe\n"
 "                       ;  No space in patterns. Pattern applied against fullpath\n"
 "                       ;  So *\\ma will exclude a directory ma or file ma \n"
+"                       ;  Directories matching *\\ma or *\\ma\\* are not scanned \n"
 "   -v                  ; Verbose \n"
 "   -V=<grepPattern>    ; Return inverse line matching grep matches \n"
 "   -w=<width>          ; Limit output to width characters per match \n"
@@ -471,8 +474,9 @@ int LLReplace::Run(const char* cmdOpts, int argc, const char* pDirs[])
                 try {
                     findCnt++;
                     grepRep.m_grepLineStr = str;   
-					grepRep.m_grepLinePat = std::regex(str /* , regex_constants::ECMAScript */);
+					grepRep.m_grepLinePat = str;
                     m_grepReplaceList.push_back(grepRep);
+                    m_grepReplaceList.back().m_prefilter.Init(str, false);
                     // If pattern has explict test for beginning or end of line
                     // process search/replace byLine rather then byEntireFile.
                     if (!m_byLine && isPattern(str, str.find('^')))
@@ -586,7 +590,7 @@ int LLReplace::Run(const char* cmdOpts, int argc, const char* pDirs[])
                                 }
                                 if (fields.size() > 2)
                                 {
-                                    grepRep.m_filePathPat = std::regex(fields[2], regex_constants::icase);
+                                    grepRep.m_filePathPat.Assign(fields[2], true);
                                     grepRep.m_haveFilePat = true;
                                 }
                                 m_grepReplaceList.push_back(grepRep);
@@ -671,8 +675,8 @@ int LLReplace::Run(const char* cmdOpts, int argc, const char* pDirs[])
         for (unsigned idx = 0; idx != m_grepReplaceList.size();  idx++)
         {
             GrepReplaceItem& grepReplaceItem = m_grepReplaceList[idx];
-            grepReplaceItem.m_grepLinePat = 
-                std::regex(grepReplaceItem.m_grepLineStr, regex_constants::icase);
+            grepReplaceItem.m_grepLinePat.Assign(grepReplaceItem.m_grepLineStr, true);
+            grepReplaceItem.m_prefilter.Init(grepReplaceItem.m_grepLineStr, true);
         }
     }
 
@@ -924,6 +928,41 @@ public:
 };
 
 
+// ---------------------------------------------------------------------------
+// Search only lines containing the prefilter literal. Pattern must not span
+// lines, so the first match is the same as searching all of [strPtr, endPtr).
+static bool PrefilterSearch(
+    const GrepPrefilter& prefilter, 
+    const char*& strPtr, 
+    const char* begPtr, 
+    const char* endPtr,
+    LLRegex::Match& match, 
+    const LLRegex& pattern, 
+    LLRegex::Flags flags)
+{
+    for (;;)
+    {
+        const char* hitPtr = prefilter.Find(strPtr, endPtr);
+        if (hitPtr == NULL)
+            return false;
+
+        const char* begLine = hitPtr;
+        while (begLine > strPtr && begLine[-1] != '\n')
+            begLine--;
+        const char* endLine = (const char*)memchr(hitPtr, '\n', endPtr - hitPtr);
+        if (endLine == NULL)
+            endLine = endPtr;
+
+        // Let word boundary see the character before the line.
+        LLRegex::Flags lineFlags = flags;
+        if (begLine != begPtr)
+            lineFlags |= std::regex_constants::match_prev_avail;
+        if (pattern.Search(begLine, endLine, match, lineFlags))
+            return true;
+        strPtr = endLine;
+    }
+}
+
 // ---------------------------------------------------------------------------
 unsigned LLReplace::FindGrep()
 {
@@ -954,11 +993,13 @@ unsigned LLReplace::FindGrep()
                 SIZE_T viewLength = INT_MAX;
                 if (mapFile.Open(m_srcPath) && (mapPtr = mapFile.MapView(0, viewLength)) != NULL)
                 {
-                    std::match_results <const char*> match;
+                    LLRegex::Match match;
                     const char* begPtr = (const char*)mapPtr;
                     const char* endPtr = begPtr + viewLength;
                     const char* strPtr = begPtr;
-                    std::regex grepLinePat = m_grepReplaceList[0].m_grepLinePat;
+                    const LLRegex& grepLinePat = m_grepReplaceList[0].m_grepLinePat;
+                    const GrepPrefilter& prefilter = m_grepReplaceList[0].m_prefilter;
+                    const bool usePrefilter = !prefilter.empty() && !prefilter.SpansLines();
 
 					if (binaryState.isBinary(strPtr, min(strPtr+256, endPtr)))
 					{
@@ -967,7 +1008,9 @@ unsigned LLReplace::FindGrep()
 						return matchCnt;
 					}
             
-                    while (std::regex_search(strPtr, endPtr, match, grepLinePat, flags))
+                    while (usePrefilter 
+                        ? PrefilterSearch(prefilter, strPtr, begPtr, endPtr, match, grepLinePat, flags)
+                        : grepLinePat.Search(strPtr, endPtr, match, flags))
                     {
                         matchCnt++;
                         const char* begLine = match.prefix().second;
@@ -991,7 +1034,7 @@ unsigned LLReplace::FindGrep()
                                     LLMsg::Out() << match.str();
                                     ResetGrepColor();
                                     begLine = strPtr = match.suffix().first; 
-                                } while (std::regex_search(strPtr, endLine, match, grepLinePat, flags));
+                                } while (grepLinePat.Search(strPtr, endLine, match, flags));
                                 std::string suffix = std::string(match.suffix().first, endLine);
                                 LLMsg::Out() << suffix << std::endl;
                             }
@@ -1036,7 +1079,7 @@ unsigned LLReplace::FindGrep(std::istream& in)
 {
     unsigned matchCnt = 0;
     unsigned lineCnt = 0;
-    std::smatch match;
+    LLRegex::Match match;
     std::regex_constants::match_flag_type flags = std::regex_constants::match_default;
 	std::vector<string> beforeLines(m_grepOpt.beforeCnt);
 	
@@ -1060,14 +1103,16 @@ unsigned LLReplace::FindGrep(std::istream& in)
         // All patterns have to match for the line to match.
         ColorMap  colorMap;
         unsigned itemMatchCnt = 0;
-        std::regex grepLinePat;
         for (unsigned patIdx = 0; patIdx != m_grepReplaceList.size(); patIdx++)
         {
             GrepReplaceItem& grepRepItem = m_grepReplaceList[patIdx];
             if (grepRepItem.m_enabled)
             {
                 bool itemMatches = false;
-                grepLinePat = grepRepItem.m_grepLinePat;
+                const LLRegex& grepLinePat = grepRepItem.m_grepLinePat;
+                // Line without the required literal can't match.
+                const bool mayMatch = grepRepItem.m_replace || grepRepItem.m_prefilter.empty() ||
+                    grepRepItem.m_prefilter.Find(str.data(), str.data() + str.size()) != NULL;
                 std::string replaceStr = grepRepItem.m_replaceStr;
                 if (grepRepItem.m_replace)
                 {
@@ -1075,15 +1120,14 @@ unsigned LLReplace::FindGrep(std::istream& in)
                     size_t off = 0;
                     do 
                     {
-                        std::string::const_iterator begIter = str.begin();
-                        std::string::const_iterator endIter = str.end();
-                        std::advance(begIter, off);
+                        const char* begPtr = str.data() + off;
+                        const char* endPtr = str.data() + str.size();
 						 
-                        if (begIter < endIter && 
-                            std::regex_search(begIter, endIter, match, grepLinePat, flags|std::regex_constants::format_first_only))
+                        if (begPtr < endPtr && 
+                            grepLinePat.Search(begPtr, endPtr, match, flags|std::regex_constants::format_first_only))
                         {
 							std::string subStr = str.substr(off);
-							std::string newStr = std::regex_replace(subStr, grepLinePat, replaceStr, flags|std::regex_constants::format_first_only);
+							std::string newStr = grepLinePat.Replace(subStr, replaceStr, flags|std::regex_constants::format_first_only);
                             int repLen = match.length() + newStr.length() - str.length();
 							if (newStr != subStr)
 							{
@@ -1108,23 +1152,26 @@ unsigned LLReplace::FindGrep(std::istream& in)
                 }
                 else if (grepRepItem.m_onMatch)
                 {
+                    if ( !mayMatch)
+                        continue;
+
                     // Loop to get multiple matches on a line.
-                    std::string::const_iterator begIter = str.begin();
-                    std::string::const_iterator endIter = str.end();
+                    const char* begPtr = str.data();
+                    const char* endPtr = str.data() + str.size();
                     size_t off = 0;
                     while (off < str.length() && 
-                        std::regex_search(begIter, endIter, match, grepLinePat, flags))
+                        grepLinePat.Search(begPtr, endPtr, match, flags))
                     {
                         itemMatches = true;
                         colorMap[uint(match.position() + off)] = ColorInfo((uint)match.length(), MATCH_COLORS[patIdx % ARRAYSIZE(MATCH_COLORS)]);
-                        std::advance (begIter, match.length());
+                        begPtr += match.length();
                         off += match.length();
                     }
                 } 
                 else
                 {
                     // Reverse match
-                    if (std::regex_search(str, match, grepLinePat, flags) == false)
+                    if ( !mayMatch || grepLinePat.Search(str, flags) == false)
                     {
                         itemMatches = true;
                         if (m_grepReplaceList.size() == 1)
@@ -1210,12 +1257,10 @@ unsigned LLReplace::FindGrep(std::istream& in)
 // ---------------------------------------------------------------------------
 void LLReplace::EnableFiltersForFile(const std::string& filePath)
 {
-    std::smatch match;
-    std::regex_constants::match_flag_type flags = std::regex_constants::match_default;
     for (unsigned patIdx = 0; patIdx != m_grepReplaceList.size(); patIdx++)
     {
         GrepReplaceItem& item = m_grepReplaceList[patIdx];
-        item.m_enabled = !item.m_haveFilePat || std::regex_match(filePath, match, item.m_filePathPat, flags);
+        item.m_enabled = !item.m_haveFilePat || item.m_filePathPat.MatchAll(filePath);
     }
 }
 
@@ -1288,7 +1333,6 @@ unsigned LLReplace::FindReplace(const WIN32_FIND_DATA* pFileData)
                 EnableFiltersForFile(m_srcPath);
 
                 // ----- Find and Replace by line -----
-                std::smatch match;
                 std::ifstream in(m_srcPath, inMode, _SH_DENYNO);
                 std::ofstream out;
                 std::streampos inPos = in.tellg();
@@ -1303,8 +1347,8 @@ unsigned LLReplace::FindReplace(const WIN32_FIND_DATA* pFileData)
                         {
                             if (m_grepReplaceList[patIdx].m_enabled)
                             {
-                                std::regex grepLinePat = m_grepReplaceList[patIdx].m_grepLinePat;
-                                if (std::regex_search(str, match, grepLinePat, flags))
+                                const LLRegex& grepLinePat = m_grepReplaceList[patIdx].m_grepLinePat;
+                                if (grepLinePat.Search(str, flags))
                                 {
                                     std::string replaceStr = m_grepReplaceList[patIdx].m_replaceStr;
 
@@ -1312,7 +1356,7 @@ unsigned LLReplace::FindReplace(const WIN32_FIND_DATA* pFileData)
                                     if (matchCnt == 1)
                                         OpenOutput(out, in, inPos);
 
-                                    std::string newStr = std::regex_replace(str, grepLinePat, replaceStr, flags);
+                                    std::string newStr = grepLinePat.Replace(str, replaceStr, flags);
                                     str.swap(newStr);
 
                                     if (m_echo)
@@ -1365,14 +1409,14 @@ unsigned LLReplace::FindReplace(const WIN32_FIND_DATA* pFileData)
 					SIZE_T viewLength = INT_MAX;
 					if (mapFile.Open(m_srcPath) && (mapPtr = mapFile.MapView(0, viewLength)) != NULL)
 					{
-						std::match_results <const char*> match;
+						LLRegex::Match match;
 						const char* begPtr = (const char*)mapPtr;
 						const char* endPtr = begPtr + viewLength;
 						const char* strPtr = begPtr;
-						std::regex grepLinePat = m_grepReplaceList[0].m_grepLinePat;
+						const LLRegex& grepLinePat = m_grepReplaceList[0].m_grepLinePat;
 						std::string replaceStr = m_grepReplaceList[0].m_replaceStr;
 
-						if (std::regex_search(strPtr, endPtr, match, grepLinePat, flags))
+						if (grepLinePat.Search(strPtr, endPtr, match, flags))
 						{
 							matchCnt++;
 							didReplace = true;
@@ -1389,11 +1433,7 @@ unsigned LLReplace::FindReplace(const WIN32_FIND_DATA* pFileData)
 							begPtr = (const char*)mapPtr;
 							begPtr += match.position(0);
 
-							std::regex_replace(
-								std::ostreambuf_iterator<char>(out),
-								begPtr,
-								endPtr,
-								grepLinePat, replaceStr, flags);
+							grepLinePat.Replace(out, begPtr, endPtr, replaceStr, flags);
 
 							mapFile.Close();
 							if (out)
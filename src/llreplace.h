@@ -37,6 +37,7 @@
 #undef byte  
 
 #include "llbase.h"
+#include "grepfilter.h"
 
 // ---------------------------------------------------------------------------
 struct LLReplaceConfig  : public LLConfig
@@ -106,9 +107,10 @@ protected:
         GrepReplaceItem() : m_haveFilePat(false), m_enabled(true), m_onMatch(true), m_replace(false) {}
 
         std::string         m_grepLineStr;
-        std::regex          m_grepLinePat;      // -G=<grepPattern>
+        LLRegex             m_grepLinePat;      // -G=<grepPattern>
+        GrepPrefilter       m_prefilter;        // Literal required by m_grepLineStr
         std::string         m_replaceStr;       // -R=<replacePattern>
-        std::regex          m_filePathPat;      // -M
+        LLRegex             m_filePathPat;      // -M
 		std::string         m_beforeStr;		// -Rbefore=<pattern>
 		std::string         m_afterStr;         // -Rafter=<pattern>
         bool                m_haveFilePat;
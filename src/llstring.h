@@ -82,48 +82,129 @@ public:
 };
 
 
+///
+/// LLPool usage counters, see LLPool::Stats
+struct LLPoolStats
+{
+    size_t      used;       // Bytes handed out by Add
+    size_t      wasted;     // Bytes left unused at the end of full buckets
+    size_t      buckets;    // Live buckets, including large objects
+};
+
 ///
 /// LLPool manages memory in buckets.
+/// Buckets start at bucketSize and double up to maxBucketSize. Objects larger
+/// than a quarter of a bucket get their own allocation. Memory is released by
+/// Reset, back to a Mark, or by Clear.
 // ---------------------------------------------------------------------------
 template <typename T>
 class LLPool
 {
 public:
-    LLPool() noexcept {}
+    static const size_t sBucketSize = 4096*16;
+    static const size_t sMaxBucketSize = 4096*256;
+
+    struct Mark
+    {
+        size_t  buckets;
+        size_t  used;       // Bytes used in last bucket
+        size_t  large;
+    };
+
+    LLPool(size_t bucketSize = sBucketSize, size_t maxBucketSize = sMaxBucketSize) noexcept :
+        m_bucketSize(bucketSize),
+        m_maxBucketSize(maxBucketSize < bucketSize ? bucketSize : maxBucketSize),
+        m_pSpare(nullptr)
+    {}
     ~LLPool() { Clear(); }
 
     void Clear() noexcept
     {
-        for (size_t i=0; i < m_buckets.size(); ++i)
+        Reset(Mark{0, 0, 0});
+        delete m_pSpare;
+        m_pSpare = nullptr;
+    }
+
+    Mark GetMark() const noexcept
+    {
+        Mark mark = { m_buckets.size(), 0, m_large.size() };
+        if ( !m_buckets.empty())
+            mark.used = m_buckets.back()->nextPtr - m_buckets.back()->topPtr;
+        return mark;
+    }
+
+    /// Release everything added after mark, one freed bucket is kept for reuse.
+    void Reset(const Mark& mark) noexcept
+    {
+        assert(mark.buckets <= m_buckets.size() && mark.large <= m_large.size());
+
+        while (m_large.size() > mark.large)
         {
-            delete m_buckets[i];
-            m_buckets[i] = nullptr;
+            delete m_large.back();
+            m_large.pop_back();
         }
 
-        m_buckets.clear();
+        while (m_buckets.size() > mark.buckets)
+        {
+            Bucket* pBucket = m_buckets.back();
+            m_buckets.pop_back();
+            if (m_pSpare == nullptr || m_pSpare->Size() < pBucket->Size())
+                std::swap(m_pSpare, pBucket);
+            delete pBucket;
+        }
+
+        if ( !m_buckets.empty())
+            m_buckets.back()->nextPtr = m_buckets.back()->topPtr + mark.used;
     }
 
-    const T* Add(const T* pObj, size_t len)
+    LLPoolStats Stats() const noexcept
     {
-        assert(len < Bucket::sBucketSize);
-
-        // Make sure we have atleast one bucket.
-        if (m_buckets.size() == 0)
-            m_buckets.push_back(new Bucket());
-        Bucket* pBucket = m_buckets[m_buckets.size()-1];
+        LLPoolStats stats = { 0, 0, m_buckets.size() + m_large.size() };
+        for (size_t i=0; i < m_buckets.size(); ++i)
+        {
+            stats.used += m_buckets[i]->nextPtr - m_buckets[i]->topPtr;
+            if (i + 1 < m_buckets.size())
+                stats.wasted += m_buckets[i]->endPtr - m_buckets[i]->nextPtr;
+        }
+        for (size_t i=0; i < m_large.size(); ++i)
+            stats.used += m_large[i]->Size();
+        return stats;
+    }
 
-        if (pBucket->nextPtr + len >= pBucket->endPtr)
+    const T* Add(const T* pObj, size_t len)
+    {
+        Bucket* pBucket;
+        if (len > NextBucketSize() / 4)
         {
-        _CrtCheckMemory( );
-            // Need more room, add another bucket.
-            m_buckets.push_back(new Bucket());
-            pBucket = m_buckets[m_buckets.size()-1];
-        _CrtCheckMemory( );
+            // Large object, own allocation.
+            m_large.push_back(new Bucket(len));
+            pBucket = m_large.back();
+        }
+        else
+        {
+            pBucket = m_buckets.empty() ? nullptr : m_buckets.back();
+            if (pBucket == nullptr || pBucket->nextPtr + len > pBucket->endPtr)
+            {
+            _CrtCheckMemory( );
+                // Need more room, add another bucket.
+                if (m_pSpare != nullptr && m_pSpare->Size() >= len)
+                {
+                    pBucket = m_pSpare;
+                    pBucket->nextPtr = pBucket->topPtr;
+                    m_pSpare = nullptr;
+                }
+                else
+                {
+                    pBucket = new Bucket(NextBucketSize());
+                }
+                m_buckets.push_back(pBucket);
+            _CrtCheckMemory( );
+            }
         }
 
         if (pObj)
         {
-            assert(pBucket->nextPtr + len < pBucket->endPtr);
+            assert(pBucket->nextPtr + len <= pBucket->endPtr);
             memcpy(pBucket->nextPtr, pObj, len);
         }
         pObj = (const T*)pBucket->nextPtr;
@@ -133,21 +214,38 @@ public:
     }
 
 private:
+    LLPool(const LLPool&);
+    LLPool& operator=(const LLPool&);
+
     struct Bucket
     {
-        static const int sBucketSize = 4096*16;
-        Bucket() noexcept : topPtr(new char[sBucketSize]), nextPtr(topPtr), endPtr(topPtr+sBucketSize){}
+        Bucket(size_t size) : topPtr(new char[size]), nextPtr(topPtr), endPtr(topPtr+size){}
         ~Bucket() { delete [] topPtr; }
+        size_t Size() const { return endPtr - topPtr; }
         char* topPtr;
         char* nextPtr;
         char* endPtr;
     };
+
+    size_t NextBucketSize() const noexcept
+    {
+        if (m_buckets.empty())
+            return (m_pSpare != nullptr) ? m_pSpare->Size() : m_bucketSize;
+        size_t size = m_buckets.back()->Size() * 2;
+        return (size < m_maxBucketSize) ? size : m_maxBucketSize;
+    }
+
+    size_t               m_bucketSize;
+    size_t               m_maxBucketSize;
     std::vector<Bucket*> m_buckets;
+    std::vector<Bucket*> m_large;
+    Bucket*              m_pSpare;
 };
 
 // ---------------------------------------------------------------------------
-// Warning - Does not free memory so heavy use will consume a lot of memory.
-// Ideal for limited burst use.
+// Warning - Shared m_pool does not free memory so heavy use will consume a lot
+// of memory. Ideal for limited burst use, else pass an owned pool which is
+// Reset or Cleared with its owner.
 
 struct LLString
 {
@@ -155,6 +253,10 @@ struct LLString
         m_str(m_pool.Add(str, sizeof(char)*(strlen(str)+1)))
     {}
 
+    LLString(const char* str, LLPool<const char>& pool) :
+        m_str(pool.Add(str, sizeof(char)*(strlen(str)+1)))
+    {}
+
     operator const char*() noexcept
     { return m_str; }
 
@@ -501,11 +501,15 @@ bool RunCommand(const char* command, DWORD* pExitCode, int waitMsec)
 
 //-----------------------------------------------------------------------------
 // Read filenames from input file or stdin if "-"
+//  metaDemand (MetaDemand bits) limits the lookup per file:
+//      eMetaAttr   GetFileAttributes only, size and times left zero.
+//      otherwise   GetFileAttributesEx, attributes, size and times.
 int ReadFileList(
     const char* fileListName,
     DoFileCb doFileCb,
     void* cbData,
-    ErrFileCb errFileCb)
+    ErrFileCb errFileCb,
+    unsigned metaDemand)
 {
     FILE* fin = stdin;
 
@@ -514,7 +518,7 @@ int ReadFileList(
         return errno;
 
     char fileName[LL_MAX_PATH];
-    BY_HANDLE_FILE_INFORMATION fileInfo;
+    WIN32_FILE_ATTRIBUTE_DATA fileInfo;
     WIN32_FIND_DATA findData;
 
     while (fgets(fileName, ARRAYSIZE(fileName), fin))
@@ -523,6 +527,18 @@ int ReadFileList(
         if (*fileName == '\0')
             continue;
 
+        bool found;
+        if (metaDemand == eMetaAttr)
+        {
+            memset(&fileInfo, 0, sizeof(fileInfo));
+            fileInfo.dwFileAttributes = GetFileAttributes(fileName);
+            found = (fileInfo.dwFileAttributes != INVALID_FILE_ATTRIBUTES);
+        }
+        else
+        {
+            found = (GetFileAttributesEx(fileName, GetFileExInfoStandard, &fileInfo) != 0);
+        }
+
         strcpy_s(findData.cFileName, ARRAYSIZE(findData.cFileName), fileName);
         const char* pDir = ".";
 
@@ -534,8 +550,7 @@ int ReadFileList(
             pDir = fileName;
         }
 
-        Handle hFile = CreateFile(fileName, FILE_READ_ATTRIBUTES, 7, 0, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, 0);
-        if (hFile.IsValid() && GetFileInformationByHandle(hFile, &fileInfo) != 0)
+        if (found)
         {
             findData.dwFileAttributes = fileInfo.dwFileAttributes;
             findData.ftCreationTime = fileInfo.ftCreationTime;
@@ -1017,7 +1032,7 @@ bool TimeOperation(
     const WIN32_FIND_DATA* pDirEntry,
     SizeOp timeOp,
     TimeFields fields,
-    FILETIME& refFtime)
+    const FILETIME& refFtime)
 {
     bool isAccTm = (fields & eTestAccessTime) != 0;
     bool isCrtTm = (fields & eTestCreationTime) != 0;
@@ -1245,6 +1260,21 @@ const char* ParseList(
     return cmdOpts;
 }
 
+// ---------------------------------------------------------------------------
+//  Parse list and compile each pattern once.
+const char* ParseList(
+    const char* cmdOpts,
+    PatternList& patList,
+    const char* emptyMsg)
+{
+    StringList strList;
+    cmdOpts = ParseList(cmdOpts, strList, emptyMsg);
+    for (const std::string& pattern : strList)
+        patList.push_back(CompiledPattern(pattern));
+    patList.Build();
+    return cmdOpts;
+}
+
 // ---------------------------------------------------------------------------
 bool PatternListMatches(const StringList& patList, const char* fileName, bool emptyResult)
 {
@@ -1260,6 +1290,15 @@ bool PatternListMatches(const StringList& patList, const char* fileName, bool em
     return false;
 }
 
+// ---------------------------------------------------------------------------
+bool PatternListMatches(const PatternList& patList, const char* fileName, bool emptyResult)
+{
+    if (patList.empty())
+        return emptyResult;
+
+    return patList.Matches(fileName);
+}
+
 // ---------------------------------------------------------------------------
 // Parse:  -A=[nrhs]     ; show only (n=normal r=readonly, h=hidden, s=system)\n"
 const char* ParseAttributes(const char* cmdOpts,  DWORD& attributes, const char* errMsg)
@@ -66,6 +66,7 @@
 
 #include "ll_stdhdr.h"
 #include "llstring.h"
+#include "patternset.h"
 #include "hash.h"
 
 // End-Of-Command, used to separate commands.
@@ -172,7 +173,9 @@ inline bool CompareDeviceBits(DWORD file, DWORD show)
 // return 0 if all okay, else error.
 typedef int (*DoFileCb)(void* pLLDir, const char* pDir, const WIN32_FIND_DATA* pFileData, int depth);
 typedef int (*ErrFileCb)(void* pLLDir, const char* errFile, const WIN32_FIND_DATA* pFileData);
-int ReadFileList(const char* fileName, DoFileCb, void* cbData, ErrFileCb = 0);
+// File metadata consumed by filters and output, attributes are always read.
+enum MetaDemand { eMetaAttr = 0, eMetaSize = 1, eMetaTime = 2, eMetaAll = eMetaSize | eMetaTime };
+int ReadFileList(const char* fileName, DoFileCb, void* cbData, ErrFileCb = 0, unsigned metaDemand = eMetaAll);
 
 enum SizeOp { eOpNone, eOpEqual, eOpGreater, eOpLess, eOpNotEqual };
 const char* ParseExitOp(const char* cmdOpts, SizeOp& exitOp, LONGLONG& exitValue, uint& loopCnt, const char* errMsg);
@@ -185,7 +188,7 @@ enum  TimeFields { eTestNoTime = 0, eTestAccessTime=1, eTestCreationTime=2, eTes
 const char* ParseTimeOp(const char* cmdOpts, bool& valid, TimeFields&, SizeOp&, FILETIME& localTime);
 bool ParseTime(const char*& inStr, FILETIME& outFileUtcTime);
 // Return true if time operation passes.
-bool TimeOperation(const WIN32_FIND_DATA* pDirEntry, SizeOp, TimeFields, FILETIME& refTime);
+bool TimeOperation(const WIN32_FIND_DATA* pDirEntry, SizeOp, TimeFields, const FILETIME& refTime);
 FILETIME UnixTimeToFileTime(time_t t, FILETIME& fileTime);
 std::ostream& Format(std::ostream& out, const FILETIME& utcFT, bool localTz=true);
 
@@ -201,13 +204,16 @@ bool SetFileModTime(const char* dstPath, const FILETIME& fileUtcTime);
 int FileTimeDifference(const FILETIME& ft1, const FILETIME& ft2, const ULONGLONG& resolution = 500e9);
 
 typedef std::vector<std::string> StringList;
+typedef PatternSet PatternList;
 
 //  Parse -F or -X*.exe,*.lib;p???.dat,foo.bar
 const char* ParseList(const char* cmdOpts, StringList& strList, const char* emptyErrMsg /* = NULL */);
+const char* ParseList(const char* cmdOpts, PatternList& patList, const char* emptyErrMsg /* = NULL */);
 
 // Return true if file matches pattern in list.
 // Return emptyListResult if patList is empty.
 bool PatternListMatches(const StringList& patList, const char* fileName, bool emptyListResult = false);
+bool PatternListMatches(const PatternList& patList, const char* fileName, bool emptyListResult = false);
 
 // Parse:  -A[nrhs]     ; show only (n=normal r=readonly, h=hidden, s=system)\n"
 const char* ParseAttributes(const char* cmdOpts,  DWORD& attributes, const char* errMsg);
@@ -0,0 +1,326 @@
+//-----------------------------------------------------------------------------
+// patternset - Match a list of wildcard patterns in one pass.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <bitset>
+#include <deque>
+
+#include "patternset.h"
+
+//-----------------------------------------------------------------------------
+PatternSet::PatternSet() :
+    m_dirty(false)
+{
+    Rebuild();
+}
+
+//-----------------------------------------------------------------------------
+// Tables are rebuilt once by Build, so adding n patterns stays linear.
+void PatternSet::push_back(const CompiledPattern& pattern)
+{
+    m_patterns.push_back(pattern);
+    m_dirty = true;
+}
+
+//-----------------------------------------------------------------------------
+void PatternSet::Build()
+{
+    if (m_dirty)
+        Rebuild();
+}
+
+//-----------------------------------------------------------------------------
+void PatternSet::clear()
+{
+    m_patterns.clear();
+    Rebuild();
+}
+
+//-----------------------------------------------------------------------------
+// Group patterns by shape, negated patterns are always general.
+void PatternSet::Rebuild()
+{
+    const Node root = { {}, 0, sNone, {} };
+    const unsigned char* pFold = CompiledPattern::FoldTable();
+
+    m_extMap.clear();
+    m_literalMap.clear();
+    m_prefix.assign(1, root);
+    m_keys.assign(1, root);
+    m_general.clear();
+    m_always.clear();
+
+    for (unsigned patIdx = 0; patIdx < m_patterns.size(); patIdx++)
+    {
+        const std::string& pattern = m_patterns[patIdx].Pattern();
+        const bool negate = (pattern.length() > 1 && pattern[0] == '!');
+
+        std::string folded;
+        for (char chr : pattern)
+            folded += (char)pFold[(unsigned char)chr];
+
+        const size_t wildPos = folded.find_first_of("*?");
+
+        if ( !negate && wildPos == std::string::npos)
+        {
+            m_literalMap.emplace(folded, patIdx);
+        }
+        else if ( !negate && folded.length() > 1 && folded[0] == '*' && folded[1] == '.'
+            && folded.find_first_of("*?", 1) == std::string::npos)
+        {
+            m_extMap.emplace(folded.substr(1), patIdx);
+        }
+        else if ( !negate && wildPos + 1 == folded.length() && folded.back() == '*')
+        {
+            AddPrefix(folded.substr(0, wildPos), patIdx);
+        }
+        else
+        {
+            // Key is longest literal run, pattern can only match if key is present.
+            const unsigned slot = (unsigned)m_general.size();
+            m_general.push_back(patIdx);
+
+            std::string key;
+            size_t off = negate ? 1 : 0;
+            while ( !negate && off < folded.length())
+            {
+                size_t len = folded.find_first_of("*?", off);
+                if (len == std::string::npos)
+                    len = folded.length();
+                len -= off;
+                if (len > key.length())
+                    key = folded.substr(off, len);
+                off += len + 1;
+            }
+
+            if (key.empty())
+                m_always.push_back(slot);
+            else
+                AddKey(key, slot);
+        }
+    }
+
+    BuildFailLinks();
+    m_dirty = false;
+}
+
+//-----------------------------------------------------------------------------
+int PatternSet::Child(const std::vector<Node>& nodes, int node, char chr)
+{
+    for (const auto& next : nodes[node].next)
+    {
+        if (next.first == chr)
+            return next.second;
+    }
+    return -1;
+}
+
+//-----------------------------------------------------------------------------
+void PatternSet::AddPrefix(const std::string& prefix, unsigned patIdx)
+{
+    int node = 0;
+    for (char chr : prefix)
+    {
+        int child = Child(m_prefix, node, chr);
+        if (child < 0)
+        {
+            child = (int)m_prefix.size();
+            m_prefix.push_back(Node{ {}, 0, sNone, {} });
+            m_prefix[node].next.push_back(std::make_pair(chr, child));
+        }
+        node = child;
+    }
+
+    if (m_prefix[node].patIdx == sNone)
+        m_prefix[node].patIdx = patIdx;
+}
+
+//-----------------------------------------------------------------------------
+void PatternSet::AddKey(const std::string& key, unsigned slot)
+{
+    int node = 0;
+    for (char chr : key)
+    {
+        int child = Child(m_keys, node, chr);
+        if (child < 0)
+        {
+            child = (int)m_keys.size();
+            m_keys.push_back(Node{ {}, 0, sNone, {} });
+            m_keys[node].next.push_back(std::make_pair(chr, child));
+        }
+        node = child;
+    }
+    m_keys[node].out.push_back(slot);
+}
+
+//-----------------------------------------------------------------------------
+// Breadth first, set fail link to longest proper suffix which is also in trie
+// and merge its output so search only looks at current node.
+void PatternSet::BuildFailLinks()
+{
+    std::deque<int> todo;
+    todo.push_back(0);
+
+    while ( !todo.empty())
+    {
+        const int node = todo.front();
+        todo.pop_front();
+
+        for (const auto& next : m_keys[node].next)
+        {
+            const int child = next.second;
+            int fail = 0;
+            if (node != 0)
+            {
+                fail = m_keys[node].fail;
+                while (fail != 0 && Child(m_keys, fail, next.first) < 0)
+                    fail = m_keys[fail].fail;
+                fail = Child(m_keys, fail, next.first);
+                if (fail < 0)
+                    fail = 0;
+            }
+
+            m_keys[child].fail = fail;
+            const std::vector<unsigned>& failOut = m_keys[fail].out;
+            m_keys[child].out.insert(m_keys[child].out.end(), failOut.begin(), failOut.end());
+            todo.push_back(child);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Test general patterns which can beat best, return new best.
+unsigned PatternSet::FindGeneral(const char* pFolded, size_t len, const char* str, unsigned best) const
+{
+    std::bitset<1024> tested;      // Avoid testing a slot twice.
+
+    auto test = [&](unsigned slot)
+    {
+        const unsigned patIdx = m_general[slot];
+        if (patIdx >= best)
+            return;
+        if (slot < tested.size())
+        {
+            if (tested[slot])
+                return;
+            tested[slot] = true;
+        }
+        if (m_patterns[patIdx].Matches(str))
+            best = patIdx;
+    };
+
+    for (unsigned slot : m_always)
+        test(slot);
+
+    if (m_keys.size() > 1)
+    {
+        int state = 0;
+        for (size_t idx = 0; idx < len; idx++)
+        {
+            const char chr = pFolded[idx];
+            int next;
+            while ((next = Child(m_keys, state, chr)) < 0 && state != 0)
+                state = m_keys[state].fail;
+            state = (next < 0) ? 0 : next;
+
+            for (unsigned slot : m_keys[state].out)
+                test(slot);
+        }
+    }
+
+    return best;
+}
+
+//-----------------------------------------------------------------------------
+int PatternSet::Find(const char* str) const
+{
+    if (m_patterns.empty())
+        return -1;
+
+    // Tables not built yet, test each pattern in turn.
+    if (m_dirty)
+    {
+        for (size_t patIdx = 0; patIdx < m_patterns.size(); patIdx++)
+        {
+            if (m_patterns[patIdx].Matches(str))
+                return (int)patIdx;
+        }
+        return -1;
+    }
+
+    // Fold once, long names fall back to heap.
+    const unsigned char* pFold = CompiledPattern::FoldTable();
+    const size_t len = strlen(str);
+    char foldBuf[LL_MAX_PATH];
+    std::string foldStr;
+    char* pFolded = foldBuf;
+    if (len >= sizeof(foldBuf))
+    {
+        foldStr.resize(len);
+        pFolded = &foldStr[0];
+    }
+    for (size_t idx = 0; idx < len; idx++)
+        pFolded[idx] = (char)pFold[(unsigned char)str[idx]];
+
+    unsigned best = sNone;
+
+    if ( !m_literalMap.empty())
+    {
+        auto iter = m_literalMap.find(std::string_view(pFolded, len));
+        if (iter != m_literalMap.end())
+            best = iter->second;
+    }
+
+    if ( !m_extMap.empty())
+    {
+        for (size_t idx = len; idx-- > 0; )
+        {
+            if (pFolded[idx] != '.')
+                continue;
+            auto iter = m_extMap.find(std::string_view(pFolded + idx, len - idx));
+            if (iter != m_extMap.end() && iter->second < best)
+                best = iter->second;
+        }
+    }
+
+    int node = 0;
+    for (size_t idx = 0; node >= 0; idx++)
+    {
+        if (m_prefix[node].patIdx < best)
+            best = m_prefix[node].patIdx;
+        if (idx == len)
+            break;
+        node = Child(m_prefix, node, pFolded[idx]);
+    }
+
+    if ( !m_general.empty())
+        best = FindGeneral(pFolded, len, str, best);
+
+    return (best == sNone) ? -1 : (int)best;
+}
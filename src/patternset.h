@@ -0,0 +1,109 @@
+//-----------------------------------------------------------------------------
+// patternset - Match a list of wildcard patterns in one pass.
+//
+// Author: Dennis Lang - 2015
+// http://landenlabs.com/
+//
+// This file is part of LLFile project.
+//
+// ----- License ----
+//
+// Copyright (c) 2015 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "dirscan.h"
+
+// List of wildcard patterns (-F, -X, -D) matched together.
+// Patterns are grouped by shape when added:
+//      *.ext       ; hash of folded extensions, looked up at each '.' in name
+//      literal     ; hash of folded names
+//      prefix*     ; trie walked once from start of name
+//      other       ; Aho-Corasick over longest literal run of each pattern,
+//                    only patterns whose run is present are fully matched.
+class PatternSet
+{
+public:
+    PatternSet();
+
+    // Add pattern, call Build once all patterns are added.
+    void push_back(const CompiledPattern& pattern);
+    void clear();
+
+    // Rebuild lookup tables if patterns were added since last Build.
+    // Find before Build still works, it tests each pattern in turn.
+    void Build();
+
+    bool empty() const noexcept
+    { return m_patterns.empty(); }
+    size_t size() const noexcept
+    { return m_patterns.size(); }
+    const CompiledPattern& operator[](size_t idx) const
+    { return m_patterns[idx]; }
+
+    // Return lowest index of matching pattern, or -1 if none match.
+    int Find(const char* str) const;
+
+    bool Matches(const char* str) const
+    { return Find(str) >= 0; }
+
+private:
+    void Rebuild();
+    void AddPrefix(const std::string& prefix, unsigned patIdx);
+    void AddKey(const std::string& key, unsigned slot);
+    void BuildFailLinks();
+    unsigned FindGeneral(const char* pFolded, size_t len, const char* str, unsigned best) const;
+
+    // Heterogeneous lookup so folded string_view does not allocate.
+    struct KeyHash
+    {
+        using is_transparent = void;
+        size_t operator()(std::string_view key) const noexcept
+        { return std::hash<std::string_view>()(key); }
+    };
+    typedef std::unordered_map<std::string, unsigned, KeyHash, std::equal_to<>> KeyMap;
+
+    // Trie node, also used for Aho-Corasick.
+    struct Node
+    {
+        std::vector<std::pair<char, int>> next;
+        int         fail;       // Aho-Corasick fail link
+        unsigned    patIdx;     // Lowest prefix pattern ending here
+        std::vector<unsigned> out;  // General patterns whose key ends here
+    };
+
+    static int Child(const std::vector<Node>& nodes, int node, char chr);
+
+    static const unsigned sNone = (unsigned)-1;
+
+    std::vector<CompiledPattern> m_patterns;
+    bool                m_dirty;        // Patterns added since Rebuild
+    KeyMap              m_extMap;       // ".ext" => lowest pattern index
+    KeyMap              m_literalMap;   // "name" => lowest pattern index
+    std::vector<Node>   m_prefix;       // Trie, node 0 is root
+    std::vector<Node>   m_keys;         // Aho-Corasick, node 0 is root
+    std::vector<unsigned> m_general;    // Pattern index of general patterns, increasing
+    std::vector<unsigned> m_always;     // m_general slots without a key, always tested
+};